@@ -0,0 +1,347 @@
+#ifndef BILATERALGRID_H
+#define BILATERALGRID_H
+
+#include "ImageKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ImageKernels {
+
+/**
+ * @brief 双边网格(空间×强度)的一个单元：加权强度和与权重
+ */
+struct BilateralCell {
+    float value = 0.0f;
+    float weight = 0.0f;
+};
+
+/**
+ * @brief 下采样的四维双边网格，强度轴在最内层以便切片时连续读取
+ *
+ * 单元总数受kMaxCells限制：按σ采样超出预算时，空间与强度采样间隔同乘coarsening放粗网格，
+ * 模糊核的σ相应缩小为1/coarsening个单元，使模糊的物理尺度仍等于给定的σ。
+ */
+class BilateralGrid {
+public:
+    static const int kPadding = 2;       // 与模糊核半径一致，避免边界判断
+    static const int kMaxRangeBins = 256; // 限制强度轴长度，防止极小的强度σ导致网格过大
+    static const vtkIdType kMaxCells = 32ll * 1024 * 1024; // 每单元8字节，约256MB
+
+    BilateralGrid(const int imageDims[3], double spatialSampling, double minValue, double maxValue,
+                  double rangeSampling, double coarsening = 1.0)
+        : spatial(std::max(1.0, spatialSampling) * std::max(1.0, coarsening))
+        , minimum(minValue)
+        , blurSigma(1.0 / std::max(1.0, coarsening))
+    {
+        range = rangeSamplingFor(minValue, maxValue, rangeSampling) * std::max(1.0, coarsening);
+        gridDims(imageDims, spatial, std::max(0.0, maxValue - minValue) / range, dims);
+        strides[0] = dims[3];
+        strides[1] = strides[0] * dims[0];
+        strides[2] = strides[1] * dims[1];
+        cells.assign(static_cast<size_t>(strides[2] * dims[2]), BilateralCell());
+    }
+
+    // 使单元数不超过kMaxCells所需的放粗倍数(不需要时为1)
+    static double requiredCoarsening(const int imageDims[3], double spatialSampling, double minValue,
+                                     double maxValue, double rangeSampling) {
+        const double spatialBase = std::max(1.0, spatialSampling);
+        const double rangeBins = std::max(0.0, maxValue - minValue) /
+                                 rangeSamplingFor(minValue, maxValue, rangeSampling);
+        double coarsening = 1.0;
+        for (;;) {
+            int d[4];
+            gridDims(imageDims, spatialBase * coarsening, rangeBins / coarsening, d);
+            if (static_cast<double>(d[0]) * d[1] * d[2] * d[3] <= static_cast<double>(kMaxCells)) {
+                return coarsening;
+            }
+            coarsening *= 1.25;
+        }
+    }
+
+    // 体素坐标到网格坐标(含填充)的最近单元
+    int spatialCell(int i) const {
+        return static_cast<int>(std::floor(i / spatial + 0.5));
+    }
+
+    double spatialCoordinate(int i) const {
+        return i / spatial + kPadding;
+    }
+
+    double rangeCoordinate(double value) const {
+        return (value - minimum) / range + kPadding;
+    }
+
+    BilateralCell* cell(int x, int y, int z) {
+        return cells.data() + x * strides[0] + y * strides[1] + z * strides[2];
+    }
+
+    const BilateralCell* cell(int x, int y, int z) const {
+        return cells.data() + x * strides[0] + y * strides[1] + z * strides[2];
+    }
+
+    // 模糊核的σ(单元)
+    double getBlurSigma() const {
+        return blurSigma;
+    }
+
+    int dims[4] = {0, 0, 0, 0}; // x, y, z, 强度
+    vtkIdType strides[3] = {0, 0, 0};
+
+private:
+    static double rangeSamplingFor(double minValue, double maxValue, double rangeSampling) {
+        const double valueRange = std::max(0.0, maxValue - minValue);
+        return std::max(rangeSampling > 0.0 ? rangeSampling : 1.0, valueRange / (kMaxRangeBins - 1));
+    }
+
+    static void gridDims(const int imageDims[3], double spatialSampling, double rangeBins, int d[4]) {
+        for (int i = 0; i < 3; ++i) {
+            d[i] = static_cast<int>(std::floor((imageDims[i] - 1) / spatialSampling + 0.5)) + 1 + 2 * kPadding;
+        }
+        d[3] = static_cast<int>(std::floor(rangeBins + 0.5)) + 1 + 2 * kPadding;
+    }
+
+    double spatial;
+    double range = 1.0;
+    double minimum;
+    double blurSigma;
+    std::vector<BilateralCell> cells;
+};
+
+namespace detail {
+
+/**
+ * @brief 五点模糊核：σ不小于1个单元时为[1 4 6 4 1]/16，放粗的网格用σ单元的归一化高斯
+ */
+inline void bilateralBlurKernel(double sigma, float kernel[5]) {
+    if (sigma >= 1.0) {
+        const float binomial[5] = {1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16};
+        std::copy(binomial, binomial + 5, kernel);
+        return;
+    }
+    double sum = 0.0;
+    double taps[5];
+    for (int i = -2; i <= 2; ++i) {
+        taps[i + 2] = std::exp(-0.5 * i * i / (sigma * sigma));
+        sum += taps[i + 2];
+    }
+    for (int i = 0; i < 5; ++i) {
+        kernel[i] = static_cast<float>(taps[i] / sum);
+    }
+}
+
+/**
+ * @brief 沿一条网格线做五点模糊，两端的填充单元视为零
+ */
+inline void blurBilateralLine(BilateralCell* start, vtkIdType stride, int n, const float kernel[5],
+                              std::vector<BilateralCell>& line) {
+    line.assign(static_cast<size_t>(n) + 4, BilateralCell());
+    for (int i = 0; i < n; ++i) {
+        line[i + 2] = start[i * stride];
+    }
+    for (int i = 0; i < n; ++i) {
+        const BilateralCell* c = line.data() + i;
+        BilateralCell& out = start[i * stride];
+        out.value = kernel[0] * c[0].value + kernel[1] * c[1].value + kernel[2] * c[2].value +
+                    kernel[3] * c[3].value + kernel[4] * c[4].value;
+        out.weight = kernel[0] * c[0].weight + kernel[1] * c[1].weight + kernel[2] * c[2].weight +
+                     kernel[3] * c[3].weight + kernel[4] * c[4].weight;
+    }
+}
+
+inline void blurBilateralGrid(BilateralGrid& grid) {
+    const int* dims = grid.dims;
+    vtkSMPThreadLocal<std::vector<BilateralCell>> lineBuffers;
+    float kernel[5];
+    bilateralBlurKernel(grid.getBlurSigma(), kernel);
+
+    // 强度轴与x、y轴的线都位于同一网格z切片内，按z并行
+    forEachSlice(dims[2], [&](int z) {
+        std::vector<BilateralCell>& line = lineBuffers.Local();
+        for (int y = 0; y < dims[1]; ++y) {
+            for (int x = 0; x < dims[0]; ++x) {
+                blurBilateralLine(grid.cell(x, y, z), 1, dims[3], kernel, line);
+            }
+            for (int r = 0; r < dims[3]; ++r) {
+                blurBilateralLine(grid.cell(0, y, z) + r, grid.strides[0], dims[0], kernel, line);
+            }
+        }
+        for (int x = 0; x < dims[0]; ++x) {
+            for (int r = 0; r < dims[3]; ++r) {
+                blurBilateralLine(grid.cell(x, 0, z) + r, grid.strides[1], dims[1], kernel, line);
+            }
+        }
+    });
+    forEachSlice(dims[1], [&](int y) {
+        std::vector<BilateralCell>& line = lineBuffers.Local();
+        for (int x = 0; x < dims[0]; ++x) {
+            for (int r = 0; r < dims[3]; ++r) {
+                blurBilateralLine(grid.cell(x, y, 0) + r, grid.strides[2], dims[2], kernel, line);
+            }
+        }
+    });
+}
+
+} // namespace detail
+
+/**
+ * @brief 直接双边滤波：在半径ceil(2σ)的邻域内按空间高斯与强度高斯加权平均，邻域越出图像的部分忽略
+ *
+ * 计算量与邻域体素数成正比，仅用于空间σ较小的情况。
+ */
+template<typename TIn, typename TOut>
+void bilateralDirectFilter(const VoxelView<const TIn>& in, const VoxelView<TOut>& out,
+                           double spatialSigma, double rangeSigma) {
+    const double sigma = std::max(spatialSigma, 1e-3);
+    const int radius = static_cast<int>(std::ceil(2.0 * sigma));
+    const int width = 2 * radius + 1;
+    std::vector<float> spatialWeights(static_cast<size_t>(width) * width * width);
+    for (int dz = -radius; dz <= radius; ++dz) {
+        for (int dy = -radius; dy <= radius; ++dy) {
+            for (int dx = -radius; dx <= radius; ++dx) {
+                const double d2 = dx * dx + dy * dy + dz * dz;
+                spatialWeights[((dz + radius) * width + dy + radius) * width + dx + radius] =
+                    static_cast<float>(std::exp(-0.5 * d2 / (sigma * sigma)));
+            }
+        }
+    }
+    const double range = rangeSigma > 0.0 ? rangeSigma : 1.0;
+    const float rangeFactor = static_cast<float>(-0.5 / (range * range));
+
+    forEachSlice(in.dims[2], [&](int z) {
+        for (int y = 0; y < in.dims[1]; ++y) {
+            TOut* dst = out.row(y, z);
+            for (int x = 0; x < in.dims[0]; ++x) {
+                const float center = static_cast<float>(in.row(y, z)[x * in.strides[0]]);
+                float sumValue = 0.0f;
+                float sumWeight = 0.0f;
+                for (int nz = std::max(0, z - radius); nz <= std::min(in.dims[2] - 1, z + radius); ++nz) {
+                    for (int ny = std::max(0, y - radius); ny <= std::min(in.dims[1] - 1, y + radius); ++ny) {
+                        const TIn* row = in.row(ny, nz);
+                        const float* weights =
+                            spatialWeights.data() + ((nz - z + radius) * width + ny - y + radius) * width + radius;
+                        for (int nx = std::max(0, x - radius); nx <= std::min(in.dims[0] - 1, x + radius); ++nx) {
+                            const float value = static_cast<float>(row[nx * in.strides[0]]);
+                            const float diff = value - center;
+                            const float w = weights[nx - x] * std::exp(rangeFactor * diff * diff);
+                            sumValue += w * value;
+                            sumWeight += w;
+                        }
+                    }
+                }
+                dst[x * out.strides[0]] = saturateCast<TOut>(sumValue / sumWeight);
+            }
+        }
+    });
+}
+
+/**
+ * @brief 双边网格加速的双边滤波
+ *
+ * 以空间σ和强度σ为采样间隔构建下采样网格：先将每个体素累加到最近的网格单元(splat)，
+ * 再在四个轴上做小核模糊，最后按体素坐标和强度四线性插值取回(slice)并归一化。
+ * 网格规模与空间σ的三次方成反比，计算量不随空间σ增大。
+ * splat按网格z切片并行(每个网格切片只由一个任务写入)，模糊和slice同样按切片并行。
+ * 网格超出BilateralGrid::kMaxCells时：空间σ较小(邻域半径不超过kMaxDirectRadius)则改用直接滤波，
+ * 否则放粗网格并相应缩小模糊核，内存始终受预算限制。
+ *
+ * @param spatialSigma 空间σ(体素)
+ * @param rangeSigma 强度σ(与体素值同单位)
+ */
+template<typename TIn, typename TOut>
+void bilateralGridFilter(const VoxelView<const TIn>& in, const VoxelView<TOut>& out,
+                         double spatialSigma, double rangeSigma) {
+    double minValue = 0.0;
+    double maxValue = 0.0;
+    valueRange(in, minValue, maxValue);
+    const double coarsening =
+        BilateralGrid::requiredCoarsening(in.dims, spatialSigma, minValue, maxValue, rangeSigma);
+    const int kMaxDirectRadius = 2;
+    if (coarsening > 1.0 && std::ceil(2.0 * spatialSigma) <= kMaxDirectRadius) {
+        bilateralDirectFilter(in, out, spatialSigma, rangeSigma);
+        return;
+    }
+    BilateralGrid grid(in.dims, spatialSigma, minValue, maxValue, rangeSigma, coarsening);
+    const int pad = BilateralGrid::kPadding;
+
+    // 每个网格z切片对应的输入切片区间
+    const int coreSlices = grid.dims[2] - 2 * pad;
+    std::vector<int> sliceBegin(static_cast<size_t>(coreSlices) + 1, in.dims[2]);
+    for (int z = in.dims[2] - 1; z >= 0; --z) {
+        sliceBegin[grid.spatialCell(z)] = z;
+    }
+    for (int g = coreSlices - 1; g >= 0; --g) {
+        sliceBegin[g] = std::min(sliceBegin[g], sliceBegin[g + 1]);
+    }
+
+    forEachSlice(coreSlices, [&](int g) {
+        for (int z = sliceBegin[g]; z < sliceBegin[g + 1]; ++z) {
+            for (int y = 0; y < in.dims[1]; ++y) {
+                const TIn* row = in.row(y, z);
+                BilateralCell* gridRow = grid.cell(0, grid.spatialCell(y) + pad, g + pad);
+                for (int x = 0; x < in.dims[0]; ++x) {
+                    const double value = static_cast<double>(row[x * in.strides[0]]);
+                    const int r = static_cast<int>(std::floor(grid.rangeCoordinate(value) + 0.5));
+                    BilateralCell& c = gridRow[(grid.spatialCell(x) + pad) * grid.strides[0] + r];
+                    c.value += static_cast<float>(value);
+                    c.weight += 1.0f;
+                }
+            }
+        }
+    });
+
+    detail::blurBilateralGrid(grid);
+
+    // x方向的网格坐标与插值权重每行相同，预先计算
+    std::vector<int> cellX(static_cast<size_t>(in.dims[0]));
+    std::vector<float> fractionX(static_cast<size_t>(in.dims[0]));
+    for (int x = 0; x < in.dims[0]; ++x) {
+        const double gx = grid.spatialCoordinate(x);
+        cellX[x] = static_cast<int>(gx);
+        fractionX[x] = static_cast<float>(gx - cellX[x]);
+    }
+
+    const vtkIdType sx = grid.strides[0];
+    const vtkIdType sy = grid.strides[1];
+    const vtkIdType sz = grid.strides[2];
+    forEachSlice(in.dims[2], [&](int z) {
+        const double gz = grid.spatialCoordinate(z);
+        const int cz = static_cast<int>(gz);
+        const float fz = static_cast<float>(gz - cz);
+        for (int y = 0; y < in.dims[1]; ++y) {
+            const double gy = grid.spatialCoordinate(y);
+            const int cy = static_cast<int>(gy);
+            const float fy = static_cast<float>(gy - cy);
+            const BilateralCell* base = grid.cell(0, cy, cz);
+            const TIn* src = in.row(y, z);
+            TOut* dst = out.row(y, z);
+            for (int x = 0; x < in.dims[0]; ++x) {
+                const float value = static_cast<float>(src[x * in.strides[0]]);
+                const double gr = grid.rangeCoordinate(value);
+                const int cr = static_cast<int>(gr);
+                const float fr = static_cast<float>(gr - cr);
+                const float fx = fractionX[x];
+                const BilateralCell* c = base + cellX[x] * sx + cr;
+
+                float sumValue = 0.0f;
+                float sumWeight = 0.0f;
+                for (int corner = 0; corner < 16; ++corner) {
+                    const int ix = corner & 1;
+                    const int iy = (corner >> 1) & 1;
+                    const int iz = (corner >> 2) & 1;
+                    const int ir = (corner >> 3) & 1;
+                    const float w = (ix ? fx : 1.0f - fx) * (iy ? fy : 1.0f - fy)
+                                  * (iz ? fz : 1.0f - fz) * (ir ? fr : 1.0f - fr);
+                    const BilateralCell& cell = c[ix * sx + iy * sy + iz * sz + ir];
+                    sumValue += w * cell.value;
+                    sumWeight += w * cell.weight;
+                }
+                dst[x * out.strides[0]] = saturateCast<TOut>(sumWeight > 0.0f ? sumValue / sumWeight : value);
+            }
+        }
+    });
+}
+
+} // namespace ImageKernels
+
+#endif // BILATERALGRID_H
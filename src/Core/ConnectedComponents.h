@@ -0,0 +1,308 @@
+#ifndef CONNECTEDCOMPONENTS_H
+#define CONNECTEDCOMPONENTS_H
+
+#include "ImageKernels.h"
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace ImageKernels {
+
+/**
+ * @brief 单个连通域的体素数与包围盒(体素索引，闭区间)
+ */
+struct ComponentStatistics {
+    long long voxelCount = 0;
+    int bounds[6] = {INT_MAX, INT_MIN, INT_MAX, INT_MIN, INT_MAX, INT_MIN}; // xmin,xmax,ymin,ymax,zmin,zmax
+
+    void add(int x, int y, int z) {
+        ++voxelCount;
+        bounds[0] = std::min(bounds[0], x);
+        bounds[1] = std::max(bounds[1], x);
+        bounds[2] = std::min(bounds[2], y);
+        bounds[3] = std::max(bounds[3], y);
+        bounds[4] = std::min(bounds[4], z);
+        bounds[5] = std::max(bounds[5], z);
+    }
+
+    void merge(const ComponentStatistics& other) {
+        voxelCount += other.voxelCount;
+        for (int i = 0; i < 6; i += 2) {
+            bounds[i] = std::min(bounds[i], other.bounds[i]);
+            bounds[i + 1] = std::max(bounds[i + 1], other.bounds[i + 1]);
+        }
+    }
+};
+
+namespace detail {
+
+struct NeighborOffset {
+    int dx;
+    int dy;
+    int dz;
+};
+
+// 光栅扫描顺序中已访问的邻居(前向半邻域)
+inline std::vector<NeighborOffset> backwardNeighbors(int connectivity) {
+    const int maxDistance = connectivity >= 26 ? 3 : (connectivity >= 18 ? 2 : 1);
+    std::vector<NeighborOffset> offsets;
+    for (int dz = -1; dz <= 0; ++dz) {
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                const bool backward = dz < 0 || (dz == 0 && (dy < 0 || (dy == 0 && dx < 0)));
+                if (backward && std::abs(dx) + std::abs(dy) + std::abs(dz) <= maxDistance) {
+                    offsets.push_back({dx, dy, dz});
+                }
+            }
+        }
+    }
+    return offsets;
+}
+
+// 块内并查集：总是把较大的根挂到较小的根下，根即集合中最早出现的标签
+inline int findRoot(std::vector<int>& parent, int x) {
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+inline int unite(std::vector<int>& parent, int a, int b) {
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b) {
+        parent[b] = a;
+        return a;
+    }
+    parent[a] = b;
+    return b;
+}
+
+// 块间合并使用无锁并查集，父指针只会单调减小
+inline int findRoot(std::atomic<int>* parent, int x) {
+    while (true) {
+        int p = parent[x].load(std::memory_order_relaxed);
+        if (p == x) {
+            return x;
+        }
+        const int grand = parent[p].load(std::memory_order_relaxed);
+        if (grand != p) {
+            parent[x].compare_exchange_weak(p, grand, std::memory_order_relaxed);
+        }
+        x = grand;
+    }
+}
+
+inline void unite(std::atomic<int>* parent, int a, int b) {
+    while (true) {
+        a = findRoot(parent, a);
+        b = findRoot(parent, b);
+        if (a == b) {
+            return;
+        }
+        if (a < b) {
+            std::swap(a, b);
+        }
+        int expected = a;
+        if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief 块并行的三维连通域标记
+ *
+ * 沿z切分为多个块，各块独立做光栅扫描标记与块内并查集，并在同一遍中统计
+ * 块内连通域的体素数与包围盒；随后并行合并相邻块边界面上的等价关系，
+ * 最后重写为从1开始的连续标签。标签按连通域首个体素的光栅顺序编号，
+ * 与线程数无关。
+ *
+ * @param mask 非零体素为前景
+ * @param labels 连续存储的输出标签，背景为0
+ * @param connectivity 6、18或26
+ * @return 连通域数量
+ */
+template<typename T>
+int labelConnectedComponents(const VoxelView<const T>& mask, const VoxelView<int>& labels, int connectivity,
+                             std::vector<ComponentStatistics>* statistics = nullptr) {
+    const int nx = mask.dims[0];
+    const int ny = mask.dims[1];
+    const int nz = mask.dims[2];
+    const std::vector<detail::NeighborOffset> offsets = detail::backwardNeighbors(connectivity);
+
+    const int blockCount = std::max(1, std::min(nz, 4 * vtkSMPTools::GetEstimatedNumberOfThreads()));
+    const int blockSlices = (nz + blockCount - 1) / std::max(1, blockCount);
+    std::vector<std::vector<ComponentStatistics>> blockStatistics(blockCount);
+
+    // 第一遍：块内标记，压缩为块内连续标签并统计
+    vtkSMPTools::For(0, blockCount, [&](vtkIdType beginBlock, vtkIdType endBlock) {
+        std::vector<int> parent;
+        std::vector<int> compact;
+        for (vtkIdType block = beginBlock; block < endBlock; ++block) {
+            const int z0 = static_cast<int>(block) * blockSlices;
+            const int z1 = std::min(nz, z0 + blockSlices);
+            parent.assign(1, 0);
+
+            for (int z = z0; z < z1; ++z) {
+                for (int y = 0; y < ny; ++y) {
+                    const T* in = mask.row(y, z);
+                    int* out = labels.row(y, z);
+                    for (int x = 0; x < nx; ++x) {
+                        if (in[x * mask.strides[0]] == T(0)) {
+                            out[x] = 0;
+                            continue;
+                        }
+                        int label = 0;
+                        for (const detail::NeighborOffset& offset : offsets) {
+                            const int xn = x + offset.dx;
+                            const int yn = y + offset.dy;
+                            const int zn = z + offset.dz;
+                            if (xn < 0 || xn >= nx || yn < 0 || yn >= ny || zn < z0) {
+                                continue;
+                            }
+                            const int neighbor = labels.at(xn, yn, zn);
+                            if (neighbor) {
+                                label = label ? detail::unite(parent, label, neighbor) : neighbor;
+                            }
+                        }
+                        if (!label) {
+                            label = static_cast<int>(parent.size());
+                            parent.push_back(label);
+                        }
+                        out[x] = label;
+                    }
+                }
+            }
+
+            // 根是集合中最小的标签，按升序遍历时根总先于其成员被编号
+            compact.assign(parent.size(), 0);
+            int count = 0;
+            for (size_t i = 1; i < parent.size(); ++i) {
+                const int root = detail::findRoot(parent, static_cast<int>(i));
+                compact[i] = root == static_cast<int>(i) ? ++count : compact[root];
+            }
+
+            std::vector<ComponentStatistics>& local = blockStatistics[block];
+            local.assign(count, ComponentStatistics());
+            for (int z = z0; z < z1; ++z) {
+                for (int y = 0; y < ny; ++y) {
+                    int* out = labels.row(y, z);
+                    for (int x = 0; x < nx; ++x) {
+                        if (out[x]) {
+                            out[x] = compact[out[x]];
+                            local[out[x] - 1].add(x, y, z);
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    std::vector<int> blockOffsets(blockCount + 1, 0);
+    for (int block = 0; block < blockCount; ++block) {
+        blockOffsets[block + 1] = blockOffsets[block] + static_cast<int>(blockStatistics[block].size());
+    }
+    const int provisionalCount = blockOffsets[blockCount];
+
+    // 第二遍：仅扫描块边界面，合并跨块的等价标签
+    std::unique_ptr<std::atomic<int>[]> parent(new std::atomic<int>[provisionalCount + 1]);
+    for (int i = 0; i <= provisionalCount; ++i) {
+        parent[i].store(i, std::memory_order_relaxed);
+    }
+    const vtkIdType boundaryRows = static_cast<vtkIdType>(blockCount - 1) * ny;
+    vtkSMPTools::For(0, boundaryRows, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType index = begin; index < end; ++index) {
+            const int block = static_cast<int>(index / ny) + 1;
+            const int y = static_cast<int>(index % ny);
+            const int z = block * blockSlices;
+            if (z >= nz) {
+                continue;
+            }
+            const int* row = labels.row(y, z);
+            for (int x = 0; x < nx; ++x) {
+                if (!row[x]) {
+                    continue;
+                }
+                const int label = blockOffsets[block] + row[x];
+                for (const detail::NeighborOffset& offset : offsets) {
+                    const int xn = x + offset.dx;
+                    const int yn = y + offset.dy;
+                    if (offset.dz == 0 || xn < 0 || xn >= nx || yn < 0 || yn >= ny) {
+                        continue;
+                    }
+                    const int neighbor = labels.at(xn, yn, z - 1);
+                    if (neighbor) {
+                        detail::unite(parent.get(), label, blockOffsets[block - 1] + neighbor);
+                    }
+                }
+            }
+        }
+    });
+
+    // 全局连续编号并合并统计
+    std::vector<int> finalLabels(provisionalCount + 1, 0);
+    int componentCount = 0;
+    for (int i = 1; i <= provisionalCount; ++i) {
+        const int root = detail::findRoot(parent.get(), i);
+        finalLabels[i] = root == i ? ++componentCount : finalLabels[root];
+    }
+    if (statistics) {
+        statistics->assign(componentCount, ComponentStatistics());
+        for (int block = 0; block < blockCount; ++block) {
+            for (size_t i = 0; i < blockStatistics[block].size(); ++i) {
+                const int label = finalLabels[blockOffsets[block] + static_cast<int>(i) + 1];
+                (*statistics)[label - 1].merge(blockStatistics[block][i]);
+            }
+        }
+    }
+
+    // 第三遍：重写为最终标签
+    vtkSMPTools::For(0, blockCount, [&](vtkIdType beginBlock, vtkIdType endBlock) {
+        for (vtkIdType block = beginBlock; block < endBlock; ++block) {
+            const int z0 = static_cast<int>(block) * blockSlices;
+            const int z1 = std::min(nz, z0 + blockSlices);
+            const int offset = blockOffsets[block];
+            for (int z = z0; z < z1; ++z) {
+                for (int y = 0; y < ny; ++y) {
+                    int* out = labels.row(y, z);
+                    for (int x = 0; x < nx; ++x) {
+                        if (out[x]) {
+                            out[x] = finalLabels[offset + out[x]];
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    return componentCount;
+}
+
+/**
+ * @brief 从已有标签图重新统计各连通域(用于缓存命中时)
+ */
+inline void labelStatistics(const VoxelView<const int>& labels, int componentCount,
+                            std::vector<ComponentStatistics>& statistics) {
+    statistics.assign(componentCount, ComponentStatistics());
+    for (int z = 0; z < labels.dims[2]; ++z) {
+        for (int y = 0; y < labels.dims[1]; ++y) {
+            const int* row = labels.row(y, z);
+            for (int x = 0; x < labels.dims[0]; ++x) {
+                const int label = row[x * labels.strides[0]];
+                if (label > 0 && label <= componentCount) {
+                    statistics[label - 1].add(x, y, z);
+                }
+            }
+        }
+    }
+}
+
+} // namespace ImageKernels
+
+#endif // CONNECTEDCOMPONENTS_H
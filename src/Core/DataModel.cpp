@@ -1,4 +1,7 @@
 #include "DataModel.h"
+#include "ImageStatistics.h"
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
 #include <vtkImageData.h>
 #include <vtkMatrix4x4.h>
 #include <vtkSmartPointer.h>
@@ -9,6 +12,24 @@ public:
     vtkSmartPointer<vtkImageData> imageData;
     vtkSmartPointer<vtkMatrix4x4> transformMatrix;
     QVariantMap metaData;
+
+    typedef std::shared_ptr<const MedicalImaging::ImageStatistics> StatisticsPointer;
+    // 查询统计的const接口在数据被原地修改后会重新启动后台计算
+    mutable QFutureWatcher<StatisticsPointer> statisticsWatcher;
+    mutable quint64 statisticsGeneration = 0;
+    mutable quint64 statisticsJobGeneration = 0;
+
+    void startStatistics() const {
+        ++statisticsGeneration;
+        if (!imageData) {
+            return;
+        }
+        statisticsJobGeneration = statisticsGeneration;
+        vtkSmartPointer<vtkImageData> image = imageData;
+        statisticsWatcher.setFuture(QtConcurrent::run([image]() {
+            return MedicalImaging::ImageStatistics::get(image);
+        }));
+    }
 };
 
 DataModel::DataModel(QObject *parent)
@@ -18,14 +39,26 @@ DataModel::DataModel(QObject *parent)
     Q_D(DataModel);
     d->transformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
     d->transformMatrix->Identity();
+
+    connect(&d->statisticsWatcher, &QFutureWatcher<DataModelPrivate::StatisticsPointer>::finished, this, [this]() {
+        Q_D(DataModel);
+        // 期间图像已被替换时丢弃
+        if (d->statisticsJobGeneration == d->statisticsGeneration && d->statisticsWatcher.result()) {
+            emit statisticsChanged();
+        }
+    });
 }
 
-DataModel::~DataModel() = default;
+DataModel::~DataModel() {
+    Q_D(DataModel);
+    d->statisticsWatcher.waitForFinished();
+}
 
 void DataModel::setImageData(vtkImageData* imageData) {
     Q_D(DataModel);
     if (d->imageData != imageData) {
         d->imageData = imageData;
+        d->startStatistics();
         emit imageDataChanged();
     }
 }
@@ -85,6 +118,7 @@ void DataModel::clear() {
     
     if (d->imageData) {
         d->imageData = nullptr;
+        d->startStatistics();
         emit imageDataChanged();
         changed = true;
     }
@@ -101,6 +135,30 @@ void DataModel::clear() {
     }
 }
 
+std::shared_ptr<const MedicalImaging::ImageStatistics> DataModel::getStatistics() const {
+    Q_D(const DataModel);
+    if (!d->imageData) {
+        return nullptr;
+    }
+    std::shared_ptr<const MedicalImaging::ImageStatistics> statistics =
+        MedicalImaging::ImageStatistics::cached(d->imageData);
+    // 缓存中没有当前版本且没有进行中的计算：数据已被原地修改，按新版本在后台重新计算
+    if (!statistics && !d->statisticsWatcher.isRunning()) {
+        d->startStatistics();
+    }
+    return statistics;
+}
+
+std::shared_ptr<const MedicalImaging::ImageStatistics> DataModel::waitForStatistics() const {
+    Q_D(const DataModel);
+    if (!d->imageData) {
+        return nullptr;
+    }
+    d->statisticsWatcher.waitForFinished();
+    // 后台结果已进入统计缓存，这里通常直接命中
+    return MedicalImaging::ImageStatistics::get(d->imageData);
+}
+
 bool DataModel::isValid() const {
     Q_D(const DataModel);
     return d->imageData != nullptr;
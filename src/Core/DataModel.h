@@ -10,6 +10,10 @@
 class vtkImageData;
 class vtkMatrix4x4;
 
+namespace MedicalImaging {
+class ImageStatistics;
+}
+
 /**
  * @brief 数据模型类，管理医学图像数据和元数据
  */
@@ -35,6 +39,12 @@ public:
     void setTransformMatrix(vtkMatrix4x4* matrix);
     vtkMatrix4x4* getTransformMatrix() const;
 
+    // 强度统计：设置图像后在后台并行计算，完成时发出statisticsChanged。
+    // getStatistics不阻塞，计算尚未完成时返回空；waitForStatistics等待(或同步计算)结果，供工作线程使用。
+    // 数据被原地修改后两者都按新版本重新计算
+    std::shared_ptr<const MedicalImaging::ImageStatistics> getStatistics() const;
+    std::shared_ptr<const MedicalImaging::ImageStatistics> waitForStatistics() const;
+
     // 数据清理
     void clear();
 
@@ -45,6 +55,7 @@ signals:
     void imageDataChanged();
     void metaDataChanged();
     void transformMatrixChanged();
+    void statisticsChanged();
 
 private:
     class DataModelPrivate;
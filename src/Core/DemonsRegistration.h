@@ -0,0 +1,313 @@
+#ifndef DEMONSREGISTRATION_H
+#define DEMONSREGISTRATION_H
+
+#include "ImageKernels.h"
+#include "RegistrationLevel.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ImageKernels {
+
+/**
+ * @brief 三分量float位移场(物理单位)，每个分量单独连续存储
+ *
+ * 分量分开存储便于逐分量原地递归平滑；几何与所在的固定图像层一致。
+ */
+struct DisplacementField {
+    std::vector<float> u[3];
+    int dims[3] = {0, 0, 0};
+    double spacing[3] = {1.0, 1.0, 1.0};
+    double origin[3] = {0.0, 0.0, 0.0};
+
+    // 按层几何分配并清零
+    void reset(const RegistrationLevel& level) {
+        for (int i = 0; i < 3; ++i) {
+            dims[i] = level.dims[i];
+            spacing[i] = level.spacing[i];
+            origin[i] = level.origin[i];
+        }
+        for (std::vector<float>& component : u) {
+            component.assign(level.voxels.size(), 0.0f);
+        }
+    }
+
+    void release() {
+        for (std::vector<float>& component : u) {
+            std::vector<float>().swap(component);
+        }
+    }
+
+    VoxelView<float> view(int component) {
+        return MedicalImaging::makeVoxelView(u[component].data(), dims);
+    }
+
+    VoxelView<const float> view(int component) const {
+        return MedicalImaging::makeVoxelView<const float>(u[component].data(), dims);
+    }
+
+    void swap(DisplacementField& other) {
+        for (int i = 0; i < 3; ++i) {
+            u[i].swap(other.u[i]);
+            std::swap(dims[i], other.dims[i]);
+            std::swap(spacing[i], other.spacing[i]);
+            std::swap(origin[i], other.origin[i]);
+        }
+    }
+
+    // 各分量按体素单位的σ原地递归高斯平滑
+    void smooth(double sigma) {
+        if (sigma <= 0.0) {
+            return;
+        }
+        const double s[3] = {sigma, sigma, sigma};
+        for (int c = 0; c < 3; ++c) {
+            recursiveGaussian(view(c), s);
+        }
+    }
+};
+
+namespace DemonsDetail {
+
+// 网格内连续索引处三线性插值，索引截断到网格范围内(场在边界外按边缘延拓)
+inline void sampleField(const DisplacementField& field, double x, double y, double z, double out[3]) {
+    x = std::max(0.0, std::min(x, field.dims[0] - 1.0));
+    y = std::max(0.0, std::min(y, field.dims[1] - 1.0));
+    z = std::max(0.0, std::min(z, field.dims[2] - 1.0));
+    for (int c = 0; c < 3; ++c) {
+        out[c] = sampleLinear(field.view(c), x, y, z, 0.0f);
+    }
+}
+
+} // namespace DemonsDetail
+
+/**
+ * @brief 位移场复合：out(x) = e(x) + s(x + e(x))，即先e后s
+ *
+ * out须与s、e同几何且为另一块内存，结果随后与s交换即可原地更新s。
+ */
+inline void composeFields(const DisplacementField& s, const DisplacementField& e, DisplacementField& out) {
+    const int nx = s.dims[0];
+    const int ny = s.dims[1];
+    forEachSlice(s.dims[2], [&](int z) {
+        for (int y = 0; y < ny; ++y) {
+            const vtkIdType row = (static_cast<vtkIdType>(z) * ny + y) * nx;
+            for (int x = 0; x < nx; ++x) {
+                const vtkIdType i = row + x;
+                const double e0 = e.u[0][i];
+                const double e1 = e.u[1][i];
+                const double e2 = e.u[2][i];
+                double v[3];
+                DemonsDetail::sampleField(s, x + e0 / s.spacing[0], y + e1 / s.spacing[1], z + e2 / s.spacing[2], v);
+                out.u[0][i] = static_cast<float>(e0 + v[0]);
+                out.u[1][i] = static_cast<float>(e1 + v[1]);
+                out.u[2][i] = static_cast<float>(e2 + v[2]);
+            }
+        }
+    });
+}
+
+/**
+ * @brief 缩放平方法求速度场的指数映射，结果原地写回v
+ *
+ * 先缩小2^N倍使最大位移不超过半个体素，再自复合N次；scratch为同几何的临时场。
+ */
+inline void exponentiateField(DisplacementField& v, DisplacementField& scratch) {
+    const vtkIdType count = static_cast<vtkIdType>(v.u[0].size());
+    std::vector<double> sliceMaxima(static_cast<size_t>(std::max(1, v.dims[2])), 0.0);
+    const vtkIdType sliceSize = static_cast<vtkIdType>(v.dims[0]) * v.dims[1];
+    forEachSlice(v.dims[2], [&](int z) {
+        double maximum = 0.0;
+        for (vtkIdType i = z * sliceSize; i < (z + 1) * sliceSize; ++i) {
+            const double x = v.u[0][i] / v.spacing[0];
+            const double y = v.u[1][i] / v.spacing[1];
+            const double w = v.u[2][i] / v.spacing[2];
+            maximum = std::max(maximum, x * x + y * y + w * w);
+        }
+        sliceMaxima[z] = maximum;
+    });
+    const double maximum = std::sqrt(*std::max_element(sliceMaxima.begin(), sliceMaxima.end()));
+    if (maximum <= 0.0) {
+        return;
+    }
+    const int squarings = std::max(0, static_cast<int>(std::ceil(std::log2(maximum / 0.5))));
+    const float scale = static_cast<float>(std::ldexp(1.0, -squarings));
+    for (std::vector<float>& component : v.u) {
+        vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType i = begin; i < end; ++i) {
+                component[i] *= scale;
+            }
+        });
+    }
+    for (int i = 0; i < squarings; ++i) {
+        composeFields(v, v, scratch);
+        v.swap(scratch);
+    }
+}
+
+/**
+ * @brief 对称(ESM)demons力：u = −(M∘s − F)·J / (|J|² + (M∘s − F)²/K)
+ *
+ * J = (∇F + ∇M∘s)/2，K为平均间距平方；每个体素的更新长度限制在maximumStep(毫米)以内。
+ * 浮动图像在x + s(x)处的值与梯度现场插值，不保存形变后的图像。
+ * 返回有效体素上的均方强度差，逐切片部分和按序合并，结果与线程数无关。
+ */
+inline double demonsForces(const RegistrationLevel& fixed, const RegistrationLevel& moving,
+                           const DisplacementField& s, DisplacementField& update, double maximumStep) {
+    const VoxelView<const float> fixedView = fixed.view();
+    const VoxelView<const float> movingView = moving.view();
+    const int nx = fixed.dims[0];
+    const int ny = fixed.dims[1];
+    const int nz = fixed.dims[2];
+    const double normalizer = (fixed.spacing[0] * fixed.spacing[0] + fixed.spacing[1] * fixed.spacing[1] +
+                               fixed.spacing[2] * fixed.spacing[2]) / 3.0;
+    const double maximumSquared = maximumStep * maximumStep;
+    std::vector<double> sliceError(static_cast<size_t>(nz), 0.0);
+    std::vector<vtkIdType> sliceValid(static_cast<size_t>(nz), 0);
+
+    forEachSlice(nz, [&](int z) {
+        double error = 0.0;
+        vtkIdType valid = 0;
+        const int z0 = std::max(0, z - 1);
+        const int z1 = std::min(nz - 1, z + 1);
+        for (int y = 0; y < ny; ++y) {
+            const int y0 = std::max(0, y - 1);
+            const int y1 = std::min(ny - 1, y + 1);
+            const vtkIdType row = (static_cast<vtkIdType>(z) * ny + y) * nx;
+            const float* f = fixedView.row(y, z);
+            for (int x = 0; x < nx; ++x) {
+                const vtkIdType i = row + x;
+                update.u[0][i] = update.u[1][i] = update.u[2][i] = 0.0f;
+
+                const double p[3] = {fixed.origin[0] + x * fixed.spacing[0] + s.u[0][i],
+                                     fixed.origin[1] + y * fixed.spacing[1] + s.u[1][i],
+                                     fixed.origin[2] + z * fixed.spacing[2] + s.u[2][i]};
+                double index[3];
+                moving.physicalToIndex(p, index);
+                float m;
+                float gm[3];
+                if (!sampleLinearGradient(movingView, index[0], index[1], index[2], m, gm)) {
+                    continue;
+                }
+                const int x0 = std::max(0, x - 1);
+                const int x1 = std::min(nx - 1, x + 1);
+                const double gf[3] = {
+                    x1 > x0 ? (f[x1] - f[x0]) / ((x1 - x0) * fixed.spacing[0]) : 0.0,
+                    y1 > y0 ? (fixedView.at(x, y1, z) - fixedView.at(x, y0, z)) / ((y1 - y0) * fixed.spacing[1]) : 0.0,
+                    z1 > z0 ? (fixedView.at(x, y, z1) - fixedView.at(x, y, z0)) / ((z1 - z0) * fixed.spacing[2]) : 0.0};
+                const double J[3] = {0.5 * (gf[0] + gm[0] / moving.spacing[0]),
+                                     0.5 * (gf[1] + gm[1] / moving.spacing[1]),
+                                     0.5 * (gf[2] + gm[2] / moving.spacing[2])};
+                const double difference = m - f[x];
+                error += difference * difference;
+                ++valid;
+
+                const double denominator = J[0] * J[0] + J[1] * J[1] + J[2] * J[2] +
+                                           difference * difference / normalizer;
+                if (denominator < 1e-12) {
+                    continue;
+                }
+                double u[3] = {-difference * J[0] / denominator,
+                               -difference * J[1] / denominator,
+                               -difference * J[2] / denominator};
+                const double length = u[0] * u[0] + u[1] * u[1] + u[2] * u[2];
+                if (length > maximumSquared) {
+                    const double shrink = maximumStep / std::sqrt(length);
+                    u[0] *= shrink;
+                    u[1] *= shrink;
+                    u[2] *= shrink;
+                }
+                update.u[0][i] = static_cast<float>(u[0]);
+                update.u[1][i] = static_cast<float>(u[1]);
+                update.u[2][i] = static_cast<float>(u[2]);
+            }
+        }
+        sliceError[z] = error;
+        sliceValid[z] = valid;
+    });
+
+    double error = 0.0;
+    vtkIdType valid = 0;
+    for (int z = 0; z < nz; ++z) {
+        error += sliceError[z];
+        valid += sliceValid[z];
+    }
+    return valid > 0 ? error / valid : 0.0;
+}
+
+/**
+ * @brief 把粗层位移场三线性插值到细层网格(位移为物理单位，数值不需缩放)
+ */
+inline void upsampleField(const DisplacementField& coarse, const RegistrationLevel& fine, DisplacementField& out) {
+    out.reset(fine);
+    const int nx = fine.dims[0];
+    const int ny = fine.dims[1];
+    forEachSlice(fine.dims[2], [&](int z) {
+        const double cz = (fine.origin[2] + z * fine.spacing[2] - coarse.origin[2]) / coarse.spacing[2];
+        for (int y = 0; y < ny; ++y) {
+            const double cy = (fine.origin[1] + y * fine.spacing[1] - coarse.origin[1]) / coarse.spacing[1];
+            const vtkIdType row = (static_cast<vtkIdType>(z) * ny + y) * nx;
+            for (int x = 0; x < nx; ++x) {
+                const double cx = (fine.origin[0] + x * fine.spacing[0] - coarse.origin[0]) / coarse.spacing[0];
+                double v[3];
+                DemonsDetail::sampleField(coarse, cx, cy, cz, v);
+                out.u[0][row + x] = static_cast<float>(v[0]);
+                out.u[1][row + x] = static_cast<float>(v[1]);
+                out.u[2][row + x] = static_cast<float>(v[2]);
+            }
+        }
+    });
+}
+
+/**
+ * @brief 微分同胚demons的参数
+ */
+struct DemonsParameters {
+    int iterations = 50;
+    double tolerance = 1e-6;        // 均方差的相对下降小于该值时停止
+    double updateSigma = 1.0;       // 更新场(类流体)平滑σ，体素单位
+    double displacementSigma = 1.5; // 位移场(类扩散)平滑σ，体素单位
+    double maximumStep = 2.0;       // 每次更新的最大长度，体素单位
+    // 每次迭代后调用，返回false时提前停止
+    std::function<bool(int iteration, double error, const DisplacementField& s)> observer;
+};
+
+/**
+ * @brief 在一层上迭代微分同胚demons，s原地更新
+ *
+ * 每次迭代：对称力 → 更新场平滑 → 缩放平方求exp(u) → s ← s∘exp(u) → 位移场平滑。
+ * 除s外只需要两个同尺寸的工作场，全部为float。返回最终均方差。
+ * observer返回false时在本次迭代后停止。
+ */
+inline double diffeomorphicDemons(const RegistrationLevel& fixed, const RegistrationLevel& moving,
+                                  DisplacementField& s, const DemonsParameters& parameters) {
+    DisplacementField update;
+    DisplacementField scratch;
+    update.reset(fixed);
+    scratch.reset(fixed);
+    const double maximumStep = parameters.maximumStep * fixed.meanSpacing();
+    double previous = -1.0;
+    double error = 0.0;
+    for (int iteration = 0; iteration < parameters.iterations; ++iteration) {
+        error = demonsForces(fixed, moving, s, update, maximumStep);
+        if (previous >= 0.0 && previous - error < parameters.tolerance * previous) {
+            break;
+        }
+        previous = error;
+        update.smooth(parameters.updateSigma);
+        exponentiateField(update, scratch);
+        composeFields(s, update, scratch);
+        s.swap(scratch);
+        s.smooth(parameters.displacementSigma);
+        if (parameters.observer && !parameters.observer(iteration, error, s)) {
+            break;
+        }
+    }
+    return error;
+}
+
+} // namespace ImageKernels
+
+#endif // DEMONSREGISTRATION_H
@@ -0,0 +1,178 @@
+#ifndef DISTANCETRANSFORM_H
+#define DISTANCETRANSFORM_H
+
+#include "ImageKernels.h"
+#include <limits>
+#include <vector>
+
+namespace ImageKernels {
+
+namespace detail {
+
+struct DistanceLineBuffers {
+    std::vector<float> f;
+    std::vector<int> v;
+    std::vector<double> z;
+};
+
+/**
+ * @brief 一维平方距离变换(Felzenszwalb-Huttenlocher抛物线下包络)
+ * @param weight 体素间距的平方，使结果为物理单位的平方距离
+ *
+ * 原地处理；值为无穷大的位置不产生抛物线。
+ */
+inline void squaredDistance1D(float* line, vtkIdType stride, int n, double weight, DistanceLineBuffers& buffers) {
+    const float infinity = std::numeric_limits<float>::infinity();
+    buffers.f.resize(n);
+    buffers.v.resize(n);
+    buffers.z.resize(n + 1);
+    float* f = buffers.f.data();
+    int* v = buffers.v.data();
+    double* z = buffers.z.data();
+
+    for (int q = 0; q < n; ++q) {
+        f[q] = line[q * stride];
+    }
+
+    int k = -1;
+    for (int q = 0; q < n; ++q) {
+        if (f[q] == infinity) {
+            continue;
+        }
+        const double fq = f[q] + weight * q * q;
+        double s = -std::numeric_limits<double>::infinity();
+        while (k >= 0) {
+            const int p = v[k];
+            s = (fq - (f[p] + weight * p * p)) / (2.0 * weight * (q - p));
+            if (s > z[k]) {
+                break;
+            }
+            --k;
+        }
+        if (k < 0) {
+            s = -std::numeric_limits<double>::infinity();
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+    }
+
+    if (k < 0) {
+        return; // 整条线上没有特征点，保持无穷大
+    }
+    z[k + 1] = std::numeric_limits<double>::infinity();
+
+    int j = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[j + 1] < q) {
+            ++j;
+        }
+        const double offset = q - v[j];
+        line[q * stride] = static_cast<float>(weight * offset * offset + f[v[j]]);
+    }
+}
+
+/**
+ * @brief 沿一个轴对所有线执行一维变换，按切片或行并行
+ */
+inline void squaredDistancePass(const VoxelView<float>& data, int axis, double spacing) {
+    const int nx = data.dims[0];
+    const int ny = data.dims[1];
+    const int nz = data.dims[2];
+    const double weight = spacing * spacing;
+    vtkSMPThreadLocal<DistanceLineBuffers> lineBuffers;
+
+    if (axis == 2) {
+        // z方向的线跨越所有切片，改为按y并行
+        forEachSlice(ny, [&](int y) {
+            DistanceLineBuffers& buffers = lineBuffers.Local();
+            for (int x = 0; x < nx; ++x) {
+                squaredDistance1D(&data.at(x, y, 0), data.strides[2], nz, weight, buffers);
+            }
+        });
+        return;
+    }
+
+    forEachSlice(nz, [&](int z) {
+        DistanceLineBuffers& buffers = lineBuffers.Local();
+        if (axis == 0) {
+            for (int y = 0; y < ny; ++y) {
+                squaredDistance1D(data.row(y, z), data.strides[0], nx, weight, buffers);
+            }
+        } else {
+            for (int x = 0; x < nx; ++x) {
+                squaredDistance1D(&data.at(x, 0, z), data.strides[1], ny, weight, buffers);
+            }
+        }
+    });
+}
+
+} // namespace detail
+
+/**
+ * @brief 精确平方欧氏距离变换：每个体素到最近特征体素的物理平方距离
+ * @param featureIsForeground true时以非零体素为特征，否则以零体素为特征
+ * @param out 连续存储的float输出；没有任何特征体素时全部为无穷大
+ */
+template<typename T>
+void squaredDistanceTransform(const VoxelView<const T>& mask, bool featureIsForeground,
+                              const VoxelView<float>& out, const double spacing[3]) {
+    const float infinity = std::numeric_limits<float>::infinity();
+    forEachSlice(mask.dims[2], [&](int z) {
+        for (int y = 0; y < mask.dims[1]; ++y) {
+            const T* in = mask.row(y, z);
+            float* dst = out.row(y, z);
+            for (int x = 0; x < mask.dims[0]; ++x) {
+                const bool foreground = in[x * mask.strides[0]] != T(0);
+                dst[x * out.strides[0]] = foreground == featureIsForeground ? 0.0f : infinity;
+            }
+        }
+    });
+
+    for (int axis = 0; axis < 3; ++axis) {
+        detail::squaredDistancePass(out, axis, spacing[axis]);
+    }
+}
+
+/**
+ * @brief 欧氏距离变换(物理单位)
+ *
+ * 无符号：到最近非零体素的距离，目标内部为0。
+ * 有符号：目标外部为到最近目标体素的距离(正)，内部为到最近背景体素的距离(负)。
+ */
+template<typename T>
+void euclideanDistanceTransform(const VoxelView<const T>& mask, const VoxelView<float>& out,
+                                const double spacing[3], bool signedDistance) {
+    squaredDistanceTransform(mask, true, out, spacing);
+
+    if (!signedDistance) {
+        forEachSlice(out.dims[2], [&](int z) {
+            for (int y = 0; y < out.dims[1]; ++y) {
+                float* row = out.row(y, z);
+                for (int x = 0; x < out.dims[0]; ++x) {
+                    row[x * out.strides[0]] = std::sqrt(row[x * out.strides[0]]);
+                }
+            }
+        });
+        return;
+    }
+
+    std::vector<float> inside(static_cast<size_t>(mask.voxelCount()));
+    const VoxelView<float> insideView = MedicalImaging::makeVoxelView(inside.data(), mask.dims);
+    squaredDistanceTransform(mask, false, insideView, spacing);
+
+    forEachSlice(out.dims[2], [&](int z) {
+        for (int y = 0; y < out.dims[1]; ++y) {
+            float* row = out.row(y, z);
+            const float* insideRow = insideView.row(y, z);
+            for (int x = 0; x < out.dims[0]; ++x) {
+                float& value = row[x * out.strides[0]];
+                value = value == 0.0f ? -std::sqrt(insideRow[x]) : std::sqrt(value);
+            }
+        }
+    });
+}
+
+} // namespace ImageKernels
+
+#endif // DISTANCETRANSFORM_H
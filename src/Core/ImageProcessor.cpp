@@ -1,138 +1,625 @@
 #include "ImageProcessor.h"
+#include "ImageKernels.h"
+#include "BilateralGrid.h"
+#include "NonLocalMeans.h"
+#include "ConnectedComponents.h"
+#include "DistanceTransform.h"
+#include "RegionGrowing.h"
+#include "ProcessingCache.h"
+#include "Config.h"
+#include "ImageStatistics.h"
+#include "Logger.h"
 #include <vtkImageData.h>
 #include <vtkImageGaussianSmooth.h>
 #include <vtkImageMedian3D.h>
 #include <vtkImageThreshold.h>
 #include <vtkSmartPointer.h>
+#include <QElapsedTimer>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+using MedicalImaging::Half;
+using MedicalImaging::ImageStatistics;
+using MedicalImaging::VoxelTypeTag;
+using MedicalImaging::VoxelView;
+using MedicalImaging::dispatchVoxelType;
+using MedicalImaging::makeVoxelView;
+
+// 创建与输入几何一致的输出图像
+vtkSmartPointer<vtkImageData> createImageLike(vtkImageData* input, int scalarType, int components) {
+    auto image = vtkSmartPointer<vtkImageData>::New();
+    image->SetExtent(input->GetExtent());
+    image->SetSpacing(input->GetSpacing());
+    image->SetOrigin(input->GetOrigin());
+    image->AllocateScalars(scalarType, components);
+    return image;
+}
+
+// 对每个标量分量执行类型化内核
+template<typename TIn, typename TOut, typename Kernel>
+void forEachComponent(vtkImageData* input, vtkImageData* output, Kernel&& kernel) {
+    const VoxelView<const TIn> in = makeVoxelView<const TIn>(input);
+    const VoxelView<TOut> out = makeVoxelView<TOut>(output);
+    for (int c = 0; c < in.components; ++c) {
+        kernel(in.component(c), out.component(c));
+    }
+}
+
+// 立方体结构元素的腐蚀或膨胀，输出类型与输入一致
+vtkSmartPointer<vtkImageData> applyRankFilter(vtkImageData* input, int radius, bool dilate) {
+    vtkSmartPointer<vtkImageData> output =
+        createImageLike(input, input->GetScalarType(), input->GetNumberOfScalarComponents());
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        forEachComponent<T, T>(input, output, [&](const VoxelView<const T>& in, const VoxelView<T>& out) {
+            if (dilate) {
+                ImageKernels::dilate(in, out, radius);
+            } else {
+                ImageKernels::erode(in, out, radius);
+            }
+        });
+    });
+    return dispatched ? output : nullptr;
+}
+
+/**
+ * @brief 按精度设置选择中间结果的存储类型
+ *
+ * int16只对值域可无损容纳的uint8/int16输入生效，四舍五入存储；其他类型回退到float。
+ */
+template<typename T, typename Functor>
+void dispatchStoreType(ImageProcessor::IntermediatePrecision precision, Functor&& functor) {
+    if (precision == ImageProcessor::Float16Precision) {
+        functor(VoxelTypeTag<Half>());
+    } else if (precision == ImageProcessor::Int16Precision
+               && (std::is_same<T, unsigned char>::value || std::is_same<T, short>::value)) {
+        functor(VoxelTypeTag<short>());
+    } else {
+        functor(VoxelTypeTag<float>());
+    }
+}
+
+template<typename S>
+QString storeTypeName() {
+    if (std::is_same<S, Half>::value) {
+        return "float16";
+    }
+    if (std::is_same<S, short>::value) {
+        return "int16";
+    }
+    return "float32";
+}
+
+// 两个中间缓冲区(乒乓)按单分量分配
+struct IntermediateInfo {
+    QString storageType;
+    qint64 bytes = 0;
+};
+
+vtkSmartPointer<vtkImageData> computeGaussian(vtkImageData* input, double sigma,
+                                              ImageProcessor::IntermediatePrecision precision,
+                                              IntermediateInfo* info = nullptr) {
+    vtkSmartPointer<vtkImageData> output =
+        createImageLike(input, input->GetScalarType(), input->GetNumberOfScalarComponents());
+    const double sigmas[3] = {sigma, sigma, sigma};
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        dispatchStoreType<T>(precision, [&](auto storeTag) {
+            using S = typename decltype(storeTag)::type;
+            forEachComponent<T, T>(input, output, [&](const VoxelView<const T>& in, const VoxelView<T>& out) {
+                ImageKernels::separableGaussian<T, T, S>(in, out, sigmas);
+            });
+            if (info) {
+                info->storageType = storeTypeName<S>();
+                info->bytes = 2 * static_cast<qint64>(input->GetNumberOfPoints()) * sizeof(S);
+            }
+        });
+    });
+    return dispatched ? output : nullptr;
+}
+
+vtkSmartPointer<vtkImageData> computeDiffusion(vtkImageData* input, int iterations, double timeStep,
+                                               ImageProcessor::IntermediatePrecision precision,
+                                               IntermediateInfo* info = nullptr) {
+    // Perona-Malik扩散，传导参数取平均梯度幅值
+    vtkSmartPointer<vtkImageData> output =
+        createImageLike(input, input->GetScalarType(), input->GetNumberOfScalarComponents());
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        dispatchStoreType<T>(precision, [&](auto storeTag) {
+            using S = typename decltype(storeTag)::type;
+            forEachComponent<T, T>(input, output, [&](const VoxelView<const T>& in, const VoxelView<T>& out) {
+                const double conductance = ImageKernels::meanGradientMagnitude(in);
+                ImageKernels::peronaMalikDiffusion<T, T, S>(in, out, iterations, timeStep, conductance);
+            });
+            if (info) {
+                info->storageType = storeTypeName<S>();
+                info->bytes = 2 * static_cast<qint64>(input->GetNumberOfPoints()) * sizeof(S);
+            }
+        });
+    });
+    return dispatched ? output : nullptr;
+}
+
+// 逐标量比较两幅同类型同尺寸的图像，填充误差统计
+void compareImages(vtkImageData* reference, vtkImageData* test, ImageProcessor::PrecisionReport& report) {
+    const vtkIdType count = reference->GetNumberOfPoints() * reference->GetNumberOfScalarComponents();
+    double maxAbs = 0.0;
+    double sumAbs = 0.0;
+    double sumSquared = 0.0;
+    dispatchVoxelType(reference->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        const T* a = static_cast<const T*>(reference->GetScalarPointer());
+        const T* b = static_cast<const T*>(test->GetScalarPointer());
+        for (vtkIdType i = 0; i < count; ++i) {
+            const double error = std::abs(static_cast<double>(a[i]) - static_cast<double>(b[i]));
+            maxAbs = std::max(maxAbs, error);
+            sumAbs += error;
+            sumSquared += error * error;
+        }
+    });
+
+    double range[2];
+    reference->GetScalarRange(range);
+    const double peak = range[1] - range[0];
+    report.maxAbsError = maxAbs;
+    report.meanAbsError = count > 0 ? sumAbs / count : 0.0;
+    report.rmse = count > 0 ? std::sqrt(sumSquared / count) : 0.0;
+    report.psnr = report.rmse > 0.0 && peak > 0.0 ? 20.0 * std::log10(peak / report.rmse)
+                                                  : std::numeric_limits<double>::infinity();
+}
+
+void logUnsupportedType(const char* operation, vtkImageData* input) {
+    LOG_WARNING(QString("%1: 不支持的体素类型 %2").arg(operation).arg(input->GetScalarType()));
+}
+
+} // namespace
 
 class ImageProcessor::ImageProcessorPrivate : public QObject {
     Q_OBJECT // 添加 Q_OBJECT 宏以启用信号和槽机制
     // 私有成员变量可以在这里声明
 public:
     // VTK滤波器实例可以在这里声明
+    std::shared_ptr<ProcessingCache> resultCache;
+    bool resultCacheEnabled = true;
+    ImageProcessor::IntermediatePrecision precision = ImageProcessor::FullPrecision;
+    QVector<ImageProcessor::ComponentInfo> components;
+
+    void setComponents(const std::vector<ImageKernels::ComponentStatistics>& statistics) {
+        components.clear();
+        components.reserve(static_cast<int>(statistics.size()));
+        for (size_t i = 0; i < statistics.size(); ++i) {
+            ImageProcessor::ComponentInfo info;
+            info.label = static_cast<int>(i) + 1;
+            info.voxelCount = statistics[i].voxelCount;
+            std::copy(statistics[i].bounds, statistics[i].bounds + 6, info.bounds);
+            components.append(info);
+        }
+    }
+    vtkSmartPointer<vtkImageData> lastResult; // 保持最近一次返回结果的生命周期
+
+    // 缓存与调用方共享同一份图像而不复制：返回的结果只读，需要修改时由调用方自行DeepCopy
+
+    vtkImageData* findCached(vtkImageData* input, const QString& operation, const QVariantList& parameters) {
+        if (!resultCacheEnabled) {
+            return nullptr;
+        }
+        vtkSmartPointer<vtkImageData> cached =
+            resultCache->lookup(ProcessingCache::makeKey(input, operation, parameters));
+        if (!cached) {
+            return nullptr;
+        }
+        lastResult = cached;
+        return lastResult;
+    }
+
+    vtkImageData* storeResult(vtkImageData* input, const QString& operation, const QVariantList& parameters,
+                              vtkImageData* result) {
+        lastResult = result;
+        if (resultCacheEnabled && result) {
+            resultCache->insert(ProcessingCache::makeKey(input, operation, parameters), result);
+        }
+        return result;
+    }
+
+    // 将滤波器输出与管线分离，并按需放入缓存
+    vtkImageData* keepResult(vtkImageData* input, const QString& operation, const QVariantList& parameters,
+                             vtkImageData* output) {
+        auto result = vtkSmartPointer<vtkImageData>::New();
+        result->ShallowCopy(output);
+        return storeResult(input, operation, parameters, result);
+    }
 };
 
 ImageProcessor::ImageProcessor(QObject *parent)
     : QObject(parent)
     , d_ptr(std::make_unique<ImageProcessorPrivate>())
 {
+    Q_D(ImageProcessor);
+    const auto settings = MedicalImaging::Config::getInstance().getImageProcessingSettings();
+    d->resultCacheEnabled = settings.enableResultCache;
+    d->resultCache = std::make_shared<ProcessingCache>(static_cast<qint64>(settings.resultCacheSizeMB) * 1024 * 1024);
+    if (settings.enableResultCacheSpill) {
+        d->resultCache->setSpillDirectory(settings.resultCacheSpillDirectory);
+    }
+    if (settings.intermediatePrecision.compare("Int16", Qt::CaseInsensitive) == 0) {
+        d->precision = Int16Precision;
+    } else if (settings.intermediatePrecision.compare("Float16", Qt::CaseInsensitive) == 0) {
+        d->precision = Float16Precision;
+    }
 }
 
 ImageProcessor::~ImageProcessor() = default;
 
 vtkImageData* ImageProcessor::applyGaussianSmoothing(vtkImageData* input, double sigma) {
+    Q_D(ImageProcessor);
     if (!input) {
         return nullptr;
     }
     
     emit processingStarted();
     
-    auto gaussianFilter = vtkSmartPointer<vtkImageGaussianSmooth>::New();
-    gaussianFilter->SetInputData(input);
-    gaussianFilter->SetStandardDeviation(sigma);
-    gaussianFilter->Update();
+    const QVariantList parameters{sigma, static_cast<int>(d->precision)};
+    if (vtkImageData* cached = d->findCached(input, "GaussianSmoothing", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    vtkImageData* result = nullptr;
+    if (vtkSmartPointer<vtkImageData> output = computeGaussian(input, sigma, d->precision)) {
+        result = d->storeResult(input, "GaussianSmoothing", parameters, output);
+    } else {
+        // 其他体素类型回退到VTK滤波器
+        auto gaussianFilter = vtkSmartPointer<vtkImageGaussianSmooth>::New();
+        gaussianFilter->SetInputData(input);
+        gaussianFilter->SetStandardDeviation(sigma);
+        gaussianFilter->Update();
+        result = d->keepResult(input, "GaussianSmoothing", parameters, gaussianFilter->GetOutput());
+    }
     
     emit processingProgress(100);
     emit processingFinished();
     
-    return gaussianFilter->GetOutput();
+    return result;
 }
 
 vtkImageData* ImageProcessor::applyMedianFilter(vtkImageData* input, int kernelSize) {
+    Q_D(ImageProcessor);
     if (!input) {
         return nullptr;
     }
     
     emit processingStarted();
     
+    const QVariantList parameters{kernelSize};
+    if (vtkImageData* cached = d->findCached(input, "MedianFilter", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
     auto medianFilter = vtkSmartPointer<vtkImageMedian3D>::New();
     medianFilter->SetInputData(input);
     medianFilter->SetKernelSize(kernelSize, kernelSize, kernelSize);
     medianFilter->Update();
     
+    vtkImageData* result = d->keepResult(input, "MedianFilter", parameters, medianFilter->GetOutput());
+    
     emit processingProgress(100);
     emit processingFinished();
     
-    return medianFilter->GetOutput();
+    return result;
 }
 
 vtkImageData* ImageProcessor::applyAnisotropicDiffusion(vtkImageData* input, int iterations, double timeStep) {
+    Q_D(ImageProcessor);
     if (!input) {
         return nullptr;
     }
     
     emit processingStarted();
-    // 实际的各向异性扩散需要更复杂的实现
-    // 这里暂时返回原图像
+    
+    const QVariantList parameters{iterations, timeStep, static_cast<int>(d->precision)};
+    if (vtkImageData* cached = d->findCached(input, "AnisotropicDiffusion", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    vtkImageData* result = input;
+    if (vtkSmartPointer<vtkImageData> output = computeDiffusion(input, iterations, timeStep, d->precision)) {
+        result = d->storeResult(input, "AnisotropicDiffusion", parameters, output);
+    } else {
+        logUnsupportedType("AnisotropicDiffusion", input);
+    }
+    
     emit processingProgress(100);
     emit processingFinished();
     
-    return input;
+    return result;
+}
+
+vtkImageData* ImageProcessor::applyBilateralFilter(vtkImageData* input, double spatialSigma, double rangeSigma) {
+    Q_D(ImageProcessor);
+    if (!input) {
+        return nullptr;
+    }
+    
+    emit processingStarted();
+    
+    const QVariantList parameters{spatialSigma, rangeSigma};
+    if (vtkImageData* cached = d->findCached(input, "BilateralFilter", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    vtkSmartPointer<vtkImageData> output =
+        createImageLike(input, input->GetScalarType(), input->GetNumberOfScalarComponents());
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        forEachComponent<T, T>(input, output, [&](const VoxelView<const T>& in, const VoxelView<T>& out) {
+            ImageKernels::bilateralGridFilter(in, out, spatialSigma, rangeSigma);
+        });
+    });
+    
+    vtkImageData* result = input;
+    if (dispatched) {
+        result = d->storeResult(input, "BilateralFilter", parameters, output);
+    } else {
+        logUnsupportedType("BilateralFilter", input);
+    }
+    
+    emit processingProgress(100);
+    emit processingFinished();
+    
+    return result;
+}
+
+vtkImageData* ImageProcessor::applyNonLocalMeans(vtkImageData* input, double filterStrength,
+                                                 int patchRadius, int searchRadius) {
+    Q_D(ImageProcessor);
+    if (!input) {
+        return nullptr;
+    }
+    
+    emit processingStarted();
+    
+    const QVariantList parameters{filterStrength, patchRadius, searchRadius};
+    if (vtkImageData* cached = d->findCached(input, "NonLocalMeans", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    vtkSmartPointer<vtkImageData> output =
+        createImageLike(input, input->GetScalarType(), input->GetNumberOfScalarComponents());
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        forEachComponent<T, T>(input, output, [&](const VoxelView<const T>& in, const VoxelView<T>& out) {
+            ImageKernels::nonLocalMeans(in, out, patchRadius, searchRadius, filterStrength);
+        });
+    });
+    
+    vtkImageData* result = input;
+    if (dispatched) {
+        result = d->storeResult(input, "NonLocalMeans", parameters, output);
+    } else {
+        logUnsupportedType("NonLocalMeans", input);
+    }
+    
+    emit processingProgress(100);
+    emit processingFinished();
+    
+    return result;
+}
+
+vtkImageData* ImageProcessor::applyUnsharpMask(vtkImageData* input, double sigma, double amount, double threshold) {
+    Q_D(ImageProcessor);
+    if (!input) {
+        return nullptr;
+    }
+    
+    emit processingStarted();
+    
+    const QVariantList parameters{sigma, amount, threshold};
+    if (vtkImageData* cached = d->findCached(input, "UnsharpMask", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    vtkSmartPointer<vtkImageData> output =
+        createImageLike(input, input->GetScalarType(), input->GetNumberOfScalarComponents());
+    const double sigmas[3] = {sigma, sigma, sigma};
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        forEachComponent<T, T>(input, output, [&](const VoxelView<const T>& in, const VoxelView<T>& out) {
+            ImageKernels::unsharpMask(in, out, sigmas, amount, threshold);
+        });
+    });
+    
+    vtkImageData* result = input;
+    if (dispatched) {
+        result = d->storeResult(input, "UnsharpMask", parameters, output);
+    } else {
+        logUnsupportedType("UnsharpMask", input);
+    }
+    
+    emit processingProgress(100);
+    emit processingFinished();
+    
+    return result;
 }
 
 vtkImageData* ImageProcessor::applyErosion(vtkImageData* input, int radius) {
+    Q_D(ImageProcessor);
     if (!input) {
         return nullptr;
     }
     
     emit processingStarted();
-    // 形态学腐蚀操作的实现
+    
+    const QVariantList parameters{radius};
+    if (vtkImageData* cached = d->findCached(input, "Erosion", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    vtkSmartPointer<vtkImageData> output = applyRankFilter(input, radius, false);
+    
+    vtkImageData* result = input;
+    if (output) {
+        result = d->storeResult(input, "Erosion", parameters, output);
+    } else {
+        logUnsupportedType("Erosion", input);
+    }
+    
     emit processingProgress(100);
     emit processingFinished();
     
-    return input;
+    return result;
 }
 
 vtkImageData* ImageProcessor::applyDilation(vtkImageData* input, int radius) {
+    Q_D(ImageProcessor);
     if (!input) {
         return nullptr;
     }
     
     emit processingStarted();
-    // 形态学膨胀操作的实现
+    
+    const QVariantList parameters{radius};
+    if (vtkImageData* cached = d->findCached(input, "Dilation", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    vtkSmartPointer<vtkImageData> output = applyRankFilter(input, radius, true);
+    
+    vtkImageData* result = input;
+    if (output) {
+        result = d->storeResult(input, "Dilation", parameters, output);
+    } else {
+        logUnsupportedType("Dilation", input);
+    }
+    
     emit processingProgress(100);
     emit processingFinished();
     
-    return input;
+    return result;
 }
 
 vtkImageData* ImageProcessor::applyOpening(vtkImageData* input, int radius) {
+    Q_D(ImageProcessor);
     if (!input) {
         return nullptr;
     }
     
     emit processingStarted();
+    
+    const QVariantList parameters{radius};
+    if (vtkImageData* cached = d->findCached(input, "Opening", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
     // 形态学开运算 = 腐蚀 + 膨胀
+    vtkSmartPointer<vtkImageData> output = applyRankFilter(input, radius, false);
+    if (output) {
+        output = applyRankFilter(output, radius, true);
+    }
+    
+    vtkImageData* result = input;
+    if (output) {
+        result = d->storeResult(input, "Opening", parameters, output);
+    } else {
+        logUnsupportedType("Opening", input);
+    }
+    
     emit processingProgress(100);
     emit processingFinished();
     
-    return input;
+    return result;
 }
 
 vtkImageData* ImageProcessor::applyClosing(vtkImageData* input, int radius) {
+    Q_D(ImageProcessor);
     if (!input) {
         return nullptr;
     }
     
     emit processingStarted();
+    
+    const QVariantList parameters{radius};
+    if (vtkImageData* cached = d->findCached(input, "Closing", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
     // 形态学闭运算 = 膨胀 + 腐蚀
+    vtkSmartPointer<vtkImageData> output = applyRankFilter(input, radius, true);
+    if (output) {
+        output = applyRankFilter(output, radius, false);
+    }
+    
+    vtkImageData* result = input;
+    if (output) {
+        result = d->storeResult(input, "Closing", parameters, output);
+    } else {
+        logUnsupportedType("Closing", input);
+    }
+    
     emit processingProgress(100);
     emit processingFinished();
     
-    return input;
+    return result;
 }
 
 vtkImageData* ImageProcessor::applySobelFilter(vtkImageData* input) {
+    Q_D(ImageProcessor);
     if (!input) {
         return nullptr;
     }
     
     emit processingStarted();
-    // Sobel边缘检测的实现
+    
+    const QVariantList parameters;
+    if (vtkImageData* cached = d->findCached(input, "Sobel", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    // Sobel梯度幅值，输出为float
+    vtkSmartPointer<vtkImageData> output =
+        createImageLike(input, VTK_FLOAT, input->GetNumberOfScalarComponents());
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        forEachComponent<T, float>(input, output, [&](const VoxelView<const T>& in, const VoxelView<float>& out) {
+            ImageKernels::sobelMagnitude(in, out);
+        });
+    });
+    
+    vtkImageData* result = input;
+    if (dispatched) {
+        result = d->storeResult(input, "Sobel", parameters, output);
+    } else {
+        logUnsupportedType("Sobel", input);
+    }
+    
     emit processingProgress(100);
     emit processingFinished();
     
-    return input;
+    return result;
 }
 
 vtkImageData* ImageProcessor::applyCannyEdgeDetector(vtkImageData* input, double threshold1, double threshold2) {
@@ -149,35 +636,328 @@ vtkImageData* ImageProcessor::applyCannyEdgeDetector(vtkImageData* input, double
 }
 
 vtkImageData* ImageProcessor::applyThreshold(vtkImageData* input, double lowerThreshold, double upperThreshold) {
+    Q_D(ImageProcessor);
     if (!input) {
         return nullptr;
     }
     
     emit processingStarted();
     
-    auto thresholdFilter = vtkSmartPointer<vtkImageThreshold>::New();
-    thresholdFilter->SetInputData(input);
-    thresholdFilter->ThresholdByUpper(upperThreshold);
-    thresholdFilter->ThresholdByLower(lowerThreshold);
-    thresholdFilter->Update();
+    const QVariantList parameters{lowerThreshold, upperThreshold};
+    if (vtkImageData* cached = d->findCached(input, "Threshold", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    // 输出二值掩膜：[lower, upper]内为255，其余为0
+    vtkImageData* result = nullptr;
+    vtkSmartPointer<vtkImageData> output = createImageLike(input, VTK_UNSIGNED_CHAR, 1);
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        ImageKernels::binaryThreshold(makeVoxelView<const T>(input), makeVoxelView<unsigned char>(output),
+                                      lowerThreshold, upperThreshold);
+    });
+    
+    if (dispatched) {
+        result = d->storeResult(input, "Threshold", parameters, output);
+    } else {
+        auto thresholdFilter = vtkSmartPointer<vtkImageThreshold>::New();
+        thresholdFilter->SetInputData(input);
+        thresholdFilter->ThresholdBetween(lowerThreshold, upperThreshold);
+        thresholdFilter->SetInValue(255);
+        thresholdFilter->SetOutValue(0);
+        thresholdFilter->ReplaceInOn();
+        thresholdFilter->ReplaceOutOn();
+        thresholdFilter->SetOutputScalarTypeToUnsignedChar();
+        thresholdFilter->Update();
+        result = d->keepResult(input, "Threshold", parameters, thresholdFilter->GetOutput());
+    }
     
     emit processingProgress(100);
     emit processingFinished();
     
-    return thresholdFilter->GetOutput();
+    return result;
 }
 
 vtkImageData* ImageProcessor::applyOtsuThreshold(vtkImageData* input) {
+    Q_D(ImageProcessor);
     if (!input) {
         return nullptr;
     }
     
     emit processingStarted();
-    // Otsu自动阈值的实现
+    
+    const QVariantList parameters;
+    if (vtkImageData* cached = d->findCached(input, "OtsuThreshold", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    // Otsu自动阈值：在第一个分量的256级直方图上最大化类间方差，直方图取自统计缓存
+    const int bins = 256;
+    vtkSmartPointer<vtkImageData> output = createImageLike(input, VTK_UNSIGNED_CHAR, 1);
+    const std::shared_ptr<const ImageStatistics> statistics = ImageStatistics::get(input);
+    const bool dispatched = statistics && dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        const double minValue = statistics->global().minimum;
+        const double maxValue = statistics->global().maximum;
+        const int bin = ImageKernels::otsuThresholdBin(statistics->histogram(bins));
+        const double threshold = minValue + (bin + 1) * (maxValue - minValue) / bins;
+        ImageKernels::binaryThreshold(makeVoxelView<const T>(input), makeVoxelView<unsigned char>(output),
+                                      threshold, maxValue);
+    });
+    
+    vtkImageData* result = input;
+    if (dispatched) {
+        result = d->storeResult(input, "OtsuThreshold", parameters, output);
+    } else {
+        logUnsupportedType("OtsuThreshold", input);
+    }
+    
     emit processingProgress(100);
     emit processingFinished();
     
-    return input;
+    return result;
+}
+
+vtkImageData* ImageProcessor::applyConnectedComponentLabeling(vtkImageData* input, int connectivity) {
+    Q_D(ImageProcessor);
+    if (!input) {
+        return nullptr;
+    }
+    
+    emit processingStarted();
+    
+    connectivity = connectivity >= 26 ? 26 : (connectivity >= 18 ? 18 : 6);
+    const QVariantList parameters{connectivity};
+    std::vector<ImageKernels::ComponentStatistics> statistics;
+    if (vtkImageData* cached = d->findCached(input, "ConnectedComponents", parameters)) {
+        // 统计不随标签图缓存，命中时从标签图重新统计
+        double range[2];
+        cached->GetScalarRange(range);
+        ImageKernels::labelStatistics(makeVoxelView<const int>(cached), static_cast<int>(range[1]), statistics);
+        d->setComponents(statistics);
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    // 仅处理第一个分量
+    vtkSmartPointer<vtkImageData> output = createImageLike(input, VTK_INT, 1);
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        ImageKernels::labelConnectedComponents(makeVoxelView<const T>(input), makeVoxelView<int>(output),
+                                               connectivity, &statistics);
+    });
+    
+    vtkImageData* result = input;
+    if (dispatched) {
+        d->setComponents(statistics);
+        result = d->storeResult(input, "ConnectedComponents", parameters, output);
+    } else {
+        d->components.clear();
+        logUnsupportedType("ConnectedComponents", input);
+    }
+    
+    emit processingProgress(100);
+    emit processingFinished();
+    
+    return result;
+}
+
+QVector<ImageProcessor::ComponentInfo> ImageProcessor::getComponentInfo() const {
+    Q_D(const ImageProcessor);
+    return d->components;
+}
+
+vtkImageData* ImageProcessor::applyDistanceTransform(vtkImageData* input, bool signedDistance) {
+    Q_D(ImageProcessor);
+    if (!input) {
+        return nullptr;
+    }
+    
+    emit processingStarted();
+    
+    const QVariantList parameters{signedDistance};
+    if (vtkImageData* cached = d->findCached(input, "DistanceTransform", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    // 仅处理第一个分量，距离按各向异性体素间距计算
+    double spacing[3];
+    input->GetSpacing(spacing);
+    vtkSmartPointer<vtkImageData> output = createImageLike(input, VTK_FLOAT, 1);
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        ImageKernels::euclideanDistanceTransform(makeVoxelView<const T>(input), makeVoxelView<float>(output),
+                                                 spacing, signedDistance);
+    });
+    
+    vtkImageData* result = input;
+    if (dispatched) {
+        result = d->storeResult(input, "DistanceTransform", parameters, output);
+    } else {
+        logUnsupportedType("DistanceTransform", input);
+    }
+    
+    emit processingProgress(100);
+    emit processingFinished();
+    
+    return result;
+}
+
+vtkImageData* ImageProcessor::applyRegionGrowing(vtkImageData* input, int seedX, int seedY, int seedZ,
+                                                 double lowerThreshold, double upperThreshold) {
+    Q_D(ImageProcessor);
+    if (!input) {
+        return nullptr;
+    }
+    
+    emit processingStarted();
+    
+    const QVariantList parameters{seedX, seedY, seedZ, lowerThreshold, upperThreshold};
+    if (vtkImageData* cached = d->findCached(input, "RegionGrowing", parameters)) {
+        emit processingProgress(100);
+        emit processingFinished();
+        return cached;
+    }
+    
+    const int seed[3] = {seedX, seedY, seedZ};
+    int dims[3];
+    input->GetDimensions(dims);
+    ImageKernels::RegionGrowingCriteria criteria;
+    criteria.lower = lowerThreshold;
+    criteria.upper = upperThreshold;
+    vtkSmartPointer<vtkImageData> output = createImageLike(input, VTK_UNSIGNED_CHAR, 1);
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        const ImageKernels::RegionBounds bounds = ImageKernels::RegionBounds::whole(dims);
+        ImageKernels::BitMask region;
+        ImageKernels::growRegion(makeVoxelView<const T>(input), seed, bounds, criteria, region);
+        ImageKernels::expandBitMask(region, bounds, makeVoxelView<unsigned char>(output));
+    });
+    
+    vtkImageData* result = input;
+    if (dispatched) {
+        result = d->storeResult(input, "RegionGrowing", parameters, output);
+    } else {
+        logUnsupportedType("RegionGrowing", input);
+    }
+    
+    emit processingProgress(100);
+    emit processingFinished();
+    
+    return result;
+}
+
+void ImageProcessor::setResultCacheEnabled(bool enabled) {
+    Q_D(ImageProcessor);
+    d->resultCacheEnabled = enabled;
+    if (!enabled) {
+        d->resultCache->clear();
+    }
+}
+
+bool ImageProcessor::isResultCacheEnabled() const {
+    Q_D(const ImageProcessor);
+    return d->resultCacheEnabled;
+}
+
+void ImageProcessor::setResultCacheBudget(qint64 bytes) {
+    Q_D(ImageProcessor);
+    d->resultCache->setByteBudget(bytes);
+}
+
+void ImageProcessor::setResultCacheSpillDirectory(const QString& directory) {
+    Q_D(ImageProcessor);
+    d->resultCache->setSpillDirectory(directory);
+}
+
+void ImageProcessor::clearResultCache() {
+    Q_D(ImageProcessor);
+    d->resultCache->clear();
+}
+
+ProcessingCache* ImageProcessor::resultCache() const {
+    Q_D(const ImageProcessor);
+    return d->resultCache.get();
+}
+
+void ImageProcessor::shareResultCache(const ImageProcessor* other) {
+    Q_D(ImageProcessor);
+    if (other && other != this) {
+        d->resultCache = other->d_func()->resultCache;
+        d->resultCacheEnabled = other->d_func()->resultCacheEnabled;
+    }
+}
+
+void ImageProcessor::setIntermediatePrecision(IntermediatePrecision precision) {
+    Q_D(ImageProcessor);
+    d->precision = precision;
+}
+
+ImageProcessor::IntermediatePrecision ImageProcessor::getIntermediatePrecision() const {
+    Q_D(const ImageProcessor);
+    return d->precision;
+}
+
+QList<ImageProcessor::PrecisionReport> ImageProcessor::evaluateIntermediatePrecision(
+    vtkImageData* input, double sigma, int iterations, double timeStep) {
+    Q_D(ImageProcessor);
+    QList<PrecisionReport> reports;
+    if (!input || !MedicalImaging::isDispatchableVoxelType(input->GetScalarType())) {
+        return reports;
+    }
+
+    // 不经过结果缓存，保证两条路径都实际计算并计时
+    auto evaluate = [&](const QString& operation, auto&& compute) {
+        PrecisionReport report;
+        report.operation = operation;
+        IntermediateInfo referenceInfo;
+        IntermediateInfo reducedInfo;
+        QElapsedTimer timer;
+
+        timer.start();
+        vtkSmartPointer<vtkImageData> reference = compute(FullPrecision, &referenceInfo);
+        report.referenceElapsedMs = timer.nsecsElapsed() / 1.0e6;
+
+        timer.restart();
+        vtkSmartPointer<vtkImageData> reduced = compute(d->precision, &reducedInfo);
+        report.elapsedMs = timer.nsecsElapsed() / 1.0e6;
+
+        report.storageType = reducedInfo.storageType;
+        report.intermediateBytes = reducedInfo.bytes;
+        report.referenceIntermediateBytes = referenceInfo.bytes;
+        compareImages(reference, reduced, report);
+        LOG_INFO(report.toString());
+        reports.append(report);
+    };
+
+    evaluate("GaussianSmoothing", [&](IntermediatePrecision precision, IntermediateInfo* info) {
+        return computeGaussian(input, sigma, precision, info);
+    });
+    evaluate("AnisotropicDiffusion", [&](IntermediatePrecision precision, IntermediateInfo* info) {
+        return computeDiffusion(input, iterations, timeStep, precision, info);
+    });
+    return reports;
+}
+
+QString ImageProcessor::PrecisionReport::toString() const {
+    return QString("%1 [%2]: 最大误差 %3, 平均误差 %4, RMSE %5, PSNR %6 dB, 中间缓冲 %7 → %8 MB, 耗时 %9 → %10 ms")
+        .arg(operation)
+        .arg(storageType)
+        .arg(maxAbsError, 0, 'g', 4)
+        .arg(meanAbsError, 0, 'g', 4)
+        .arg(rmse, 0, 'g', 4)
+        .arg(psnr, 0, 'f', 1)
+        .arg(referenceIntermediateBytes / (1024.0 * 1024.0), 0, 'f', 1)
+        .arg(intermediateBytes / (1024.0 * 1024.0), 0, 'f', 1)
+        .arg(referenceElapsedMs, 0, 'f', 1)
+        .arg(elapsedMs, 0, 'f', 1);
 }
 
 #include "ImageProcessor.moc"
@@ -1,11 +1,15 @@
 #ifndef IMAGEPROCESSOR_H
 #define IMAGEPROCESSOR_H
 
+#include <QList>
 #include <QObject>
+#include <QString>
+#include <QVector>
 #include <memory>
 
 // VTK前向声明
 class vtkImageData;
+class ProcessingCache;
 
 /**
  * @brief 图像处理器，提供各种图像处理算法
@@ -14,6 +18,44 @@ class ImageProcessor : public QObject {
     Q_OBJECT
 
 public:
+    /**
+     * @brief 平滑与扩散中间结果的存储精度
+     *
+     * 降精度模式减少中间缓冲区的内存带宽，结果误差可用evaluateIntermediatePrecision评估。
+     */
+    enum IntermediatePrecision {
+        FullPrecision,     // float
+        Int16Precision,    // 仅对uint8/int16输入生效，其他类型回退到float
+        Float16Precision   // IEEE半精度，超出±65504的值饱和截断
+    };
+
+    /**
+     * @brief 降精度结果相对全精度结果的误差报告
+     */
+    struct PrecisionReport {
+        QString operation;
+        QString storageType;               // 实际使用的中间存储类型
+        double maxAbsError = 0.0;
+        double meanAbsError = 0.0;
+        double rmse = 0.0;
+        double psnr = 0.0;                 // 以全精度结果的值域为峰值(dB)
+        qint64 intermediateBytes = 0;
+        qint64 referenceIntermediateBytes = 0;
+        double elapsedMs = 0.0;
+        double referenceElapsedMs = 0.0;
+
+        QString toString() const;
+    };
+
+    /**
+     * @brief 连通域统计，包围盒为体素索引闭区间(xmin,xmax,ymin,ymax,zmin,zmax)
+     */
+    struct ComponentInfo {
+        int label = 0;
+        qint64 voxelCount = 0;
+        int bounds[6] = {0, 0, 0, 0, 0, 0};
+    };
+
     explicit ImageProcessor(QObject *parent = nullptr);
     ~ImageProcessor();
 
@@ -21,6 +63,13 @@ public:
     vtkImageData* applyGaussianSmoothing(vtkImageData* input, double sigma);
     vtkImageData* applyMedianFilter(vtkImageData* input, int kernelSize);
     vtkImageData* applyAnisotropicDiffusion(vtkImageData* input, int iterations, double timeStep);
+    // 双边网格加速的保边平滑：spatialSigma以体素为单位，rangeSigma与体素值同单位
+    vtkImageData* applyBilateralFilter(vtkImageData* input, double spatialSigma, double rangeSigma);
+    // 非局部均值去噪：filterStrength为权重衰减参数h(与体素值同单位)，半径以体素为单位
+    vtkImageData* applyNonLocalMeans(vtkImageData* input, double filterStrength,
+                                     int patchRadius = 1, int searchRadius = 3);
+    // 反锐化掩模锐化：in + amount·(in − 高斯模糊)，|差值|不超过threshold的体素不变；sigma以体素为单位
+    vtkImageData* applyUnsharpMask(vtkImageData* input, double sigma, double amount, double threshold = 0.0);
 
     // 形态学操作
     vtkImageData* applyErosion(vtkImageData* input, int radius);
@@ -36,6 +85,34 @@ public:
     vtkImageData* applyThreshold(vtkImageData* input, double lowerThreshold, double upperThreshold);
     vtkImageData* applyOtsuThreshold(vtkImageData* input);
 
+    // 连通域标记：非零体素为前景，输出int32标签图(背景为0，标签从1连续编号)
+    vtkImageData* applyConnectedComponentLabeling(vtkImageData* input, int connectivity = 6);
+    QVector<ComponentInfo> getComponentInfo() const; // 最近一次标记的各连通域统计
+
+    // 精确欧氏距离变换：非零体素为目标，按体素间距输出物理单位的float距离；有符号时目标内部为负
+    vtkImageData* applyDistanceTransform(vtkImageData* input, bool signedDistance = false);
+
+    // 种子区域生长(6邻域)：与种子连通且值在[lower, upper]内的体素，输出0/255掩膜
+    vtkImageData* applyRegionGrowing(vtkImageData* input, int seedX, int seedY, int seedZ,
+                                     double lowerThreshold, double upperThreshold);
+
+    // 结果缓存：相同输入版本与参数的重复请求直接返回缓存结果。
+    // 返回的图像与缓存共享，应视为只读；需要原地修改时先DeepCopy
+    void setResultCacheEnabled(bool enabled);
+    bool isResultCacheEnabled() const;
+    void setResultCacheBudget(qint64 bytes);
+    void setResultCacheSpillDirectory(const QString& directory);
+    void clearResultCache();
+    ProcessingCache* resultCache() const;
+    void shareResultCache(const ImageProcessor* other);
+
+    // 中间结果精度
+    void setIntermediatePrecision(IntermediatePrecision precision);
+    IntermediatePrecision getIntermediatePrecision() const;
+    // 以当前精度设置分别运行高斯平滑和各向异性扩散，与全精度结果比较
+    QList<PrecisionReport> evaluateIntermediatePrecision(vtkImageData* input, double sigma,
+                                                         int iterations, double timeStep);
+
 signals:
     void processingStarted();
     void processingFinished();
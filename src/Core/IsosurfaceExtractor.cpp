@@ -0,0 +1,345 @@
+#include "IsosurfaceExtractor.h"
+#include "DataModel.h"
+#include "ImageStatistics.h"
+#include "VTKUtils_fixed.h"
+#include <QFutureWatcher>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QtConcurrent/QtConcurrentRun>
+#include <vtkFlyingEdges3D.h>
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <algorithm>
+#include <cmath>
+#include <list>
+
+namespace {
+
+const int kAutomaticSteps = 256;
+
+struct MeshEntry {
+    long long key;
+    vtkSmartPointer<vtkPolyData> mesh;
+};
+
+// 提取任务的结果：量化后的阈值、网格与提取开始时的缓存代数
+struct SurfaceResult {
+    vtkSmartPointer<vtkImageData> image;
+    double threshold = 0.0;
+    vtkSmartPointer<vtkPolyData> mesh;
+    quint64 generation = 0;
+};
+
+} // namespace
+
+class IsosurfaceExtractor::IsosurfaceExtractorPrivate : public QObject {
+    Q_OBJECT // 添加 Q_OBJECT 宏以启用信号和槽机制
+
+public:
+    QPointer<DataModel> model;
+
+    // 参数与缓存可被后台提取任务访问
+    mutable QMutex mutex;
+    double quantizationStep = 0.0;
+    int cacheCapacity = 16;
+    bool computeNormals = true;
+    const vtkImageData* cacheImage = nullptr;
+    vtkMTimeType cacheVersion = 0;
+    double cacheStep = 0.0;
+    quint64 generation = 0;      // 清空缓存或修改提取参数时递增，旧代数的结果不入缓存也不交付
+    std::list<MeshEntry> meshes; // 按最近使用排序
+
+    QFutureWatcher<SurfaceResult> watcher;
+    bool pending = false;
+    double pendingThreshold = 0.0;
+    double lastVolume = 0.0;
+    double lastSurfaceArea = 0.0;
+
+    double stepFor(vtkImageData* image) const;
+    bool knownStep(vtkImageData* image, double& step) const;
+    long long keyFor(vtkImageData* image, double threshold, double& step) const;
+    vtkSmartPointer<vtkPolyData> findCached(vtkImageData* image, long long key, double step);
+    SurfaceResult extract(vtkImageData* image, double threshold);
+    quint64 currentGeneration() const;
+};
+
+double IsosurfaceExtractor::IsosurfaceExtractorPrivate::stepFor(vtkImageData* image) const {
+    double step;
+    {
+        QMutexLocker locker(&mutex);
+        step = quantizationStep;
+    }
+    if (step > 0.0) {
+        return step;
+    }
+    // 自动步长取自统计服务(DataModel设置图像时已在后台计算)
+    if (auto statistics = MedicalImaging::ImageStatistics::get(image)) {
+        const double range = statistics->global().maximum - statistics->global().minimum;
+        if (range > 0.0) {
+            return range / kAutomaticSteps;
+        }
+    }
+    return 1.0;
+}
+
+// 不访问统计服务即可确定的步长：显式设置的步长，或当前图像版本的缓存所用的步长
+bool IsosurfaceExtractor::IsosurfaceExtractorPrivate::knownStep(vtkImageData* image, double& step) const {
+    QMutexLocker locker(&mutex);
+    if (quantizationStep > 0.0) {
+        step = quantizationStep;
+        return true;
+    }
+    if (cacheImage == image && cacheVersion == image->GetMTime() && cacheStep > 0.0) {
+        step = cacheStep;
+        return true;
+    }
+    return false;
+}
+
+quint64 IsosurfaceExtractor::IsosurfaceExtractorPrivate::currentGeneration() const {
+    QMutexLocker locker(&mutex);
+    return generation;
+}
+
+long long IsosurfaceExtractor::IsosurfaceExtractorPrivate::keyFor(vtkImageData* image, double threshold,
+                                                                  double& step) const {
+    step = stepFor(image);
+    return std::llround(threshold / step);
+}
+
+vtkSmartPointer<vtkPolyData> IsosurfaceExtractor::IsosurfaceExtractorPrivate::findCached(
+    vtkImageData* image, long long key, double step) {
+    QMutexLocker locker(&mutex);
+    if (cacheImage != image || cacheVersion != image->GetMTime() || cacheStep != step) {
+        meshes.clear();
+        cacheImage = image;
+        cacheVersion = image->GetMTime();
+        cacheStep = step;
+        return nullptr;
+    }
+    for (auto it = meshes.begin(); it != meshes.end(); ++it) {
+        if (it->key == key) {
+            meshes.splice(meshes.begin(), meshes, it);
+            return meshes.front().mesh;
+        }
+    }
+    return nullptr;
+}
+
+SurfaceResult IsosurfaceExtractor::IsosurfaceExtractorPrivate::extract(vtkImageData* image, double threshold) {
+    SurfaceResult result;
+    result.image = image;
+    bool normals;
+    {
+        QMutexLocker locker(&mutex);
+        normals = computeNormals;
+        result.generation = generation;
+    }
+    double step = 1.0;
+    const long long key = keyFor(image, threshold, step);
+    const vtkMTimeType version = image->GetMTime();
+    result.threshold = key * step;
+    if (vtkSmartPointer<vtkPolyData> cached = findCached(image, key, step)) {
+        result.mesh = cached;
+        return result;
+    }
+
+    auto contour = vtkSmartPointer<vtkFlyingEdges3D>::New();
+    contour->SetInputData(image);
+    contour->SetValue(0, key * step);
+    contour->SetComputeNormals(normals);
+    contour->ComputeGradientsOff();
+    contour->ComputeScalarsOff();
+    contour->Update();
+
+    auto mesh = vtkSmartPointer<vtkPolyData>::New();
+    mesh->ShallowCopy(contour->GetOutput());
+    MedicalImaging::VTKUtils::attachMeshMeasures(mesh);
+    result.mesh = mesh;
+
+    QMutexLocker locker(&mutex);
+    // 提取期间数据被修改、缓存已切换到其他图像或提取参数已改变时不入缓存
+    if (cacheImage == image && cacheVersion == version && cacheStep == step && generation == result.generation) {
+        meshes.remove_if([key](const MeshEntry& entry) { return entry.key == key; });
+        meshes.push_front({key, mesh});
+        while (meshes.size() > static_cast<size_t>(std::max(1, cacheCapacity))) {
+            meshes.pop_back();
+        }
+    }
+    return result;
+}
+
+IsosurfaceExtractor::IsosurfaceExtractor(QObject *parent)
+    : QObject(parent)
+    , d_ptr(std::make_unique<IsosurfaceExtractorPrivate>())
+{
+    Q_D(IsosurfaceExtractor);
+    connect(&d->watcher, &QFutureWatcher<SurfaceResult>::finished, this, [this]() {
+        Q_D(IsosurfaceExtractor);
+        const SurfaceResult result = d->watcher.result();
+        // 期间图像已被替换时丢弃；提取参数已改变时丢弃并按新参数重新提取
+        if (result.mesh && d->model && result.image == d->model->getImageData()) {
+            if (result.generation == d->currentGeneration()) {
+                d->lastVolume = MedicalImaging::VTKUtils::calculateVolume(result.mesh);
+                d->lastSurfaceArea = MedicalImaging::VTKUtils::calculateSurfaceArea(result.mesh);
+                emit surfaceReady(result.mesh, result.threshold);
+            } else if (!d->pending) {
+                d->pending = true;
+                d->pendingThreshold = result.threshold;
+            }
+        }
+        if (d->pending) {
+            d->pending = false;
+            requestSurface(d->pendingThreshold);
+        }
+    });
+}
+
+IsosurfaceExtractor::~IsosurfaceExtractor() {
+    Q_D(IsosurfaceExtractor);
+    d->watcher.waitForFinished();
+}
+
+void IsosurfaceExtractor::setDataModel(DataModel* model) {
+    Q_D(IsosurfaceExtractor);
+    if (d->model == model) {
+        return;
+    }
+    if (d->model) {
+        disconnect(d->model.data(), nullptr, this, nullptr);
+    }
+    d->model = model;
+    if (model) {
+        connect(model, &DataModel::imageDataChanged, this, &IsosurfaceExtractor::onImageDataChanged);
+    }
+    clearCache();
+}
+
+DataModel* IsosurfaceExtractor::getDataModel() const {
+    Q_D(const IsosurfaceExtractor);
+    return d->model;
+}
+
+void IsosurfaceExtractor::setQuantizationStep(double step) {
+    Q_D(IsosurfaceExtractor);
+    QMutexLocker locker(&d->mutex);
+    d->quantizationStep = step;
+}
+
+double IsosurfaceExtractor::getQuantizationStep() const {
+    Q_D(const IsosurfaceExtractor);
+    QMutexLocker locker(&d->mutex);
+    return d->quantizationStep;
+}
+
+void IsosurfaceExtractor::setCacheCapacity(int meshes) {
+    Q_D(IsosurfaceExtractor);
+    QMutexLocker locker(&d->mutex);
+    d->cacheCapacity = std::max(1, meshes);
+    while (d->meshes.size() > static_cast<size_t>(d->cacheCapacity)) {
+        d->meshes.pop_back();
+    }
+}
+
+int IsosurfaceExtractor::getCacheCapacity() const {
+    Q_D(const IsosurfaceExtractor);
+    QMutexLocker locker(&d->mutex);
+    return d->cacheCapacity;
+}
+
+void IsosurfaceExtractor::setComputeNormals(bool enabled) {
+    Q_D(IsosurfaceExtractor);
+    QMutexLocker locker(&d->mutex);
+    if (d->computeNormals != enabled) {
+        d->computeNormals = enabled;
+        d->meshes.clear();
+        ++d->generation;
+    }
+}
+
+bool IsosurfaceExtractor::isComputeNormals() const {
+    Q_D(const IsosurfaceExtractor);
+    QMutexLocker locker(&d->mutex);
+    return d->computeNormals;
+}
+
+void IsosurfaceExtractor::clearCache() {
+    Q_D(IsosurfaceExtractor);
+    QMutexLocker locker(&d->mutex);
+    d->meshes.clear();
+    d->cacheImage = nullptr;
+    d->cacheVersion = 0;
+    ++d->generation;
+}
+
+vtkSmartPointer<vtkPolyData> IsosurfaceExtractor::extract(double threshold) {
+    Q_D(IsosurfaceExtractor);
+    vtkSmartPointer<vtkImageData> image = d->model ? d->model->getImageData() : nullptr;
+    if (!image) {
+        return nullptr;
+    }
+    vtkSmartPointer<vtkPolyData> mesh = d->extract(image, threshold).mesh;
+    d->lastVolume = MedicalImaging::VTKUtils::calculateVolume(mesh);
+    d->lastSurfaceArea = MedicalImaging::VTKUtils::calculateSurfaceArea(mesh);
+    return mesh;
+}
+
+double IsosurfaceExtractor::quantizeThreshold(double threshold) const {
+    Q_D(const IsosurfaceExtractor);
+    vtkImageData* image = d->model ? d->model->getImageData() : nullptr;
+    if (!image) {
+        return threshold;
+    }
+    double step = 1.0;
+    const long long key = d->keyFor(image, threshold, step);
+    return key * step;
+}
+
+double IsosurfaceExtractor::getLastVolume() const {
+    Q_D(const IsosurfaceExtractor);
+    return d->lastVolume;
+}
+
+double IsosurfaceExtractor::getLastSurfaceArea() const {
+    Q_D(const IsosurfaceExtractor);
+    return d->lastSurfaceArea;
+}
+
+void IsosurfaceExtractor::requestSurface(double threshold) {
+    Q_D(IsosurfaceExtractor);
+    vtkSmartPointer<vtkImageData> image = d->model ? d->model->getImageData() : nullptr;
+    if (!image) {
+        return;
+    }
+    if (d->watcher.isRunning()) {
+        d->pending = true;
+        d->pendingThreshold = threshold;
+        return;
+    }
+
+    // 自动步长需要图像统计，可能要等待统计计算完成，只在后台任务中求取；
+    // 主线程只在步长已知(显式设置或已有该图像的缓存)时查缓存
+    double step = 0.0;
+    if (d->knownStep(image, step)) {
+        const long long key = std::llround(threshold / step);
+        if (vtkSmartPointer<vtkPolyData> cached = d->findCached(image, key, step)) {
+            d->lastVolume = MedicalImaging::VTKUtils::calculateVolume(cached);
+            d->lastSurfaceArea = MedicalImaging::VTKUtils::calculateSurfaceArea(cached);
+            emit surfaceReady(cached, key * step);
+            return;
+        }
+    }
+
+    emit extractionStarted();
+    IsosurfaceExtractorPrivate* priv = d;
+    d->watcher.setFuture(QtConcurrent::run([priv, image, threshold]() {
+        return priv->extract(image, threshold);
+    }));
+}
+
+void IsosurfaceExtractor::onImageDataChanged() {
+    clearCache();
+}
+
+#include "IsosurfaceExtractor.moc"
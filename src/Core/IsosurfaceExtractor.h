@@ -0,0 +1,66 @@
+#ifndef ISOSURFACEEXTRACTOR_H
+#define ISOSURFACEEXTRACTOR_H
+
+#include <QObject>
+#include <memory>
+
+#include <vtkSmartPointer.h>
+
+class vtkImageData;
+class vtkPolyData;
+class DataModel;
+
+/**
+ * @brief 等值面提取器
+ *
+ * 对DataModel当前体数据用vtkFlyingEdges3D提取等值面，生成三维视图使用的vtkPolyData。
+ * flying edges的x边分类、行计数、输出分配和三角形生成各遍均由vtkSMPTools并行执行。
+ * 阈值按量化步长取整后作为缓存键，来回拖动阈值时提取过的阈值直接返回缓存网格；
+ * 图像被替换或数据版本(MTime)变化时缓存失效。
+ * 体积和表面积在提取时计算并附加到网格上，VTKUtils::calculateVolume/calculateSurfaceArea直接读取。
+ *
+ * 典型连接方式：DataModel::imageDataChanged → onImageDataChanged，
+ * 阈值控件 → requestSurface，surfaceReady → RenderingEngine::setSurfaceData。
+ */
+class IsosurfaceExtractor : public QObject {
+    Q_OBJECT
+
+public:
+    explicit IsosurfaceExtractor(QObject *parent = nullptr);
+    ~IsosurfaceExtractor();
+
+    void setDataModel(DataModel* model);
+    DataModel* getDataModel() const;
+
+    // 阈值量化步长(与体素值同单位)，不大于0时取当前图像值域的1/256
+    void setQuantizationStep(double step);
+    double getQuantizationStep() const;
+    void setCacheCapacity(int meshes);
+    int getCacheCapacity() const;
+    void setComputeNormals(bool enabled);
+    bool isComputeNormals() const;
+    void clearCache();
+
+    // 同步提取，阈值先按量化步长取整；没有图像时返回空指针
+    vtkSmartPointer<vtkPolyData> extract(double threshold);
+    double quantizeThreshold(double threshold) const;
+    // 最近一次交付网格的度量
+    double getLastVolume() const;
+    double getLastSurfaceArea() const;
+
+public slots:
+    // 后台提取：计算期间的多次请求只保留最新一次，命中缓存时立即交付
+    void requestSurface(double threshold);
+    void onImageDataChanged();
+
+signals:
+    void extractionStarted();
+    void surfaceReady(vtkPolyData* surface, double threshold);
+
+private:
+    class IsosurfaceExtractorPrivate;
+    std::unique_ptr<IsosurfaceExtractorPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(IsosurfaceExtractor)
+};
+
+#endif // ISOSURFACEEXTRACTOR_H
@@ -0,0 +1,257 @@
+#ifndef MATTESMUTUALINFORMATION_H
+#define MATTESMUTUALINFORMATION_H
+
+#include "RegistrationLevel.h"
+#include "Resampling.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace ImageKernels {
+
+/**
+ * @brief Mattes互信息度量(Parzen窗联合直方图)
+ *
+ * 固定图像强度用零阶(矩形)核、浮动图像强度用三次B样条核投票到联合直方图，
+ * 使直方图对变换参数可导。返回负互信息作为代价(越小越好)。
+ * 梯度按 ∂MI/∂μ = Σ ∂p(ι,κ)/∂μ · log(p(ι,κ)/pm(κ)) 计算，分两遍完成：
+ * 第一遍求浮动图像值、梯度与联合直方图，第二遍用对数比表把每个样本的
+ * B样条导数权重投影到变换参数上。两遍都按样本块并行，直方图与梯度
+ * 先累加到各块自己的部分和中，再按块序合并：块划分只取决于样本数，
+ * 因此结果与线程数和调度无关，逐位可复现。
+ */
+class MattesMutualInformation {
+public:
+    static constexpr int kPadding = 2;
+
+    void initialize(int bins, double fixedMin, double fixedMax, double movingMin, double movingMax) {
+        binCount = std::max(2 * kPadding + 4, bins);
+        const int usable = binCount - 2 * kPadding - 1;
+        fixedMinimum = fixedMin;
+        movingMinimum = movingMin;
+        fixedBinWidth = fixedMax > fixedMin ? (fixedMax - fixedMin) / usable : 1.0;
+        movingBinWidth = movingMax > movingMin ? (movingMax - movingMin) / usable : 1.0;
+        samples = nullptr;
+    }
+
+    // 样本集变化后调用：固定图像分箱只依赖样本本身，预先计算
+    void setSamples(const SampleSet& sampleSet) {
+        samples = &sampleSet;
+        const vtkIdType count = sampleSet.size();
+        fixedBin.resize(static_cast<size_t>(count));
+        movingPosition.resize(static_cast<size_t>(count));
+        movingGradient.resize(static_cast<size_t>(count) * 3);
+        const int lastBin = binCount - kPadding - 1;
+        vtkSMPTools::For(0, count, kGrain, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType i = begin; i < end; ++i) {
+                const double position = (sampleSet.fixedValue[i] - fixedMinimum) / fixedBinWidth + kPadding;
+                fixedBin[i] = std::max(kPadding, std::min(lastBin, static_cast<int>(std::floor(position))));
+            }
+        });
+    }
+
+    int getBinCount() const {
+        return binCount;
+    }
+
+    // 最近一次评估中映射到浮动图像内的样本数
+    vtkIdType getValidSampleCount() const {
+        return validSamples;
+    }
+
+    /**
+     * @brief 评估代价(负互信息)，gradient非空时同时求对变换参数的梯度
+     */
+    template<typename Transform>
+    double evaluate(const Transform& transform, const RegistrationLevel& moving, std::vector<double>* gradient) {
+        if (!samples) {
+            return 0.0;
+        }
+        const vtkIdType count = samples->size();
+        const VoxelView<const float> movingView = moving.view();
+        const int bins = binCount;
+        const size_t jointSize = static_cast<size_t>(bins) * bins;
+        const double lowest = kPadding;
+        const double highest = binCount - kPadding - 1 - 1e-6;
+
+        // 第一遍：映射样本、插值浮动图像并累加联合直方图
+        const vtkIdType blocks = blockCount(count);
+        const vtkIdType blockSize = (count + blocks - 1) / blocks;
+        partialHistograms.assign(static_cast<size_t>(blocks) * jointSize, 0.0);
+        vtkSMPTools::For(0, blocks, 1, [&](vtkIdType firstBlock, vtkIdType lastBlock) {
+            double index[3 * kChunk];
+            for (vtkIdType block = firstBlock; block < lastBlock; ++block) {
+                double* histogram = partialHistograms.data() + static_cast<size_t>(block) * jointSize;
+                const vtkIdType blockEnd = std::min(count, (block + 1) * blockSize);
+                for (vtkIdType chunk = block * blockSize; chunk < blockEnd; chunk += kChunk) {
+                    const int n = static_cast<int>(std::min<vtkIdType>(kChunk, blockEnd - chunk));
+                    // 先把一段样本整体映射到浮动图像索引，线性变换时这一循环可被编译器向量化
+                    for (int j = 0; j < n; ++j) {
+                        double p[3];
+                        double q[3];
+                        samples->point(chunk + j, p);
+                        transform.map(chunk + j, p, q);
+                        moving.physicalToIndex(q, index + 3 * j);
+                    }
+                    for (int j = 0; j < n; ++j) {
+                        const vtkIdType i = chunk + j;
+                        const double* at = index + 3 * j;
+                        float value;
+                        float g[3];
+                        if (!sampleLinearGradient(movingView, at[0], at[1], at[2], value, g)) {
+                            movingPosition[i] = std::numeric_limits<float>::quiet_NaN();
+                            continue;
+                        }
+                        const double position = std::max(lowest, std::min(highest,
+                            (value - movingMinimum) / movingBinWidth + kPadding));
+                        movingPosition[i] = static_cast<float>(position);
+                        for (int a = 0; a < 3; ++a) {
+                            movingGradient[3 * i + a] = static_cast<float>(g[a] / moving.spacing[a]);
+                        }
+
+                        const int base = static_cast<int>(position);
+                        float w[4];
+                        cubicBSplineWeights(static_cast<float>(position - base), w);
+                        double* row = histogram + static_cast<size_t>(fixedBin[i]) * bins + base - 1;
+                        row[0] += w[0];
+                        row[1] += w[1];
+                        row[2] += w[2];
+                        row[3] += w[3];
+                    }
+                }
+            }
+        });
+
+        joint.assign(jointSize, 0.0);
+        for (vtkIdType block = 0; block < blocks; ++block) {
+            const double* histogram = partialHistograms.data() + static_cast<size_t>(block) * jointSize;
+            for (size_t k = 0; k < jointSize; ++k) {
+                joint[k] += histogram[k];
+            }
+        }
+
+        double total = 0.0;
+        for (double h : joint) {
+            total += h;
+        }
+        validSamples = static_cast<vtkIdType>(std::llround(total));
+        if (gradient) {
+            gradient->assign(static_cast<size_t>(transform.parameterCount()), 0.0);
+        }
+        if (total <= 0.0) {
+            return 0.0;
+        }
+
+        // 归一化为概率并求边缘分布
+        std::vector<double> fixedMarginal(static_cast<size_t>(bins), 0.0);
+        std::vector<double> movingMarginal(static_cast<size_t>(bins), 0.0);
+        for (int f = 0; f < bins; ++f) {
+            for (int m = 0; m < bins; ++m) {
+                double& p = joint[static_cast<size_t>(f) * bins + m];
+                p /= total;
+                fixedMarginal[f] += p;
+                movingMarginal[m] += p;
+            }
+        }
+
+        double mutualInformation = 0.0;
+        logRatio.assign(jointSize, 0.0);
+        for (int f = 0; f < bins; ++f) {
+            for (int m = 0; m < bins; ++m) {
+                const size_t k = static_cast<size_t>(f) * bins + m;
+                const double p = joint[k];
+                if (p > kEpsilon && movingMarginal[m] > kEpsilon) {
+                    logRatio[k] = std::log(p / movingMarginal[m]);
+                    mutualInformation += p * (logRatio[k] - std::log(fixedMarginal[f]));
+                }
+            }
+        }
+
+        if (!gradient) {
+            return -mutualInformation;
+        }
+
+        // 第二遍：∂代价/∂μ = −(1/(Z·Δm)) Σ_s Σ_κ L(ιs, κ)·β′(ξs − κ) · ∇m·∂T/∂μ
+        const int parameterCount = transform.parameterCount();
+        const double scale = -1.0 / (total * movingBinWidth);
+        // 参数很多(如自由形变)时减少块数，使部分梯度的总内存不超过kGradientBudget
+        const vtkIdType gradientBlocks = std::max<vtkIdType>(1,
+            std::min<vtkIdType>(blocks, kGradientBudget / std::max(1, parameterCount)));
+        const vtkIdType gradientBlockSize = (count + gradientBlocks - 1) / gradientBlocks;
+        partialGradients.assign(static_cast<size_t>(gradientBlocks) * parameterCount, 0.0);
+        vtkSMPTools::For(0, gradientBlocks, 1, [&](vtkIdType firstBlock, vtkIdType lastBlock) {
+            for (vtkIdType block = firstBlock; block < lastBlock; ++block) {
+                double* partial = partialGradients.data() + static_cast<size_t>(block) * parameterCount;
+                const vtkIdType blockEnd = std::min(count, (block + 1) * gradientBlockSize);
+                for (vtkIdType i = block * gradientBlockSize; i < blockEnd; ++i) {
+                    const float position = movingPosition[i];
+                    if (!(position == position)) {
+                        continue;
+                    }
+                    const int base = static_cast<int>(position);
+                    float dw[4];
+                    cubicBSplineDerivativeWeights(position - base, dw);
+                    const double* L = logRatio.data() + static_cast<size_t>(fixedBin[i]) * bins + base - 1;
+                    const double weight = scale * (L[0] * dw[0] + L[1] * dw[1] + L[2] * dw[2] + L[3] * dw[3]);
+                    if (weight == 0.0) {
+                        continue;
+                    }
+                    double p[3];
+                    samples->point(i, p);
+                    const double g[3] = {weight * movingGradient[3 * i],
+                                         weight * movingGradient[3 * i + 1],
+                                         weight * movingGradient[3 * i + 2]};
+                    transform.accumulateGradient(i, p, g, partial);
+                }
+            }
+        });
+        for (vtkIdType block = 0; block < gradientBlocks; ++block) {
+            const double* partial = partialGradients.data() + static_cast<size_t>(block) * parameterCount;
+            for (int k = 0; k < parameterCount; ++k) {
+                (*gradient)[k] += partial[k];
+            }
+        }
+        return -mutualInformation;
+    }
+
+    // 三次B样条权重(见cubicBSplineWeights)对小数部分t的导数
+    static void cubicBSplineDerivativeWeights(float t, float dw[4]) {
+        const float s = 1.0f - t;
+        dw[0] = -0.5f * s * s;
+        dw[1] = 1.5f * t * t - 2.0f * t;
+        dw[2] = 0.5f + t - 1.5f * t * t;
+        dw[3] = 0.5f * t * t;
+    }
+
+private:
+    static constexpr double kEpsilon = 1e-16;
+    static constexpr vtkIdType kGrain = 4096;
+    static constexpr vtkIdType kMaxBlocks = 64; // 限制部分直方图的总内存
+    static constexpr int kChunk = 256;
+    static constexpr vtkIdType kGradientBudget = 1 << 21; // 部分梯度最多占用的double个数
+
+    static vtkIdType blockCount(vtkIdType count) {
+        return std::max<vtkIdType>(1, std::min(kMaxBlocks, (count + kGrain - 1) / kGrain));
+    }
+
+    int binCount = 32;
+    double fixedMinimum = 0.0;
+    double fixedBinWidth = 1.0;
+    double movingMinimum = 0.0;
+    double movingBinWidth = 1.0;
+    const SampleSet* samples = nullptr;
+    vtkIdType validSamples = 0;
+
+    std::vector<int> fixedBin;
+    std::vector<float> movingPosition; // 浮动强度的连续分箱位置，映射出界为NaN
+    std::vector<float> movingGradient; // 浮动图像物理梯度，每样本3个分量
+    std::vector<double> partialHistograms; // 每块一个联合直方图
+    std::vector<double> partialGradients;  // 每块一组参数梯度
+    std::vector<double> joint;
+    std::vector<double> logRatio;      // log(p(ι,κ) / pm(κ))
+};
+
+} // namespace ImageKernels
+
+#endif // MATTESMUTUALINFORMATION_H
@@ -0,0 +1,223 @@
+#ifndef NONLOCALMEANS_H
+#define NONLOCALMEANS_H
+
+#include "ImageKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ImageKernels {
+
+namespace detail {
+
+/**
+ * @brief 一个z块的工作区：平方差积分体与该块的累加器，每线程一份
+ */
+struct NonLocalMeansScratch {
+    std::vector<double> integral;
+    std::vector<float> weightSum;
+    std::vector<float> valueSum;
+    std::vector<float> maxWeight;
+    std::vector<int> indexA;
+    std::vector<int> indexB;
+};
+
+/**
+ * @brief exp(−a)的查表近似(线性插值，相对误差约1e-6)，a ≥ 10时权重可忽略，取0
+ */
+class NegativeExpTable {
+public:
+    NegativeExpTable() : values(static_cast<size_t>(kRange * kSamplesPerUnit) + 2) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] = static_cast<float>(std::exp(-static_cast<double>(i) / kSamplesPerUnit));
+        }
+    }
+
+    float operator()(float a) const {
+        if (!(a < kRange)) {
+            return 0.0f;
+        }
+        const float position = a * kSamplesPerUnit;
+        const int i = static_cast<int>(position);
+        const float fraction = position - i;
+        return values[i] + fraction * (values[i + 1] - values[i]);
+    }
+
+private:
+    static constexpr float kRange = 10.0f;
+    static constexpr float kSamplesPerUnit = 256.0f;
+    std::vector<float> values;
+};
+
+/**
+ * @brief 原地三维前缀和，首行、首列、首切片为零
+ */
+inline void integrateVolume(double* data, int nx, int ny, int nz) {
+    const vtkIdType sliceSize = static_cast<vtkIdType>(nx) * ny;
+    for (int z = 1; z < nz; ++z) {
+        double* slice = data + z * sliceSize;
+        for (int y = 1; y < ny; ++y) {
+            double* row = slice + static_cast<vtkIdType>(y) * nx;
+            for (int x = 1; x < nx; ++x) {
+                row[x] += row[x - 1];
+            }
+            const double* previous = row - nx;
+            for (int x = 1; x < nx; ++x) {
+                row[x] += previous[x];
+            }
+        }
+        const double* previousSlice = slice - sliceSize;
+        for (vtkIdType i = nx; i < sliceSize; ++i) {
+            slice[i] += previousSlice[i];
+        }
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief 非局部均值去噪
+ *
+ * 对搜索窗口内的每个偏移δ，先求平方差 D(x) = (I(x) − I(x+δ))² 的积分体，
+ * 任意尺寸块(patch)的距离都只需8次查表，计算量与块大小无关。
+ * 体数据按z分块并行，每线程持有本块的积分体和累加器，块间互不写入；
+ * 块与邻块在z方向重叠patchRadius层用于块距离计算。
+ * 中心体素权重取其他偏移中的最大权重，边界外的块内容按边界复制处理。
+ * 权重由查表近似计算，exp是累加循环中的主要开销。
+ *
+ * @param filterStrength 滤波强度h，权重为 exp(−块内均方差 / h²)，通常取噪声标准差的量级
+ */
+template<typename TIn, typename TOut>
+void nonLocalMeans(const VoxelView<const TIn>& in, const VoxelView<TOut>& out,
+                   int patchRadius, int searchRadius, double filterStrength) {
+    const int nx = in.dims[0];
+    const int ny = in.dims[1];
+    const int nz = in.dims[2];
+    const int P = std::max(0, patchRadius);
+    const int S = std::max(0, searchRadius);
+    const int blockSlices = 8;
+    const int blockCount = (nz + blockSlices - 1) / blockSlices;
+    const double patchSize = std::pow(2.0 * P + 1.0, 3);
+    const float weightScale = static_cast<float>(
+        filterStrength > 0.0 ? 1.0 / (patchSize * filterStrength * filterStrength) : 0.0);
+
+    // 连续float副本，便于按偏移随机访问
+    std::vector<float> image(static_cast<size_t>(in.voxelCount()));
+    const VoxelView<float> imageView = MedicalImaging::makeVoxelView(image.data(), in.dims);
+    forEachSlice(nz, [&](int z) {
+        for (int y = 0; y < ny; ++y) {
+            const TIn* src = in.row(y, z);
+            float* dst = imageView.row(y, z);
+            for (int x = 0; x < nx; ++x) {
+                dst[x] = static_cast<float>(src[x * in.strides[0]]);
+            }
+        }
+    });
+
+    const detail::NegativeExpTable negativeExp;
+
+    // 积分体覆盖块及其四周P层，另加一层零边
+    const int ex = nx + 2 * P + 1;
+    const int ey = ny + 2 * P + 1;
+    vtkSMPThreadLocal<detail::NonLocalMeansScratch> scratchBuffers;
+
+    forEachSlice(blockCount, [&](int block) {
+        const int z0 = block * blockSlices;
+        const int z1 = std::min(nz, z0 + blockSlices);
+        const int coreSlices = z1 - z0;
+        const int ez = coreSlices + 2 * P + 1;
+        const vtkIdType coreSize = static_cast<vtkIdType>(nx) * ny * coreSlices;
+        const vtkIdType eSlice = static_cast<vtkIdType>(ex) * ey;
+
+        detail::NonLocalMeansScratch& scratch = scratchBuffers.Local();
+        scratch.integral.assign(static_cast<size_t>(eSlice * ez), 0.0);
+        scratch.weightSum.assign(static_cast<size_t>(coreSize), 0.0f);
+        scratch.valueSum.assign(static_cast<size_t>(coreSize), 0.0f);
+        scratch.maxWeight.assign(static_cast<size_t>(coreSize), 0.0f);
+        scratch.indexA.resize(static_cast<size_t>(ex - 1));
+        scratch.indexB.resize(static_cast<size_t>(ex - 1));
+        double* integral = scratch.integral.data();
+
+        for (int dz = -S; dz <= S; ++dz) {
+            for (int dy = -S; dy <= S; ++dy) {
+                for (int dx = -S; dx <= S; ++dx) {
+                    if (dx == 0 && dy == 0 && dz == 0) {
+                        continue;
+                    }
+                    for (int i = 0; i < ex - 1; ++i) {
+                        scratch.indexA[i] = clampIndex(i - P, nx);
+                        scratch.indexB[i] = clampIndex(i - P + dx, nx);
+                    }
+                    const int* ia = scratch.indexA.data();
+                    const int* ib = scratch.indexB.data();
+
+                    // 平方差(边界复制)写入积分体的非零边部分，零边在各偏移间保持不变
+                    for (int k = 1; k < ez; ++k) {
+                        const int z = z0 - P + k - 1;
+                        for (int j = 1; j < ey; ++j) {
+                            const int y = j - 1 - P;
+                            const float* a = imageView.row(clampIndex(y, ny), clampIndex(z, nz));
+                            const float* b = imageView.row(clampIndex(y + dy, ny), clampIndex(z + dz, nz));
+                            double* row = integral + k * eSlice + static_cast<vtkIdType>(j) * ex + 1;
+                            for (int i = 0; i < ex - 1; ++i) {
+                                const float difference = a[ia[i]] - b[ib[i]];
+                                row[i] = difference * difference;
+                            }
+                        }
+                    }
+                    detail::integrateVolume(integral, ex, ey, ez);
+
+                    // 块距离与权重累加，只对偏移后仍在体内的体素进行
+                    const int xBegin = std::max(0, -dx);
+                    const int xEnd = std::min(nx, nx - dx);
+                    const vtkIdType side = 2 * P + 1;
+                    for (int z = z0; z < z1; ++z) {
+                        if (z + dz < 0 || z + dz >= nz) {
+                            continue;
+                        }
+                        const double* lower = integral + static_cast<vtkIdType>(z - z0) * eSlice;
+                        const double* upper = lower + side * eSlice;
+                        for (int y = std::max(0, -dy); y < std::min(ny, ny - dy); ++y) {
+                            const vtkIdType r0 = static_cast<vtkIdType>(y) * ex;
+                            const vtkIdType r1 = r0 + side * ex;
+                            const float* neighbor = imageView.row(y + dy, z + dz) + dx;
+                            const vtkIdType coreRow = (static_cast<vtkIdType>(z - z0) * ny + y) * nx;
+                            float* weightSum = scratch.weightSum.data() + coreRow;
+                            float* valueSum = scratch.valueSum.data() + coreRow;
+                            float* maxWeight = scratch.maxWeight.data() + coreRow;
+                            for (int x = xBegin; x < xEnd; ++x) {
+                                const vtkIdType c0 = x;
+                                const vtkIdType c1 = x + side;
+                                const double distance =
+                                    upper[r1 + c1] - upper[r1 + c0] - upper[r0 + c1] + upper[r0 + c0]
+                                    - lower[r1 + c1] + lower[r1 + c0] + lower[r0 + c1] - lower[r0 + c0];
+                                const float w = negativeExp(static_cast<float>(distance) * weightScale);
+                                weightSum[x] += w;
+                                valueSum[x] += w * neighbor[x];
+                                maxWeight[x] = std::max(maxWeight[x], w);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        for (int z = z0; z < z1; ++z) {
+            for (int y = 0; y < ny; ++y) {
+                const vtkIdType coreRow = (static_cast<vtkIdType>(z - z0) * ny + y) * nx;
+                const float* center = imageView.row(y, z);
+                TOut* dst = out.row(y, z);
+                for (int x = 0; x < nx; ++x) {
+                    const float selfWeight = scratch.maxWeight[coreRow + x] > 0.0f ? scratch.maxWeight[coreRow + x] : 1.0f;
+                    const float value = (scratch.valueSum[coreRow + x] + selfWeight * center[x])
+                                      / (scratch.weightSum[coreRow + x] + selfWeight);
+                    dst[x * out.strides[0]] = saturateCast<TOut>(value);
+                }
+            }
+        }
+    });
+}
+
+} // namespace ImageKernels
+
+#endif // NONLOCALMEANS_H
@@ -0,0 +1,426 @@
+#include "ProcessingCache.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <vtkImageData.h>
+#include <climits>
+#include <cstring>
+#include <list>
+#include <vector>
+
+namespace {
+
+const quint32 kSpillMagic = 0x4D495043; // "MIPC"
+const quint32 kSpillVersion = 1;
+
+qint64 imageBytes(vtkImageData* image) {
+    // GetActualMemorySize以KiB为单位
+    return image ? static_cast<qint64>(image->GetActualMemorySize()) * 1024 : 0;
+}
+
+QString variantToKeyString(const QVariant& value) {
+    // 浮点参数使用完整精度，避免不同参数映射到同一个键
+    if (value.userType() == QMetaType::Double || value.userType() == QMetaType::Float) {
+        return QString::number(value.toDouble(), 'g', 17);
+    }
+    return value.toString();
+}
+
+// 把图像写成压缩的溢出文件，返回文件大小(失败时为0)；不访问缓存状态，在锁外调用
+qint64 writeSpillFile(const QString& path, vtkImageData* image) {
+    const qint64 rawBytes = static_cast<qint64>(image->GetNumberOfPoints())
+        * image->GetNumberOfScalarComponents() * image->GetScalarSize();
+    if (rawBytes <= 0 || rawBytes > INT_MAX) {
+        return 0; // qCompress只支持int大小的缓冲区
+    }
+
+    const QByteArray raw = QByteArray::fromRawData(
+        static_cast<const char*>(image->GetScalarPointer()), static_cast<int>(rawBytes));
+    const QByteArray compressed = qCompress(raw, 1);
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return 0;
+    }
+
+    int extent[6];
+    double spacing[3];
+    double origin[3];
+    image->GetExtent(extent);
+    image->GetSpacing(spacing);
+    image->GetOrigin(origin);
+
+    QDataStream stream(&file);
+    stream << kSpillMagic << kSpillVersion;
+    for (int i = 0; i < 6; ++i) stream << qint32(extent[i]);
+    for (int i = 0; i < 3; ++i) stream << spacing[i];
+    for (int i = 0; i < 3; ++i) stream << origin[i];
+    stream << qint32(image->GetScalarType()) << qint32(image->GetNumberOfScalarComponents());
+    stream << compressed;
+    file.close();
+    if (stream.status() != QDataStream::Ok) {
+        QFile::remove(path);
+        return 0;
+    }
+    return file.size();
+}
+
+// 读取并解压溢出文件，格式不符或数据不完整时返回空；同样在锁外调用
+vtkSmartPointer<vtkImageData> readSpillFile(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != kSpillMagic || version != kSpillVersion) {
+        return nullptr;
+    }
+
+    int extent[6];
+    double spacing[3];
+    double origin[3];
+    qint32 value = 0;
+    for (int i = 0; i < 6; ++i) { stream >> value; extent[i] = value; }
+    for (int i = 0; i < 3; ++i) stream >> spacing[i];
+    for (int i = 0; i < 3; ++i) stream >> origin[i];
+    qint32 scalarType = 0;
+    qint32 components = 0;
+    QByteArray compressed;
+    stream >> scalarType >> components >> compressed;
+    file.close();
+
+    const QByteArray raw = qUncompress(compressed);
+
+    auto image = vtkSmartPointer<vtkImageData>::New();
+    image->SetExtent(extent);
+    image->SetSpacing(spacing);
+    image->SetOrigin(origin);
+    image->AllocateScalars(scalarType, components);
+
+    const qint64 expected = static_cast<qint64>(image->GetNumberOfPoints()) * components * image->GetScalarSize();
+    if (stream.status() != QDataStream::Ok || raw.size() != expected) {
+        return nullptr;
+    }
+    std::memcpy(image->GetScalarPointer(), raw.constData(), static_cast<size_t>(expected));
+    return image;
+}
+
+} // namespace
+
+QString ProcessingCache::Key::toString() const {
+    QString key = operation;
+    key += QString("|%1|%2").arg(reinterpret_cast<quintptr>(input), 0, 16).arg(static_cast<qulonglong>(version));
+    for (const QVariant& parameter : parameters) {
+        key += QString("|%1:%2").arg(parameter.typeName(), variantToKeyString(parameter));
+    }
+    return key;
+}
+
+ProcessingCache::Key ProcessingCache::makeKey(vtkImageData* input, const QString& operation, const QVariantList& parameters) {
+    Key key;
+    key.input = input;
+    key.version = input ? input->GetMTime() : 0;
+    key.operation = operation;
+    key.parameters = parameters;
+    return key;
+}
+
+struct ProcessingCache::Impl {
+    struct MemoryEntry {
+        vtkSmartPointer<vtkImageData> image;
+        qint64 bytes = 0;
+        std::list<QString>::iterator position;
+    };
+
+    struct SpillEntry {
+        QString filePath;
+        qint64 bytes = 0;
+        std::list<QString>::iterator position;
+    };
+
+    // 已移出内存、等待在锁外压缩写盘的结果
+    struct SpillJob {
+        QString keyString;
+        QString filePath;
+        vtkSmartPointer<vtkImageData> image;
+    };
+
+    mutable QMutex mutex;
+    qint64 byteBudget = 0;
+    qint64 currentBytes = 0;
+    QHash<QString, MemoryEntry> entries;
+    std::list<QString> lru;             // 头部为最近使用
+
+    QString spillDirectory;
+    qint64 spillByteBudget = 4ll * 1024 * 1024 * 1024;
+    qint64 spillBytes = 0;
+    QHash<QString, SpillEntry> spilled;
+    std::list<QString> spillLru;
+    // 正在写盘的结果：写完后才登记到spilled，期间的查找直接取回内存中的图像
+    QHash<QString, vtkSmartPointer<vtkImageData>> spilling;
+    quint64 spillSerial = 0;
+
+    qint64 hits = 0;
+    qint64 misses = 0;
+
+    void touch(MemoryEntry& entry) {
+        lru.splice(lru.begin(), lru, entry.position);
+    }
+
+    // 持锁调用：淘汰的结果只登记为待写盘，压缩与写文件由writeSpills在锁外完成
+    void evictToBudget(std::vector<SpillJob>& jobs) {
+        while (currentBytes > byteBudget && !lru.empty()) {
+            const QString victim = lru.back();
+            auto it = entries.find(victim);
+            if (it != entries.end()) {
+                if (!spillDirectory.isEmpty() && it->image &&
+                    !spilled.contains(victim) && !spilling.contains(victim)) {
+                    jobs.push_back({victim, spillPath(victim), it->image});
+                    spilling.insert(victim, it->image);
+                }
+                currentBytes -= it->bytes;
+                entries.erase(it);
+            }
+            lru.pop_back();
+        }
+    }
+
+    // 同一个键可能在旧文件尚未删除时再次溢出，文件名附加序号避免互相覆盖
+    QString spillPath(const QString& keyString) {
+        const QByteArray digest = QCryptographicHash::hash(keyString.toUtf8(), QCryptographicHash::Sha1).toHex();
+        return QDir(spillDirectory).filePath(
+            QString("%1-%2.mipc").arg(QString::fromLatin1(digest)).arg(++spillSerial));
+    }
+
+    // 不持锁调用：逐个压缩写盘，写完后持锁发布为溢出条目
+    void writeSpills(std::vector<SpillJob>& jobs) {
+        for (SpillJob& job : jobs) {
+            const qint64 fileBytes = writeSpillFile(job.filePath, job.image);
+            QMutexLocker locker(&mutex);
+            publishSpill(job, fileBytes);
+        }
+        jobs.clear();
+    }
+
+    void publishSpill(const SpillJob& job, qint64 fileBytes) {
+        auto pending = spilling.find(job.keyString);
+        const bool current = pending != spilling.end() && pending.value() == job.image;
+        if (current) {
+            spilling.erase(pending);
+        }
+        // 写盘期间已被取回、清空或更换了溢出目录时丢弃文件
+        if (!current || fileBytes <= 0) {
+            if (fileBytes > 0) {
+                QFile::remove(job.filePath);
+            }
+            return;
+        }
+
+        SpillEntry entry;
+        entry.filePath = job.filePath;
+        entry.bytes = fileBytes;
+        spillLru.push_front(job.keyString);
+        entry.position = spillLru.begin();
+        spilled.insert(job.keyString, entry);
+        spillBytes += entry.bytes;
+
+        while (spillBytes > spillByteBudget && !spillLru.empty()) {
+            removeSpilled(spillLru.back());
+        }
+    }
+
+    // 只撤销登记，返回文件路径；文件由调用方在锁外读取后删除
+    QString takeSpilled(const QString& keyString) {
+        auto it = spilled.find(keyString);
+        if (it == spilled.end()) {
+            return QString();
+        }
+        const QString path = it->filePath;
+        spillBytes -= it->bytes;
+        spillLru.erase(it->position);
+        spilled.erase(it);
+        return path;
+    }
+
+    void removeSpilled(const QString& keyString) {
+        const QString path = takeSpilled(keyString);
+        if (!path.isEmpty()) {
+            QFile::remove(path);
+        }
+    }
+
+    void insertMemory(const QString& keyString, vtkImageData* image, std::vector<SpillJob>& jobs) {
+        auto existing = entries.find(keyString);
+        if (existing != entries.end()) {
+            currentBytes -= existing->bytes;
+            lru.erase(existing->position);
+            entries.erase(existing);
+        }
+
+        MemoryEntry entry;
+        entry.image = image;
+        entry.bytes = imageBytes(image);
+        lru.push_front(keyString);
+        entry.position = lru.begin();
+        entries.insert(keyString, entry);
+        currentBytes += entry.bytes;
+        evictToBudget(jobs);
+    }
+};
+
+ProcessingCache::ProcessingCache(qint64 byteBudget)
+    : d(std::make_unique<Impl>())
+{
+    d->byteBudget = byteBudget;
+}
+
+ProcessingCache::~ProcessingCache() {
+    clear();
+}
+
+vtkSmartPointer<vtkImageData> ProcessingCache::lookup(const Key& key) {
+    std::vector<Impl::SpillJob> jobs;
+    QMutexLocker locker(&d->mutex);
+    const QString keyString = key.toString();
+
+    auto it = d->entries.find(keyString);
+    if (it != d->entries.end()) {
+        d->touch(*it);
+        ++d->hits;
+        return it->image;
+    }
+
+    vtkSmartPointer<vtkImageData> restored;
+    auto pending = d->spilling.find(keyString);
+    if (pending != d->spilling.end()) {
+        // 尚在写盘，直接取回内存中的图像；写完的文件在发布时丢弃
+        restored = pending.value();
+        d->spilling.erase(pending);
+    } else {
+        const QString path = d->takeSpilled(keyString);
+        if (!path.isEmpty()) {
+            // 读文件与解压不持锁，期间其他线程可以继续查找与插入
+            locker.unlock();
+            restored = readSpillFile(path);
+            QFile::remove(path);
+            locker.relock();
+        }
+    }
+
+    if (!restored) {
+        ++d->misses;
+        return nullptr;
+    }
+    ++d->hits;
+    d->insertMemory(keyString, restored, jobs);
+    locker.unlock();
+    d->writeSpills(jobs);
+    return restored;
+}
+
+void ProcessingCache::insert(const Key& key, vtkImageData* result) {
+    if (!result) {
+        return;
+    }
+
+    std::vector<Impl::SpillJob> jobs;
+    {
+        QMutexLocker locker(&d->mutex);
+        if (imageBytes(result) > d->byteBudget) {
+            return; // 单个结果超出预算时不缓存
+        }
+        d->insertMemory(key.toString(), result, jobs);
+    }
+    d->writeSpills(jobs);
+}
+
+bool ProcessingCache::contains(const Key& key) const {
+    QMutexLocker locker(&d->mutex);
+    const QString keyString = key.toString();
+    return d->entries.contains(keyString) || d->spilling.contains(keyString) || d->spilled.contains(keyString);
+}
+
+void ProcessingCache::setByteBudget(qint64 bytes) {
+    std::vector<Impl::SpillJob> jobs;
+    {
+        QMutexLocker locker(&d->mutex);
+        d->byteBudget = qMax<qint64>(0, bytes);
+        d->evictToBudget(jobs);
+    }
+    d->writeSpills(jobs);
+}
+
+qint64 ProcessingCache::byteBudget() const {
+    QMutexLocker locker(&d->mutex);
+    return d->byteBudget;
+}
+
+qint64 ProcessingCache::currentBytes() const {
+    QMutexLocker locker(&d->mutex);
+    return d->currentBytes;
+}
+
+int ProcessingCache::entryCount() const {
+    QMutexLocker locker(&d->mutex);
+    return d->entries.size();
+}
+
+void ProcessingCache::setSpillDirectory(const QString& directory) {
+    QMutexLocker locker(&d->mutex);
+    if (d->spillDirectory == directory) {
+        return;
+    }
+
+    while (!d->spillLru.empty()) {
+        d->removeSpilled(d->spillLru.back());
+    }
+    d->spilling.clear(); // 写往旧目录的文件在发布时丢弃
+
+    d->spillDirectory = directory;
+    if (!directory.isEmpty()) {
+        QDir().mkpath(directory);
+    }
+}
+
+QString ProcessingCache::spillDirectory() const {
+    QMutexLocker locker(&d->mutex);
+    return d->spillDirectory;
+}
+
+void ProcessingCache::setSpillByteBudget(qint64 bytes) {
+    QMutexLocker locker(&d->mutex);
+    d->spillByteBudget = qMax<qint64>(0, bytes);
+    while (d->spillBytes > d->spillByteBudget && !d->spillLru.empty()) {
+        d->removeSpilled(d->spillLru.back());
+    }
+}
+
+void ProcessingCache::clear() {
+    QMutexLocker locker(&d->mutex);
+    d->entries.clear();
+    d->lru.clear();
+    d->currentBytes = 0;
+    d->spilling.clear();
+
+    while (!d->spillLru.empty()) {
+        d->removeSpilled(d->spillLru.back());
+    }
+}
+
+qint64 ProcessingCache::hitCount() const {
+    QMutexLocker locker(&d->mutex);
+    return d->hits;
+}
+
+qint64 ProcessingCache::missCount() const {
+    QMutexLocker locker(&d->mutex);
+    return d->misses;
+}
@@ -0,0 +1,66 @@
+#ifndef PROCESSINGCACHE_H
+#define PROCESSINGCACHE_H
+
+#include <QString>
+#include <QVariant>
+#include <memory>
+
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+class vtkImageData;
+
+/**
+ * @brief 图像处理结果缓存
+ *
+ * 以"输入体数据身份 + 数据版本(MTime) + 操作名 + 参数"为键缓存处理结果，
+ * 内存占用受字节预算约束，超出时按LRU淘汰；可选地将淘汰的结果压缩后写入磁盘，
+ * 再次命中时从磁盘恢复。所有接口线程安全。
+ */
+class ProcessingCache {
+public:
+    struct Key {
+        const vtkImageData* input = nullptr;   ///< 输入体数据身份
+        vtkMTimeType version = 0;              ///< 输入体数据版本
+        QString operation;                     ///< 操作名称
+        QVariantList parameters;               ///< 操作参数
+
+        QString toString() const;
+    };
+
+    static Key makeKey(vtkImageData* input, const QString& operation, const QVariantList& parameters);
+
+    explicit ProcessingCache(qint64 byteBudget = 512ll * 1024 * 1024);
+    ~ProcessingCache();
+
+    // 查找与插入
+    vtkSmartPointer<vtkImageData> lookup(const Key& key);
+    void insert(const Key& key, vtkImageData* result);
+    bool contains(const Key& key) const;
+
+    // 容量管理
+    void setByteBudget(qint64 bytes);
+    qint64 byteBudget() const;
+    qint64 currentBytes() const;
+    int entryCount() const;
+
+    // 磁盘溢出，目录为空时禁用
+    void setSpillDirectory(const QString& directory);
+    QString spillDirectory() const;
+    void setSpillByteBudget(qint64 bytes);
+
+    void clear();
+
+    // 命中统计
+    qint64 hitCount() const;
+    qint64 missCount() const;
+
+private:
+    ProcessingCache(const ProcessingCache&) = delete;
+    ProcessingCache& operator=(const ProcessingCache&) = delete;
+
+    struct Impl;
+    std::unique_ptr<Impl> d;
+};
+
+#endif // PROCESSINGCACHE_H
@@ -0,0 +1,240 @@
+#ifndef REGIONGROWING_H
+#define REGIONGROWING_H
+
+#include "ImageKernels.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace ImageKernels {
+
+/**
+ * @brief 每体素1位的访问标记，体积为掩膜字节数的1/8
+ */
+class BitMask {
+public:
+    explicit BitMask(vtkIdType size = 0) : words(static_cast<size_t>((size + 63) / 64), 0) {}
+
+    // 清零并调整为size位，复用已有的存储
+    void reset(vtkIdType size) {
+        words.assign(static_cast<size_t>((size + 63) / 64), 0);
+    }
+
+    bool test(vtkIdType index) const {
+        return (words[static_cast<size_t>(index >> 6)] >> (index & 63)) & 1u;
+    }
+
+    void set(vtkIdType index) {
+        words[static_cast<size_t>(index >> 6)] |= uint64_t(1) << (index & 63);
+    }
+
+private:
+    std::vector<uint64_t> words;
+};
+
+/**
+ * @brief 区域生长的搜索范围(体素索引闭区间)，用于先在当前切片上生长
+ */
+struct RegionBounds {
+    int min[3] = {0, 0, 0};
+    int max[3] = {0, 0, 0};
+
+    static RegionBounds whole(const int dims[3]) {
+        RegionBounds bounds;
+        for (int i = 0; i < 3; ++i) {
+            bounds.max[i] = dims[i] - 1;
+        }
+        return bounds;
+    }
+
+    bool contains(int x, int y, int z) const {
+        return x >= min[0] && x <= max[0] && y >= min[1] && y <= max[1] && z >= min[2] && z <= max[2];
+    }
+
+    vtkIdType voxelCount() const {
+        return static_cast<vtkIdType>(max[0] - min[0] + 1) * (max[1] - min[1] + 1) * (max[2] - min[2] + 1);
+    }
+
+    // 范围内体素的线性索引(x最快)，位掩膜按此索引，大小只与范围有关
+    vtkIdType index(int x, int y, int z) const {
+        const vtkIdType nx = max[0] - min[0] + 1;
+        const vtkIdType ny = max[1] - min[1] + 1;
+        return (x - min[0]) + nx * ((y - min[1]) + ny * static_cast<vtkIdType>(z - min[2]));
+    }
+};
+
+/**
+ * @brief 6邻域扫描线种子填充
+ *
+ * 每次弹出种子后沿x方向扩展为整段，再在y±1、z±1的相邻行中为每段连续的
+ * 可接受体素压入一个种子，栈深与跨段数而非体素数成正比。
+ * 已填充体素记录在按bounds索引(RegionBounds::index)的位掩膜中，filled至少有bounds.voxelCount()位；
+ * cancelled非空且被置位时提前返回-1。
+ *
+ * @param accept 体素值是否属于区域的判定函数
+ * @return 区域体素数
+ */
+template<typename T, typename Accept>
+long long scanlineFloodFill(const VoxelView<const T>& image, const int seed[3], const RegionBounds& bounds,
+                            Accept&& accept, BitMask& filled, const std::atomic<bool>* cancelled = nullptr) {
+    auto fillable = [&](int x, int y, int z) {
+        return !filled.test(bounds.index(x, y, z)) && accept(image.at(x, y, z));
+    };
+
+    if (!bounds.contains(seed[0], seed[1], seed[2]) || !fillable(seed[0], seed[1], seed[2])) {
+        return 0;
+    }
+
+    struct Seed {
+        int x;
+        int y;
+        int z;
+    };
+    std::vector<Seed> stack;
+    stack.push_back({seed[0], seed[1], seed[2]});
+    long long count = 0;
+    long long spans = 0;
+
+    while (!stack.empty()) {
+        const Seed current = stack.back();
+        stack.pop_back();
+        if (!fillable(current.x, current.y, current.z)) {
+            continue;
+        }
+        if (cancelled && (++spans & 1023) == 0 && cancelled->load(std::memory_order_relaxed)) {
+            return -1;
+        }
+
+        int left = current.x;
+        while (left > bounds.min[0] && fillable(left - 1, current.y, current.z)) {
+            --left;
+        }
+        int right = current.x;
+        while (right < bounds.max[0] && fillable(right + 1, current.y, current.z)) {
+            ++right;
+        }
+        const vtkIdType spanStart = bounds.index(left, current.y, current.z);
+        for (int x = left; x <= right; ++x) {
+            filled.set(spanStart + (x - left));
+        }
+        count += right - left + 1;
+
+        const Seed neighbors[4] = {
+            {0, current.y - 1, current.z}, {0, current.y + 1, current.z},
+            {0, current.y, current.z - 1}, {0, current.y, current.z + 1}};
+        for (const Seed& row : neighbors) {
+            if (row.y < bounds.min[1] || row.y > bounds.max[1] || row.z < bounds.min[2] || row.z > bounds.max[2]) {
+                continue;
+            }
+            bool inRun = false;
+            for (int x = left; x <= right; ++x) {
+                const bool ok = fillable(x, row.y, row.z);
+                if (ok && !inRun) {
+                    stack.push_back({x, row.y, row.z});
+                }
+                inRun = ok;
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief bounds范围内体素值的均值与标准差；region非空时只统计区域内体素(region按bounds索引)
+ */
+template<typename T>
+void regionMeanStd(const VoxelView<const T>& image, const BitMask* region, const RegionBounds& bounds,
+                   double& mean, double& standardDeviation) {
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    long long count = 0;
+    for (int z = bounds.min[2]; z <= bounds.max[2]; ++z) {
+        for (int y = bounds.min[1]; y <= bounds.max[1]; ++y) {
+            const vtkIdType rowStart = bounds.index(bounds.min[0], y, z);
+            for (int x = bounds.min[0]; x <= bounds.max[0]; ++x) {
+                if (!region || region->test(rowStart + (x - bounds.min[0]))) {
+                    const double v = static_cast<double>(image.at(x, y, z));
+                    sum += v;
+                    sumSquares += v * v;
+                    ++count;
+                }
+            }
+        }
+    }
+    mean = count > 0 ? sum / count : 0.0;
+    standardDeviation = count > 1 ? std::sqrt(std::max(0.0, (sumSquares - count * mean * mean) / (count - 1))) : 0.0;
+}
+
+/**
+ * @brief 区域生长判据
+ *
+ * 置信连接模式下区间为均值±multiplier×标准差：先由种子邻域(半径radius)估计，
+ * 再以生长出的区域重新估计并重新生长iterations次。
+ */
+struct RegionGrowingCriteria {
+    bool confidence = false;
+    double lower = 0.0;
+    double upper = 0.0;
+    double multiplier = 2.5;
+    int iterations = 2;
+    int radius = 1;
+};
+
+/**
+ * @brief 在bounds范围内生长区域，region按bounds索引、大小为bounds.voxelCount()位
+ *
+ * 切片预览只分配该切片大小的掩膜；传入的region可复用其存储。
+ */
+template<typename T>
+long long growRegion(const VoxelView<const T>& image, const int seed[3], const RegionBounds& bounds,
+                     const RegionGrowingCriteria& criteria, BitMask& region,
+                     const std::atomic<bool>* cancelled = nullptr) {
+    double lower = criteria.lower;
+    double upper = criteria.upper;
+    double mean = 0.0;
+    double standardDeviation = 0.0;
+    if (criteria.confidence) {
+        RegionBounds neighborhood;
+        for (int i = 0; i < 3; ++i) {
+            neighborhood.min[i] = std::max(bounds.min[i], seed[i] - criteria.radius);
+            neighborhood.max[i] = std::min(bounds.max[i], seed[i] + criteria.radius);
+        }
+        regionMeanStd(image, nullptr, neighborhood, mean, standardDeviation);
+    }
+
+    for (int iteration = 0;; ++iteration) {
+        if (criteria.confidence) {
+            lower = mean - criteria.multiplier * standardDeviation;
+            upper = mean + criteria.multiplier * standardDeviation;
+        }
+        region.reset(bounds.voxelCount());
+        const long long count = scanlineFloodFill(image, seed, bounds, [lower, upper](T value) {
+            const double v = static_cast<double>(value);
+            return v >= lower && v <= upper;
+        }, region, cancelled);
+        if (!criteria.confidence || count <= 0 || iteration >= criteria.iterations) {
+            return count;
+        }
+        regionMeanStd(image, &region, bounds, mean, standardDeviation);
+    }
+}
+
+/**
+ * @brief 将按bounds索引的位掩膜写为0/255的uint8掩膜，按切片并行
+ * @param out 维度等于bounds的范围
+ */
+inline void expandBitMask(const BitMask& region, const RegionBounds& bounds, const VoxelView<unsigned char>& out) {
+    forEachSlice(out.dims[2], [&](int k) {
+        for (int j = 0; j < out.dims[1]; ++j) {
+            const vtkIdType rowStart = bounds.index(bounds.min[0], bounds.min[1] + j, bounds.min[2] + k);
+            unsigned char* row = out.row(j, k);
+            for (int i = 0; i < out.dims[0]; ++i) {
+                row[i * out.strides[0]] = region.test(rowStart + i) ? 255 : 0;
+            }
+        }
+    });
+}
+
+} // namespace ImageKernels
+
+#endif // REGIONGROWING_H
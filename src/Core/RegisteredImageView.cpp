@@ -0,0 +1,352 @@
+#include "RegisteredImageView.h"
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <vector>
+
+namespace {
+
+// 切片法向为axis时平面内的两个轴(u在内存中变化较快)
+int planeU(int axis) {
+    return axis == 0 ? 1 : 0;
+}
+
+int planeV(int axis) {
+    return axis == 2 ? 1 : 2;
+}
+
+quint64 tileKey(int axis, int index, int tu, int tv) {
+    return (static_cast<quint64>(axis) << 62) | (static_cast<quint64>(index) << 32) |
+           (static_cast<quint64>(tu) << 16) | static_cast<quint64>(tv);
+}
+
+// extent(闭区间体素索引)对应的子网格
+Resampler::Grid subGrid(const Resampler::Grid& grid, const int extent[6]) {
+    Resampler::Grid sub = grid;
+    for (int i = 0; i < 3; ++i) {
+        sub.origin[i] += extent[2 * i] * grid.spacing[i];
+        sub.dimensions[i] = extent[2 * i + 1] - extent[2 * i] + 1;
+    }
+    return sub;
+}
+
+// 两个网格的体素一一重合：维度相同，原点与间距在间距的1e-6以内一致
+bool sameGrid(const Resampler::Grid& a, const Resampler::Grid& b) {
+    for (int i = 0; i < 3; ++i) {
+        const double tolerance = 1e-6 * std::abs(b.spacing[i]);
+        if (a.dimensions[i] != b.dimensions[i] || std::abs(a.spacing[i] - b.spacing[i]) > tolerance ||
+            std::abs(a.origin[i] - b.origin[i]) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+vtkSmartPointer<vtkImageData> allocateLike(const Resampler::Grid& grid, vtkImageData* prototype) {
+    auto image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(grid.dimensions[0], grid.dimensions[1], grid.dimensions[2]);
+    image->SetSpacing(grid.spacing[0], grid.spacing[1], grid.spacing[2]);
+    image->SetOrigin(grid.origin[0], grid.origin[1], grid.origin[2]);
+    image->AllocateScalars(prototype->GetScalarType(), prototype->GetNumberOfScalarComponents());
+    return image;
+}
+
+/**
+ * @brief 在两幅单体素厚的平面图像之间复制矩形
+ *
+ * 平面内坐标(u, v)相对各自图像的起点，u方向连续存储，行宽分别为srcWidth与dstWidth。
+ */
+void copyRect(vtkImageData* src, int srcWidth, int srcU, int srcV,
+              vtkImageData* dst, int dstWidth, int dstU, int dstV, int width, int height) {
+    const size_t pixelBytes = static_cast<size_t>(src->GetScalarSize()) * src->GetNumberOfScalarComponents();
+    const char* in = static_cast<const char*>(src->GetScalarPointer());
+    char* out = static_cast<char*>(dst->GetScalarPointer());
+    for (int row = 0; row < height; ++row) {
+        std::memcpy(out + (static_cast<size_t>(dstV + row) * dstWidth + dstU) * pixelBytes,
+                    in + (static_cast<size_t>(srcV + row) * srcWidth + srcU) * pixelBytes,
+                    static_cast<size_t>(width) * pixelBytes);
+    }
+}
+
+} // namespace
+
+struct RegisteredImageView::Impl {
+    struct Tile {
+        vtkSmartPointer<vtkImageData> image;
+        qint64 bytes = 0;
+        std::list<quint64>::iterator position;
+    };
+
+    vtkSmartPointer<vtkImageData> moving;
+    vtkSmartPointer<vtkMatrix4x4> transform;
+    vtkSmartPointer<vtkImageData> field;
+    Resampler::Grid grid;
+    Resampler resampler;
+    Resampler fieldResampler;   // 位移场单独插值，避免与浮动图像交替时B样条系数缓存失效
+
+    mutable QMutex mutex;
+    qint64 byteBudget = 64ll * 1024 * 1024;
+    qint64 currentBytes = 0;
+    QHash<quint64, Tile> tiles;
+    std::list<quint64> lru;             // 头部为最近使用
+    quint64 generation = 0;             // 清空缓存时递增，丢弃按旧设置算出的瓦片
+    qint64 hits = 0;
+    qint64 misses = 0;
+    vtkSmartPointer<vtkImageData> full;
+
+    vtkSmartPointer<vtkImageData> resample(const Resampler::Grid& target) const;
+    vtkSmartPointer<vtkImageData> tiledRegion(int axis, const int extent[6]);
+
+    void evictToBudget() {
+        while (currentBytes > byteBudget && !lru.empty()) {
+            auto it = tiles.find(lru.back());
+            if (it != tiles.end()) {
+                currentBytes -= it->bytes;
+                tiles.erase(it);
+            }
+            lru.pop_back();
+        }
+    }
+
+    void clear() {
+        tiles.clear();
+        lru.clear();
+        currentBytes = 0;
+        ++generation;
+    }
+};
+
+vtkSmartPointer<vtkImageData> RegisteredImageView::Impl::resample(const Resampler::Grid& target) const {
+    if (!field) {
+        return resampler.resample(moving, target, transform.GetPointer());
+    }
+    // 位移场按体素与目标网格对应：维度、原点或间距不同时先把位移场插值到目标网格上(在网格节点处与原值一致)
+    if (sameGrid(Resampler::Grid::fromImage(field), target)) {
+        return resampler.resample(moving, target, field.GetPointer());
+    }
+    vtkSmartPointer<vtkImageData> fieldPart = fieldResampler.resample(field, target);
+    return fieldPart ? resampler.resample(moving, target, fieldPart.GetPointer()) : nullptr;
+}
+
+/**
+ * @brief 由瓦片拼出沿axis单体素厚的区域
+ *
+ * 缺失的瓦片按其包围矩形一次重采样后切分入缓存，整个请求只经过一次重采样。
+ */
+vtkSmartPointer<vtkImageData> RegisteredImageView::Impl::tiledRegion(int axis, const int extent[6]) {
+    const int u = planeU(axis);
+    const int v = planeV(axis);
+    const int index = extent[2 * axis];
+    const int tu0 = extent[2 * u] / kTileSize;
+    const int tu1 = extent[2 * u + 1] / kTileSize;
+    const int tv0 = extent[2 * v] / kTileSize;
+    const int tv1 = extent[2 * v + 1] / kTileSize;
+    const int tilesU = tu1 - tu0 + 1;
+
+    std::vector<vtkSmartPointer<vtkImageData>> parts(static_cast<size_t>(tilesU) * (tv1 - tv0 + 1));
+    int missU0 = tu1 + 1, missU1 = tu0 - 1, missV0 = tv1 + 1, missV1 = tv0 - 1;
+    quint64 version;
+    {
+        QMutexLocker locker(&mutex);
+        version = generation;
+        for (int tv = tv0; tv <= tv1; ++tv) {
+            for (int tu = tu0; tu <= tu1; ++tu) {
+                auto it = tiles.find(tileKey(axis, index, tu, tv));
+                if (it != tiles.end()) {
+                    lru.splice(lru.begin(), lru, it->position);
+                    parts[(tv - tv0) * tilesU + (tu - tu0)] = it->image;
+                    ++hits;
+                } else {
+                    missU0 = std::min(missU0, tu);
+                    missU1 = std::max(missU1, tu);
+                    missV0 = std::min(missV0, tv);
+                    missV1 = std::max(missV1, tv);
+                    ++misses;
+                }
+            }
+        }
+    }
+
+    if (missU0 <= missU1) {
+        int blockExtent[6];
+        blockExtent[2 * axis] = blockExtent[2 * axis + 1] = index;
+        blockExtent[2 * u] = missU0 * kTileSize;
+        blockExtent[2 * u + 1] = std::min((missU1 + 1) * kTileSize, grid.dimensions[u]) - 1;
+        blockExtent[2 * v] = missV0 * kTileSize;
+        blockExtent[2 * v + 1] = std::min((missV1 + 1) * kTileSize, grid.dimensions[v]) - 1;
+        vtkSmartPointer<vtkImageData> block = resample(subGrid(grid, blockExtent));
+        if (!block) {
+            return nullptr;
+        }
+        const int blockWidth = blockExtent[2 * u + 1] - blockExtent[2 * u] + 1;
+
+        QMutexLocker locker(&mutex);
+        for (int tv = missV0; tv <= missV1; ++tv) {
+            for (int tu = missU0; tu <= missU1; ++tu) {
+                vtkSmartPointer<vtkImageData>& part = parts[(tv - tv0) * tilesU + (tu - tu0)];
+                if (part) {
+                    continue;  // 包围矩形内已命中的瓦片
+                }
+                int tileExtent[6];
+                tileExtent[2 * axis] = tileExtent[2 * axis + 1] = index;
+                tileExtent[2 * u] = tu * kTileSize;
+                tileExtent[2 * u + 1] = std::min((tu + 1) * kTileSize, grid.dimensions[u]) - 1;
+                tileExtent[2 * v] = tv * kTileSize;
+                tileExtent[2 * v + 1] = std::min((tv + 1) * kTileSize, grid.dimensions[v]) - 1;
+                const Resampler::Grid tileGrid = subGrid(grid, tileExtent);
+                part = allocateLike(tileGrid, block);
+                copyRect(block, blockWidth, tileExtent[2 * u] - blockExtent[2 * u], tileExtent[2 * v] - blockExtent[2 * v],
+                         part, tileGrid.dimensions[u], 0, 0, tileGrid.dimensions[u], tileGrid.dimensions[v]);
+
+                const quint64 key = tileKey(axis, index, tu, tv);
+                if (version == generation && !tiles.contains(key)) {
+                    Tile& tile = tiles[key];
+                    tile.image = part;
+                    tile.bytes = static_cast<qint64>(part->GetNumberOfPoints()) * part->GetScalarSize() *
+                                 part->GetNumberOfScalarComponents();
+                    lru.push_front(key);
+                    tile.position = lru.begin();
+                    currentBytes += tile.bytes;
+                }
+            }
+        }
+        evictToBudget();
+    }
+
+    const Resampler::Grid outputGrid = subGrid(grid, extent);
+    vtkSmartPointer<vtkImageData> output = allocateLike(outputGrid, parts.front());
+    const int outputWidth = outputGrid.dimensions[u];
+    for (int tv = tv0; tv <= tv1; ++tv) {
+        for (int tu = tu0; tu <= tu1; ++tu) {
+            vtkImageData* part = parts[(tv - tv0) * tilesU + (tu - tu0)];
+            const int u0 = std::max(extent[2 * u], tu * kTileSize);
+            const int u1 = std::min(extent[2 * u + 1], (tu + 1) * kTileSize - 1);
+            const int v0 = std::max(extent[2 * v], tv * kTileSize);
+            const int v1 = std::min(extent[2 * v + 1], (tv + 1) * kTileSize - 1);
+            copyRect(part, part->GetDimensions()[u], u0 - tu * kTileSize, v0 - tv * kTileSize,
+                     output, outputWidth, u0 - extent[2 * u], v0 - extent[2 * v], u1 - u0 + 1, v1 - v0 + 1);
+        }
+    }
+    return output;
+}
+
+RegisteredImageView::RegisteredImageView(vtkImageData* movingImage, const Resampler::Grid& grid,
+                                         vtkMatrix4x4* transform, vtkImageData* displacementField)
+    : d(std::make_unique<Impl>())
+{
+    d->moving = movingImage;
+    d->grid = grid;
+    d->transform = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (transform) {
+        d->transform->DeepCopy(transform);
+    }
+    d->field = displacementField;
+    d->resampler.setInterpolation(Resampler::Linear);
+    d->fieldResampler.setInterpolation(Resampler::Linear);
+    d->fieldResampler.setFloatOutput(true);
+}
+
+RegisteredImageView::~RegisteredImageView() = default;
+
+const Resampler::Grid& RegisteredImageView::grid() const {
+    return d->grid;
+}
+
+void RegisteredImageView::setInterpolation(Resampler::Interpolation interpolation) {
+    QMutexLocker locker(&d->mutex);
+    if (d->resampler.getInterpolation() != interpolation) {
+        d->resampler.setInterpolation(interpolation);
+        d->clear();
+        d->full = nullptr;
+    }
+}
+
+void RegisteredImageView::setFloatOutput(bool enabled) {
+    QMutexLocker locker(&d->mutex);
+    if (d->resampler.isFloatOutput() != enabled) {
+        d->resampler.setFloatOutput(enabled);
+        d->clear();
+        d->full = nullptr;
+    }
+}
+
+vtkSmartPointer<vtkImageData> RegisteredImageView::slice(int axis, int index) const {
+    if (axis < 0 || axis > 2) {
+        return nullptr;
+    }
+    int extent[6] = {0, d->grid.dimensions[0] - 1, 0, d->grid.dimensions[1] - 1, 0, d->grid.dimensions[2] - 1};
+    extent[2 * axis] = extent[2 * axis + 1] = index;
+    return region(extent);
+}
+
+vtkSmartPointer<vtkImageData> RegisteredImageView::region(const int extent[6]) const {
+    if (!d->moving || !d->grid.isValid()) {
+        return nullptr;
+    }
+    int clipped[6];
+    for (int i = 0; i < 3; ++i) {
+        clipped[2 * i] = std::max(0, extent[2 * i]);
+        clipped[2 * i + 1] = std::min(d->grid.dimensions[i] - 1, extent[2 * i + 1]);
+        if (clipped[2 * i] > clipped[2 * i + 1]) {
+            return nullptr;
+        }
+    }
+    for (int axis = 2; axis >= 0; --axis) {
+        if (clipped[2 * axis] == clipped[2 * axis + 1]) {
+            return d->tiledRegion(axis, clipped);
+        }
+    }
+    return d->resample(subGrid(d->grid, clipped));
+}
+
+vtkImageData* RegisteredImageView::materialize() const {
+    {
+        QMutexLocker locker(&d->mutex);
+        if (d->full) {
+            return d->full;
+        }
+    }
+    vtkSmartPointer<vtkImageData> full = d->resample(d->grid);
+    QMutexLocker locker(&d->mutex);
+    if (!d->full) {
+        d->full = full;
+    }
+    return d->full;
+}
+
+void RegisteredImageView::setCacheBudget(qint64 bytes) {
+    QMutexLocker locker(&d->mutex);
+    d->byteBudget = std::max<qint64>(0, bytes);
+    d->evictToBudget();
+}
+
+qint64 RegisteredImageView::cacheBudget() const {
+    QMutexLocker locker(&d->mutex);
+    return d->byteBudget;
+}
+
+qint64 RegisteredImageView::cachedBytes() const {
+    QMutexLocker locker(&d->mutex);
+    return d->currentBytes;
+}
+
+qint64 RegisteredImageView::hitCount() const {
+    QMutexLocker locker(&d->mutex);
+    return d->hits;
+}
+
+qint64 RegisteredImageView::missCount() const {
+    QMutexLocker locker(&d->mutex);
+    return d->misses;
+}
+
+void RegisteredImageView::clearCache() {
+    QMutexLocker locker(&d->mutex);
+    d->clear();
+}
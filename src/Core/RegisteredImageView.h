@@ -0,0 +1,71 @@
+#ifndef REGISTEREDIMAGEVIEW_H
+#define REGISTEREDIMAGEVIEW_H
+
+#include <QtGlobal>
+#include <memory>
+
+#include <vtkSmartPointer.h>
+
+#include "Resampler.h"
+
+class vtkImageData;
+class vtkMatrix4x4;
+
+/**
+ * @brief 配准结果的惰性视图
+ *
+ * 不生成完整的重采样体，而是在请求切片或区域时才把浮动图像经变换(矩阵或位移场)
+ * 重采样到固定图像网格的对应部分，结果与完整重采样的相应体素一致。
+ * 单体素厚的请求(切片或切片上的矩形)按切片平面内kTileSize见方的瓦片计算，
+ * 瓦片放入按字节预算LRU淘汰的小缓存，来回翻页与改变叠加方式时不再重复重采样；
+ * 更厚的区域直接重采样、不进入缓存。视图持有构造时的变换快照，所有接口线程安全。
+ */
+class RegisteredImageView {
+public:
+    static const int kTileSize = 64;
+
+    /**
+     * @param grid 结果网格(通常为固定图像网格)
+     * @param transform 结果网格物理点到浮动图像物理点的变换，为空时视为恒等变换
+     * @param displacementField 覆盖结果网格的三分量位移场，非空时代替transform
+     */
+    RegisteredImageView(vtkImageData* movingImage, const Resampler::Grid& grid, vtkMatrix4x4* transform,
+                        vtkImageData* displacementField = nullptr);
+    ~RegisteredImageView();
+
+    const Resampler::Grid& grid() const;
+
+    // 插值方式与输出类型，修改后清空瓦片缓存与完整结果体；默认三线性、与浮动图像相同的标量类型
+    void setInterpolation(Resampler::Interpolation interpolation);
+    void setFloatOutput(bool enabled);
+
+    // 沿axis(0=x, 1=y, 2=z)第index层的整张切片
+    vtkSmartPointer<vtkImageData> slice(int axis, int index) const;
+
+    /**
+     * @brief 结果网格上的子区域
+     * @param extent 体素索引范围{x0, x1, y0, y1, z0, z1}(闭区间)，按网格裁剪
+     * @return 原点与间距对应该子网格的图像，区域为空时返回空指针
+     */
+    vtkSmartPointer<vtkImageData> region(const int extent[6]) const;
+
+    // 生成完整结果体并在视图中保留，供需要整个体的调用方使用；修改插值方式或输出类型后重新生成
+    vtkImageData* materialize() const;
+
+    // 瓦片缓存容量与统计
+    void setCacheBudget(qint64 bytes);
+    qint64 cacheBudget() const;
+    qint64 cachedBytes() const;
+    qint64 hitCount() const;
+    qint64 missCount() const;
+    void clearCache();
+
+private:
+    RegisteredImageView(const RegisteredImageView&) = delete;
+    RegisteredImageView& operator=(const RegisteredImageView&) = delete;
+
+    struct Impl;
+    std::unique_ptr<Impl> d;
+};
+
+#endif // REGISTEREDIMAGEVIEW_H
@@ -0,0 +1,708 @@
+#include "RegistrationCache.h"
+#include "ImageKernels.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <vtkImageData.h>
+#include <vtkSMPTools.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <list>
+
+namespace {
+
+const int kCacheVersion = 1;
+const int kIndexVersion = 1;
+const char* const kIndexFileName = "index.json";
+const quint32 kFieldMagic = 0x4D495246; // "MIRF"
+const quint32 kFieldVersion = 1;
+const vtkIdType kHashChunkBytes = 1 << 20;
+const int kCompressChunkValues = 16 << 20; // 每块64MB，qCompress只支持int大小的缓冲区
+const int kSignatureCacheSize = 8;
+
+/**
+ * @brief 一块数据的64位哈希：四路独立的乘法混合，最后合并
+ */
+quint64 hashBytes(const unsigned char* data, size_t size) {
+    const quint64 k1 = 0x9E3779B97F4A7C15ULL;
+    const quint64 k2 = 0xff51afd7ed558ccdULL;
+    quint64 lanes[4] = {k1 ^ size, k2, k1 * 3, k2 * 5};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; ++lane) {
+            quint64 w;
+            std::memcpy(&w, data + i + 8 * lane, 8);
+            lanes[lane] = (lanes[lane] ^ (w * k2)) * k1;
+            lanes[lane] ^= lanes[lane] >> 29;
+        }
+    }
+    quint64 h = lanes[0] ^ (lanes[1] * k1) ^ (lanes[2] * k2) ^ (lanes[3] * (k1 + k2));
+    for (; i < size; ++i) {
+        h = (h ^ data[i]) * k1;
+    }
+    h ^= h >> 33;
+    h *= k2;
+    h ^= h >> 33;
+    return h;
+}
+
+// 标量数组的内容哈希：按固定大小分块并行求块哈希，再与几何、类型一起按块序SHA-1
+QByteArray contentHash(vtkImageData* image) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(image->GetScalarPointer());
+    const vtkIdType size = static_cast<vtkIdType>(image->GetNumberOfPoints()) *
+                           image->GetNumberOfScalarComponents() * image->GetScalarSize();
+    const vtkIdType chunks = (size + kHashChunkBytes - 1) / kHashChunkBytes;
+    std::vector<quint64> digests(static_cast<size_t>(chunks), 0);
+    if (bytes) {
+        vtkSMPTools::For(0, chunks, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType c = begin; c < end; ++c) {
+                const vtkIdType offset = c * kHashChunkBytes;
+                digests[c] = hashBytes(bytes + offset, static_cast<size_t>(std::min(kHashChunkBytes, size - offset)));
+            }
+        });
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    int dims[3];
+    image->GetDimensions(dims);
+    const qint32 header[5] = {dims[0], dims[1], dims[2], image->GetScalarType(), image->GetNumberOfScalarComponents()};
+    hash.addData(reinterpret_cast<const char*>(header), sizeof(header));
+    hash.addData(reinterpret_cast<const char*>(image->GetSpacing()), 3 * sizeof(double));
+    hash.addData(reinterpret_cast<const char*>(image->GetOrigin()), 3 * sizeof(double));
+    hash.addData(reinterpret_cast<const char*>(digests.data()), static_cast<int>(digests.size() * sizeof(quint64)));
+    return hash.result().toHex();
+}
+
+// 第一分量的8x8x8块均值
+std::vector<float> thumbnailOf(vtkImageData* image) {
+    const int n = RegistrationCache::kThumbnailSize;
+    std::vector<double> sums(static_cast<size_t>(n) * n * n, 0.0);
+    std::vector<double> counts(sums.size(), 0.0);
+    int dims[3];
+    image->GetDimensions(dims);
+    std::vector<int> blockX(dims[0]);
+    std::vector<int> blockY(dims[1]);
+    for (int x = 0; x < dims[0]; ++x) {
+        blockX[x] = x * n / dims[0];
+    }
+    for (int y = 0; y < dims[1]; ++y) {
+        blockY[y] = y * n / dims[1];
+    }
+
+    MedicalImaging::dispatchVoxelType(image->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        const MedicalImaging::VoxelView<const T> in = MedicalImaging::makeVoxelView<const T>(image).component(0);
+        // 每个任务负责一层z块，写入互不重叠
+        vtkSMPTools::For(0, n, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType bz = begin; bz < end; ++bz) {
+                double* blockSums = sums.data() + bz * n * n;
+                double* blockCounts = counts.data() + bz * n * n;
+                const int z0 = static_cast<int>((bz * dims[2] + n - 1) / n);
+                const int z1 = static_cast<int>(((bz + 1) * dims[2] + n - 1) / n);
+                for (int z = z0; z < z1; ++z) {
+                    for (int y = 0; y < dims[1]; ++y) {
+                        const T* row = in.row(y, z);
+                        double* rowSums = blockSums + blockY[y] * n;
+                        double* rowCounts = blockCounts + blockY[y] * n;
+                        for (int x = 0; x < dims[0]; ++x) {
+                            rowSums[blockX[x]] += static_cast<double>(row[x * in.strides[0]]);
+                            rowCounts[blockX[x]] += 1.0;
+                        }
+                    }
+                }
+            }
+        });
+    });
+
+    std::vector<float> thumbnail(sums.size(), 0.0f);
+    for (size_t i = 0; i < sums.size(); ++i) {
+        thumbnail[i] = counts[i] > 0.0 ? static_cast<float>(sums[i] / counts[i]) : 0.0f;
+    }
+    return thumbnail;
+}
+
+QString parametersKey(const QVariantList& parameters) {
+    QString key;
+    for (const QVariant& parameter : parameters) {
+        // 浮点参数使用完整精度，避免不同参数映射到同一个键
+        const bool floating = parameter.userType() == QMetaType::Double || parameter.userType() == QMetaType::Float;
+        key += QString("|%1:%2").arg(parameter.typeName(),
+                                     floating ? QString::number(parameter.toDouble(), 'g', 17) : parameter.toString());
+    }
+    return key;
+}
+
+QString entryKey(const QString& algorithm, const QVariantList& parameters,
+                 const RegistrationCache::Signature& fixed, const RegistrationCache::Signature& moving) {
+    const QString key = algorithm + parametersKey(parameters) + "|" + QString::fromLatin1(fixed.hash) +
+                        "|" + QString::fromLatin1(moving.hash);
+    return QString::fromLatin1(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+QJsonArray toJson(const double* values, int count) {
+    QJsonArray array;
+    for (int i = 0; i < count; ++i) {
+        array.append(values[i]);
+    }
+    return array;
+}
+
+QJsonObject toJson(const RegistrationCache::Signature& signature) {
+    QJsonObject object;
+    object["hash"] = QString::fromLatin1(signature.hash);
+    object["dimensions"] = QJsonArray{signature.dimensions[0], signature.dimensions[1], signature.dimensions[2]};
+    object["spacing"] = toJson(signature.spacing, 3);
+    object["origin"] = toJson(signature.origin, 3);
+    const QByteArray thumbnail(reinterpret_cast<const char*>(signature.thumbnail.data()),
+                               static_cast<int>(signature.thumbnail.size() * sizeof(float)));
+    object["thumbnail"] = QString::fromLatin1(thumbnail.toBase64());
+    return object;
+}
+
+RegistrationCache::Signature signatureFromJson(const QJsonObject& object) {
+    RegistrationCache::Signature signature;
+    signature.hash = object["hash"].toString().toLatin1();
+    const QJsonArray dimensions = object["dimensions"].toArray();
+    const QJsonArray spacing = object["spacing"].toArray();
+    const QJsonArray origin = object["origin"].toArray();
+    for (int i = 0; i < 3; ++i) {
+        signature.dimensions[i] = dimensions.at(i).toInt();
+        signature.spacing[i] = spacing.at(i).toDouble();
+        signature.origin[i] = origin.at(i).toDouble();
+    }
+    const QByteArray thumbnail = QByteArray::fromBase64(object["thumbnail"].toString().toLatin1());
+    signature.thumbnail.resize(thumbnail.size() / sizeof(float));
+    std::memcpy(signature.thumbnail.data(), thumbnail.constData(), signature.thumbnail.size() * sizeof(float));
+    return signature;
+}
+
+bool sameGeometry(const RegistrationCache::Signature& a, const RegistrationCache::Signature& b) {
+    for (int i = 0; i < 3; ++i) {
+        if (a.dimensions[i] != b.dimensions[i] ||
+            std::fabs(a.spacing[i] - b.spacing[i]) > 1e-6 * std::max(1.0, std::fabs(a.spacing[i])) ||
+            std::fabs(a.origin[i] - b.origin[i]) > 1e-3 * std::max(1e-6, a.spacing[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 缩略图的均方根差，相对于参考缩略图的值域
+double thumbnailDistance(const std::vector<float>& reference, const std::vector<float>& other) {
+    if (reference.empty() || reference.size() != other.size()) {
+        return std::numeric_limits<double>::infinity();
+    }
+    const auto range = std::minmax_element(reference.begin(), reference.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < reference.size(); ++i) {
+        const double difference = static_cast<double>(reference[i]) - other[i];
+        sum += difference * difference;
+    }
+    return std::sqrt(sum / reference.size()) / std::max(1e-12, static_cast<double>(*range.second - *range.first));
+}
+
+// 位移场文件：几何头 + 分块压缩的标量数据，每块先按字节平面重排(平滑的浮点场压缩率明显更高)
+bool writeField(const QString& path, vtkImageData* field) {
+    const int scalarSize = field->GetScalarSize();
+    const qint64 values = static_cast<qint64>(field->GetNumberOfPoints()) * field->GetNumberOfScalarComponents();
+    const unsigned char* data = static_cast<const unsigned char*>(field->GetScalarPointer());
+    if (!data || values <= 0) {
+        return false;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    int extent[6];
+    field->GetExtent(extent);
+    QDataStream stream(&file);
+    stream << kFieldMagic << kFieldVersion;
+    for (int i = 0; i < 6; ++i) stream << qint32(extent[i]);
+    for (int i = 0; i < 3; ++i) stream << field->GetSpacing()[i];
+    for (int i = 0; i < 3; ++i) stream << field->GetOrigin()[i];
+    stream << qint32(field->GetScalarType()) << qint32(field->GetNumberOfScalarComponents());
+
+    const qint64 chunks = (values + kCompressChunkValues - 1) / kCompressChunkValues;
+    stream << qint64(chunks);
+    QByteArray shuffled;
+    for (qint64 c = 0; c < chunks; ++c) {
+        const qint64 first = c * kCompressChunkValues;
+        const int count = static_cast<int>(std::min<qint64>(kCompressChunkValues, values - first));
+        shuffled.resize(count * scalarSize);
+        const unsigned char* src = data + first * scalarSize;
+        for (int b = 0; b < scalarSize; ++b) {
+            char* plane = shuffled.data() + static_cast<qint64>(b) * count;
+            for (int i = 0; i < count; ++i) {
+                plane[i] = static_cast<char>(src[static_cast<qint64>(i) * scalarSize + b]);
+            }
+        }
+        stream << qCompress(shuffled, 1);
+    }
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+vtkSmartPointer<vtkImageData> readField(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != kFieldMagic || version != kFieldVersion) {
+        return nullptr;
+    }
+    qint32 extent[6];
+    double spacing[3];
+    double origin[3];
+    qint32 scalarType = 0;
+    qint32 components = 0;
+    for (int i = 0; i < 6; ++i) stream >> extent[i];
+    for (int i = 0; i < 3; ++i) stream >> spacing[i];
+    for (int i = 0; i < 3; ++i) stream >> origin[i];
+    stream >> scalarType >> components;
+    qint64 chunks = 0;
+    stream >> chunks;
+
+    auto field = vtkSmartPointer<vtkImageData>::New();
+    field->SetExtent(extent[0], extent[1], extent[2], extent[3], extent[4], extent[5]);
+    field->SetSpacing(spacing);
+    field->SetOrigin(origin);
+    field->AllocateScalars(scalarType, components);
+    const int scalarSize = field->GetScalarSize();
+    const qint64 values = static_cast<qint64>(field->GetNumberOfPoints()) * components;
+    unsigned char* data = static_cast<unsigned char*>(field->GetScalarPointer());
+
+    qint64 first = 0;
+    for (qint64 c = 0; c < chunks; ++c) {
+        QByteArray compressed;
+        stream >> compressed;
+        const QByteArray shuffled = qUncompress(compressed);
+        const int count = shuffled.size() / scalarSize;
+        if (stream.status() != QDataStream::Ok || count <= 0 || first + count > values) {
+            return nullptr;
+        }
+        unsigned char* dst = data + first * scalarSize;
+        for (int b = 0; b < scalarSize; ++b) {
+            const char* plane = shuffled.constData() + static_cast<qint64>(b) * count;
+            for (int i = 0; i < count; ++i) {
+                dst[static_cast<qint64>(i) * scalarSize + b] = static_cast<unsigned char>(plane[i]);
+            }
+        }
+        first += count;
+    }
+    return first == values ? field : nullptr;
+}
+
+} // namespace
+
+bool RegistrationCache::Signature::isValid() const {
+    return !hash.isEmpty();
+}
+
+RegistrationCache::Signature RegistrationCache::signature(vtkImageData* image) {
+    struct CachedSignature {
+        const vtkImageData* image;
+        vtkMTimeType version;
+        Signature signature;
+    };
+    static QMutex mutex;
+    static std::list<CachedSignature> recent;
+
+    Signature result;
+    if (!image || !image->GetScalarPointer()) {
+        return result;
+    }
+    {
+        QMutexLocker locker(&mutex);
+        for (auto it = recent.begin(); it != recent.end(); ++it) {
+            if (it->image == image && it->version == image->GetMTime()) {
+                recent.splice(recent.begin(), recent, it);
+                return recent.front().signature;
+            }
+        }
+    }
+
+    const vtkMTimeType version = image->GetMTime();
+    result.hash = contentHash(image);
+    image->GetDimensions(result.dimensions);
+    const int* extent = image->GetExtent();
+    for (int i = 0; i < 3; ++i) {
+        result.spacing[i] = image->GetSpacing()[i];
+        result.origin[i] = image->GetOrigin()[i] + result.spacing[i] * extent[2 * i];
+    }
+    result.thumbnail = thumbnailOf(image);
+
+    QMutexLocker locker(&mutex);
+    recent.remove_if([image](const CachedSignature& entry) { return entry.image == image; });
+    recent.push_front({image, version, result});
+    while (recent.size() > static_cast<size_t>(kSignatureCacheSize)) {
+        recent.pop_back();
+    }
+    return result;
+}
+
+struct RegistrationCache::Impl {
+    // 索引条目：近似查找所需的签名与条目在磁盘上的总字节数
+    struct IndexEntry {
+        QString algorithm;
+        QString parameterKey;
+        Signature fixed;
+        Signature moving;
+        qint64 bytes = 0;
+        std::list<QString>::iterator position;
+    };
+
+    mutable QMutex mutex;
+    QString directory;
+    qint64 byteBudget = 1024ll * 1024 * 1024;
+    qint64 currentBytes = 0;
+    QHash<QString, IndexEntry> index;
+    std::list<QString> lru;             // 头部为最近使用
+    bool indexLoaded = false;
+    bool indexDirty = false;
+
+    QString indexPath() const {
+        return QDir(directory).filePath(kIndexFileName);
+    }
+
+    void resetIndex() {
+        index.clear();
+        lru.clear();
+        currentBytes = 0;
+        indexLoaded = false;
+        indexDirty = false;
+    }
+
+    // 首次使用目录时读入索引；索引缺失或版本不符时扫描一次元数据文件重建
+    void ensureIndex() {
+        if (indexLoaded || directory.isEmpty()) {
+            return;
+        }
+        indexLoaded = true;
+        QFile file(indexPath());
+        const QJsonObject object = file.open(QIODevice::ReadOnly)
+                                       ? QJsonDocument::fromJson(file.readAll()).object()
+                                       : QJsonObject();
+        if (object["version"].toInt() == kIndexVersion) {
+            for (const QJsonValue& value : object["entries"].toArray()) {
+                const QJsonObject item = value.toObject();
+                IndexEntry entry;
+                entry.algorithm = item["algorithm"].toString();
+                entry.parameterKey = item["parameterKey"].toString();
+                entry.fixed = signatureFromJson(item["fixed"].toObject());
+                entry.moving = signatureFromJson(item["moving"].toObject());
+                entry.bytes = static_cast<qint64>(item["bytes"].toDouble());
+                insert(item["key"].toString(), entry, false);
+            }
+        } else {
+            rebuildIndex();
+        }
+        evictToBudget();
+    }
+
+    void rebuildIndex() {
+        // 按修改时间从新到旧，较旧的条目排在LRU尾部
+        const QFileInfoList files =
+            QDir(directory).entryInfoList(QStringList() << "*.json", QDir::Files, QDir::Time);
+        for (const QFileInfo& info : files) {
+            if (info.fileName() == kIndexFileName) {
+                continue;
+            }
+            const QJsonObject object = readMetadata(info.absoluteFilePath());
+            if (object.isEmpty()) {
+                continue;
+            }
+            IndexEntry entry;
+            entry.algorithm = object["algorithm"].toString();
+            entry.parameterKey = object["parameterKey"].toString();
+            entry.fixed = signatureFromJson(object["fixed"].toObject());
+            entry.moving = signatureFromJson(object["moving"].toObject());
+            entry.bytes = info.size() + QFileInfo(fieldPath(info.baseName())).size();
+            insert(info.baseName(), entry, false);
+        }
+        indexDirty = true;
+    }
+
+    void saveIndex() {
+        if (!indexDirty || directory.isEmpty()) {
+            return;
+        }
+        QJsonArray entries;
+        for (const QString& key : lru) {
+            const IndexEntry& entry = index[key];
+            QJsonObject item;
+            item["key"] = key;
+            item["algorithm"] = entry.algorithm;
+            item["parameterKey"] = entry.parameterKey;
+            item["fixed"] = toJson(entry.fixed);
+            item["moving"] = toJson(entry.moving);
+            item["bytes"] = static_cast<double>(entry.bytes);
+            entries.append(item);
+        }
+        QJsonObject object;
+        object["version"] = kIndexVersion;
+        object["entries"] = entries;
+        QSaveFile file(indexPath());
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+            indexDirty = !file.commit();
+        }
+    }
+
+    // atFront为false时追加到LRU尾部(按从新到旧的顺序载入索引)
+    void insert(const QString& key, IndexEntry entry, bool atFront = true) {
+        remove(key, false);
+        entry.position = atFront ? lru.insert(lru.begin(), key) : lru.insert(lru.end(), key);
+        currentBytes += entry.bytes;
+        index.insert(key, entry);
+        indexDirty = true;
+    }
+
+    void remove(const QString& key, bool deleteFiles) {
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return;
+        }
+        if (deleteFiles) {
+            QFile::remove(metadataPath(key));
+            QFile::remove(fieldPath(key));
+        }
+        currentBytes -= it->bytes;
+        lru.erase(it->position);
+        index.erase(it);
+        indexDirty = true;
+    }
+
+    void touch(const QString& key) {
+        auto it = index.find(key);
+        if (it != index.end() && it->position != lru.begin()) {
+            lru.splice(lru.begin(), lru, it->position);
+            indexDirty = true;
+        }
+    }
+
+    void evictToBudget() {
+        while (currentBytes > byteBudget && !lru.empty()) {
+            remove(lru.back(), true);
+        }
+    }
+
+    QString metadataPath(const QString& key) const {
+        return QDir(directory).filePath(key + ".json");
+    }
+
+    QString fieldPath(const QString& key) const {
+        return QDir(directory).filePath(key + ".field");
+    }
+
+    static QJsonObject readMetadata(const QString& path) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return QJsonObject();
+        }
+        const QJsonObject object = QJsonDocument::fromJson(file.readAll()).object();
+        return object["version"].toInt() == kCacheVersion ? object : QJsonObject();
+    }
+
+    bool load(const QString& key, const QJsonObject& object, Entry& entry) const {
+        const QJsonArray matrix = object["matrix"].toArray();
+        if (matrix.size() != 16) {
+            return false;
+        }
+        for (int i = 0; i < 16; ++i) {
+            entry.matrix[i] = matrix.at(i).toDouble();
+        }
+        entry.parameters.clear();
+        for (const QJsonValue& value : object["parameters"].toArray()) {
+            entry.parameters.push_back(value.toDouble());
+        }
+        entry.metricValue = object["metricValue"].toDouble();
+        entry.displacementField = nullptr;
+        if (object["hasField"].toBool()) {
+            entry.displacementField = readField(fieldPath(key));
+            if (!entry.displacementField) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+RegistrationCache::RegistrationCache(const QString& directory)
+    : d(std::make_unique<Impl>())
+{
+    setDirectory(directory);
+}
+
+RegistrationCache::~RegistrationCache() {
+    // 命中只更新内存中的LRU顺序，退出时写回
+    QMutexLocker locker(&d->mutex);
+    d->saveIndex();
+}
+
+void RegistrationCache::setDirectory(const QString& directory) {
+    QMutexLocker locker(&d->mutex);
+    if (d->directory == directory) {
+        return;
+    }
+    d->saveIndex();
+    d->resetIndex();
+    d->directory = directory;
+    if (!directory.isEmpty()) {
+        QDir().mkpath(directory);
+    }
+}
+
+QString RegistrationCache::directory() const {
+    QMutexLocker locker(&d->mutex);
+    return d->directory;
+}
+
+void RegistrationCache::setByteBudget(qint64 bytes) {
+    QMutexLocker locker(&d->mutex);
+    d->byteBudget = qMax<qint64>(0, bytes);
+    d->ensureIndex();
+    d->evictToBudget();
+    d->saveIndex();
+}
+
+qint64 RegistrationCache::byteBudget() const {
+    QMutexLocker locker(&d->mutex);
+    return d->byteBudget;
+}
+
+qint64 RegistrationCache::currentBytes() const {
+    QMutexLocker locker(&d->mutex);
+    d->ensureIndex();
+    return d->currentBytes;
+}
+
+bool RegistrationCache::lookup(const QString& algorithm, const QVariantList& parameters,
+                               const Signature& fixed, const Signature& moving, Entry& entry) const {
+    QMutexLocker locker(&d->mutex);
+    if (d->directory.isEmpty() || !fixed.isValid() || !moving.isValid()) {
+        return false;
+    }
+    d->ensureIndex();
+    const QString key = entryKey(algorithm, parameters, fixed, moving);
+    if (!d->index.contains(key)) {
+        return false;
+    }
+    const QJsonObject object = d->readMetadata(d->metadataPath(key));
+    if (object.isEmpty() || !d->load(key, object, entry)) {
+        // 文件被外部删除或损坏，从索引中去掉
+        d->remove(key, true);
+        return false;
+    }
+    d->touch(key);
+    return true;
+}
+
+bool RegistrationCache::findSimilar(const QString& algorithm, const QVariantList& parameters,
+                                    const Signature& fixed, const Signature& moving, Entry& entry,
+                                    double tolerance) const {
+    QMutexLocker locker(&d->mutex);
+    if (d->directory.isEmpty() || !fixed.isValid() || !moving.isValid()) {
+        return false;
+    }
+    // 只在内存索引中比较签名，仅读取最终选中的一个条目
+    d->ensureIndex();
+    const QString parameterString = parametersKey(parameters);
+    QString bestKey;
+    double bestDistance = tolerance;
+    for (auto it = d->index.constBegin(); it != d->index.constEnd(); ++it) {
+        const Impl::IndexEntry& cached = it.value();
+        if (cached.algorithm != algorithm || cached.parameterKey != parameterString ||
+            !sameGeometry(cached.fixed, fixed) || !sameGeometry(cached.moving, moving)) {
+            continue;
+        }
+        const double distance = std::max(thumbnailDistance(cached.fixed.thumbnail, fixed.thumbnail),
+                                         thumbnailDistance(cached.moving.thumbnail, moving.thumbnail));
+        if (distance <= bestDistance) {
+            bestDistance = distance;
+            bestKey = it.key();
+        }
+    }
+    if (bestKey.isEmpty()) {
+        return false;
+    }
+    const QJsonObject object = d->readMetadata(d->metadataPath(bestKey));
+    if (object.isEmpty() || !d->load(bestKey, object, entry)) {
+        d->remove(bestKey, true);
+        return false;
+    }
+    d->touch(bestKey);
+    return true;
+}
+
+bool RegistrationCache::store(const QString& algorithm, const QVariantList& parameters,
+                              const Signature& fixed, const Signature& moving, const Entry& entry) {
+    QMutexLocker locker(&d->mutex);
+    if (d->directory.isEmpty() || !fixed.isValid() || !moving.isValid()) {
+        return false;
+    }
+    const QString key = entryKey(algorithm, parameters, fixed, moving);
+    // 先写位移场再写元数据，元数据存在即表示条目完整
+    if (entry.displacementField && !writeField(d->fieldPath(key), entry.displacementField)) {
+        return false;
+    }
+
+    QJsonObject object;
+    object["version"] = kCacheVersion;
+    object["algorithm"] = algorithm;
+    object["parameterKey"] = parametersKey(parameters);
+    object["fixed"] = toJson(fixed);
+    object["moving"] = toJson(moving);
+    object["matrix"] = toJson(entry.matrix, 16);
+    object["parameters"] = toJson(entry.parameters.data(), static_cast<int>(entry.parameters.size()));
+    object["metricValue"] = entry.metricValue;
+    object["hasField"] = entry.displacementField != nullptr;
+
+    QSaveFile file(d->metadataPath(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    const QByteArray metadata = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    file.write(metadata);
+    if (!file.commit()) {
+        return false;
+    }
+
+    d->ensureIndex();
+    Impl::IndexEntry indexEntry;
+    indexEntry.algorithm = algorithm;
+    indexEntry.parameterKey = parametersKey(parameters);
+    indexEntry.fixed = fixed;
+    indexEntry.moving = moving;
+    indexEntry.bytes = metadata.size() + (entry.displacementField ? QFileInfo(d->fieldPath(key)).size() : 0);
+    d->insert(key, indexEntry);
+    d->evictToBudget();
+    d->saveIndex();
+    return true;
+}
+
+void RegistrationCache::clear() {
+    QMutexLocker locker(&d->mutex);
+    if (d->directory.isEmpty()) {
+        return;
+    }
+    QDir directory(d->directory);
+    const QStringList files = directory.entryList(QStringList() << "*.json" << "*.field", QDir::Files);
+    for (const QString& name : files) {
+        directory.remove(name);
+    }
+    d->resetIndex();
+}
@@ -0,0 +1,86 @@
+#ifndef REGISTRATIONCACHE_H
+#define REGISTRATIONCACHE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+#include <memory>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+
+class vtkImageData;
+
+/**
+ * @brief 配准结果的持久化缓存
+ *
+ * 以"固定/浮动图像内容哈希 + 算法名 + 参数"为键，把变换矩阵、优化参数和
+ * (可变形配准的)位移场写入本地目录：元数据为JSON，位移场按字节平面重排后
+ * zlib压缩。内容哈希与图像身份无关，跨会话重新加载同一数据也能命中。
+ * 内容不同但几何相同、缩略图接近的图像对可查到"相似"结果，用作配准初值。
+ * 目录中的index.json记录各条目的签名、字节数与LRU顺序，查找只在内存索引中进行；
+ * 条目总字节数超过预算时按LRU删除最久未用的条目。所有接口线程安全。
+ */
+class RegistrationCache {
+public:
+    /**
+     * @brief 图像内容签名：并行分块哈希、几何与8x8x8块均值缩略图
+     */
+    struct Signature {
+        QByteArray hash;
+        int dimensions[3] = {0, 0, 0};
+        double spacing[3] = {0.0, 0.0, 0.0};
+        double origin[3] = {0.0, 0.0, 0.0};
+        std::vector<float> thumbnail;
+
+        bool isValid() const;
+    };
+
+    /**
+     * @brief 一次配准的结果
+     */
+    struct Entry {
+        double matrix[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+        std::vector<double> parameters;                    ///< 优化器参数，用作热启动初值
+        double metricValue = 0.0;
+        vtkSmartPointer<vtkImageData> displacementField;   ///< 可变形配准的位移场，可为空
+    };
+
+    static const int kThumbnailSize = 8;
+
+    // 计算签名(按图像身份 + 数据版本缓存最近的结果)；图像为空时返回无效签名
+    static Signature signature(vtkImageData* image);
+
+    explicit RegistrationCache(const QString& directory = QString());
+    ~RegistrationCache();
+
+    // 缓存目录，为空时禁用
+    void setDirectory(const QString& directory);
+    QString directory() const;
+
+    // 磁盘字节预算(元数据与位移场文件合计)，默认1GB
+    void setByteBudget(qint64 bytes);
+    qint64 byteBudget() const;
+    qint64 currentBytes() const;
+
+    // 精确查找：内容、算法与参数完全一致
+    bool lookup(const QString& algorithm, const QVariantList& parameters,
+                const Signature& fixed, const Signature& moving, Entry& entry) const;
+    // 相似查找：算法与参数一致、几何相同、两幅图像的缩略图相对差异都不超过tolerance
+    bool findSimilar(const QString& algorithm, const QVariantList& parameters,
+                     const Signature& fixed, const Signature& moving, Entry& entry,
+                     double tolerance = 0.02) const;
+    bool store(const QString& algorithm, const QVariantList& parameters,
+               const Signature& fixed, const Signature& moving, const Entry& entry);
+
+    void clear();
+
+private:
+    RegistrationCache(const RegistrationCache&) = delete;
+    RegistrationCache& operator=(const RegistrationCache&) = delete;
+
+    struct Impl;
+    std::unique_ptr<Impl> d;
+};
+
+#endif // REGISTRATIONCACHE_H
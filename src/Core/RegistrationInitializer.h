@@ -0,0 +1,431 @@
+#ifndef REGISTRATIONINITIALIZER_H
+#define REGISTRATIONINITIALIZER_H
+
+#include "ImageKernels.h"
+#include "RegistrationLevel.h"
+#include "Resampling.h"
+#include <vtkSMPTools.h>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <utility>
+#include <vector>
+
+namespace ImageKernels {
+
+/**
+ * @brief 强度加权的一阶与二阶矩(物理坐标)
+ *
+ * 权重为 max(0, v − background)；主轴为协方差矩阵的单位特征向量(按列存放)，按特征值降序排列。
+ */
+struct ImageMoments {
+    double mass = 0.0;
+    double center[3] = {0.0, 0.0, 0.0};
+    double covariance[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+    double eigenvalues[3] = {0.0, 0.0, 0.0};
+    double axes[3][3] = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+
+    bool isValid() const {
+        return mass > 0.0;
+    }
+};
+
+/**
+ * @brief 对称3x3矩阵的Jacobi特征分解，特征值降序，vectors的第k列对应values[k]
+ */
+inline void symmetricEigen3(const double a[3][3], double values[3], double vectors[3][3]) {
+    double m[3][3];
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            m[r][c] = a[r][c];
+            vectors[r][c] = r == c ? 1.0 : 0.0;
+        }
+    }
+    for (int sweep = 0; sweep < 50; ++sweep) {
+        const double off = m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+        const double diagonal = m[0][0] * m[0][0] + m[1][1] * m[1][1] + m[2][2] * m[2][2];
+        if (!(off > 1e-30 * diagonal)) {
+            break;
+        }
+        for (int p = 0; p < 2; ++p) {
+            for (int q = p + 1; q < 3; ++q) {
+                if (m[p][q] == 0.0) {
+                    continue;
+                }
+                // 旋转角使m[p][q]归零：t = tanθ取绝对值较小的根
+                const double theta = (m[q][q] - m[p][p]) / (2.0 * m[p][q]);
+                const double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                const double c = 1.0 / std::sqrt(t * t + 1.0);
+                const double s = t * c;
+                for (int k = 0; k < 3; ++k) {
+                    const double mkp = m[k][p];
+                    const double mkq = m[k][q];
+                    m[k][p] = c * mkp - s * mkq;
+                    m[k][q] = s * mkp + c * mkq;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    const double mpk = m[p][k];
+                    const double mqk = m[q][k];
+                    m[p][k] = c * mpk - s * mqk;
+                    m[q][k] = s * mpk + c * mqk;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    const double vkp = vectors[k][p];
+                    const double vkq = vectors[k][q];
+                    vectors[k][p] = c * vkp - s * vkq;
+                    vectors[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    int order[3] = {0, 1, 2};
+    std::sort(order, order + 3, [&m](int i, int j) { return m[i][i] > m[j][j]; });
+    double sorted[3][3];
+    for (int k = 0; k < 3; ++k) {
+        values[k] = m[order[k]][order[k]];
+        for (int r = 0; r < 3; ++r) {
+            sorted[r][k] = vectors[r][order[k]];
+        }
+    }
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            vectors[r][c] = sorted[r][c];
+        }
+    }
+}
+
+/**
+ * @brief 一次并行遍历求层的强度矩
+ *
+ * 每个z切片累加一组部分和后按切片顺序归并，结果与线程数无关；
+ * 坐标相对层中心累加，减小二阶矩的抵消误差。
+ */
+inline ImageMoments computeMoments(const RegistrationLevel& level, float background) {
+    ImageMoments moments;
+    if (level.isEmpty()) {
+        return moments;
+    }
+    // 每个切片：w, wx, wy, wz, wxx, wyy, wzz, wxy, wxz, wyz
+    const int kSums = 10;
+    std::vector<double> partial(static_cast<size_t>(level.dims[2]) * kSums, 0.0);
+    const VoxelView<const float> in = level.view();
+    const double half[3] = {0.5 * (level.dims[0] - 1), 0.5 * (level.dims[1] - 1), 0.5 * (level.dims[2] - 1)};
+
+    forEachSlice(level.dims[2], [&](int z) {
+        double* sums = partial.data() + static_cast<size_t>(z) * kSums;
+        const double pz = (z - half[2]) * level.spacing[2];
+        for (int y = 0; y < level.dims[1]; ++y) {
+            const float* row = in.row(y, z);
+            const double py = (y - half[1]) * level.spacing[1];
+            double w = 0.0, wx = 0.0, wxx = 0.0;
+            for (int x = 0; x < level.dims[0]; ++x) {
+                const double weight = row[x] - background;
+                if (weight > 0.0) {
+                    const double px = (x - half[0]) * level.spacing[0];
+                    w += weight;
+                    wx += weight * px;
+                    wxx += weight * px * px;
+                }
+            }
+            sums[0] += w;
+            sums[1] += wx;
+            sums[2] += w * py;
+            sums[3] += w * pz;
+            sums[4] += wxx;
+            sums[5] += w * py * py;
+            sums[6] += w * pz * pz;
+            sums[7] += wx * py;
+            sums[8] += wx * pz;
+            sums[9] += w * py * pz;
+        }
+    });
+
+    double total[kSums] = {0.0};
+    for (int z = 0; z < level.dims[2]; ++z) {
+        for (int k = 0; k < kSums; ++k) {
+            total[k] += partial[static_cast<size_t>(z) * kSums + k];
+        }
+    }
+    if (!(total[0] > 0.0)) {
+        return moments;
+    }
+
+    moments.mass = total[0];
+    const double mean[3] = {total[1] / total[0], total[2] / total[0], total[3] / total[0]};
+    for (int i = 0; i < 3; ++i) {
+        moments.center[i] = level.origin[i] + half[i] * level.spacing[i] + mean[i];
+    }
+    const double second[3][3] = {{total[4], total[7], total[8]},
+                                 {total[7], total[5], total[9]},
+                                 {total[8], total[9], total[6]}};
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            moments.covariance[r][c] = second[r][c] / total[0] - mean[r] * mean[c];
+        }
+    }
+    symmetricEigen3(moments.covariance, moments.eigenvalues, moments.axes);
+    return moments;
+}
+
+/**
+ * @brief 由两组主轴求把固定图像主轴转到浮动图像主轴的旋转 R = Vm·S·Vfᵀ
+ *
+ * 特征向量的符号不确定：在det(R) = +1的符号组合S中取最接近恒等(迹最大)的一个。
+ * 任一图像相邻特征值之比小于minimumAnisotropy时主轴不可靠，返回false。
+ */
+inline bool principalAxesRotation(const ImageMoments& fixed, const ImageMoments& moving, double R[3][3],
+                                  double minimumAnisotropy = 1.1) {
+    for (const ImageMoments* moments : {&fixed, &moving}) {
+        const double* lambda = moments->eigenvalues;
+        if (!(lambda[2] > 0.0) || lambda[0] < minimumAnisotropy * lambda[1] ||
+            lambda[1] < minimumAnisotropy * lambda[2]) {
+            return false;
+        }
+    }
+
+    double best = -1e300;
+    for (int signs = 0; signs < 8; ++signs) {
+        const double S[3] = {signs & 1 ? -1.0 : 1.0, signs & 2 ? -1.0 : 1.0, signs & 4 ? -1.0 : 1.0};
+        double candidate[3][3];
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                candidate[r][c] = 0.0;
+                for (int k = 0; k < 3; ++k) {
+                    candidate[r][c] += moving.axes[r][k] * S[k] * fixed.axes[c][k];
+                }
+            }
+        }
+        const double det =
+            candidate[0][0] * (candidate[1][1] * candidate[2][2] - candidate[1][2] * candidate[2][1]) -
+            candidate[0][1] * (candidate[1][0] * candidate[2][2] - candidate[1][2] * candidate[2][0]) +
+            candidate[0][2] * (candidate[1][0] * candidate[2][1] - candidate[1][1] * candidate[2][0]);
+        const double trace = candidate[0][0] + candidate[1][1] + candidate[2][2];
+        if (det > 0.0 && trace > best) {
+            best = trace;
+            std::copy(&candidate[0][0], &candidate[0][0] + 9, &R[0][0]);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 按块平均把层缩小到每轴不超过maximumDimension个体素
+ *
+ * 新体素位于块的中心，原点相应偏移(factor − 1)/2个原体素。
+ */
+inline void downsampleLevel(const RegistrationLevel& in, int maximumDimension, RegistrationLevel& out) {
+    int factors[3];
+    for (int i = 0; i < 3; ++i) {
+        factors[i] = std::max(1, (in.dims[i] + maximumDimension - 1) / maximumDimension);
+        out.dims[i] = std::max(1, in.dims[i] / factors[i]);
+        out.spacing[i] = in.spacing[i] * factors[i];
+        out.origin[i] = in.origin[i] + 0.5 * (factors[i] - 1) * in.spacing[i];
+    }
+    out.shrinkFactor = in.shrinkFactor * std::max(factors[0], std::max(factors[1], factors[2]));
+    out.voxels.assign(static_cast<size_t>(out.dims[0]) * out.dims[1] * out.dims[2], 0.0f);
+
+    const VoxelView<const float> src = in.view();
+    const VoxelView<float> dst = MedicalImaging::makeVoxelView(out.voxels.data(), out.dims);
+    const double norm = 1.0 / (static_cast<double>(factors[0]) * factors[1] * factors[2]);
+    forEachSlice(out.dims[2], [&](int z) {
+        for (int y = 0; y < out.dims[1]; ++y) {
+            float* row = dst.row(y, z);
+            for (int x = 0; x < out.dims[0]; ++x) {
+                double sum = 0.0;
+                for (int k = 0; k < factors[2]; ++k) {
+                    for (int j = 0; j < factors[1]; ++j) {
+                        const float* block = src.row(y * factors[1] + j, z * factors[2] + k) + x * factors[0];
+                        for (int i = 0; i < factors[0]; ++i) {
+                            sum += block[i];
+                        }
+                    }
+                }
+                row[x] = static_cast<float>(sum * norm);
+            }
+        }
+    });
+}
+
+/**
+ * @brief 把浮动层经仿射 q = A·p + b 三线性重采样到目标层的网格上
+ */
+inline void warpLevel(const RegistrationLevel& moving, const double A[3][3], const double b[3],
+                      const RegistrationLevel& target, std::vector<float>& out, float background) {
+    out.assign(target.voxels.size(), background);
+    const VoxelView<const float> in = moving.view();
+    const VoxelView<float> dst = MedicalImaging::makeVoxelView(out.data(), target.dims);
+    forEachSlice(target.dims[2], [&](int z) {
+        for (int y = 0; y < target.dims[1]; ++y) {
+            float* row = dst.row(y, z);
+            for (int x = 0; x < target.dims[0]; ++x) {
+                const double p[3] = {target.origin[0] + x * target.spacing[0],
+                                     target.origin[1] + y * target.spacing[1],
+                                     target.origin[2] + z * target.spacing[2]};
+                double q[3];
+                for (int r = 0; r < 3; ++r) {
+                    q[r] = A[r][0] * p[0] + A[r][1] * p[1] + A[r][2] * p[2] + b[r];
+                }
+                double index[3];
+                moving.physicalToIndex(q, index);
+                row[x] = sampleLinear(in, index[0], index[1], index[2], background);
+            }
+        }
+    });
+}
+
+/**
+ * @brief 长度为2的幂的原地基2 FFT(不做1/n归一化)
+ */
+inline void fft(std::complex<double>* data, int n, bool inverse) {
+    for (int i = 1, j = 0; i < n; ++i) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+    for (int length = 2; length <= n; length <<= 1) {
+        const double angle = (inverse ? 2.0 : -2.0) * 3.14159265358979323846 / length;
+        const std::complex<double> root(std::cos(angle), std::sin(angle));
+        for (int start = 0; start < n; start += length) {
+            std::complex<double> w(1.0, 0.0);
+            for (int k = 0; k < length / 2; ++k) {
+                const std::complex<double> even = data[start + k];
+                const std::complex<double> odd = data[start + k + length / 2] * w;
+                data[start + k] = even + odd;
+                data[start + k + length / 2] = even - odd;
+                w *= root;
+            }
+        }
+    }
+}
+
+// 按轴逐行并行的三维FFT，各轴长度为2的幂
+inline void fft3d(std::vector<std::complex<double>>& data, const int n[3], bool inverse) {
+    const vtkIdType total = static_cast<vtkIdType>(n[0]) * n[1] * n[2];
+    const vtkIdType strides[3] = {1, n[0], static_cast<vtkIdType>(n[0]) * n[1]};
+    for (int axis = 0; axis < 3; ++axis) {
+        if (n[axis] < 2) {
+            continue;
+        }
+        const vtkIdType lines = total / n[axis];
+        vtkSMPTools::For(0, lines, [&](vtkIdType begin, vtkIdType end) {
+            std::vector<std::complex<double>> line(static_cast<size_t>(n[axis]));
+            for (vtkIdType l = begin; l < end; ++l) {
+                // 行号按其余两轴展开为行首偏移
+                vtkIdType base;
+                if (axis == 0) {
+                    base = l * n[0];
+                } else if (axis == 1) {
+                    base = (l / n[0]) * strides[2] + l % n[0];
+                } else {
+                    base = l;
+                }
+                for (int i = 0; i < n[axis]; ++i) {
+                    line[i] = data[base + i * strides[axis]];
+                }
+                fft(line.data(), n[axis], inverse);
+                for (int i = 0; i < n[axis]; ++i) {
+                    data[base + i * strides[axis]] = line[i];
+                }
+            }
+        });
+    }
+}
+
+/**
+ * @brief 相位相关求平移
+ *
+ * fixed与moved为同一网格上的图像(moved已按当前估计变换到固定网格)。两者减均值、乘Hann窗并
+ * 零填充到2的幂后求归一化互功率谱，其逆变换的峰值位置给出moved相对fixed的循环平移，
+ * 峰邻域抛物线拟合到亚体素。shift满足 moved(p + shift) ≈ fixed(p)(体素单位)，
+ * 返回峰值高度(0~1，越大越可信)。
+ */
+inline double phaseCorrelation(const RegistrationLevel& fixed, const std::vector<float>& moved, double shift[3]) {
+    int n[3];
+    for (int i = 0; i < 3; ++i) {
+        n[i] = 1;
+        while (n[i] < fixed.dims[i]) {
+            n[i] <<= 1;
+        }
+        shift[i] = 0.0;
+    }
+    const vtkIdType total = static_cast<vtkIdType>(n[0]) * n[1] * n[2];
+    std::vector<double> window[3];
+    for (int i = 0; i < 3; ++i) {
+        window[i].resize(static_cast<size_t>(fixed.dims[i]));
+        for (int k = 0; k < fixed.dims[i]; ++k) {
+            window[i][k] = fixed.dims[i] > 1 ? 0.5 - 0.5 * std::cos(2.0 * 3.14159265358979323846 * k / (fixed.dims[i] - 1))
+                                             : 1.0;
+        }
+    }
+
+    double means[2] = {0.0, 0.0};
+    for (size_t i = 0; i < fixed.voxels.size(); ++i) {
+        means[0] += fixed.voxels[i];
+        means[1] += moved[i];
+    }
+    means[0] /= std::max<size_t>(1, fixed.voxels.size());
+    means[1] /= std::max<size_t>(1, fixed.voxels.size());
+
+    std::vector<std::complex<double>> F(static_cast<size_t>(total));
+    std::vector<std::complex<double>> M(static_cast<size_t>(total));
+    forEachSlice(fixed.dims[2], [&](int z) {
+        for (int y = 0; y < fixed.dims[1]; ++y) {
+            for (int x = 0; x < fixed.dims[0]; ++x) {
+                const size_t src = (static_cast<size_t>(z) * fixed.dims[1] + y) * fixed.dims[0] + x;
+                const size_t dst = (static_cast<size_t>(z) * n[1] + y) * n[0] + x;
+                const double w = window[0][x] * window[1][y] * window[2][z];
+                F[dst] = w * (fixed.voxels[src] - means[0]);
+                M[dst] = w * (moved[src] - means[1]);
+            }
+        }
+    });
+    fft3d(F, n, false);
+    fft3d(M, n, false);
+    vtkSMPTools::For(0, total, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i) {
+            const std::complex<double> cross = F[i] * std::conj(M[i]);
+            const double magnitude = std::abs(cross);
+            F[i] = magnitude > 1e-20 ? cross / magnitude : std::complex<double>(0.0, 0.0);
+        }
+    });
+    fft3d(F, n, true);
+
+    vtkIdType peak = 0;
+    for (vtkIdType i = 1; i < total; ++i) {
+        if (F[i].real() > F[peak].real()) {
+            peak = i;
+        }
+    }
+    const int position[3] = {static_cast<int>(peak % n[0]), static_cast<int>((peak / n[0]) % n[1]),
+                             static_cast<int>(peak / (static_cast<vtkIdType>(n[0]) * n[1]))};
+    const vtkIdType strides[3] = {1, n[0], static_cast<vtkIdType>(n[0]) * n[1]};
+    for (int i = 0; i < 3; ++i) {
+        double offset = 0.0;
+        if (n[i] > 2) {
+            const vtkIdType base = peak - position[i] * strides[i];
+            const double left = F[base + ((position[i] + n[i] - 1) % n[i]) * strides[i]].real();
+            const double right = F[base + ((position[i] + 1) % n[i]) * strides[i]].real();
+            const double curvature = left - 2.0 * F[peak].real() + right;
+            if (curvature < 0.0) {
+                offset = std::max(-0.5, std::min(0.5, 0.5 * (left - right) / curvature));
+            }
+        }
+        // 峰位于−shift(循环)，超过一半的位置视为负方向
+        double p = position[i] + offset;
+        if (p > 0.5 * n[i]) {
+            p -= n[i];
+        }
+        shift[i] = -p;
+    }
+    return F[peak].real() / static_cast<double>(total);
+}
+
+} // namespace ImageKernels
+
+#endif // REGISTRATIONINITIALIZER_H
@@ -0,0 +1,338 @@
+#ifndef REGISTRATIONLEVEL_H
+#define REGISTRATIONLEVEL_H
+
+#include "ImageKernels.h"
+#include "Resampling.h"
+#include <vtkImageData.h>
+#include <vtkSMPTools.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace ImageKernels {
+
+/**
+ * @brief 配准金字塔的一层：第一分量的float副本及其物理几何
+ *
+ * 原点为标量数组首元素的物理坐标(已计入范围起点)，与Resampler::Grid一致。
+ */
+struct RegistrationLevel {
+    std::vector<float> voxels;
+    int dims[3] = {0, 0, 0};
+    double spacing[3] = {1.0, 1.0, 1.0};
+    double origin[3] = {0.0, 0.0, 0.0};
+    int shrinkFactor = 1;
+
+    VoxelView<const float> view() const {
+        return MedicalImaging::makeVoxelView<const float>(voxels.data(), dims);
+    }
+
+    bool isEmpty() const {
+        return voxels.empty();
+    }
+
+    void physicalToIndex(const double p[3], double index[3]) const {
+        for (int i = 0; i < 3; ++i) {
+            index[i] = (p[i] - origin[i]) / spacing[i];
+        }
+    }
+
+    // 物理范围的中心
+    void center(double c[3]) const {
+        for (int i = 0; i < 3; ++i) {
+            c[i] = origin[i] + 0.5 * (dims[i] - 1) * spacing[i];
+        }
+    }
+
+    double meanSpacing() const {
+        return (spacing[0] + spacing[1] + spacing[2]) / 3.0;
+    }
+};
+
+/**
+ * @brief 由图像构建按shrink缩小的金字塔层
+ *
+ * shrink > 1时先以σ = shrink/2(体素)高斯平滑抑制混叠，再每隔shrink个体素取样；
+ * 各轴缩小后不少于4个体素时才缩小该轴。
+ */
+inline bool buildRegistrationLevel(vtkImageData* image, int shrink, RegistrationLevel& level) {
+    if (!image) {
+        return false;
+    }
+    int dims[3];
+    image->GetDimensions(dims);
+    const int* extent = image->GetExtent();
+    const double* spacing = image->GetSpacing();
+    const double* origin = image->GetOrigin();
+
+    int factors[3];
+    for (int i = 0; i < 3; ++i) {
+        factors[i] = (dims[i] - 1) / std::max(1, shrink) + 1 >= 4 ? std::max(1, shrink) : 1;
+        level.dims[i] = (dims[i] - 1) / factors[i] + 1;
+        level.spacing[i] = spacing[i] * factors[i];
+        level.origin[i] = origin[i] + spacing[i] * extent[2 * i];
+    }
+    level.shrinkFactor = std::max(1, shrink);
+    level.voxels.assign(static_cast<size_t>(level.dims[0]) * level.dims[1] * level.dims[2], 0.0f);
+    const VoxelView<float> out = MedicalImaging::makeVoxelView(level.voxels.data(), level.dims);
+
+    return MedicalImaging::dispatchVoxelType(image->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        const VoxelView<const T> in = MedicalImaging::makeVoxelView<const T>(image).component(0);
+        if (factors[0] == 1 && factors[1] == 1 && factors[2] == 1) {
+            forEachSlice(dims[2], [&](int z) {
+                for (int y = 0; y < dims[1]; ++y) {
+                    const T* src = in.row(y, z);
+                    float* dst = out.row(y, z);
+                    for (int x = 0; x < dims[0]; ++x) {
+                        dst[x] = static_cast<float>(src[x * in.strides[0]]);
+                    }
+                }
+            });
+            return;
+        }
+
+        const double sigma[3] = {0.5 * factors[0], 0.5 * factors[1], 0.5 * factors[2]};
+        std::vector<float> smoothed(static_cast<size_t>(in.voxelCount()));
+        const VoxelView<float> smoothedView = MedicalImaging::makeVoxelView(smoothed.data(), dims);
+        separableGaussian<T, float>(in, smoothedView, sigma);
+        forEachSlice(level.dims[2], [&](int z) {
+            for (int y = 0; y < level.dims[1]; ++y) {
+                const float* src = smoothedView.row(y * factors[1], z * factors[2]);
+                float* dst = out.row(y, z);
+                for (int x = 0; x < level.dims[0]; ++x) {
+                    dst[x] = src[x * factors[0]];
+                }
+            }
+        });
+    });
+}
+
+/**
+ * @brief 三线性插值并求索引空间梯度(插值函数的解析导数)，越界返回false
+ */
+inline bool sampleLinearGradient(const VoxelView<const float>& in, double x, double y, double z,
+                                 float& value, float gradient[3]) {
+    if (!(x >= 0.0 && y >= 0.0 && z >= 0.0 && x <= in.dims[0] - 1 && y <= in.dims[1] - 1 && z <= in.dims[2] - 1)) {
+        return false;
+    }
+    const int x0 = std::min(static_cast<int>(x), std::max(0, in.dims[0] - 2));
+    const int y0 = std::min(static_cast<int>(y), std::max(0, in.dims[1] - 2));
+    const int z0 = std::min(static_cast<int>(z), std::max(0, in.dims[2] - 2));
+    const float fx = static_cast<float>(x - x0);
+    const float fy = static_cast<float>(y - y0);
+    const float fz = static_cast<float>(z - z0);
+    const vtkIdType dx = in.dims[0] > 1 ? in.strides[0] : 0;
+    const vtkIdType dy = in.dims[1] > 1 ? in.strides[1] : 0;
+    const vtkIdType dz = in.dims[2] > 1 ? in.strides[2] : 0;
+
+    const float* p = &in.at(x0, y0, z0);
+    const float v000 = p[0];
+    const float v100 = p[dx];
+    const float v010 = p[dy];
+    const float v110 = p[dy + dx];
+    const float v001 = p[dz];
+    const float v101 = p[dz + dx];
+    const float v011 = p[dz + dy];
+    const float v111 = p[dz + dy + dx];
+
+    const float c00 = v000 + fx * (v100 - v000);
+    const float c10 = v010 + fx * (v110 - v010);
+    const float c01 = v001 + fx * (v101 - v001);
+    const float c11 = v011 + fx * (v111 - v011);
+    const float c0 = c00 + fy * (c10 - c00);
+    const float c1 = c01 + fy * (c11 - c01);
+    value = c0 + fz * (c1 - c0);
+
+    const float gx00 = v100 - v000;
+    const float gx10 = v110 - v010;
+    const float gx01 = v101 - v001;
+    const float gx11 = v111 - v011;
+    const float gx0 = gx00 + fy * (gx10 - gx00);
+    const float gx1 = gx01 + fy * (gx11 - gx01);
+    gradient[0] = dx ? gx0 + fz * (gx1 - gx0) : 0.0f;
+    gradient[1] = dy ? (c10 - c00) + fz * ((c11 - c01) - (c10 - c00)) : 0.0f;
+    gradient[2] = dz ? c1 - c0 : 0.0f;
+    return true;
+}
+
+/**
+ * @brief 度量计算的样本：物理坐标与固定图像强度，按分量分别连续存储(SoA)
+ */
+struct SampleSet {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> fixedValue;
+
+    vtkIdType size() const {
+        return static_cast<vtkIdType>(x.size());
+    }
+
+    void resize(vtkIdType count) {
+        x.resize(static_cast<size_t>(count));
+        y.resize(static_cast<size_t>(count));
+        z.resize(static_cast<size_t>(count));
+        fixedValue.resize(static_cast<size_t>(count));
+    }
+
+    void point(vtkIdType i, double p[3]) const {
+        p[0] = x[i];
+        p[1] = y[i];
+        p[2] = z[i];
+    }
+};
+
+/**
+ * @brief 以固定图像层的全部体素作为样本
+ */
+inline void denseSamples(const RegistrationLevel& fixed, SampleSet& samples) {
+    const int nx = fixed.dims[0];
+    const int ny = fixed.dims[1];
+    samples.resize(static_cast<vtkIdType>(fixed.voxels.size()));
+    const VoxelView<const float> in = fixed.view();
+    forEachSlice(fixed.dims[2], [&](int z) {
+        for (int y = 0; y < ny; ++y) {
+            const vtkIdType base = (static_cast<vtkIdType>(z) * ny + y) * nx;
+            const float* row = in.row(y, z);
+            const float py = static_cast<float>(fixed.origin[1] + y * fixed.spacing[1]);
+            const float pz = static_cast<float>(fixed.origin[2] + z * fixed.spacing[2]);
+            for (int x = 0; x < nx; ++x) {
+                samples.x[base + x] = static_cast<float>(fixed.origin[0] + x * fixed.spacing[0]);
+                samples.y[base + x] = py;
+                samples.z[base + x] = pz;
+                samples.fixedValue[base + x] = row[x];
+            }
+        }
+    });
+}
+
+// ========== 稀疏采样 ==========
+
+namespace SamplingDetail {
+
+// 随机采样按固定大小的块生成，每块用(种子, 块号)派生独立的随机数引擎，结果与线程数无关
+const vtkIdType kBlock = 4096;
+
+inline std::uint32_t blockSeed(std::uint32_t seed, vtkIdType block) {
+    std::uint64_t h = (static_cast<std::uint64_t>(seed) << 32) ^ static_cast<std::uint64_t>(block);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return static_cast<std::uint32_t>(h);
+}
+
+// 在连续索引(x, y, z)处写入第i个样本，强度三线性插值
+inline void store(const RegistrationLevel& fixed, const VoxelView<const float>& view, vtkIdType i,
+                  double x, double y, double z, SampleSet& samples) {
+    samples.x[i] = static_cast<float>(fixed.origin[0] + x * fixed.spacing[0]);
+    samples.y[i] = static_cast<float>(fixed.origin[1] + y * fixed.spacing[1]);
+    samples.z[i] = static_cast<float>(fixed.origin[2] + z * fixed.spacing[2]);
+    samples.fixedValue[i] = sampleLinear(view, x, y, z, 0.0f);
+}
+
+} // namespace SamplingDetail
+
+/**
+ * @brief 在固定图像层范围内均匀随机取count个连续位置
+ */
+inline void randomSamples(const RegistrationLevel& fixed, vtkIdType count, std::uint32_t seed, SampleSet& samples) {
+    samples.resize(count);
+    const VoxelView<const float> view = fixed.view();
+    const vtkIdType blocks = (count + SamplingDetail::kBlock - 1) / SamplingDetail::kBlock;
+    vtkSMPTools::For(0, blocks, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType block = first; block < last; ++block) {
+            std::mt19937 engine(SamplingDetail::blockSeed(seed, block));
+            std::uniform_real_distribution<double> ux(0.0, fixed.dims[0] - 1);
+            std::uniform_real_distribution<double> uy(0.0, fixed.dims[1] - 1);
+            std::uniform_real_distribution<double> uz(0.0, fixed.dims[2] - 1);
+            const vtkIdType end = std::min(count, (block + 1) * SamplingDetail::kBlock);
+            for (vtkIdType i = block * SamplingDetail::kBlock; i < end; ++i) {
+                const double x = ux(engine);
+                const double y = uy(engine);
+                const double z = uz(engine);
+                SamplingDetail::store(fixed, view, i, x, y, z, samples);
+            }
+        }
+    });
+}
+
+// 把体素总数按约count个各向同性单元划分，返回各轴单元数
+inline void samplingCells(const RegistrationLevel& fixed, vtkIdType count, int cells[3]) {
+    const double voxels = static_cast<double>(fixed.dims[0]) * fixed.dims[1] * fixed.dims[2];
+    const double edge = std::cbrt(voxels / std::max<vtkIdType>(1, count));
+    for (int i = 0; i < 3; ++i) {
+        cells[i] = std::max(1, std::min(fixed.dims[i], static_cast<int>(std::lround(fixed.dims[i] / edge))));
+    }
+}
+
+/**
+ * @brief 分层随机采样：把范围划分为约count个单元，每个单元内随机取一点
+ *
+ * 与纯随机采样相比样本覆盖更均匀，同样样本数下度量的方差更小。
+ */
+inline void stratifiedSamples(const RegistrationLevel& fixed, vtkIdType count, std::uint32_t seed,
+                              SampleSet& samples) {
+    int cells[3];
+    samplingCells(fixed, count, cells);
+    const vtkIdType total = static_cast<vtkIdType>(cells[0]) * cells[1] * cells[2];
+    samples.resize(total);
+    const VoxelView<const float> view = fixed.view();
+    double size[3];
+    for (int i = 0; i < 3; ++i) {
+        size[i] = static_cast<double>(fixed.dims[i] - 1) / cells[i];
+    }
+    const vtkIdType blocks = (total + SamplingDetail::kBlock - 1) / SamplingDetail::kBlock;
+    vtkSMPTools::For(0, blocks, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType block = first; block < last; ++block) {
+            std::mt19937 engine(SamplingDetail::blockSeed(seed, block));
+            std::uniform_real_distribution<double> jitter(0.0, 1.0);
+            const vtkIdType end = std::min(total, (block + 1) * SamplingDetail::kBlock);
+            for (vtkIdType i = block * SamplingDetail::kBlock; i < end; ++i) {
+                const vtkIdType cx = i % cells[0];
+                const vtkIdType cy = (i / cells[0]) % cells[1];
+                const vtkIdType cz = i / (static_cast<vtkIdType>(cells[0]) * cells[1]);
+                const double x = (cx + jitter(engine)) * size[0];
+                const double y = (cy + jitter(engine)) * size[1];
+                const double z = (cz + jitter(engine)) * size[2];
+                SamplingDetail::store(fixed, view, i, x, y, z, samples);
+            }
+        }
+    });
+}
+
+/**
+ * @brief 规则网格采样：各轴以相同步长取体素中心，样本数约为count，结果确定
+ */
+inline void gridSamples(const RegistrationLevel& fixed, vtkIdType count, SampleSet& samples) {
+    int cells[3];
+    samplingCells(fixed, count, cells);
+    int stride[3];
+    int offset[3];
+    int n[3];
+    for (int i = 0; i < 3; ++i) {
+        stride[i] = std::max(1, fixed.dims[i] / cells[i]);
+        n[i] = (fixed.dims[i] - 1) / stride[i] + 1;
+        offset[i] = (fixed.dims[i] - 1 - (n[i] - 1) * stride[i]) / 2;
+    }
+    samples.resize(static_cast<vtkIdType>(n[0]) * n[1] * n[2]);
+    const VoxelView<const float> view = fixed.view();
+    forEachSlice(n[2], [&](int k) {
+        const int z = offset[2] + k * stride[2];
+        for (int j = 0; j < n[1]; ++j) {
+            const int y = offset[1] + j * stride[1];
+            const vtkIdType base = (static_cast<vtkIdType>(k) * n[1] + j) * n[0];
+            for (int i = 0; i < n[0]; ++i) {
+                SamplingDetail::store(fixed, view, base + i, offset[0] + i * stride[0], y, z, samples);
+            }
+        }
+    });
+}
+
+} // namespace ImageKernels
+
+#endif // REGISTRATIONLEVEL_H
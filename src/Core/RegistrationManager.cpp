@@ -1,52 +1,1044 @@
 #include "RegistrationManager.h"
+#include "Config.h"
+#include "DemonsRegistration.h"
+#include "ImageStatistics.h"
+#include "Logger.h"
+#include "MattesMutualInformation.h"
+#include "RegistrationLevel.h"
+#include "RegistrationCache.h"
+#include "RegistrationInitializer.h"
+#include "RegisteredImageView.h"
+#include "RegistrationOptimizer.h"
+#include "Resampler.h"
+#include "TransformModels.h"
 #include <vtkImageData.h>
 #include <vtkMatrix4x4.h>
 #include <vtkSmartPointer.h>
+#include <QElapsedTimer>
+#include <QFutureSynchronizer>
+#include <QSemaphore>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
 
 class RegistrationManager::RegistrationManagerPrivate : public QObject {
     Q_OBJECT // 添加 Q_OBJECT 宏以启用信号和槽机制
 
     // 私有成员变量可以在这里声明
 public:
+    // 批量配准的工作实例没有公有对象(parent为空)，不发出进度与预览
+    explicit RegistrationManagerPrivate(RegistrationManager* parent)
+        : q_ptr(parent)
+        , transformMatrix(vtkSmartPointer<vtkMatrix4x4>::New()) {
+        demons.tolerance = 1e-4;
+    }
+
+    RegistrationManager* q_ptr;
+    Q_DECLARE_PUBLIC(RegistrationManager)
+
     vtkSmartPointer<vtkImageData> fixedImage;
     vtkSmartPointer<vtkImageData> movingImage;
     vtkSmartPointer<vtkImageData> registeredImage;
+    std::shared_ptr<RegisteredImageView> registeredView;
+    bool lazyRegisteredImage = false;
     vtkSmartPointer<vtkMatrix4x4> transformMatrix;
     int maxIterations = 100;
     double tolerance = 1e-6;
+    int pyramidLevels = 3;
+    int histogramBins = 32;
+    SamplingStrategy samplingStrategy = RandomSampling;
+    int numberOfSamples = 50000;
+    bool resampleEachIteration = false;
+    double controlPointSpacing = 20.0;
+    Initialization initialization = PhaseCorrelationInitialization;
+    ImageKernels::DemonsParameters demons;
+    double metricValue = 0.0;
+    vtkSmartPointer<vtkImageData> displacementField;
+    RegistrationCache cache;
+    RegistrationCache::Signature fixedSignature;
+    RegistrationCache::Signature movingSignature;
+
+    /**
+     * @brief 批量配准共享的固定图像预计算：各层图像与首次抽取的样本，只读
+     */
+    struct FixedPyramid {
+        vtkImageData* image = nullptr;
+        std::vector<ImageKernels::RegistrationLevel> levels;
+        std::vector<ImageKernels::SampleSet> samples;
+        std::vector<char> stochastic;
+
+        qint64 bytes() const;
+    };
+    std::shared_ptr<const FixedPyramid> fixedPyramid;
+    qint64 batchMemoryBudget = 0;
+
+    // 进度与预览：进度按阶段(如可变形配准的仿射与自由形变)与层内迭代线性推进
+    std::atomic<bool> stopRequested{false};
+    const std::atomic<bool>* batchStop = nullptr;  // 批量配准时指向管理器的停止标志
+    bool stopped = false;
+    int previewIterations = 0;
+    int previewMilliseconds = 200;
+    QElapsedTimer previewTimer;
+    int iterationsSincePreview = 0;
+    int progressStage = 0;
+    int progressStages = 1;
+    int lastPercentage = -1;
+
+    // 预览位移场网格每轴的最大点数
+    static constexpr int kPreviewGridSize = 48;
+    // 相位相关所用降采样层每轴的最大体素数
+    static constexpr int kPhaseCorrelationSize = 64;
+    // 初始化时构建的最粗层浮动图像，由随后的优化直接取用
+    ImageKernels::RegistrationLevel initialMovingLevel;
+
+    enum CacheHit { CacheMiss, CacheSimilar, CacheExact };
+
+    bool prepare(vtkImageData* fixed, vtkImageData* moving, int stages = 1);
+    void copySettings(const RegistrationManagerPrivate& other);
+    bool run(RegistrationType type);
+    bool registerRigid();
+    bool registerAffine();
+    bool registerDeformable();
+    bool registerDemons();
+    int coarsestLevel() const;
+    bool drawSamples(const ImageKernels::RegistrationLevel& fixed, std::uint32_t seed,
+                     ImageKernels::SampleSet& samples) const;
+    std::shared_ptr<const FixedPyramid> buildFixedPyramid(RegistrationType type, vtkImageData* fixed) const;
+    const ImageKernels::RegistrationLevel& fixedLevelAt(int level, ImageKernels::RegistrationLevel& own) const;
+    const ImageKernels::SampleSet& samplesAt(int level, const ImageKernels::RegistrationLevel& fixed,
+                                             ImageKernels::SampleSet& own, bool& stochastic) const;
+    qint64 estimatePairBytes(RegistrationType type, vtkImageData* fixed, vtkImageData* moving) const;
+    void initialTransform(double A[3][3], double b[3]);
+    template<typename Transform>
+    void optimizePyramid(Transform& transform, std::vector<double>& parameters, std::vector<double>& scales,
+                         int coarsest, const std::function<void(int level)>& levelSetup = {});
+    void optimizeAffine(ImageKernels::AffineTransform& transform, const std::vector<double>* initial = nullptr);
+    void storeTransform(const double A[3][3], const double b[3]);
+    QVariantList cacheKey(const QString& algorithm) const;
+    CacheHit queryCache(const QString& algorithm, RegistrationCache::Entry& entry);
+    void storeCache(const QString& algorithm, const std::vector<double>& parameters);
+    void restore(const RegistrationCache::Entry& entry);
+    bool resampleResult();
+    vtkSmartPointer<vtkImageData> displacementFieldOf(const ImageKernels::BSplineTransform& transform,
+                                                      const Resampler::Grid& grid) const;
+    vtkSmartPointer<vtkImageData> displacementFieldOf(const ImageKernels::DisplacementField& field) const;
+
+    using Snapshot = std::function<void(vtkMatrix4x4* matrix, vtkSmartPointer<vtkImageData>& field)>;
+    bool monitor(double fraction, double metric, const Snapshot& snapshot);
+    Resampler::Grid previewGrid() const;
+    vtkSmartPointer<vtkImageData> previewFieldOf(const ImageKernels::DisplacementField& field) const;
+    template<typename Transform>
+    void snapshotOf(const Transform& transform, vtkMatrix4x4* matrix, vtkSmartPointer<vtkImageData>& field) const;
+    void snapshotOf(const ImageKernels::BSplineTransform& transform, vtkMatrix4x4* matrix,
+                    vtkSmartPointer<vtkImageData>& field) const;
 };
 
+namespace {
+
+// 图像物理范围的中心，返回半对角线长度(不小于1毫米)
+double imageCenter(vtkImageData* image, double center[3]) {
+    const int* extent = image->GetExtent();
+    const double* spacing = image->GetSpacing();
+    const double* origin = image->GetOrigin();
+    double radius = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        const double half = 0.5 * (extent[2 * i + 1] - extent[2 * i]) * spacing[i];
+        center[i] = origin[i] + spacing[i] * extent[2 * i] + half;
+        radius += half * half;
+    }
+    return std::max(1.0, std::sqrt(radius));
+}
+
+// 每层首次抽样的种子，批量共享的样本与单次配准一致
+std::uint32_t levelSeed(int level) {
+    return static_cast<std::uint32_t>(level) << 24;
+}
+
+int stageCount(RegistrationManager::RegistrationType type) {
+    return type == RegistrationManager::DeformableRegistration ? 2 : 1;
+}
+
+// 把 q = R·p + b(R = Rz·Ry·Rx为旋转)换算为绕center的刚体参数
+std::vector<double> rigidParameters(const double R[3][3], const double b[3], const double center[3]) {
+    std::vector<double> parameters(ImageKernels::RigidTransform::kParameters);
+    parameters[0] = std::atan2(R[2][1], R[2][2]);
+    parameters[1] = std::asin(std::max(-1.0, std::min(1.0, -R[2][0])));
+    parameters[2] = std::atan2(R[1][0], R[0][0]);
+    for (int r = 0; r < 3; ++r) {
+        parameters[3 + r] = b[r] - center[r];
+        for (int c = 0; c < 3; ++c) {
+            parameters[3 + r] += R[r][c] * center[c];
+        }
+    }
+    return parameters;
+}
+
+} // namespace
+
+// 记录输入、重置进度与停止标志，并检查两幅图像都能统计强度范围(互信息分箱依赖该范围)
+bool RegistrationManager::RegistrationManagerPrivate::prepare(vtkImageData* fixed, vtkImageData* moving, int stages) {
+    fixedImage = fixed;
+    movingImage = moving;
+    displacementField = nullptr;
+    initialMovingLevel = ImageKernels::RegistrationLevel();
+    stopRequested.store(false);
+    stopped = false;
+    progressStage = 0;
+    progressStages = std::max(1, stages);
+    lastPercentage = -1;
+    iterationsSincePreview = 0;
+    previewTimer.start();
+    if (!MedicalImaging::ImageStatistics::get(fixed) || !MedicalImaging::ImageStatistics::get(moving)) {
+        LOG_WARNING(QString("Registration: 不支持的体素类型 %1 / %2")
+                        .arg(fixed->GetScalarType()).arg(moving->GetScalarType()));
+        return false;
+    }
+    if (cache.directory().isEmpty()) {
+        fixedSignature = RegistrationCache::Signature();
+        movingSignature = RegistrationCache::Signature();
+    } else {
+        fixedSignature = RegistrationCache::signature(fixed);
+        movingSignature = RegistrationCache::signature(moving);
+    }
+    return true;
+}
+
+// 批量配准的工作实例沿用管理器的配准参数与缓存目录
+void RegistrationManager::RegistrationManagerPrivate::copySettings(const RegistrationManagerPrivate& other) {
+    maxIterations = other.maxIterations;
+    tolerance = other.tolerance;
+    pyramidLevels = other.pyramidLevels;
+    histogramBins = other.histogramBins;
+    samplingStrategy = other.samplingStrategy;
+    numberOfSamples = other.numberOfSamples;
+    resampleEachIteration = other.resampleEachIteration;
+    controlPointSpacing = other.controlPointSpacing;
+    initialization = other.initialization;
+    demons = other.demons;
+    lazyRegisteredImage = other.lazyRegisteredImage;
+    cache.setDirectory(other.cache.directory());
+}
+
+bool RegistrationManager::RegistrationManagerPrivate::run(RegistrationType type) {
+    switch (type) {
+    case RigidRegistration:
+        return registerRigid();
+    case AffineRegistration:
+        return registerAffine();
+    case DeformableRegistration:
+        return registerDeformable();
+    case DemonsRegistration:
+        return registerDemons();
+    }
+    return false;
+}
+
+// 完整金字塔的最粗层号；热启动时只优化第0层
+int RegistrationManager::RegistrationManagerPrivate::coarsestLevel() const {
+    return std::max(1, pyramidLevels) - 1;
+}
+
+// 按采样策略选取固定图像层上的样本，返回样本是否依赖种子(需要时可每次迭代重新抽样)
+bool RegistrationManager::RegistrationManagerPrivate::drawSamples(const ImageKernels::RegistrationLevel& fixed,
+                                                                  std::uint32_t seed,
+                                                                  ImageKernels::SampleSet& samples) const {
+    const vtkIdType count = std::max(1, numberOfSamples);
+    if (samplingStrategy == FullSampling || count >= static_cast<vtkIdType>(fixed.voxels.size())) {
+        denseSamples(fixed, samples);
+        return false;
+    }
+    switch (samplingStrategy) {
+    case RandomSampling:
+        randomSamples(fixed, count, seed, samples);
+        return true;
+    case StratifiedSampling:
+        stratifiedSamples(fixed, count, seed, samples);
+        return true;
+    default:
+        gridSamples(fixed, count, samples);
+        return false;
+    }
+}
+
+qint64 RegistrationManager::RegistrationManagerPrivate::FixedPyramid::bytes() const {
+    qint64 total = 0;
+    for (const ImageKernels::RegistrationLevel& level : levels) {
+        total += static_cast<qint64>(level.voxels.size()) * sizeof(float);
+    }
+    for (const ImageKernels::SampleSet& set : samples) {
+        total += static_cast<qint64>(set.size()) * 4 * sizeof(float);
+    }
+    return total;
+}
+
+// 一次构建固定图像的各层；互信息类配准同时按各层种子抽取样本(demons不需要样本)
+std::shared_ptr<const RegistrationManager::RegistrationManagerPrivate::FixedPyramid>
+RegistrationManager::RegistrationManagerPrivate::buildFixedPyramid(RegistrationType type, vtkImageData* fixed) const {
+    auto pyramid = std::make_shared<FixedPyramid>();
+    pyramid->image = fixed;
+    const int levels = std::max(1, pyramidLevels);
+    pyramid->levels.resize(static_cast<size_t>(levels));
+    for (int level = 0; level < levels; ++level) {
+        buildRegistrationLevel(fixed, 1 << level, pyramid->levels[level]);
+    }
+    if (type != DemonsRegistration) {
+        pyramid->samples.resize(static_cast<size_t>(levels));
+        pyramid->stochastic.resize(static_cast<size_t>(levels));
+        for (int level = 0; level < levels; ++level) {
+            pyramid->stochastic[level] = drawSamples(pyramid->levels[level], levelSeed(level), pyramid->samples[level]);
+        }
+    }
+    return pyramid;
+}
+
+// 有共享的固定图像金字塔时直接取用，否则构建到own中
+const ImageKernels::RegistrationLevel& RegistrationManager::RegistrationManagerPrivate::fixedLevelAt(
+    int level, ImageKernels::RegistrationLevel& own) const {
+    if (fixedPyramid && fixedPyramid->image == fixedImage && level < static_cast<int>(fixedPyramid->levels.size())) {
+        return fixedPyramid->levels[level];
+    }
+    buildRegistrationLevel(fixedImage, 1 << level, own);
+    return own;
+}
+
+const ImageKernels::SampleSet& RegistrationManager::RegistrationManagerPrivate::samplesAt(
+    int level, const ImageKernels::RegistrationLevel& fixed, ImageKernels::SampleSet& own, bool& stochastic) const {
+    if (fixedPyramid && fixedPyramid->image == fixedImage && level < static_cast<int>(fixedPyramid->samples.size())) {
+        stochastic = fixedPyramid->stochastic[level] != 0;
+        return fixedPyramid->samples[level];
+    }
+    stochastic = drawSamples(fixed, levelSeed(level), own);
+    return own;
+}
+
+/**
+ * @brief 估算一个图像对配准期间的峰值内存(共享的固定图像金字塔不计在内)
+ *
+ * 浮动图像最细层及其平滑缓冲、结果图像、度量的逐样本缓冲(分箱、位置与梯度)，
+ * 自由形变另加位移场与逐样本B样条权重，demons另加s、更新场、工作场与输出位移场。
+ */
+qint64 RegistrationManager::RegistrationManagerPrivate::estimatePairBytes(RegistrationType type, vtkImageData* fixed,
+                                                                          vtkImageData* moving) const {
+    const qint64 fixedVoxels = fixed->GetNumberOfPoints();
+    const qint64 movingVoxels = moving->GetNumberOfPoints();
+    const qint64 samples = samplingStrategy == FullSampling
+                               ? fixedVoxels : std::min<qint64>(fixedVoxels, std::max(1, numberOfSamples));
+    const qint64 fieldBytes = 3 * sizeof(float) * fixedVoxels;
+    qint64 bytes = 2 * sizeof(float) * movingVoxels;
+    if (!lazyRegisteredImage) {
+        bytes += fixedVoxels * moving->GetScalarSize();
+    }
+    switch (type) {
+    case DemonsRegistration:
+        bytes += 4 * fieldBytes;
+        break;
+    case DeformableRegistration:
+        bytes += fieldBytes + samples * (sizeof(int) + 4 * sizeof(float) + sizeof(vtkIdType) + 12 * sizeof(float));
+        break;
+    default:
+        bytes += samples * (sizeof(int) + 4 * sizeof(float));
+        break;
+    }
+    return bytes;
+}
+
+/**
+ * @brief 优化前的初始对齐 q = A·p + b
+ *
+ * 在最粗层上比较几何中心对齐、质心平移与质心+主轴旋转(两幅图像各一次并行矩计算)，
+ * 取互信息最好的一个，因此不会比原先的几何中心对齐差；启用相位相关时再在每轴不超过
+ * kPhaseCorrelationSize个体素的降采样层上用FFT求残余平移，度量改善时采用。
+ * 每个候选只在同一组样本上求一次度量，开销远小于一层优化；最粗层浮动图像留给随后的优化。
+ */
+void RegistrationManager::RegistrationManagerPrivate::initialTransform(double A[3][3], double b[3]) {
+    double fixedCenter[3];
+    double movingCenter[3];
+    imageCenter(fixedImage, fixedCenter);
+    imageCenter(movingImage, movingCenter);
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            A[r][c] = r == c ? 1.0 : 0.0;
+        }
+        b[r] = movingCenter[r] - fixedCenter[r];
+    }
+    if (initialization == GeometricCenterInitialization) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const std::shared_ptr<const MedicalImaging::ImageStatistics> fixedStatistics =
+        MedicalImaging::ImageStatistics::get(fixedImage);
+    const std::shared_ptr<const MedicalImaging::ImageStatistics> movingStatistics =
+        MedicalImaging::ImageStatistics::get(movingImage);
+    const MedicalImaging::IntensityStatistics& fixedRange = fixedStatistics->global();
+    const MedicalImaging::IntensityStatistics& movingRange = movingStatistics->global();
+    const int coarsest = coarsestLevel();
+    ImageKernels::RegistrationLevel ownFixedLevel;
+    const ImageKernels::RegistrationLevel& fixedLevel = fixedLevelAt(coarsest, ownFixedLevel);
+    buildRegistrationLevel(movingImage, 1 << coarsest, initialMovingLevel);
+
+    // 以各自的最小值为背景，强度越高权重越大
+    const ImageKernels::ImageMoments fixedMoments =
+        ImageKernels::computeMoments(fixedLevel, static_cast<float>(fixedRange.minimum));
+    const ImageKernels::ImageMoments movingMoments =
+        ImageKernels::computeMoments(initialMovingLevel, static_cast<float>(movingRange.minimum));
+    if (!fixedMoments.isValid() || !movingMoments.isValid()) {
+        return;
+    }
+
+    ImageKernels::MattesMutualInformation metric;
+    ImageKernels::SampleSet ownSamples;
+    bool stochastic = false;
+    metric.initialize(histogramBins, fixedRange.minimum, fixedRange.maximum,
+                      movingRange.minimum, movingRange.maximum);
+    metric.setSamples(samplesAt(coarsest, fixedLevel, ownSamples, stochastic));
+    ImageKernels::AffineTransform transform;  // 中心为原点时参数即A与b
+    auto evaluate = [&](const double candidateA[3][3], const double candidateB[3]) {
+        double parameters[ImageKernels::AffineTransform::kParameters];
+        for (int r = 0; r < 3; ++r) {
+            std::copy(candidateA[r], candidateA[r] + 3, parameters + 3 * r);
+            parameters[9 + r] = candidateB[r];
+        }
+        transform.setParameters(parameters);
+        return metric.evaluate(transform, initialMovingLevel, nullptr);
+    };
+
+    const double initialCost = evaluate(A, b);
+    double bestCost = initialCost;
+    QString method("几何中心");
+    auto consider = [&](const double candidateA[3][3], const double candidateB[3], const QString& name) {
+        const double cost = evaluate(candidateA, candidateB);
+        if (cost < bestCost) {
+            bestCost = cost;
+            method = name;
+            for (int r = 0; r < 3; ++r) {
+                std::copy(candidateA[r], candidateA[r] + 3, A[r]);
+                b[r] = candidateB[r];
+            }
+        }
+    };
+
+    const double identity[3][3] = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+    double translation[3];
+    for (int r = 0; r < 3; ++r) {
+        translation[r] = movingMoments.center[r] - fixedMoments.center[r];
+    }
+    consider(identity, translation, QString("质心"));
+    double R[3][3];
+    if (ImageKernels::principalAxesRotation(fixedMoments, movingMoments, R)) {
+        for (int r = 0; r < 3; ++r) {
+            translation[r] = movingMoments.center[r] -
+                             (R[r][0] * fixedMoments.center[0] + R[r][1] * fixedMoments.center[1] +
+                              R[r][2] * fixedMoments.center[2]);
+        }
+        consider(R, translation, QString("主轴"));
+    }
+
+    if (initialization == PhaseCorrelationInitialization) {
+        ImageKernels::RegistrationLevel smallFixed;
+        ImageKernels::downsampleLevel(fixedLevel, kPhaseCorrelationSize, smallFixed);
+        std::vector<float> moved;
+        ImageKernels::warpLevel(initialMovingLevel, A, b, smallFixed, moved, static_cast<float>(movingRange.minimum));
+        double shift[3];
+        ImageKernels::phaseCorrelation(smallFixed, moved, shift);
+        // moved(p + d) ≈ fixed(p)，新变换为 q = A·(p + d) + b
+        double current[3][3];
+        double shifted[3];
+        for (int r = 0; r < 3; ++r) {
+            std::copy(A[r], A[r] + 3, current[r]);
+            shifted[r] = b[r];
+            for (int c = 0; c < 3; ++c) {
+                shifted[r] += A[r][c] * shift[c] * smallFixed.spacing[c];
+            }
+        }
+        consider(current, shifted, method + "+相位相关");
+    }
+
+    LOG_INFO(QString("Registration: 初始对齐 %1, 最粗层度量 %2 -> %3, 耗时 %4 ms")
+                 .arg(method).arg(initialCost, 0, 'g', 6).arg(bestCost, 0, 'g', 6).arg(timer.elapsed()));
+}
+
+/**
+ * @brief 由粗到细逐层优化变换参数
+ *
+ * 每层按采样策略选取固定图像样本，最大步长取两倍层间距；
+ * 最细层步长小于tolerance时收敛，较粗层放宽到层间距的5%。
+ * 从coarsest层开始(热启动时为0，只做最细层)。
+ * levelSetup在每层优化前调用(参数为层号)，可调整变换、参数与缩放(如加密形变网格)。
+ */
+template<typename Transform>
+void RegistrationManager::RegistrationManagerPrivate::optimizePyramid(Transform& transform,
+                                                                      std::vector<double>& parameters,
+                                                                      std::vector<double>& scales,
+                                                                      int coarsest,
+                                                                      const std::function<void(int level)>& levelSetup) {
+    // 持有统计对象：统计缓存容量有限(批量配准时各工作实例互相淘汰)，只取引用会悬空
+    const std::shared_ptr<const MedicalImaging::ImageStatistics> fixedStatistics =
+        MedicalImaging::ImageStatistics::get(fixedImage);
+    const std::shared_ptr<const MedicalImaging::ImageStatistics> movingStatistics =
+        MedicalImaging::ImageStatistics::get(movingImage);
+    const MedicalImaging::IntensityStatistics& fixedRange = fixedStatistics->global();
+    const MedicalImaging::IntensityStatistics& movingRange = movingStatistics->global();
+    ImageKernels::MattesMutualInformation metric;
+    ImageKernels::RegistrationLevel ownFixedLevel;
+    ImageKernels::RegistrationLevel movingLevel;
+    ImageKernels::SampleSet samples;
+
+    for (int level = coarsest; level >= 0; --level) {
+        if (levelSetup) {
+            levelSetup(level);
+        }
+        const ImageKernels::RegistrationLevel& fixedLevel = fixedLevelAt(level, ownFixedLevel);
+        if (level == coarsest && !initialMovingLevel.isEmpty() && initialMovingLevel.shrinkFactor == (1 << level)) {
+            std::swap(movingLevel, initialMovingLevel);
+            initialMovingLevel = ImageKernels::RegistrationLevel();
+        } else {
+            buildRegistrationLevel(movingImage, 1 << level, movingLevel);
+        }
+        bool stochastic = false;
+        const ImageKernels::SampleSet& levelSamples = samplesAt(level, fixedLevel, samples, stochastic);
+        metric.initialize(histogramBins, fixedRange.minimum, fixedRange.maximum,
+                          movingRange.minimum, movingRange.maximum);
+        metric.setSamples(levelSamples);
+        transform.setSamples(levelSamples);
+
+        ImageKernels::RegularStepGradientDescent optimizer;
+        optimizer.maximumIterations = std::max(1, maxIterations);
+        optimizer.maximumStep = 2.0 * fixedLevel.meanSpacing();
+        optimizer.minimumStep = level == 0 ? std::max(tolerance, 1e-9)
+                                           : std::max(tolerance, 0.05 * fixedLevel.meanSpacing());
+        optimizer.scales = scales;
+        optimizer.observer = [&](int iteration, double cost, const std::vector<double>& current) {
+            if (stochastic && resampleEachIteration) {
+                drawSamples(fixedLevel, levelSeed(level) + static_cast<std::uint32_t>(iteration) + 1, samples);
+                metric.setSamples(samples);
+                transform.setSamples(samples);
+            }
+            const double fraction = (coarsest - level + (iteration + 1.0) / optimizer.maximumIterations) /
+                                    (coarsest + 1.0);
+            return monitor(fraction, cost, [&](vtkMatrix4x4* matrix, vtkSmartPointer<vtkImageData>& field) {
+                transform.setParameters(current.data());
+                snapshotOf(transform, matrix, field);
+            });
+        };
+        const ImageKernels::OptimizerResult result = optimizer.minimize(parameters,
+            [&](const std::vector<double>& mu, std::vector<double>& gradient) {
+                transform.setParameters(mu.data());
+                return metric.evaluate(transform, movingLevel, &gradient);
+            });
+        transform.setParameters(parameters.data());
+        metricValue = result.cost;
+        if (stopped) {
+            break;
+        }
+    }
+    ++progressStage;
+}
+
+// 从初始对齐(见initialTransform)开始优化绕固定图像中心的仿射变换；给出initial时以其为初值只优化最细层
+void RegistrationManager::RegistrationManagerPrivate::optimizeAffine(ImageKernels::AffineTransform& transform,
+                                                                     const std::vector<double>* initial) {
+    double fixedCenter[3];
+    const double radius = imageCenter(fixedImage, fixedCenter);
+    transform.setCenter(fixedCenter);
+    // 矩阵元素乘以半径换算为边缘的位移，与平移同量纲
+    std::vector<double> scales(ImageKernels::AffineTransform::kParameters, radius);
+    scales[9] = scales[10] = scales[11] = 1.0;
+
+    std::vector<double> parameters(ImageKernels::AffineTransform::kParameters);
+    if (initial && initial->size() >= parameters.size()) {
+        std::copy(initial->begin(), initial->begin() + parameters.size(), parameters.begin());
+        optimizePyramid(transform, parameters, scales, 0);
+        return;
+    }
+    double A[3][3];
+    double b[3];
+    initialTransform(A, b);
+    for (int r = 0; r < 3; ++r) {
+        parameters[9 + r] = b[r] - fixedCenter[r];
+        for (int c = 0; c < 3; ++c) {
+            parameters[3 * r + c] = A[r][c];
+            parameters[9 + r] += A[r][c] * fixedCenter[c];
+        }
+    }
+    optimizePyramid(transform, parameters, scales, coarsestLevel());
+}
+
+// 在给定网格上求位移场 u(p) = T(p) − p
+vtkSmartPointer<vtkImageData> RegistrationManager::RegistrationManagerPrivate::displacementFieldOf(
+    const ImageKernels::BSplineTransform& transform, const Resampler::Grid& grid) const {
+    auto field = vtkSmartPointer<vtkImageData>::New();
+    field->SetDimensions(grid.dimensions);
+    field->SetSpacing(grid.spacing[0], grid.spacing[1], grid.spacing[2]);
+    field->SetOrigin(grid.origin[0], grid.origin[1], grid.origin[2]);
+    field->AllocateScalars(VTK_FLOAT, 3);
+
+    const MedicalImaging::VoxelView<float> out = MedicalImaging::makeVoxelView<float>(field);
+    ImageKernels::forEachSlice(grid.dimensions[2], [&](int z) {
+        for (int y = 0; y < grid.dimensions[1]; ++y) {
+            float* row = out.row(y, z);
+            for (int x = 0; x < grid.dimensions[0]; ++x) {
+                const double p[3] = {grid.origin[0] + x * grid.spacing[0],
+                                     grid.origin[1] + y * grid.spacing[1],
+                                     grid.origin[2] + z * grid.spacing[2]};
+                double q[3];
+                transform.transformPoint(p, q);
+                float* u = row + x * out.strides[0];
+                u[0] = static_cast<float>(q[0] - p[0]);
+                u[1] = static_cast<float>(q[1] - p[1]);
+                u[2] = static_cast<float>(q[2] - p[2]);
+            }
+        }
+    });
+    return field;
+}
+
+// 把分量分开存储的demons位移场交织为三分量vtkImageData
+vtkSmartPointer<vtkImageData> RegistrationManager::RegistrationManagerPrivate::displacementFieldOf(
+    const ImageKernels::DisplacementField& field) const {
+    auto image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(field.dims[0], field.dims[1], field.dims[2]);
+    image->SetSpacing(field.spacing[0], field.spacing[1], field.spacing[2]);
+    image->SetOrigin(field.origin[0], field.origin[1], field.origin[2]);
+    image->AllocateScalars(VTK_FLOAT, 3);
+
+    const MedicalImaging::VoxelView<float> out = MedicalImaging::makeVoxelView<float>(image);
+    const vtkIdType sliceSize = static_cast<vtkIdType>(field.dims[0]) * field.dims[1];
+    ImageKernels::forEachSlice(field.dims[2], [&](int z) {
+        float* dst = out.row(0, z);
+        for (vtkIdType i = 0; i < sliceSize; ++i) {
+            const vtkIdType j = z * sliceSize + i;
+            dst[3 * i] = field.u[0][j];
+            dst[3 * i + 1] = field.u[1][j];
+            dst[3 * i + 2] = field.u[2][j];
+        }
+    });
+    return image;
+}
+
+/**
+ * @brief 每次迭代后调用：推进进度，按节流间隔发出预览，返回是否继续
+ * @param fraction 当前阶段内的完成比例
+ * @param snapshot 生成当前变换的快照，只在需要预览时调用
+ */
+bool RegistrationManager::RegistrationManagerPrivate::monitor(double fraction, double metric,
+                                                              const Snapshot& snapshot) {
+    Q_Q(RegistrationManager);
+    const int percentage = std::min(99, static_cast<int>(100.0 * (progressStage + std::min(1.0, fraction)) /
+                                                         progressStages));
+    if (q && percentage != lastPercentage) {
+        lastPercentage = percentage;
+        emit q->registrationProgress(percentage);
+    }
+
+    ++iterationsSincePreview;
+    const bool due = (previewIterations > 0 && iterationsSincePreview >= previewIterations) ||
+                     (previewMilliseconds > 0 && previewTimer.elapsed() >= previewMilliseconds);
+    if (q && due) {
+        auto matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+        vtkSmartPointer<vtkImageData> field;
+        snapshot(matrix, field);
+        emit q->registrationPreview(matrix, field, metric);
+        iterationsSincePreview = 0;
+        previewTimer.restart();
+    }
+
+    if (stopRequested.load() || (batchStop && batchStop->load())) {
+        stopped = true;
+        return false;
+    }
+    return true;
+}
+
+// 覆盖固定图像物理范围、每轴不超过kPreviewGridSize个点的粗网格
+Resampler::Grid RegistrationManager::RegistrationManagerPrivate::previewGrid() const {
+    Resampler::Grid grid = Resampler::Grid::fromImage(fixedImage);
+    for (int i = 0; i < 3; ++i) {
+        if (grid.dimensions[i] > kPreviewGridSize) {
+            const double extent = (grid.dimensions[i] - 1) * grid.spacing[i];
+            grid.dimensions[i] = kPreviewGridSize;
+            grid.spacing[i] = extent / (kPreviewGridSize - 1);
+        }
+    }
+    return grid;
+}
+
+// 把demons当前层的位移场三线性插值到预览网格
+vtkSmartPointer<vtkImageData> RegistrationManager::RegistrationManagerPrivate::previewFieldOf(
+    const ImageKernels::DisplacementField& field) const {
+    const Resampler::Grid grid = previewGrid();
+    auto image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(grid.dimensions);
+    image->SetSpacing(grid.spacing[0], grid.spacing[1], grid.spacing[2]);
+    image->SetOrigin(grid.origin[0], grid.origin[1], grid.origin[2]);
+    image->AllocateScalars(VTK_FLOAT, 3);
+
+    const MedicalImaging::VoxelView<float> out = MedicalImaging::makeVoxelView<float>(image);
+    ImageKernels::forEachSlice(grid.dimensions[2], [&](int z) {
+        const double k = (grid.origin[2] + z * grid.spacing[2] - field.origin[2]) / field.spacing[2];
+        for (int y = 0; y < grid.dimensions[1]; ++y) {
+            const double j = (grid.origin[1] + y * grid.spacing[1] - field.origin[1]) / field.spacing[1];
+            float* row = out.row(y, z);
+            for (int x = 0; x < grid.dimensions[0]; ++x) {
+                const double i = (grid.origin[0] + x * grid.spacing[0] - field.origin[0]) / field.spacing[0];
+                double u[3];
+                ImageKernels::DemonsDetail::sampleField(field, i, j, k, u);
+                float* v = row + x * out.strides[0];
+                v[0] = static_cast<float>(u[0]);
+                v[1] = static_cast<float>(u[1]);
+                v[2] = static_cast<float>(u[2]);
+            }
+        }
+    });
+    return image;
+}
+
+// 刚体与仿射变换的快照只有矩阵
+template<typename Transform>
+void RegistrationManager::RegistrationManagerPrivate::snapshotOf(const Transform& transform, vtkMatrix4x4* matrix,
+                                                                 vtkSmartPointer<vtkImageData>&) const {
+    double A[3][3];
+    double b[3];
+    transform.affine(A, b);
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            matrix->SetElement(r, c, A[r][c]);
+        }
+        matrix->SetElement(r, 3, b[r]);
+    }
+}
+
+// 自由形变的快照为仿射初始化矩阵与预览网格上的完整位移场
+void RegistrationManager::RegistrationManagerPrivate::snapshotOf(const ImageKernels::BSplineTransform& transform,
+                                                                 vtkMatrix4x4* matrix,
+                                                                 vtkSmartPointer<vtkImageData>& field) const {
+    matrix->DeepCopy(transformMatrix);
+    field = displacementFieldOf(transform, previewGrid());
+}
+
+void RegistrationManager::RegistrationManagerPrivate::storeTransform(const double A[3][3], const double b[3]) {
+    transformMatrix->Identity();
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            transformMatrix->SetElement(r, c, A[r][c]);
+        }
+        transformMatrix->SetElement(r, 3, b[r]);
+    }
+    transformMatrix->Modified();
+}
+
+// 缓存键中的参数部分：影响结果的全部设置
+QVariantList RegistrationManager::RegistrationManagerPrivate::cacheKey(const QString& algorithm) const {
+    QVariantList key = {maxIterations, tolerance, pyramidLevels};
+    if (algorithm == "demons") {
+        key << demons.displacementSigma << demons.updateSigma << demons.maximumStep << demons.tolerance;
+    } else {
+        key << histogramBins << static_cast<int>(samplingStrategy) << numberOfSamples << resampleEachIteration
+            << static_cast<int>(initialization);
+        if (algorithm == "deformable") {
+            key << controlPointSpacing;
+        }
+    }
+    return key;
+}
+
+// 先精确查找，再查找可用作初值的相似结果；缓存禁用或签名无效时未命中
+RegistrationManager::RegistrationManagerPrivate::CacheHit
+RegistrationManager::RegistrationManagerPrivate::queryCache(const QString& algorithm, RegistrationCache::Entry& entry) {
+    if (!fixedSignature.isValid() || !movingSignature.isValid()) {
+        return CacheMiss;
+    }
+    const QVariantList key = cacheKey(algorithm);
+    if (cache.lookup(algorithm, key, fixedSignature, movingSignature, entry)) {
+        LOG_INFO(QString("Registration: 命中缓存结果 (%1)").arg(algorithm));
+        return CacheExact;
+    }
+    if (cache.findSimilar(algorithm, key, fixedSignature, movingSignature, entry)) {
+        LOG_INFO(QString("Registration: 以相似图像对的缓存结果热启动 (%1)").arg(algorithm));
+        return CacheSimilar;
+    }
+    return CacheMiss;
+}
+
+void RegistrationManager::RegistrationManagerPrivate::storeCache(const QString& algorithm,
+                                                                 const std::vector<double>& parameters) {
+    if (stopped || !fixedSignature.isValid() || !movingSignature.isValid()) {
+        return;
+    }
+    RegistrationCache::Entry entry;
+    std::copy(transformMatrix->GetData(), transformMatrix->GetData() + 16, entry.matrix);
+    entry.parameters = parameters;
+    entry.metricValue = metricValue;
+    entry.displacementField = displacementField;
+    if (!cache.store(algorithm, cacheKey(algorithm), fixedSignature, movingSignature, entry)) {
+        LOG_WARNING(QString("Registration: 无法写入配准缓存 %1").arg(cache.directory()));
+    }
+}
+
+void RegistrationManager::RegistrationManagerPrivate::restore(const RegistrationCache::Entry& entry) {
+    transformMatrix->DeepCopy(entry.matrix);
+    transformMatrix->Modified();
+    displacementField = entry.displacementField;
+    metricValue = entry.metricValue;
+}
+
+// 有位移场时按位移场重采样浮动图像，否则按变换矩阵
+bool RegistrationManager::RegistrationManagerPrivate::resampleResult() {
+    registeredView = std::make_shared<RegisteredImageView>(movingImage, Resampler::Grid::fromImage(fixedImage),
+                                                           transformMatrix, displacementField);
+    if (lazyRegisteredImage) {
+        registeredImage = nullptr;
+        return true;
+    }
+    registeredImage = registeredView->materialize();
+    return registeredImage != nullptr;
+}
+
+bool RegistrationManager::RegistrationManagerPrivate::registerRigid() {
+    const QString algorithm("rigid");
+    RegistrationCache::Entry cached;
+    const auto hit = queryCache(algorithm, cached);
+    if (hit == CacheExact) {
+        restore(cached);
+        return resampleResult();
+    }
+
+    // 绕固定图像中心旋转，从初始对齐(几何中心、质心或主轴，见initialTransform)开始优化
+    double fixedCenter[3];
+    const double radius = imageCenter(fixedImage, fixedCenter);
+
+    ImageKernels::RigidTransform transform;
+    transform.setCenter(fixedCenter);
+    // 旋转参数乘以半径换算为边缘的弧长，与平移同量纲
+    std::vector<double> scales = {radius, radius, radius, 1.0, 1.0, 1.0};
+    std::vector<double> parameters;
+    int coarsest = coarsestLevel();
+    if (hit == CacheSimilar && cached.parameters.size() == ImageKernels::RigidTransform::kParameters) {
+        parameters = cached.parameters;
+        coarsest = 0;
+    } else {
+        double A[3][3];
+        double b[3];
+        initialTransform(A, b);
+        parameters = rigidParameters(A, b, fixedCenter);
+    }
+    optimizePyramid(transform, parameters, scales, coarsest);
+
+    double A[3][3];
+    double b[3];
+    transform.affine(A, b);
+    storeTransform(A, b);
+    storeCache(algorithm, parameters);
+
+    return resampleResult();
+}
+
+bool RegistrationManager::RegistrationManagerPrivate::registerAffine() {
+    const QString algorithm("affine");
+    RegistrationCache::Entry cached;
+    const auto hit = queryCache(algorithm, cached);
+    if (hit == CacheExact) {
+        restore(cached);
+        return resampleResult();
+    }
+
+    ImageKernels::AffineTransform transform;
+    optimizeAffine(transform, hit == CacheSimilar ? &cached.parameters : nullptr);
+
+    double A[3][3];
+    double b[3];
+    transform.affine(A, b);
+    storeTransform(A, b);
+    storeCache(algorithm, std::vector<double>(transform.getParameters(),
+                                              transform.getParameters() + ImageKernels::AffineTransform::kParameters));
+
+    return resampleResult();
+}
+
+bool RegistrationManager::RegistrationManagerPrivate::registerDeformable() {
+    const QString algorithm("deformable");
+    RegistrationCache::Entry cached;
+    const auto hit = queryCache(algorithm, cached);
+    if (hit == CacheExact) {
+        restore(cached);
+        return resampleResult();
+    }
+    // 缓存参数为仿射的12个参数后接最细层控制点系数
+    const bool warm = hit == CacheSimilar &&
+                      cached.parameters.size() > ImageKernels::AffineTransform::kParameters;
+
+    // 先做仿射配准，其结果作为自由形变的固定仿射部分
+    ImageKernels::AffineTransform affine;
+    optimizeAffine(affine, warm ? &cached.parameters : nullptr);
+    double A[3][3];
+    double b[3];
+    affine.affine(A, b);
+    storeTransform(A, b);
+
+    // 仿射阶段被停止时不再做自由形变，结果只有仿射矩阵
+    if (!stopped) {
+        // 最粗层的网格间距为最终间距乘以2^(层数−1)，之后每层加密一倍
+        const Resampler::Grid grid = Resampler::Grid::fromImage(fixedImage);
+        const int levels = std::max(1, pyramidLevels);
+        double extent[3];
+        int spans[3];
+        for (int i = 0; i < 3; ++i) {
+            extent[i] = (grid.dimensions[i] - 1) * grid.spacing[i];
+            spans[i] = std::max(1, static_cast<int>(std::lround(extent[i] / (controlPointSpacing * (1 << (levels - 1))))));
+        }
+        ImageKernels::BSplineTransform transform;
+        transform.setGrid(grid.origin, extent, spans);
+        transform.setBulkTransform(A, b);
+
+        std::vector<double> parameters;
+        std::vector<double> scales;
+        if (warm) {
+            // 零网格加密到最细层后换入缓存系数，只优化最细层
+            for (int level = levels - 1; level > 0; --level) {
+                transform.refine();
+            }
+            parameters.assign(cached.parameters.begin() + ImageKernels::AffineTransform::kParameters,
+                              cached.parameters.end());
+        }
+        if (warm && static_cast<int>(parameters.size()) == transform.parameterCount()) {
+            optimizePyramid(transform, parameters, scales, 0);
+        } else {
+            if (warm) {
+                transform.setGrid(grid.origin, extent, spans);
+            }
+            parameters.assign(static_cast<size_t>(transform.parameterCount()), 0.0);
+            optimizePyramid(transform, parameters, scales, levels - 1, [&](int level) {
+                if (level != levels - 1) {
+                    transform.refine();
+                    parameters = transform.getParameters();
+                }
+            });
+        }
+
+        displacementField = displacementFieldOf(transform, grid);
+        std::vector<double> stored(affine.getParameters(),
+                                   affine.getParameters() + ImageKernels::AffineTransform::kParameters);
+        stored.insert(stored.end(), parameters.begin(), parameters.end());
+        storeCache(algorithm, stored);
+    }
+
+    return resampleResult();
+}
+
+bool RegistrationManager::RegistrationManagerPrivate::registerDemons() {
+    const QString algorithm("demons");
+    RegistrationCache::Entry cached;
+    const auto hit = queryCache(algorithm, cached);
+    if (hit == CacheExact) {
+        restore(cached);
+        return resampleResult();
+    }
+    transformMatrix->Identity();
+    transformMatrix->Modified();
+
+    // 由粗到细，粗层的位移场插值到下一层作为初值；任一时刻只保留一层的图像与场
+    // 相似图像对的缓存位移场与固定图像同网格，直接作为最细层初值
+    const bool warm = hit == CacheSimilar && cached.displacementField &&
+                      cached.displacementField->GetNumberOfScalarComponents() == 3 &&
+                      cached.displacementField->GetScalarType() == VTK_FLOAT;
+    ImageKernels::DemonsParameters parameters = demons;
+    parameters.iterations = std::max(1, maxIterations);
+    ImageKernels::RegistrationLevel ownFixedLevel;
+    ImageKernels::RegistrationLevel movingLevel;
+    ImageKernels::DisplacementField field;
+    const int levels = warm ? 1 : std::max(1, pyramidLevels);
+    for (int level = levels - 1; level >= 0; --level) {
+        const ImageKernels::RegistrationLevel& fixedLevel = fixedLevelAt(level, ownFixedLevel);
+        buildRegistrationLevel(movingImage, 1 << level, movingLevel);
+        if (warm) {
+            field.reset(fixedLevel);
+            const MedicalImaging::VoxelView<float> in = MedicalImaging::makeVoxelView<float>(cached.displacementField);
+            const vtkIdType sliceSize = static_cast<vtkIdType>(field.dims[0]) * field.dims[1];
+            ImageKernels::forEachSlice(field.dims[2], [&](int z) {
+                const float* src = in.row(0, z);
+                for (vtkIdType i = 0; i < sliceSize; ++i) {
+                    const vtkIdType j = z * sliceSize + i;
+                    field.u[0][j] = src[3 * i];
+                    field.u[1][j] = src[3 * i + 1];
+                    field.u[2][j] = src[3 * i + 2];
+                }
+            });
+            cached.displacementField = nullptr;
+        } else if (level == levels - 1) {
+            field.reset(fixedLevel);
+        } else {
+            ImageKernels::DisplacementField coarse;
+            coarse.swap(field);
+            ImageKernels::upsampleField(coarse, fixedLevel, field);
+        }
+        parameters.observer = [&](int iteration, double error, const ImageKernels::DisplacementField& current) {
+            const double fraction = (levels - 1 - level + (iteration + 1.0) / parameters.iterations) / levels;
+            return monitor(fraction, error, [&](vtkMatrix4x4*, vtkSmartPointer<vtkImageData>& preview) {
+                preview = previewFieldOf(current);
+            });
+        };
+        metricValue = ImageKernels::diffeomorphicDemons(fixedLevel, movingLevel, field, parameters);
+        if (stopped) {
+            // 在粗层停止时把当前场插值到固定图像网格
+            if (level > 0) {
+                ImageKernels::DisplacementField coarse;
+                coarse.swap(field);
+                ImageKernels::upsampleField(coarse, fixedLevelAt(0, ownFixedLevel), field);
+            }
+            break;
+        }
+    }
+    std::vector<float>().swap(ownFixedLevel.voxels);
+    std::vector<float>().swap(movingLevel.voxels);
+
+    displacementField = displacementFieldOf(field);
+    field.release();
+    storeCache(algorithm, {});
+
+    return resampleResult();
+}
+
 RegistrationManager::RegistrationManager(QObject *parent)
     : QObject(parent)
-    , d_ptr(std::make_unique<RegistrationManagerPrivate>())
+    , d_ptr(std::make_unique<RegistrationManagerPrivate>(this))
 {
     Q_D(RegistrationManager);
-    d->transformMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-    d->transformMatrix->Identity();
+    qRegisterMetaType<vtkSmartPointer<vtkMatrix4x4>>();
+    qRegisterMetaType<vtkSmartPointer<vtkImageData>>();
+
+    const auto settings = MedicalImaging::Config::getInstance().getImageProcessingSettings();
+    d->cache.setDirectory(settings.enableRegistrationCache ? settings.registrationCacheDirectory : QString());
+    d->cache.setByteBudget(static_cast<qint64>(settings.registrationCacheSizeMB) * 1024 * 1024);
+    d->batchMemoryBudget = static_cast<qint64>(settings.streamingMemoryBudgetMB) * 1024 * 1024;
+    d->lazyRegisteredImage = settings.lazyRegisteredImage;
 }
 
 RegistrationManager::~RegistrationManager() = default;
 
 bool RegistrationManager::performRigidRegistration(vtkImageData* fixedImage, vtkImageData* movingImage) {
-    Q_D(RegistrationManager);
-    
-    if (!fixedImage || !movingImage) {
-        return false;
-    }
-    
-    emit registrationStarted();
-    
-    // 这里应该实现实际的刚性配准算法
-    // 暂时返回true表示成功
-    d->fixedImage = fixedImage;
-    d->movingImage = movingImage;
-    d->registeredImage = movingImage; // 临时解决方案
-    
-    emit registrationFinished();
-    return true;
+    return performRegistration(RigidRegistration, fixedImage, movingImage);
 }
 
 bool RegistrationManager::performAffineRegistration(vtkImageData* fixedImage, vtkImageData* movingImage) {
+    return performRegistration(AffineRegistration, fixedImage, movingImage);
+}
+
+bool RegistrationManager::performDeformableRegistration(vtkImageData* fixedImage, vtkImageData* movingImage) {
+    return performRegistration(DeformableRegistration, fixedImage, movingImage);
+}
+
+bool RegistrationManager::performDemonsRegistration(vtkImageData* fixedImage, vtkImageData* movingImage) {
+    return performRegistration(DemonsRegistration, fixedImage, movingImage);
+}
+
+bool RegistrationManager::performRegistration(RegistrationType type, vtkImageData* fixedImage,
+                                              vtkImageData* movingImage) {
     Q_D(RegistrationManager);
     
     if (!fixedImage || !movingImage) {
@@ -55,31 +1047,115 @@ bool RegistrationManager::performAffineRegistration(vtkImageData* fixedImage, vt
     
     emit registrationStarted();
     
-    // 这里应该实现实际的仿射配准算法
-    d->fixedImage = fixedImage;
-    d->movingImage = movingImage;
-    d->registeredImage = movingImage; // 临时解决方案
-    
+    if (!d->prepare(fixedImage, movingImage, stageCount(type))) {
+        emit registrationFinished();
+        return false;
+    }
+    const bool success = d->run(type);
+
+    emit registrationProgress(100);
     emit registrationFinished();
-    return true;
+    return success;
 }
 
-bool RegistrationManager::performDeformableRegistration(vtkImageData* fixedImage, vtkImageData* movingImage) {
+/**
+ * @brief 一对多批量配准
+ *
+ * 固定图像的各层与样本只构建一次，由所有图像对只读共享；每个图像对在全局线程池上
+ * 用独立的工作实例配准。调用线程按估算的峰值内存从预算中预留额度后才提交下一对，
+ * 预算不足时等待已完成的图像对释放额度，单对超出预算时独占全部预算。
+ */
+QList<RegistrationManager::BatchResult> RegistrationManager::performBatchRegistration(
+    RegistrationType type, vtkImageData* fixedImage, const QList<vtkImageData*>& movingImages) {
     Q_D(RegistrationManager);
-    
-    if (!fixedImage || !movingImage) {
-        return false;
+    QList<BatchResult> results;
+    if (!fixedImage || movingImages.isEmpty()) {
+        return results;
     }
-    
+
     emit registrationStarted();
-    
-    // 这里应该实现实际的可变形配准算法
-    d->fixedImage = fixedImage;
-    d->movingImage = movingImage;
-    d->registeredImage = movingImage; // 临时解决方案
-    
+    d->stopRequested.store(false);
+    d->stopped = false;
+    if (!MedicalImaging::ImageStatistics::get(fixedImage)) {
+        LOG_WARNING(QString("Registration: 不支持的体素类型 %1").arg(fixedImage->GetScalarType()));
+        emit registrationFinished();
+        return results;
+    }
+
+    // 固定图像的签名在此计算一次，之后各工作实例命中签名缓存
+    if (!d->cache.directory().isEmpty()) {
+        RegistrationCache::signature(fixedImage);
+    }
+    const std::shared_ptr<const RegistrationManagerPrivate::FixedPyramid> pyramid =
+        d->buildFixedPyramid(type, fixedImage);
+
+    constexpr qint64 kMegabyte = 1024 * 1024;
+    const int budgetUnits = static_cast<int>(std::max<qint64>(1, (d->batchMemoryBudget - pyramid->bytes()) / kMegabyte));
+    QSemaphore budget(budgetUnits);
+    const int total = movingImages.size();
+    std::vector<BatchResult> pairs(static_cast<size_t>(total));
+    std::atomic<int> completed{0};
+    const double fixedVoxels = static_cast<double>(fixedImage->GetNumberOfPoints());
+    const RegistrationManagerPrivate* settings = d;
+    QFutureSynchronizer<void> synchronizer;
+
+    for (int i = 0; i < total && !d->stopRequested.load(); ++i) {
+        vtkImageData* movingImage = movingImages[i];
+        if (!movingImage) {
+            continue;
+        }
+        BatchResult& result = pairs[static_cast<size_t>(i)];
+        result.reservedBytes = d->estimatePairBytes(type, fixedImage, movingImage);
+        const int units = static_cast<int>(std::min<qint64>(budgetUnits, (result.reservedBytes + kMegabyte - 1) / kMegabyte));
+        QElapsedTimer queued;
+        queued.start();
+        budget.acquire(units);
+
+        synchronizer.addFuture(QtConcurrent::run([this, settings, pyramid, type, fixedImage, movingImage, units,
+                                                  queued, fixedVoxels, total, i, &result, &budget, &completed]() {
+            result.waitMs = queued.nsecsElapsed() / 1.0e6;
+            QElapsedTimer timer;
+            timer.start();
+
+            RegistrationManagerPrivate worker(nullptr);
+            worker.copySettings(*settings);
+            worker.fixedPyramid = pyramid;
+            worker.batchStop = &settings->stopRequested;
+            if (worker.prepare(fixedImage, movingImage, stageCount(type)) && worker.run(type)) {
+                result.success = true;
+                result.registeredImage = worker.registeredImage;
+                result.registeredView = worker.registeredView;
+                result.transformMatrix = worker.transformMatrix;
+                result.displacementField = worker.displacementField;
+                result.metricValue = worker.metricValue;
+            }
+            result.elapsedMs = timer.nsecsElapsed() / 1.0e6;
+            result.megavoxelsPerSecond = result.elapsedMs > 0.0 ? fixedVoxels / (result.elapsedMs * 1.0e3) : 0.0;
+            budget.release(units);
+
+            LOG_INFO(QString("Registration: 批量配准 %1/%2 %3").arg(i + 1).arg(total).arg(result.toString()));
+            emit registrationProgress(100 * (++completed) / total);
+        }));
+    }
+    synchronizer.waitForFinished();
+    d->stopped = d->stopRequested.load();
+
+    results.reserve(total);
+    for (BatchResult& result : pairs) {
+        results.append(result);
+    }
     emit registrationFinished();
-    return true;
+    return results;
+}
+
+QString RegistrationManager::BatchResult::toString() const {
+    return QString("%1: 度量 %2, 预留内存 %3 MB, 等待 %4 ms, 耗时 %5 ms, 吞吐量 %6 Mvoxel/s")
+        .arg(success ? "成功" : "失败")
+        .arg(metricValue, 0, 'g', 6)
+        .arg(reservedBytes / (1024.0 * 1024.0), 0, 'f', 1)
+        .arg(waitMs, 0, 'f', 1)
+        .arg(elapsedMs, 0, 'f', 1)
+        .arg(megavoxelsPerSecond, 0, 'f', 3);
 }
 
 vtkMatrix4x4* RegistrationManager::getTransformMatrix() const {
@@ -89,9 +1165,27 @@ vtkMatrix4x4* RegistrationManager::getTransformMatrix() const {
 
 vtkImageData* RegistrationManager::getRegisteredImage() const {
     Q_D(const RegistrationManager);
+    if (!d->registeredImage && d->registeredView) {
+        return d->registeredView->materialize();
+    }
     return d->registeredImage;
 }
 
+std::shared_ptr<RegisteredImageView> RegistrationManager::getRegisteredView() const {
+    Q_D(const RegistrationManager);
+    return d->registeredView;
+}
+
+vtkImageData* RegistrationManager::getDisplacementField() const {
+    Q_D(const RegistrationManager);
+    return d->displacementField;
+}
+
+double RegistrationManager::getMetricValue() const {
+    Q_D(const RegistrationManager);
+    return d->metricValue;
+}
+
 void RegistrationManager::setMaxIterations(int iterations) {
     Q_D(RegistrationManager);
     d->maxIterations = iterations;
@@ -102,4 +1196,103 @@ void RegistrationManager::setTolerance(double tolerance) {
     d->tolerance = tolerance;
 }
 
+void RegistrationManager::setPyramidLevels(int levels) {
+    Q_D(RegistrationManager);
+    d->pyramidLevels = std::max(1, levels);
+}
+
+void RegistrationManager::setNumberOfHistogramBins(int bins) {
+    Q_D(RegistrationManager);
+    d->histogramBins = std::max(8, bins);
+}
+
+void RegistrationManager::setSamplingStrategy(SamplingStrategy strategy) {
+    Q_D(RegistrationManager);
+    d->samplingStrategy = strategy;
+}
+
+void RegistrationManager::setNumberOfSamples(int samples) {
+    Q_D(RegistrationManager);
+    d->numberOfSamples = std::max(1, samples);
+}
+
+void RegistrationManager::setResampleEachIteration(bool enabled) {
+    Q_D(RegistrationManager);
+    d->resampleEachIteration = enabled;
+}
+
+void RegistrationManager::setControlPointSpacing(double spacing) {
+    Q_D(RegistrationManager);
+    if (spacing > 0.0) {
+        d->controlPointSpacing = spacing;
+    }
+}
+
+void RegistrationManager::setInitialization(Initialization initialization) {
+    Q_D(RegistrationManager);
+    d->initialization = initialization;
+}
+
+RegistrationManager::Initialization RegistrationManager::getInitialization() const {
+    Q_D(const RegistrationManager);
+    return d->initialization;
+}
+
+void RegistrationManager::setDemonsSmoothing(double displacementSigma, double updateSigma) {
+    Q_D(RegistrationManager);
+    d->demons.displacementSigma = std::max(0.0, displacementSigma);
+    d->demons.updateSigma = std::max(0.0, updateSigma);
+}
+
+void RegistrationManager::setDemonsConvergence(double tolerance) {
+    Q_D(RegistrationManager);
+    d->demons.tolerance = std::max(0.0, tolerance);
+}
+
+double RegistrationManager::getDemonsConvergence() const {
+    Q_D(const RegistrationManager);
+    return d->demons.tolerance;
+}
+
+void RegistrationManager::setCacheDirectory(const QString& directory) {
+    Q_D(RegistrationManager);
+    d->cache.setDirectory(directory);
+}
+
+void RegistrationManager::setLazyRegisteredImage(bool enabled) {
+    Q_D(RegistrationManager);
+    d->lazyRegisteredImage = enabled;
+}
+
+bool RegistrationManager::isLazyRegisteredImage() const {
+    Q_D(const RegistrationManager);
+    return d->lazyRegisteredImage;
+}
+
+void RegistrationManager::setBatchMemoryBudget(qint64 bytes) {
+    Q_D(RegistrationManager);
+    d->batchMemoryBudget = std::max<qint64>(0, bytes);
+}
+
+qint64 RegistrationManager::batchMemoryBudget() const {
+    Q_D(const RegistrationManager);
+    return d->batchMemoryBudget;
+}
+
+void RegistrationManager::setPreviewInterval(int iterations, int milliseconds) {
+    Q_D(RegistrationManager);
+    d->previewIterations = std::max(0, iterations);
+    d->previewMilliseconds = std::max(0, milliseconds);
+}
+
+bool RegistrationManager::wasStopped() const {
+    Q_D(const RegistrationManager);
+    return d->stopped;
+}
+
+void RegistrationManager::stopRegistration() {
+    Q_D(RegistrationManager);
+    d->stopRequested.store(true);
+}
+
 #include "RegistrationManager.moc"
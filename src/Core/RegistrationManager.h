@@ -1,20 +1,72 @@
 #ifndef REGISTRATIONMANAGER_H
 #define REGISTRATIONMANAGER_H
 
+#include <QList>
 #include <QObject>
+#include <QMetaType>
+#include <QString>
 #include <memory>
 
+#include <vtkSmartPointer.h>
+
 // VTK前向声明
 class vtkImageData;
 class vtkMatrix4x4;
+class RegisteredImageView;
 
 /**
  * @brief 配准管理器，处理图像配准相关功能
+ *
+ * 变换矩阵把固定图像的物理点映射到浮动图像的物理点(与Resampler一致)，
+ * 配准结果为浮动图像经该变换重采样到固定图像网格上的图像。
+ * 配准通常在工作线程中调用：优化过程中按节流间隔发出进度与中间变换预览，
+ * 其他线程可随时请求停止，配准在下一次迭代后以当前结果结束。
  */
 class RegistrationManager : public QObject {
     Q_OBJECT
 
 public:
+    // 度量评估的样本选取方式
+    enum SamplingStrategy {
+        FullSampling,        // 固定图像的全部体素
+        RandomSampling,      // 均匀随机位置
+        StratifiedSampling,  // 每个网格单元内随机取一点
+        RegularSampling      // 规则网格上的体素
+    };
+
+    // 优化前的初始对齐(刚体、仿射与自由形变的仿射阶段)，候选在最粗层上按互信息择优
+    enum Initialization {
+        GeometricCenterInitialization,  // 对齐两幅图像的几何中心
+        MomentsInitialization,          // 另试质心平移与主轴旋转
+        PhaseCorrelationInitialization  // 在此基础上用降采样层的FFT相位相关求残余平移
+    };
+
+    // 配准方法
+    enum RegistrationType {
+        RigidRegistration,
+        AffineRegistration,
+        DeformableRegistration,  // 仿射初始化后的多层B样条自由形变
+        DemonsRegistration
+    };
+
+    /**
+     * @brief 批量配准中一个图像对的结果与吞吐量
+     */
+    struct BatchResult {
+        bool success = false;
+        vtkSmartPointer<vtkImageData> registeredImage;       // 惰性结果模式下为空
+        std::shared_ptr<RegisteredImageView> registeredView;
+        vtkSmartPointer<vtkMatrix4x4> transformMatrix;
+        vtkSmartPointer<vtkImageData> displacementField;
+        double metricValue = 0.0;
+        qint64 reservedBytes = 0;          // 按估算从内存预算中预留的字节数
+        double waitMs = 0.0;               // 等待内存预算与线程池的时间
+        double elapsedMs = 0.0;            // 配准本身的耗时
+        double megavoxelsPerSecond = 0.0;  // 吞吐量：固定图像体素数 / 配准耗时
+
+        QString toString() const;
+    };
+
     explicit RegistrationManager(QObject *parent = nullptr);
     ~RegistrationManager();
 
@@ -22,19 +74,78 @@ public:
     bool performRigidRegistration(vtkImageData* fixedImage, vtkImageData* movingImage);
     bool performAffineRegistration(vtkImageData* fixedImage, vtkImageData* movingImage);
     bool performDeformableRegistration(vtkImageData* fixedImage, vtkImageData* movingImage);
+    // 微分同胚demons，适用于同一患者同模态的随访图像(强度可直接比较)，结果通过位移场给出
+    bool performDemonsRegistration(vtkImageData* fixedImage, vtkImageData* movingImage);
+    bool performRegistration(RegistrationType type, vtkImageData* fixedImage, vtkImageData* movingImage);
+
+    /**
+     * @brief 把多幅浮动图像(随访扫描、图谱候选等)分别配准到同一幅固定图像
+     *
+     * 固定图像的金字塔与样本只计算一次；各图像对在全局线程池上并发执行，
+     * 并发度受批量内存预算限制。结果与输入顺序一致，空指针或未执行的图像对success为false。
+     * 进度按完成的图像对发出，不发出中间预览；管理器自身的单次配准结果不受影响。
+     */
+    QList<BatchResult> performBatchRegistration(RegistrationType type, vtkImageData* fixedImage,
+                                                const QList<vtkImageData*>& movingImages);
 
     // 获取配准结果
     vtkMatrix4x4* getTransformMatrix() const;
+    // 惰性结果模式下首次调用时才生成完整结果体(由结果视图持有)
     vtkImageData* getRegisteredImage() const;
+    // 最近一次配准结果的惰性视图：按切片或区域重采样，带瓦片缓存，不需要完整结果体
+    std::shared_ptr<RegisteredImageView> getRegisteredView() const;
+    double getMetricValue() const; // 最终度量值，越小越好(互信息配准为负互信息，demons为均方强度差)
+    // 可变形配准在固定图像网格上的位移场(三分量float，物理单位)，此时变换矩阵为其仿射初始化部分
+    vtkImageData* getDisplacementField() const;
 
     // 配准参数设置
-    void setMaxIterations(int iterations);
+    void setMaxIterations(int iterations);     // 每个金字塔层的最大迭代次数
+    // 最细层的最小步长(毫米)，步长衰减到该值以下视为收敛；较粗层在步长小于该层间距的5%时转入下一层。
+    // 只用于基于步长的优化，demons的收敛判据见setDemonsConvergence
     void setTolerance(double tolerance);
+    void setPyramidLevels(int levels);         // 金字塔层数，逐层缩小一半
+    void setNumberOfHistogramBins(int bins);   // 互信息联合直方图的分箱数
+    void setSamplingStrategy(SamplingStrategy strategy);
+    void setNumberOfSamples(int samples);      // 每层样本数，不小于该层体素数时退化为全采样
+    void setResampleEachIteration(bool enabled); // 随机类采样每次迭代后重新抽样，否则每层固定一组样本
+    void setControlPointSpacing(double spacing); // 自由形变最细层的控制点间距(毫米)
+    void setInitialization(Initialization initialization); // 默认PhaseCorrelationInitialization
+    Initialization getInitialization() const;
+    // demons的位移场与更新场平滑σ(体素单位)
+    void setDemonsSmoothing(double displacementSigma, double updateSigma);
+    // demons的收敛判据：一次迭代的均方强度差相对下降小于该值时转入下一层，默认1e-4
+    void setDemonsConvergence(double tolerance);
+    double getDemonsConvergence() const;
+    // 配准结果持久化缓存目录，为空时禁用；默认取自图像处理配置
+    void setCacheDirectory(const QString& directory);
+    // 惰性结果：配准结束时不生成完整结果体，只给出结果视图；默认取自图像处理配置
+    void setLazyRegisteredImage(bool enabled);
+    bool isLazyRegisteredImage() const;
+    // 批量配准同时进行的图像对的内存预算(字节)，默认取流式处理的内存预算
+    void setBatchMemoryBudget(qint64 bytes);
+    qint64 batchMemoryBudget() const;
+    // 预览节流：每隔iterations次迭代或milliseconds毫秒发出一次registrationPreview，两者均为0时不预览
+    void setPreviewInterval(int iterations, int milliseconds);
+    // 最近一次配准是否因stopRegistration提前结束(提前结束的结果不写入缓存)
+    bool wasStopped() const;
+
+public slots:
+    // 线程安全：请求正在进行的配准在下一次迭代后停止
+    void stopRegistration();
 
 signals:
     void registrationStarted();
     void registrationFinished();
     void registrationProgress(int percentage);
+    /**
+     * @brief 中间结果预览(在配准线程中发出，参数为快照，可跨线程排队传递)
+     * @param transform 当前的仿射变换(可变形配准时为其仿射初始化部分)
+     * @param displacementField 可变形配准当前的完整位移场，定义在覆盖固定图像的粗网格上，
+     *        非空时应按位移场而非矩阵重采样；仿射类配准为空
+     * @param metricValue 当前度量值
+     */
+    void registrationPreview(vtkSmartPointer<vtkMatrix4x4> transform,
+                             vtkSmartPointer<vtkImageData> displacementField, double metricValue);
 
 private:
     class RegistrationManagerPrivate;
@@ -42,4 +153,7 @@ private:
     Q_DECLARE_PRIVATE(RegistrationManager)
 };
 
+Q_DECLARE_METATYPE(vtkSmartPointer<vtkMatrix4x4>)
+Q_DECLARE_METATYPE(vtkSmartPointer<vtkImageData>)
+
 #endif // REGISTRATIONMANAGER_H
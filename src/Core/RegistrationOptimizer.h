@@ -0,0 +1,88 @@
+#ifndef REGISTRATIONOPTIMIZER_H
+#define REGISTRATIONOPTIMIZER_H
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+namespace ImageKernels {
+
+struct OptimizerResult {
+    int iterations = 0;
+    double cost = 0.0;
+    bool converged = false;
+};
+
+/**
+ * @brief 规则步长梯度下降
+ *
+ * 在按scales缩放后的参数空间(q = μ·scale)中沿负梯度方向走固定长度的步，
+ * 梯度方向相对上一步反转时步长乘以relaxation；步长小于minimumStep或梯度为零时收敛。
+ * 代价函数形如 double cost(const std::vector<double>& μ, std::vector<double>& gradient)。
+ * observer在每次迭代后调用，返回false时提前停止。
+ */
+class RegularStepGradientDescent {
+public:
+    double maximumStep = 1.0;
+    double minimumStep = 1e-3;
+    double relaxation = 0.5;
+    double gradientTolerance = 1e-12;
+    int maximumIterations = 100;
+    std::vector<double> scales;
+    std::function<bool(int iteration, double cost, const std::vector<double>& parameters)> observer;
+
+    template<typename Cost>
+    OptimizerResult minimize(std::vector<double>& parameters, Cost&& cost) const {
+        OptimizerResult result;
+        const size_t n = parameters.size();
+        std::vector<double> gradient(n, 0.0);
+        std::vector<double> direction(n, 0.0);
+        std::vector<double> previous;
+        double step = maximumStep;
+
+        for (int iteration = 0; iteration < maximumIterations; ++iteration) {
+            result.cost = cost(parameters, gradient);
+            result.iterations = iteration + 1;
+
+            double norm = 0.0;
+            double dot = 0.0;
+            for (size_t k = 0; k < n; ++k) {
+                direction[k] = gradient[k] / scaleOf(k);
+                norm += direction[k] * direction[k];
+                if (!previous.empty()) {
+                    dot += direction[k] * previous[k];
+                }
+            }
+            norm = std::sqrt(norm);
+            if (!(norm > gradientTolerance)) {
+                result.converged = true;
+                break;
+            }
+            if (dot < 0.0) {
+                step *= relaxation;
+            }
+            if (step < minimumStep) {
+                result.converged = true;
+                break;
+            }
+            for (size_t k = 0; k < n; ++k) {
+                parameters[k] -= step * direction[k] / norm / scaleOf(k);
+            }
+            previous = direction;
+
+            if (observer && !observer(iteration, result.cost, parameters)) {
+                break;
+            }
+        }
+        return result;
+    }
+
+private:
+    double scaleOf(size_t k) const {
+        return k < scales.size() && scales[k] > 0.0 ? scales[k] : 1.0;
+    }
+};
+
+} // namespace ImageKernels
+
+#endif // REGISTRATIONOPTIMIZER_H
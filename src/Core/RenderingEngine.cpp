@@ -6,6 +6,10 @@
 #include <vtkImageActor.h>
 #include <vtkImageMapper3D.h>
 #include <vtkCamera.h>
+#include <vtkActor.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
 #include <vtkSmartPointer.h>
 
 class RenderingEngine::RenderingEnginePrivate : public QObject {
@@ -17,6 +21,8 @@ public:
     vtkSmartPointer<vtkRenderWindow> renderWindow;
     vtkSmartPointer<vtkRenderWindowInteractor> interactor;
     vtkSmartPointer<vtkImageActor> imageActor;
+    vtkSmartPointer<vtkPolyDataMapper> surfaceMapper;
+    vtkSmartPointer<vtkActor> surfaceActor;
     bool initialized = false;
 };
 
@@ -27,6 +33,12 @@ RenderingEngine::RenderingEngine(QObject *parent)
     Q_D(RenderingEngine);
     d->renderer = vtkSmartPointer<vtkRenderer>::New();
     d->imageActor = vtkSmartPointer<vtkImageActor>::New();
+    d->surfaceMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+    d->surfaceMapper->ScalarVisibilityOff();
+    d->surfaceActor = vtkSmartPointer<vtkActor>::New();
+    d->surfaceActor->SetMapper(d->surfaceMapper);
+    d->surfaceActor->GetProperty()->SetColor(0.95, 0.85, 0.75);
+    d->surfaceActor->VisibilityOff();
 }
 
 RenderingEngine::~RenderingEngine() {
@@ -45,6 +57,7 @@ void RenderingEngine::initialize() {
     
     // 添加图像演员到渲染器
     d->renderer->AddActor(d->imageActor);
+    d->renderer->AddActor(d->surfaceActor);
     
     d->initialized = true;
     emit renderingStarted();
@@ -115,6 +128,26 @@ void RenderingEngine::removeImageData() {
     }
 }
 
+void RenderingEngine::setSurfaceData(vtkPolyData* surface) {
+    Q_D(RenderingEngine);
+    
+    if (!surface) {
+        removeSurfaceData();
+        return;
+    }
+    d->surfaceMapper->SetInputData(surface);
+    d->surfaceActor->VisibilityOn();
+    render();
+}
+
+void RenderingEngine::removeSurfaceData() {
+    Q_D(RenderingEngine);
+    
+    d->surfaceMapper->SetInputData(nullptr);
+    d->surfaceActor->VisibilityOff();
+    render();
+}
+
 void RenderingEngine::setViewport(int x, int y, int width, int height) {
     Q_D(RenderingEngine);
     
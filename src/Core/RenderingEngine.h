@@ -9,6 +9,7 @@ class vtkRenderer;
 class vtkRenderWindow;
 class vtkRenderWindowInteractor;
 class vtkImageData;
+class vtkPolyData;
 
 /**
  * @brief 渲染引擎类，负责VTK渲染管理
@@ -33,6 +34,9 @@ public:
     // 数据设置
     void setImageData(vtkImageData* imageData);
     void removeImageData();
+    // 等值面网格(如IsosurfaceExtractor::surfaceReady交付的网格)
+    void setSurfaceData(vtkPolyData* surface);
+    void removeSurfaceData();
 
     // 视口操作
     void setViewport(int x, int y, int width, int height);
@@ -0,0 +1,353 @@
+#include "ReprocessingScheduler.h"
+#include "ImageProcessor.h"
+#include <QFutureWatcher>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
+#include <vtkImageData.h>
+#include <vtkImageShrink3D.h>
+#include <vtkSmartPointer.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+struct ReprocessingParameters {
+    ReprocessingScheduler::Operation operation = ReprocessingScheduler::GaussianSmoothing;
+    double sigma = 1.0;
+    int kernelSize = 3;
+    double lowerThreshold = 0.0;
+    double upperThreshold = 255.0;
+    double sharpenAmount = 1.0;
+};
+
+// 代理体数据在工作线程中按需构建，按输入的身份和版本失效
+struct ProxyState {
+    QMutex mutex;
+    vtkImageData* source = nullptr;
+    vtkMTimeType sourceVersion = 0;
+    qint64 voxelBudget = 0;
+    int shrinkFactor = 1;
+    vtkSmartPointer<vtkImageData> proxy;
+};
+
+int shrinkFactorFor(vtkImageData* image, qint64 voxelBudget) {
+    const qint64 voxels = image->GetNumberOfPoints();
+    if (voxelBudget <= 0 || voxels <= voxelBudget) {
+        return 1;
+    }
+    return static_cast<int>(std::ceil(std::cbrt(static_cast<double>(voxels) / voxelBudget)));
+}
+
+vtkSmartPointer<vtkImageData> proxyFor(ProxyState& state, vtkImageData* input, int& shrinkFactor) {
+    QMutexLocker locker(&state.mutex);
+    if (state.source != input || state.sourceVersion != input->GetMTime() || !state.proxy) {
+        state.source = input;
+        state.sourceVersion = input->GetMTime();
+        state.shrinkFactor = shrinkFactorFor(input, state.voxelBudget);
+        state.proxy = input;
+        if (state.shrinkFactor > 1) {
+            auto shrink = vtkSmartPointer<vtkImageShrink3D>::New();
+            shrink->SetInputData(input);
+            shrink->SetShrinkFactors(state.shrinkFactor, state.shrinkFactor, state.shrinkFactor);
+            shrink->AveragingOn();
+            shrink->Update();
+            state.proxy = vtkSmartPointer<vtkImageData>::New();
+            state.proxy->ShallowCopy(shrink->GetOutput());
+        }
+    }
+    shrinkFactor = state.shrinkFactor;
+    return state.proxy;
+}
+
+// 参数以体素为单位，在代理分辨率上按比例缩小
+vtkSmartPointer<vtkImageData> runOperation(ImageProcessor* processor, vtkImageData* input,
+                                           const ReprocessingParameters& parameters, int shrinkFactor) {
+    switch (parameters.operation) {
+        case ReprocessingScheduler::GaussianSmoothing:
+            return processor->applyGaussianSmoothing(input, parameters.sigma / shrinkFactor);
+        case ReprocessingScheduler::MedianFilter: {
+            int kernelSize = std::max(1, static_cast<int>(std::lround(double(parameters.kernelSize) / shrinkFactor)));
+            if (kernelSize % 2 == 0) {
+                ++kernelSize;
+            }
+            return processor->applyMedianFilter(input, kernelSize);
+        }
+        case ReprocessingScheduler::Threshold:
+            return processor->applyThreshold(input, parameters.lowerThreshold, parameters.upperThreshold);
+        case ReprocessingScheduler::Sharpen:
+            return processor->applyUnsharpMask(input, parameters.sigma / shrinkFactor, parameters.sharpenAmount);
+    }
+    return nullptr;
+}
+
+} // namespace
+
+class ReprocessingScheduler::ReprocessingSchedulerPrivate : public QObject {
+    Q_OBJECT // 添加 Q_OBJECT 宏以启用信号和槽机制
+
+public:
+    typedef QFutureWatcher<vtkSmartPointer<vtkImageData>> ResultWatcher;
+
+    ImageProcessor* processor = nullptr;
+    // 每条计算通道使用独立的处理器实例，共享结果缓存
+    std::unique_ptr<ImageProcessor> proxyProcessor;
+    std::unique_ptr<ImageProcessor> fullProcessor;
+
+    vtkSmartPointer<vtkImageData> input;
+    ReprocessingParameters parameters;
+    std::shared_ptr<ProxyState> proxyState = std::make_shared<ProxyState>();
+
+    QTimer debounceTimer;
+    QTimer refineTimer;
+    ResultWatcher proxyWatcher;
+    ResultWatcher fullWatcher;
+
+    quint64 generation = 0;          // 每次参数变化递增
+    quint64 proxyJobGeneration = 0;
+    quint64 fullJobGeneration = 0;
+    quint64 deliveredGeneration = 0; // 已交付结果(预览或最终)的最新代数
+    bool proxyPending = false;
+    bool fullPending = false;
+
+    vtkSmartPointer<vtkImageData> lastPreview;
+    vtkSmartPointer<vtkImageData> lastResult;
+};
+
+ReprocessingScheduler::ReprocessingScheduler(ImageProcessor* processor, QObject *parent)
+    : QObject(parent)
+    , d_ptr(std::make_unique<ReprocessingSchedulerPrivate>())
+{
+    Q_D(ReprocessingScheduler);
+    d->processor = processor;
+    d->proxyProcessor = std::make_unique<ImageProcessor>();
+    d->fullProcessor = std::make_unique<ImageProcessor>();
+    d->proxyProcessor->shareResultCache(processor);
+    d->fullProcessor->shareResultCache(processor);
+    d->proxyState->voxelBudget = 128ll * 128 * 128;
+
+    d->debounceTimer.setSingleShot(true);
+    d->debounceTimer.setInterval(16);  // 约一帧，合并同一帧内的多次滑块变化
+    d->refineTimer.setSingleShot(true);
+    d->refineTimer.setInterval(300);
+
+    connect(&d->debounceTimer, &QTimer::timeout, this, [this]() {
+        Q_D(ReprocessingScheduler);
+        if (d->proxyWatcher.isRunning()) {
+            d->proxyPending = true;
+            return;
+        }
+        startProxyJob();
+    });
+
+    connect(&d->refineTimer, &QTimer::timeout, this, [this]() {
+        Q_D(ReprocessingScheduler);
+        if (d->fullWatcher.isRunning()) {
+            d->fullPending = true;
+            return;
+        }
+        startFullJob();
+    });
+
+    connect(&d->proxyWatcher, &ReprocessingSchedulerPrivate::ResultWatcher::finished, this, [this]() {
+        Q_D(ReprocessingScheduler);
+        vtkSmartPointer<vtkImageData> result = d->proxyWatcher.result();
+        // 仅交付比已显示内容更新的预览
+        if (result && d->proxyJobGeneration > d->deliveredGeneration) {
+            d->deliveredGeneration = d->proxyJobGeneration;
+            d->lastPreview = result;
+            emit previewReady(result);
+        }
+        if (d->proxyPending) {
+            d->proxyPending = false;
+            if (d->proxyJobGeneration != d->generation) {
+                startProxyJob();
+            }
+        }
+    });
+
+    connect(&d->fullWatcher, &ReprocessingSchedulerPrivate::ResultWatcher::finished, this, [this]() {
+        Q_D(ReprocessingScheduler);
+        vtkSmartPointer<vtkImageData> result = d->fullWatcher.result();
+        // 参数在计算期间已变化时丢弃过期结果
+        if (result && d->fullJobGeneration == d->generation) {
+            d->deliveredGeneration = d->fullJobGeneration;
+            d->lastResult = result;
+            emit resultReady(result);
+        }
+        if (d->fullPending) {
+            d->fullPending = false;
+            startFullJob();
+        }
+    });
+}
+
+ReprocessingScheduler::~ReprocessingScheduler() {
+    Q_D(ReprocessingScheduler);
+    d->debounceTimer.stop();
+    d->refineTimer.stop();
+    d->proxyWatcher.waitForFinished();
+    d->fullWatcher.waitForFinished();
+}
+
+void ReprocessingScheduler::setInputImage(vtkImageData* image) {
+    Q_D(ReprocessingScheduler);
+    if (d->input == image) {
+        return;
+    }
+    d->input = image;
+    requestReprocess();
+}
+
+vtkImageData* ReprocessingScheduler::getInputImage() const {
+    Q_D(const ReprocessingScheduler);
+    return d->input;
+}
+
+void ReprocessingScheduler::setOperation(Operation operation) {
+    Q_D(ReprocessingScheduler);
+    if (d->parameters.operation != operation) {
+        d->parameters.operation = operation;
+        requestReprocess();
+    }
+}
+
+ReprocessingScheduler::Operation ReprocessingScheduler::getOperation() const {
+    Q_D(const ReprocessingScheduler);
+    return d->parameters.operation;
+}
+
+void ReprocessingScheduler::setDebounceInterval(int milliseconds) {
+    Q_D(ReprocessingScheduler);
+    d->debounceTimer.setInterval(std::max(0, milliseconds));
+}
+
+void ReprocessingScheduler::setRefineDelay(int milliseconds) {
+    Q_D(ReprocessingScheduler);
+    d->refineTimer.setInterval(std::max(0, milliseconds));
+}
+
+void ReprocessingScheduler::setProxyVoxelBudget(qint64 voxels) {
+    Q_D(ReprocessingScheduler);
+    QMutexLocker locker(&d->proxyState->mutex);
+    d->proxyState->voxelBudget = voxels;
+    d->proxyState->proxy = nullptr;
+}
+
+bool ReprocessingScheduler::isBusy() const {
+    Q_D(const ReprocessingScheduler);
+    return d->proxyWatcher.isRunning() || d->fullWatcher.isRunning()
+        || d->debounceTimer.isActive() || d->refineTimer.isActive();
+}
+
+void ReprocessingScheduler::onSigmaChanged(double sigma) {
+    Q_D(ReprocessingScheduler);
+    d->parameters.sigma = sigma;
+    // 锐化与高斯平滑共用sigma，锐化时调整sigma不切换操作
+    if (d->parameters.operation != Sharpen) {
+        d->parameters.operation = GaussianSmoothing;
+    }
+    requestReprocess();
+}
+
+void ReprocessingScheduler::onKernelSizeChanged(int kernelSize) {
+    Q_D(ReprocessingScheduler);
+    d->parameters.kernelSize = kernelSize;
+    if (d->parameters.operation == MedianFilter) {
+        requestReprocess();
+    }
+}
+
+void ReprocessingScheduler::onThresholdChanged(double lower, double upper) {
+    Q_D(ReprocessingScheduler);
+    d->parameters.lowerThreshold = lower;
+    d->parameters.upperThreshold = upper;
+    d->parameters.operation = Threshold;
+    requestReprocess();
+}
+
+void ReprocessingScheduler::onFilterTypeChanged(const QString& filterType) {
+    if (filterType == QString("高斯滤波")) {
+        setOperation(GaussianSmoothing);
+    } else if (filterType == QString("中值滤波")) {
+        setOperation(MedianFilter);
+    } else if (filterType == QString("锐化滤波")) {
+        setOperation(Sharpen);
+    }
+}
+
+void ReprocessingScheduler::onSharpenRequested() {
+    Q_D(ReprocessingScheduler);
+    d->parameters.operation = Sharpen;
+    requestReprocess();
+}
+
+void ReprocessingScheduler::setSharpenAmount(double amount) {
+    Q_D(ReprocessingScheduler);
+    d->parameters.sharpenAmount = amount;
+    if (d->parameters.operation == Sharpen) {
+        requestReprocess();
+    }
+}
+
+void ReprocessingScheduler::requestReprocess() {
+    Q_D(ReprocessingScheduler);
+    if (!d->input) {
+        return;
+    }
+
+    ++d->generation;
+    // 预览按固定间隔节流，间隔内的多次变化合并为一次，执行时取最新参数
+    if (!d->debounceTimer.isActive()) {
+        d->debounceTimer.start();
+    }
+    d->refineTimer.start(); // 每次变化都重新计时，用户停顿后才计算全分辨率
+    emit reprocessingStarted();
+}
+
+void ReprocessingScheduler::cancel() {
+    Q_D(ReprocessingScheduler);
+    d->debounceTimer.stop();
+    d->refineTimer.stop();
+    d->proxyPending = false;
+    d->fullPending = false;
+    ++d->generation; // 使进行中的计算结果全部过期
+}
+
+void ReprocessingScheduler::startProxyJob() {
+    Q_D(ReprocessingScheduler);
+    if (!d->input) {
+        return;
+    }
+
+    d->proxyJobGeneration = d->generation;
+    ImageProcessor* processor = d->proxyProcessor.get();
+    vtkSmartPointer<vtkImageData> input = d->input;
+    const ReprocessingParameters parameters = d->parameters;
+    std::shared_ptr<ProxyState> proxyState = d->proxyState;
+
+    d->proxyWatcher.setFuture(QtConcurrent::run([processor, input, parameters, proxyState]() {
+        int shrinkFactor = 1;
+        vtkSmartPointer<vtkImageData> proxy = proxyFor(*proxyState, input, shrinkFactor);
+        return runOperation(processor, proxy, parameters, shrinkFactor);
+    }));
+}
+
+void ReprocessingScheduler::startFullJob() {
+    Q_D(ReprocessingScheduler);
+    if (!d->input) {
+        return;
+    }
+
+    d->fullJobGeneration = d->generation;
+    ImageProcessor* processor = d->fullProcessor.get();
+    vtkSmartPointer<vtkImageData> input = d->input;
+    const ReprocessingParameters parameters = d->parameters;
+
+    d->fullWatcher.setFuture(QtConcurrent::run([processor, input, parameters]() {
+        return runOperation(processor, input, parameters, 1);
+    }));
+}
+
+#include "ReprocessingScheduler.moc"
@@ -0,0 +1,74 @@
+#ifndef REPROCESSINGSCHEDULER_H
+#define REPROCESSINGSCHEDULER_H
+
+#include <QObject>
+#include <QString>
+#include <memory>
+
+// VTK前向声明
+class vtkImageData;
+class ImageProcessor;
+
+/**
+ * @brief 参数变化的重处理调度器
+ *
+ * 合并滑块拖动产生的连续参数变化，丢弃过期请求：先在降采样的代理体数据上
+ * 计算预览结果以提供即时反馈，待用户停止调整后再以全分辨率计算最终结果。
+ * 计算在后台线程中进行，结果通过信号在主线程交付。
+ *
+ * 典型连接方式：ParameterPanel::sigmaChanged → onSigmaChanged，
+ * kernelSizeChanged → onKernelSizeChanged，thresholdChanged → onThresholdChanged，
+ * filterTypeChanged → onFilterTypeChanged，sharpenFilterRequested → onSharpenRequested。
+ */
+class ReprocessingScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    enum Operation {
+        GaussianSmoothing,
+        MedianFilter,
+        Threshold,
+        Sharpen
+    };
+
+    explicit ReprocessingScheduler(ImageProcessor* processor, QObject *parent = nullptr);
+    ~ReprocessingScheduler();
+
+    // 输入与操作
+    void setInputImage(vtkImageData* image);
+    vtkImageData* getInputImage() const;
+    void setOperation(Operation operation);
+    Operation getOperation() const;
+
+    // 调度参数
+    void setDebounceInterval(int milliseconds);
+    void setRefineDelay(int milliseconds);
+    void setProxyVoxelBudget(qint64 voxels);
+    bool isBusy() const;
+
+public slots:
+    void onSigmaChanged(double sigma);
+    void onKernelSizeChanged(int kernelSize);
+    void onThresholdChanged(double lower, double upper);
+    void onFilterTypeChanged(const QString& filterType);
+    void onSharpenRequested();
+    void setSharpenAmount(double amount);
+
+    void requestReprocess();
+    void cancel();
+
+signals:
+    void previewReady(vtkImageData* result);
+    void resultReady(vtkImageData* result);
+    void reprocessingStarted();
+
+private:
+    void startProxyJob();
+    void startFullJob();
+
+    class ReprocessingSchedulerPrivate;
+    std::unique_ptr<ReprocessingSchedulerPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(ReprocessingScheduler)
+};
+
+#endif // REPROCESSINGSCHEDULER_H
@@ -0,0 +1,313 @@
+#include "Resampler.h"
+#include "Resampling.h"
+#include "Logger.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+using ImageKernels::AffineIndexMap;
+using MedicalImaging::VoxelTypeTag;
+using MedicalImaging::VoxelView;
+using MedicalImaging::dispatchVoxelType;
+using MedicalImaging::makeVoxelView;
+
+// 标量数组首元素对应的物理坐标(范围起点不为0时与GetOrigin不同)
+void arrayOrigin(vtkImageData* image, double origin[3]) {
+    const int* extent = image->GetExtent();
+    const double* imageOrigin = image->GetOrigin();
+    const double* spacing = image->GetSpacing();
+    for (int i = 0; i < 3; ++i) {
+        origin[i] = imageOrigin[i] + spacing[i] * extent[2 * i];
+    }
+}
+
+// 每个分量一份连续存储的B样条系数
+typedef std::vector<std::vector<float>> Coefficients;
+
+std::shared_ptr<const Coefficients> computeCoefficients(vtkImageData* input) {
+    int dims[3];
+    input->GetDimensions(dims);
+    const int components = input->GetNumberOfScalarComponents();
+    auto coefficients = std::make_shared<Coefficients>(components);
+
+    dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        const VoxelView<const T> in = makeVoxelView<const T>(input);
+        for (int c = 0; c < components; ++c) {
+            std::vector<float>& buffer = (*coefficients)[c];
+            buffer.resize(static_cast<size_t>(in.voxelCount()));
+            const VoxelView<const T> source = in.component(c);
+            const VoxelView<float> target = makeVoxelView(buffer.data(), dims);
+            ImageKernels::forEachSlice(dims[2], [&](int z) {
+                for (int y = 0; y < dims[1]; ++y) {
+                    const T* src = source.row(y, z);
+                    float* dst = target.row(y, z);
+                    for (int x = 0; x < dims[0]; ++x) {
+                        dst[x] = static_cast<float>(src[x * source.strides[0]]);
+                    }
+                }
+            });
+            ImageKernels::bsplinePrefilter(target);
+        }
+    });
+    return coefficients;
+}
+
+/**
+ * @brief 输出网格到输入索引的映射：仿射矩阵或位移场二选一
+ */
+struct Mapping {
+    AffineIndexMap affine;
+    vtkImageData* field = nullptr;
+    double outOrigin[3] = {0.0, 0.0, 0.0};
+    double outSpacing[3] = {1.0, 1.0, 1.0};
+    double inOrigin[3] = {0.0, 0.0, 0.0};
+    double inSpacing[3] = {1.0, 1.0, 1.0};
+
+    template<typename TOut, typename Sample>
+    void apply(const VoxelView<TOut>& out, Sample&& sample) const {
+        if (!field) {
+            ImageKernels::resampleAffine(out, affine, sample);
+        } else if (field->GetScalarType() == VTK_DOUBLE) {
+            ImageKernels::resampleDisplacement(out, outOrigin, outSpacing, inOrigin, inSpacing,
+                                               makeVoxelView<const double>(field), sample);
+        } else {
+            ImageKernels::resampleDisplacement(out, outOrigin, outSpacing, inOrigin, inSpacing,
+                                               makeVoxelView<const float>(field), sample);
+        }
+    }
+};
+
+} // namespace
+
+bool Resampler::Grid::isValid() const {
+    for (int i = 0; i < 3; ++i) {
+        if (dimensions[i] <= 0 || !(spacing[i] > 0.0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Resampler::Grid Resampler::Grid::fromImage(vtkImageData* image) {
+    Grid grid;
+    if (image) {
+        image->GetDimensions(grid.dimensions);
+        image->GetSpacing(grid.spacing);
+        arrayOrigin(image, grid.origin);
+    }
+    return grid;
+}
+
+Resampler::Grid Resampler::Grid::isotropic(vtkImageData* image, double spacing) {
+    Grid grid = fromImage(image);
+    if (!image || !(spacing > 0.0)) {
+        return grid;
+    }
+    for (int i = 0; i < 3; ++i) {
+        const double extent = (grid.dimensions[i] - 1) * grid.spacing[i];
+        grid.dimensions[i] = static_cast<int>(std::floor(extent / spacing + 1e-6)) + 1;
+        grid.spacing[i] = spacing;
+    }
+    return grid;
+}
+
+struct Resampler::Impl {
+    Interpolation interpolation = Linear;
+    double backgroundValue = 0.0;
+    bool floatOutput = false;
+
+    mutable QMutex mutex;
+    const vtkImageData* coefficientInput = nullptr;
+    vtkMTimeType coefficientVersion = 0;
+    std::shared_ptr<const Coefficients> coefficients;
+
+    std::shared_ptr<const Coefficients> coefficientsFor(vtkImageData* input) {
+        QMutexLocker locker(&mutex);
+        if (!coefficients || coefficientInput != input || coefficientVersion != input->GetMTime()) {
+            coefficients = computeCoefficients(input);
+            coefficientInput = input;
+            coefficientVersion = input->GetMTime();
+        }
+        return coefficients;
+    }
+
+    vtkSmartPointer<vtkImageData> run(vtkImageData* input, const Grid& target, const Mapping& mapping);
+};
+
+vtkSmartPointer<vtkImageData> Resampler::Impl::run(vtkImageData* input, const Grid& target, const Mapping& mapping) {
+    Interpolation mode;
+    float background;
+    bool toFloat;
+    {
+        QMutexLocker locker(&mutex);
+        mode = interpolation;
+        background = static_cast<float>(backgroundValue);
+        toFloat = floatOutput;
+    }
+
+    const int components = input->GetNumberOfScalarComponents();
+    auto output = vtkSmartPointer<vtkImageData>::New();
+    output->SetDimensions(target.dimensions[0], target.dimensions[1], target.dimensions[2]);
+    output->SetSpacing(target.spacing[0], target.spacing[1], target.spacing[2]);
+    output->SetOrigin(target.origin[0], target.origin[1], target.origin[2]);
+    output->AllocateScalars(toFloat ? VTK_FLOAT : input->GetScalarType(), components);
+
+    std::shared_ptr<const Coefficients> coefficients;
+    if (mode == CubicBSpline) {
+        coefficients = coefficientsFor(input);
+    }
+    int inputDims[3];
+    input->GetDimensions(inputDims);
+
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        const VoxelView<const T> in = makeVoxelView<const T>(input);
+
+        auto resampleInto = [&](auto outTag) {
+            using TOut = typename decltype(outTag)::type;
+            const VoxelView<TOut> out = makeVoxelView<TOut>(output);
+            for (int c = 0; c < components; ++c) {
+                const VoxelView<TOut> outComponent = out.component(c);
+                const VoxelView<const T> inComponent = in.component(c);
+                switch (mode) {
+                    case Nearest:
+                        mapping.apply(outComponent, [&inComponent, background](double x, double y, double z) {
+                            return ImageKernels::sampleNearest(inComponent, x, y, z, background);
+                        });
+                        break;
+                    case Linear:
+                        mapping.apply(outComponent, [&inComponent, background](double x, double y, double z) {
+                            return ImageKernels::sampleLinear(inComponent, x, y, z, background);
+                        });
+                        break;
+                    case CubicBSpline: {
+                        const VoxelView<const float> coefficientView =
+                            makeVoxelView<const float>((*coefficients)[c].data(), inputDims);
+                        mapping.apply(outComponent, [&coefficientView, background](double x, double y, double z) {
+                            return ImageKernels::sampleCubicBSpline(coefficientView, x, y, z, background);
+                        });
+                        break;
+                    }
+                }
+            }
+        };
+
+        if (toFloat) {
+            resampleInto(VoxelTypeTag<float>());
+        } else {
+            resampleInto(tag);
+        }
+    });
+
+    if (!dispatched) {
+        LOG_WARNING(QString("Resample: 不支持的体素类型 %1").arg(input->GetScalarType()));
+        return nullptr;
+    }
+    return output;
+}
+
+Resampler::Resampler()
+    : d(std::make_unique<Impl>())
+{
+}
+
+Resampler::~Resampler() = default;
+
+void Resampler::setInterpolation(Interpolation interpolation) {
+    QMutexLocker locker(&d->mutex);
+    d->interpolation = interpolation;
+}
+
+Resampler::Interpolation Resampler::getInterpolation() const {
+    QMutexLocker locker(&d->mutex);
+    return d->interpolation;
+}
+
+void Resampler::setBackgroundValue(double value) {
+    QMutexLocker locker(&d->mutex);
+    d->backgroundValue = value;
+}
+
+double Resampler::getBackgroundValue() const {
+    QMutexLocker locker(&d->mutex);
+    return d->backgroundValue;
+}
+
+void Resampler::setFloatOutput(bool enabled) {
+    QMutexLocker locker(&d->mutex);
+    d->floatOutput = enabled;
+}
+
+bool Resampler::isFloatOutput() const {
+    QMutexLocker locker(&d->mutex);
+    return d->floatOutput;
+}
+
+vtkSmartPointer<vtkImageData> Resampler::resample(vtkImageData* input, const Grid& target,
+                                                  vtkMatrix4x4* transform) const {
+    if (!input || !target.isValid()) {
+        return nullptr;
+    }
+
+    double outOrigin[3];
+    double inOrigin[3];
+    std::copy(target.origin, target.origin + 3, outOrigin);
+    arrayOrigin(input, inOrigin);
+    const double* inSpacing = input->GetSpacing();
+
+    // 合并"输出索引→物理点→变换→输入索引"为一个仿射映射，
+    // 行内相邻体素的输入坐标只差一个常量步长
+    Mapping mapping;
+    for (int r = 0; r < 3; ++r) {
+        double translation = transform ? transform->GetElement(r, 3) : 0.0;
+        for (int c = 0; c < 3; ++c) {
+            const double element = transform ? transform->GetElement(r, c) : (r == c ? 1.0 : 0.0);
+            mapping.affine.m[r][c] = element * target.spacing[c] / inSpacing[r];
+            translation += element * outOrigin[c];
+        }
+        mapping.affine.m[r][3] = (translation - inOrigin[r]) / inSpacing[r];
+    }
+    return d->run(input, target, mapping);
+}
+
+vtkSmartPointer<vtkImageData> Resampler::resample(vtkImageData* input, const Grid& target,
+                                                  vtkImageData* displacementField) const {
+    if (!input || !target.isValid()) {
+        return nullptr;
+    }
+    if (!displacementField) {
+        return resample(input, target, static_cast<vtkMatrix4x4*>(nullptr));
+    }
+
+    int fieldDims[3];
+    displacementField->GetDimensions(fieldDims);
+    const int fieldType = displacementField->GetScalarType();
+    if (displacementField->GetNumberOfScalarComponents() != 3 ||
+        (fieldType != VTK_FLOAT && fieldType != VTK_DOUBLE) ||
+        !std::equal(fieldDims, fieldDims + 3, target.dimensions)) {
+        LOG_WARNING("Resample: 位移场须为与目标网格同维度的三分量float/double图像");
+        return nullptr;
+    }
+
+    Mapping mapping;
+    mapping.field = displacementField;
+    std::copy(target.origin, target.origin + 3, mapping.outOrigin);
+    std::copy(target.spacing, target.spacing + 3, mapping.outSpacing);
+    arrayOrigin(input, mapping.inOrigin);
+    input->GetSpacing(mapping.inSpacing);
+    return d->run(input, target, mapping);
+}
+
+void Resampler::clearCoefficientCache() {
+    QMutexLocker locker(&d->mutex);
+    d->coefficients.reset();
+    d->coefficientInput = nullptr;
+    d->coefficientVersion = 0;
+}
@@ -0,0 +1,80 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <memory>
+
+#include <vtkSmartPointer.h>
+
+class vtkImageData;
+class vtkMatrix4x4;
+
+/**
+ * @brief 体数据重采样引擎
+ *
+ * 将输入图像通过空间变换映射到目标网格上，供配准、各向同性重排和斜切MPR使用。
+ * 变换方向与配准一致：把目标网格上的物理点映射到输入图像的物理点。
+ * 支持最近邻、三线性和三次B样条插值；B样条系数按输入数据版本(MTime)缓存，
+ * 对同一输入的反复重采样(如配准迭代)只预滤波一次。所有接口线程安全。
+ */
+class Resampler {
+public:
+    enum Interpolation {
+        Nearest,
+        Linear,
+        CubicBSpline
+    };
+
+    /**
+     * @brief 目标网格：维度、间距与原点(物理坐标)
+     */
+    struct Grid {
+        int dimensions[3] = {0, 0, 0};
+        double spacing[3] = {1.0, 1.0, 1.0};
+        double origin[3] = {0.0, 0.0, 0.0};
+
+        bool isValid() const;
+        static Grid fromImage(vtkImageData* image);
+        // 覆盖输入相同物理范围的各向同性网格
+        static Grid isotropic(vtkImageData* image, double spacing);
+    };
+
+    Resampler();
+    ~Resampler();
+
+    void setInterpolation(Interpolation interpolation);
+    Interpolation getInterpolation() const;
+
+    // 映射到输入范围以外的体素取值
+    void setBackgroundValue(double value);
+    double getBackgroundValue() const;
+
+    // true时输出float，否则输出与输入相同的标量类型(四舍五入并饱和)
+    void setFloatOutput(bool enabled);
+    bool isFloatOutput() const;
+
+    /**
+     * @brief 仿射重采样
+     * @param transform 目标物理点到输入物理点的4x4齐次变换，为空时视为恒等变换
+     */
+    vtkSmartPointer<vtkImageData> resample(vtkImageData* input, const Grid& target,
+                                           vtkMatrix4x4* transform = nullptr) const;
+
+    /**
+     * @brief 位移场重采样
+     * @param displacementField 定义在目标网格上的三分量float/double位移场(物理单位)
+     */
+    vtkSmartPointer<vtkImageData> resample(vtkImageData* input, const Grid& target,
+                                           vtkImageData* displacementField) const;
+
+    // 释放缓存的B样条系数
+    void clearCoefficientCache();
+
+private:
+    Resampler(const Resampler&) = delete;
+    Resampler& operator=(const Resampler&) = delete;
+
+    struct Impl;
+    std::unique_ptr<Impl> d;
+};
+
+#endif // RESAMPLER_H
@@ -0,0 +1,278 @@
+#ifndef RESAMPLING_H
+#define RESAMPLING_H
+
+#include "ImageKernels.h"
+#include <cmath>
+#include <vector>
+
+namespace ImageKernels {
+
+/**
+ * @brief 输出体素索引到输入连续索引的仿射映射：in = m · [x, y, z, 1]
+ */
+struct AffineIndexMap {
+    double m[3][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+};
+
+// ========== 插值 ==========
+
+template<typename T>
+inline float sampleNearest(const VoxelView<const T>& in, double x, double y, double z, float background) {
+    const int i = static_cast<int>(std::floor(x + 0.5));
+    const int j = static_cast<int>(std::floor(y + 0.5));
+    const int k = static_cast<int>(std::floor(z + 0.5));
+    if (i < 0 || j < 0 || k < 0 || i >= in.dims[0] || j >= in.dims[1] || k >= in.dims[2]) {
+        return background;
+    }
+    return static_cast<float>(in.at(i, j, k));
+}
+
+template<typename T>
+inline float sampleLinear(const VoxelView<const T>& in, double x, double y, double z, float background) {
+    if (!(x >= 0.0 && y >= 0.0 && z >= 0.0 && x <= in.dims[0] - 1 && y <= in.dims[1] - 1 && z <= in.dims[2] - 1)) {
+        return background;
+    }
+    const int x0 = static_cast<int>(x);
+    const int y0 = static_cast<int>(y);
+    const int z0 = static_cast<int>(z);
+    const float fx = static_cast<float>(x - x0);
+    const float fy = static_cast<float>(y - y0);
+    const float fz = static_cast<float>(z - z0);
+    const vtkIdType dx = x0 + 1 < in.dims[0] ? in.strides[0] : 0;
+    const vtkIdType dy = y0 + 1 < in.dims[1] ? in.strides[1] : 0;
+    const vtkIdType dz = z0 + 1 < in.dims[2] ? in.strides[2] : 0;
+
+    const T* p = &in.at(x0, y0, z0);
+    const float c00 = p[0] + fx * (static_cast<float>(p[dx]) - p[0]);
+    const float c10 = p[dy] + fx * (static_cast<float>(p[dy + dx]) - p[dy]);
+    const float c01 = p[dz] + fx * (static_cast<float>(p[dz + dx]) - p[dz]);
+    const float c11 = p[dz + dy] + fx * (static_cast<float>(p[dz + dy + dx]) - p[dz + dy]);
+    const float c0 = c00 + fy * (c10 - c00);
+    const float c1 = c01 + fy * (c11 - c01);
+    return c0 + fz * (c1 - c0);
+}
+
+inline int mirrorIndex(int i, int n) {
+    if (n == 1) {
+        return 0;
+    }
+    const int period = 2 * n - 2;
+    i = std::abs(i) % period;
+    return i < n ? i : period - i;
+}
+
+inline void cubicBSplineWeights(float t, float w[4]) {
+    const float t2 = t * t;
+    const float t3 = t2 * t;
+    const float s = 1.0f - t;
+    w[0] = s * s * s / 6.0f;
+    w[1] = (4.0f - 6.0f * t2 + 3.0f * t3) / 6.0f;
+    w[2] = (1.0f + 3.0f * t + 3.0f * t2 - 3.0f * t3) / 6.0f;
+    w[3] = t3 / 6.0f;
+}
+
+/**
+ * @brief 三次B样条插值，coefficients须由bsplinePrefilter预先计算
+ */
+inline float sampleCubicBSpline(const VoxelView<const float>& coefficients, double x, double y, double z,
+                                float background) {
+    const int nx = coefficients.dims[0];
+    const int ny = coefficients.dims[1];
+    const int nz = coefficients.dims[2];
+    if (!(x >= 0.0 && y >= 0.0 && z >= 0.0 && x <= nx - 1 && y <= ny - 1 && z <= nz - 1)) {
+        return background;
+    }
+    const int xi = static_cast<int>(std::floor(x));
+    const int yi = static_cast<int>(std::floor(y));
+    const int zi = static_cast<int>(std::floor(z));
+    float wx[4];
+    float wy[4];
+    float wz[4];
+    cubicBSplineWeights(static_cast<float>(x - xi), wx);
+    cubicBSplineWeights(static_cast<float>(y - yi), wy);
+    cubicBSplineWeights(static_cast<float>(z - zi), wz);
+
+    vtkIdType xo[4];
+    for (int a = 0; a < 4; ++a) {
+        xo[a] = mirrorIndex(xi - 1 + a, nx) * coefficients.strides[0];
+    }
+    float value = 0.0f;
+    for (int c = 0; c < 4; ++c) {
+        const int k = mirrorIndex(zi - 1 + c, nz);
+        float plane = 0.0f;
+        for (int b = 0; b < 4; ++b) {
+            const float* row = coefficients.row(mirrorIndex(yi - 1 + b, ny), k);
+            plane += wy[b] * (wx[0] * row[xo[0]] + wx[1] * row[xo[1]] + wx[2] * row[xo[2]] + wx[3] * row[xo[3]]);
+        }
+        value += wz[c] * plane;
+    }
+    return value;
+}
+
+// ========== 三次B样条预滤波(Unser递归滤波，镜像边界) ==========
+
+namespace detail {
+
+inline void bsplinePrefilterLine(double* c, int n) {
+    if (n < 2) {
+        return;
+    }
+    const double z = std::sqrt(3.0) - 2.0;
+    const double lambda = (1.0 - z) * (1.0 - 1.0 / z);
+    for (int k = 0; k < n; ++k) {
+        c[k] *= lambda;
+    }
+
+    // 因果初值：截断到精度足够的项数，否则按镜像边界精确求和
+    const int horizon = static_cast<int>(std::ceil(std::log(1e-6) / std::log(std::fabs(z))));
+    double sum = c[0];
+    if (horizon < n) {
+        double zn = z;
+        for (int k = 1; k < horizon; ++k) {
+            sum += zn * c[k];
+            zn *= z;
+        }
+    } else {
+        double zn = z;
+        const double iz = 1.0 / z;
+        double z2n = std::pow(z, n - 1);
+        sum = c[0] + z2n * c[n - 1];
+        z2n *= z2n * iz;
+        for (int k = 1; k < n - 1; ++k) {
+            sum += (zn + z2n) * c[k];
+            zn *= z;
+            z2n *= iz;
+        }
+        sum /= 1.0 - zn * zn;
+    }
+    c[0] = sum;
+    for (int k = 1; k < n; ++k) {
+        c[k] += z * c[k - 1];
+    }
+    c[n - 1] = (z / (z * z - 1.0)) * (z * c[n - 2] + c[n - 1]);
+    for (int k = n - 2; k >= 0; --k) {
+        c[k] = z * (c[k + 1] - c[k]);
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief 原地将体素值转换为三次B样条插值系数，三个轴依次处理，每轴按线并行
+ */
+inline void bsplinePrefilter(const VoxelView<float>& data) {
+    const int nx = data.dims[0];
+    const int ny = data.dims[1];
+    const int nz = data.dims[2];
+    vtkSMPThreadLocal<std::vector<double>> lineBuffers;
+
+    auto filterLine = [&](float* start, vtkIdType stride, int n) {
+        std::vector<double>& line = lineBuffers.Local();
+        line.resize(n);
+        for (int i = 0; i < n; ++i) {
+            line[i] = start[i * stride];
+        }
+        detail::bsplinePrefilterLine(line.data(), n);
+        for (int i = 0; i < n; ++i) {
+            start[i * stride] = static_cast<float>(line[i]);
+        }
+    };
+
+    forEachSlice(nz, [&](int z) {
+        for (int y = 0; y < ny; ++y) {
+            filterLine(data.row(y, z), data.strides[0], nx);
+        }
+        for (int x = 0; x < nx; ++x) {
+            filterLine(&data.at(x, 0, z), data.strides[1], ny);
+        }
+    });
+    forEachSlice(ny, [&](int y) {
+        for (int x = 0; x < nx; ++x) {
+            filterLine(&data.at(x, y, 0), data.strides[2], nz);
+        }
+    });
+}
+
+// ========== 重采样 ==========
+
+/**
+ * @brief 仿射重采样：按输出切片并行
+ *
+ * 每行先以起点加步长的方式批量生成输入坐标(连续访存，可向量化)，
+ * 再逐体素插值。sample(x, y, z)返回输入连续索引处的值。
+ */
+template<typename TOut, typename Sample>
+void resampleAffine(const VoxelView<TOut>& out, const AffineIndexMap& map, Sample&& sample) {
+    const int nx = out.dims[0];
+    struct Coordinates {
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> z;
+    };
+    vtkSMPThreadLocal<Coordinates> coordinateBuffers;
+
+    forEachSlice(out.dims[2], [&](int k) {
+        Coordinates& c = coordinateBuffers.Local();
+        c.x.resize(nx);
+        c.y.resize(nx);
+        c.z.resize(nx);
+        double* cx = c.x.data();
+        double* cy = c.y.data();
+        double* cz = c.z.data();
+        const double stepX = map.m[0][0];
+        const double stepY = map.m[1][0];
+        const double stepZ = map.m[2][0];
+
+        for (int j = 0; j < out.dims[1]; ++j) {
+            // 行起点直接计算，避免跨行累积误差
+            const double x0 = map.m[0][1] * j + map.m[0][2] * k + map.m[0][3];
+            const double y0 = map.m[1][1] * j + map.m[1][2] * k + map.m[1][3];
+            const double z0 = map.m[2][1] * j + map.m[2][2] * k + map.m[2][3];
+            for (int i = 0; i < nx; ++i) {
+                cx[i] = x0 + stepX * i;
+                cy[i] = y0 + stepY * i;
+                cz[i] = z0 + stepZ * i;
+            }
+            TOut* row = out.row(j, k);
+            for (int i = 0; i < nx; ++i) {
+                row[i * out.strides[0]] = saturateCast<TOut>(sample(cx[i], cy[i], cz[i]));
+            }
+        }
+    });
+}
+
+/**
+ * @brief 位移场重采样：输入物理点 = 输出物理点 + u(输出物理点)
+ * @param field 定义在输出网格上的三分量位移场(物理单位)
+ */
+template<typename TOut, typename TField, typename Sample>
+void resampleDisplacement(const VoxelView<TOut>& out, const double outOrigin[3], const double outSpacing[3],
+                          const double inOrigin[3], const double inSpacing[3],
+                          const VoxelView<const TField>& field, Sample&& sample) {
+    double scale[3];
+    double offset[3];
+    for (int a = 0; a < 3; ++a) {
+        scale[a] = outSpacing[a] / inSpacing[a];
+        offset[a] = (outOrigin[a] - inOrigin[a]) / inSpacing[a];
+    }
+    const double inverseSpacing[3] = {1.0 / inSpacing[0], 1.0 / inSpacing[1], 1.0 / inSpacing[2]};
+
+    forEachSlice(out.dims[2], [&](int k) {
+        for (int j = 0; j < out.dims[1]; ++j) {
+            const TField* u = field.row(j, k);
+            TOut* row = out.row(j, k);
+            const double y = offset[1] + scale[1] * j;
+            const double z = offset[2] + scale[2] * k;
+            for (int i = 0; i < out.dims[0]; ++i) {
+                const TField* ui = u + i * field.strides[0];
+                const double x = offset[0] + scale[0] * i + ui[0] * inverseSpacing[0];
+                row[i * out.strides[0]] = saturateCast<TOut>(
+                    sample(x, y + ui[1] * inverseSpacing[1], z + ui[2] * inverseSpacing[2]));
+            }
+        }
+    });
+}
+
+} // namespace ImageKernels
+
+#endif // RESAMPLING_H
@@ -0,0 +1,214 @@
+#include "SeedRegionGrower.h"
+#include "RegionGrowing.h"
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+namespace {
+
+using ImageKernels::BitMask;
+using ImageKernels::RegionBounds;
+using ImageKernels::RegionGrowingCriteria;
+using MedicalImaging::dispatchVoxelType;
+using MedicalImaging::makeVoxelView;
+
+struct RegionResult {
+    vtkSmartPointer<vtkImageData> mask;
+    qint64 voxelCount = -1;
+};
+
+// 掩膜的范围取bounds对应的输入子范围，与输入在世界坐标中对齐
+vtkSmartPointer<vtkImageData> createMask(vtkImageData* input, const RegionBounds& bounds) {
+    int extent[6];
+    input->GetExtent(extent);
+    auto mask = vtkSmartPointer<vtkImageData>::New();
+    mask->SetExtent(extent[0] + bounds.min[0], extent[0] + bounds.max[0],
+                    extent[2] + bounds.min[1], extent[2] + bounds.max[1],
+                    extent[4] + bounds.min[2], extent[4] + bounds.max[2]);
+    mask->SetSpacing(input->GetSpacing());
+    mask->SetOrigin(input->GetOrigin());
+    mask->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    return mask;
+}
+
+RegionResult growMask(vtkImageData* input, const int seed[3], const RegionBounds& bounds,
+                      const RegionGrowingCriteria& criteria, const std::atomic<bool>* cancelled) {
+    RegionResult result;
+    BitMask region;
+    long long count = -1;
+    const bool dispatched = dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        count = ImageKernels::growRegion(makeVoxelView<const T>(input), seed, bounds, criteria, region, cancelled);
+    });
+    if (!dispatched || count < 0) {
+        return result;
+    }
+
+    result.mask = createMask(input, bounds);
+    ImageKernels::expandBitMask(region, bounds, makeVoxelView<unsigned char>(result.mask));
+    result.voxelCount = count;
+    return result;
+}
+
+} // namespace
+
+class SeedRegionGrower::SeedRegionGrowerPrivate : public QObject {
+    Q_OBJECT // 添加 Q_OBJECT 宏以启用信号和槽机制
+
+public:
+    typedef QFutureWatcher<RegionResult> ResultWatcher;
+
+    vtkSmartPointer<vtkImageData> input;
+    SeedRegionGrower::Criterion criterion = SeedRegionGrower::IntensityRange;
+    RegionGrowingCriteria criteria;
+    int previewAxis = 2;
+
+    ResultWatcher watcher;
+    std::shared_ptr<std::atomic<bool>> cancelFlag;
+    quint64 generation = 0;
+    quint64 jobGeneration = 0;
+
+    vtkSmartPointer<vtkImageData> preview;
+    vtkSmartPointer<vtkImageData> region;
+
+    void cancelRunningJob() {
+        if (cancelFlag) {
+            cancelFlag->store(true);
+        }
+        ++generation;
+    }
+};
+
+SeedRegionGrower::SeedRegionGrower(QObject *parent)
+    : QObject(parent)
+    , d_ptr(std::make_unique<SeedRegionGrowerPrivate>())
+{
+    Q_D(SeedRegionGrower);
+    d->criteria.lower = 0.0;
+    d->criteria.upper = 255.0;
+
+    connect(&d->watcher, &SeedRegionGrowerPrivate::ResultWatcher::finished, this, [this]() {
+        Q_D(SeedRegionGrower);
+        const RegionResult result = d->watcher.result();
+        // 期间已有新种子或被取消时丢弃
+        if (result.mask && d->jobGeneration == d->generation) {
+            d->region = result.mask;
+            emit regionReady(result.mask, result.voxelCount);
+        }
+    });
+}
+
+SeedRegionGrower::~SeedRegionGrower() {
+    Q_D(SeedRegionGrower);
+    d->cancelRunningJob();
+    d->watcher.waitForFinished();
+}
+
+void SeedRegionGrower::setInputImage(vtkImageData* image) {
+    Q_D(SeedRegionGrower);
+    if (d->input == image) {
+        return;
+    }
+    d->cancelRunningJob();
+    d->input = image;
+    d->preview = nullptr;
+    d->region = nullptr;
+}
+
+vtkImageData* SeedRegionGrower::getInputImage() const {
+    Q_D(const SeedRegionGrower);
+    return d->input;
+}
+
+void SeedRegionGrower::setCriterion(Criterion criterion) {
+    Q_D(SeedRegionGrower);
+    d->criterion = criterion;
+}
+
+SeedRegionGrower::Criterion SeedRegionGrower::getCriterion() const {
+    Q_D(const SeedRegionGrower);
+    return d->criterion;
+}
+
+void SeedRegionGrower::setIntensityRange(double lower, double upper) {
+    Q_D(SeedRegionGrower);
+    d->criteria.lower = std::min(lower, upper);
+    d->criteria.upper = std::max(lower, upper);
+}
+
+void SeedRegionGrower::setConfidenceParameters(double multiplier, int iterations, int radius) {
+    Q_D(SeedRegionGrower);
+    d->criteria.multiplier = multiplier;
+    d->criteria.iterations = std::max(0, iterations);
+    d->criteria.radius = std::max(0, radius);
+}
+
+void SeedRegionGrower::setPreviewAxis(int axis) {
+    Q_D(SeedRegionGrower);
+    d->previewAxis = std::max(0, std::min(2, axis));
+}
+
+int SeedRegionGrower::getPreviewAxis() const {
+    Q_D(const SeedRegionGrower);
+    return d->previewAxis;
+}
+
+vtkImageData* SeedRegionGrower::getRegion() const {
+    Q_D(const SeedRegionGrower);
+    return d->region;
+}
+
+bool SeedRegionGrower::isBusy() const {
+    Q_D(const SeedRegionGrower);
+    return d->watcher.isRunning();
+}
+
+void SeedRegionGrower::growFromSeed(int x, int y, int z) {
+    Q_D(SeedRegionGrower);
+    if (!d->input) {
+        return;
+    }
+    int dims[3];
+    d->input->GetDimensions(dims);
+    const std::array<int, 3> seed = {x, y, z};
+    const RegionBounds volume = RegionBounds::whole(dims);
+    if (!volume.contains(x, y, z)) {
+        return;
+    }
+
+    d->cancelRunningJob();
+    emit growingStarted();
+
+    RegionGrowingCriteria criteria = d->criteria;
+    criteria.confidence = d->criterion == Confidence;
+
+    // 可见切片上的二维生长规模很小，在主线程同步完成
+    const int axis = d->previewAxis;
+    RegionBounds slice = volume;
+    slice.min[axis] = seed[axis];
+    slice.max[axis] = seed[axis];
+    const RegionResult preview = growMask(d->input, seed.data(), slice, criteria, nullptr);
+    if (preview.mask) {
+        d->preview = preview.mask;
+        emit slicePreviewReady(preview.mask, axis, seed[axis]);
+    }
+
+    auto cancelFlag = std::make_shared<std::atomic<bool>>(false);
+    d->cancelFlag = cancelFlag;
+    d->jobGeneration = d->generation;
+    vtkSmartPointer<vtkImageData> input = d->input;
+    d->watcher.setFuture(QtConcurrent::run([input, seed, volume, criteria, cancelFlag]() {
+        return growMask(input, seed.data(), volume, criteria, cancelFlag.get());
+    }));
+}
+
+void SeedRegionGrower::cancel() {
+    Q_D(SeedRegionGrower);
+    d->cancelRunningJob();
+}
+
+#include "SeedRegionGrower.moc"
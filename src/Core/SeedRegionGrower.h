@@ -0,0 +1,60 @@
+#ifndef SEEDREGIONGROWER_H
+#define SEEDREGIONGROWER_H
+
+#include <QObject>
+#include <memory>
+
+// VTK前向声明
+class vtkImageData;
+
+/**
+ * @brief 视口点击驱动的交互式种子区域生长
+ *
+ * 收到种子后先在当前可见切片上同步生长并立即交付二维预览(slicePreviewReady)，
+ * 随后在后台线程中完成三维生长(regionReady)。新的种子会取消进行中的三维计算。
+ *
+ * 典型连接方式：ViewportWidget::seedPointSelected → growFromSeed。
+ */
+class SeedRegionGrower : public QObject {
+    Q_OBJECT
+
+public:
+    enum Criterion {
+        IntensityRange,  // 固定强度区间
+        Confidence       // 均值±倍数×标准差，迭代更新
+    };
+
+    explicit SeedRegionGrower(QObject *parent = nullptr);
+    ~SeedRegionGrower();
+
+    // 输入与判据
+    void setInputImage(vtkImageData* image);
+    vtkImageData* getInputImage() const;
+    void setCriterion(Criterion criterion);
+    Criterion getCriterion() const;
+    void setIntensityRange(double lower, double upper);
+    void setConfidenceParameters(double multiplier, int iterations, int radius);
+
+    // 预览切片的法向轴(0=x, 1=y, 2=z)，应与发出种子的视口方向一致
+    void setPreviewAxis(int axis);
+    int getPreviewAxis() const;
+
+    vtkImageData* getRegion() const;
+    bool isBusy() const;
+
+public slots:
+    void growFromSeed(int x, int y, int z);
+    void cancel();
+
+signals:
+    void growingStarted();
+    void slicePreviewReady(vtkImageData* sliceMask, int axis, int slice);
+    void regionReady(vtkImageData* mask, qint64 voxelCount);
+
+private:
+    class SeedRegionGrowerPrivate;
+    std::unique_ptr<SeedRegionGrowerPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(SeedRegionGrower)
+};
+
+#endif // SEEDREGIONGROWER_H
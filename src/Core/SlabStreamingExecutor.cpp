@@ -0,0 +1,352 @@
+#include "SlabStreamingExecutor.h"
+#include "ImageKernels.h"
+#include "Config.h"
+#include "Logger.h"
+#include <QAtomicInt>
+#include <QFile>
+#include <QFuture>
+#include <QtConcurrent/QtConcurrentRun>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+using MedicalImaging::VoxelView;
+using MedicalImaging::dispatchVoxelType;
+using MedicalImaging::makeVoxelView;
+
+typedef SlabStreamingExecutor::VolumeLayout VolumeLayout;
+
+const qint64 PageSize = 4096;
+
+class GaussianSlabOperation : public SlabOperation {
+public:
+    explicit GaussianSlabOperation(double sigma) : sigma(sigma) {}
+
+    QString name() const override { return "GaussianSmoothing"; }
+
+    int haloSlices() const override {
+        return static_cast<int>(ImageKernels::gaussianKernel1D(sigma).size()) / 2;
+    }
+
+    // 两个float乒乓缓冲区，分量依次处理
+    qint64 scratchBytesPerSlice(qint64 voxelsPerSlice) const override {
+        return 2 * voxelsPerSlice * static_cast<qint64>(sizeof(float));
+    }
+
+    bool process(vtkImageData* input, int coreOffset, vtkImageData* output) const override {
+        const double sigmas[3] = {sigma, sigma, sigma};
+        return dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+            using T = typename decltype(tag)::type;
+            const VoxelView<const T> in = makeVoxelView<const T>(input);
+            const VoxelView<T> out = makeVoxelView<T>(output);
+            for (int c = 0; c < in.components; ++c) {
+                ImageKernels::separableGaussian<T, T>(in.component(c), out.component(c), sigmas, coreOffset);
+            }
+        });
+    }
+
+private:
+    double sigma;
+};
+
+class ThresholdSlabOperation : public SlabOperation {
+public:
+    ThresholdSlabOperation(double lower, double upper) : lower(lower), upper(upper) {}
+
+    QString name() const override { return "Threshold"; }
+    int haloSlices() const override { return 0; }
+    int outputScalarType(int) const override { return VTK_UNSIGNED_CHAR; }
+    int outputComponents(int) const override { return 1; }
+
+    bool process(vtkImageData* input, int, vtkImageData* output) const override {
+        return dispatchVoxelType(input->GetScalarType(), [&](auto tag) {
+            using T = typename decltype(tag)::type;
+            ImageKernels::binaryThreshold(makeVoxelView<const T>(input), makeVoxelView<unsigned char>(output),
+                                          lower, upper);
+        });
+    }
+
+private:
+    double lower;
+    double upper;
+};
+
+struct InputSlab {
+    std::shared_ptr<QFile> file; // 关闭文件时解除映射
+    vtkSmartPointer<vtkImageData> image;
+    int coreOffset = 0;
+    QString error;
+};
+
+/**
+ * @brief 映射[first - halo, first + count + halo)层并在后台线程中预取
+ *
+ * 每个分块使用独立的QFile，映射随分块对象释放，不与其他线程共享文件对象。
+ */
+InputSlab mapInputSlab(const QString& path, const VolumeLayout& layout, int first, int count, int halo) {
+    InputSlab slab;
+    const int begin = std::max(0, first - halo);
+    const int end = std::min(layout.dimensions[2], first + count + halo);
+    slab.coreOffset = first - begin;
+
+    slab.file = std::make_shared<QFile>(path);
+    if (!slab.file->open(QIODevice::ReadOnly)) {
+        slab.error = QString("无法打开输入文件: %1").arg(slab.file->errorString());
+        return slab;
+    }
+    const qint64 bytes = (end - begin) * layout.sliceBytes();
+    uchar* data = slab.file->map(layout.headerBytes + begin * layout.sliceBytes(), bytes);
+    if (!data) {
+        slab.error = QString("无法映射输入分块: %1").arg(slab.file->errorString());
+        return slab;
+    }
+
+    // 逐页访问一次，使缺页读盘发生在I/O线程而非计算线程
+    volatile uchar sink = 0;
+    for (qint64 offset = 0; offset < bytes; offset += PageSize) {
+        sink ^= data[offset];
+    }
+
+    vtkSmartPointer<vtkDataArray> scalars =
+        vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(layout.scalarType));
+    scalars->SetNumberOfComponents(layout.components);
+    // 映射为只读，操作只通过const视图访问；save=1表示不由数组释放
+    scalars->SetVoidArray(data, (end - begin) * layout.voxelsPerSlice() * layout.components, 1);
+
+    slab.image = vtkSmartPointer<vtkImageData>::New();
+    slab.image->SetDimensions(layout.dimensions[0], layout.dimensions[1], end - begin);
+    slab.image->SetSpacing(layout.spacing[0], layout.spacing[1], layout.spacing[2]);
+    slab.image->SetOrigin(layout.origin[0], layout.origin[1], layout.origin[2] + begin * layout.spacing[2]);
+    slab.image->GetPointData()->SetScalars(scalars);
+    return slab;
+}
+
+vtkSmartPointer<vtkImageData> createOutputSlab(const VolumeLayout& layout, int first, int count) {
+    auto slab = vtkSmartPointer<vtkImageData>::New();
+    slab->SetDimensions(layout.dimensions[0], layout.dimensions[1], count);
+    slab->SetSpacing(layout.spacing[0], layout.spacing[1], layout.spacing[2]);
+    slab->SetOrigin(layout.origin[0], layout.origin[1], layout.origin[2] + first * layout.spacing[2]);
+    slab->AllocateScalars(layout.scalarType, layout.components);
+    return slab;
+}
+
+bool writeSlab(QFile* file, qint64 offset, vtkSmartPointer<vtkImageData> slab, qint64 bytes) {
+    if (!file->seek(offset)) {
+        return false;
+    }
+    const char* data = static_cast<const char*>(slab->GetScalarPointer());
+    qint64 written = 0;
+    while (written < bytes) {
+        const qint64 n = file->write(data + written, bytes - written);
+        if (n <= 0) {
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+} // namespace
+
+qint64 SlabStreamingExecutor::VolumeLayout::voxelsPerSlice() const {
+    return static_cast<qint64>(dimensions[0]) * dimensions[1];
+}
+
+qint64 SlabStreamingExecutor::VolumeLayout::sliceBytes() const {
+    const int scalarSize = vtkDataArray::GetDataTypeSize(scalarType);
+    return voxelsPerSlice() * components * scalarSize;
+}
+
+qint64 SlabStreamingExecutor::VolumeLayout::dataBytes() const {
+    return sliceBytes() * dimensions[2];
+}
+
+bool SlabStreamingExecutor::VolumeLayout::isValid() const {
+    return dimensions[0] > 0 && dimensions[1] > 0 && dimensions[2] > 0 && components > 0
+        && headerBytes >= 0 && MedicalImaging::isDispatchableVoxelType(scalarType);
+}
+
+std::shared_ptr<SlabOperation> SlabOperation::gaussianSmoothing(double sigma) {
+    return std::make_shared<GaussianSlabOperation>(sigma);
+}
+
+std::shared_ptr<SlabOperation> SlabOperation::threshold(double lowerThreshold, double upperThreshold) {
+    return std::make_shared<ThresholdSlabOperation>(lowerThreshold, upperThreshold);
+}
+
+class SlabStreamingExecutor::SlabStreamingExecutorPrivate : public QObject {
+    Q_OBJECT // 添加 Q_OBJECT 宏以启用信号和槽机制
+
+public:
+    qint64 memoryBudget = 0;
+    int slabSlices = 0;
+    QAtomicInt cancelled;
+    QString lastError;
+};
+
+SlabStreamingExecutor::SlabStreamingExecutor(QObject *parent)
+    : QObject(parent)
+    , d_ptr(std::make_unique<SlabStreamingExecutorPrivate>())
+{
+    Q_D(SlabStreamingExecutor);
+    const auto settings = MedicalImaging::Config::getInstance().getImageProcessingSettings();
+    d->memoryBudget = static_cast<qint64>(settings.streamingMemoryBudgetMB) * 1024 * 1024;
+}
+
+SlabStreamingExecutor::~SlabStreamingExecutor() = default;
+
+void SlabStreamingExecutor::setMemoryBudget(qint64 bytes) {
+    Q_D(SlabStreamingExecutor);
+    d->memoryBudget = std::max<qint64>(0, bytes);
+}
+
+qint64 SlabStreamingExecutor::memoryBudget() const {
+    Q_D(const SlabStreamingExecutor);
+    return d->memoryBudget;
+}
+
+void SlabStreamingExecutor::setSlabSlices(int slices) {
+    Q_D(SlabStreamingExecutor);
+    d->slabSlices = std::max(0, slices);
+}
+
+int SlabStreamingExecutor::slabSlices() const {
+    Q_D(const SlabStreamingExecutor);
+    return d->slabSlices;
+}
+
+SlabStreamingExecutor::VolumeLayout SlabStreamingExecutor::outputLayout(const VolumeLayout& input,
+                                                                        const SlabOperation& operation) const {
+    VolumeLayout layout = input;
+    layout.scalarType = operation.outputScalarType(input.scalarType);
+    layout.components = operation.outputComponents(input.components);
+    layout.headerBytes = 0;
+    return layout;
+}
+
+int SlabStreamingExecutor::plannedSlabSlices(const VolumeLayout& input, const SlabOperation& operation) const {
+    Q_D(const SlabStreamingExecutor);
+    const int depth = input.dimensions[2];
+    if (d->slabSlices > 0) {
+        return std::min(d->slabSlices, depth);
+    }
+
+    // 同时驻留：当前与预取中的两个输入分块(含halo)、计算中与写出中的两个输出分块，以及操作的临时内存
+    const VolumeLayout output = outputLayout(input, operation);
+    const qint64 halo = std::max(0, operation.haloSlices());
+    const qint64 scratch = operation.scratchBytesPerSlice(input.voxelsPerSlice());
+    const qint64 perCoreSlice = 2 * input.sliceBytes() + 2 * output.sliceBytes() + scratch;
+    const qint64 perHaloSlice = 2 * input.sliceBytes() + scratch;
+    const qint64 available = d->memoryBudget - 2 * halo * perHaloSlice;
+    if (perCoreSlice <= 0 || available < perCoreSlice) {
+        return 1;
+    }
+    return static_cast<int>(std::min<qint64>(depth, available / perCoreSlice));
+}
+
+bool SlabStreamingExecutor::execute(const QString& inputPath, const VolumeLayout& layout,
+                                    const QString& outputPath, const SlabOperation& operation) {
+    Q_D(SlabStreamingExecutor);
+    d->cancelled = 0;
+    d->lastError.clear();
+
+    auto fail = [d](const QString& message) {
+        d->lastError = message;
+        LOG_ERROR(QString("分块流式处理失败: %1").arg(message));
+        return false;
+    };
+
+    if (!layout.isValid()) {
+        return fail("体数据布局无效或体素类型不受支持");
+    }
+    if (QFile(inputPath).size() < layout.headerBytes + layout.dataBytes()) {
+        return fail(QString("输入文件小于声明的体数据大小: %1").arg(inputPath));
+    }
+
+    const VolumeLayout outLayout = outputLayout(layout, operation);
+    QFile output(outputPath);
+    if (!output.open(QIODevice::ReadWrite | QIODevice::Truncate) || !output.resize(outLayout.dataBytes())) {
+        return fail(QString("无法创建输出文件: %1").arg(output.errorString()));
+    }
+
+    const int depth = layout.dimensions[2];
+    const int halo = std::max(0, operation.haloSlices());
+    const int slabSize = plannedSlabSlices(layout, operation);
+    const int slabCount = (depth + slabSize - 1) / slabSize;
+    LOG_INFO(QString("分块流式处理 %1: %2层/块，共%3块，halo %4层")
+                 .arg(operation.name()).arg(slabSize).arg(slabCount).arg(halo));
+
+    auto readSlab = [&inputPath, layout, halo, slabSize, depth](int index) {
+        const int first = index * slabSize;
+        return mapInputSlab(inputPath, layout, first, std::min(slabSize, depth - first), halo);
+    };
+
+    QFuture<InputSlab> pendingRead = QtConcurrent::run([readSlab]() { return readSlab(0); });
+    QFuture<bool> pendingWrite;
+    bool writeInFlight = false;
+    bool succeeded = true;
+
+    for (int index = 0; index < slabCount; ++index) {
+        const InputSlab current = pendingRead.result();
+        if (!current.image) {
+            succeeded = fail(current.error);
+            break;
+        }
+        if (index + 1 < slabCount) {
+            pendingRead = QtConcurrent::run([readSlab, index]() { return readSlab(index + 1); });
+        }
+
+        const int first = index * slabSize;
+        const int count = std::min(slabSize, depth - first);
+        vtkSmartPointer<vtkImageData> outputSlab = createOutputSlab(outLayout, first, count);
+        if (!operation.process(current.image, current.coreOffset, outputSlab)) {
+            succeeded = fail(QString("操作%1处理第%2层起的分块失败").arg(operation.name()).arg(first));
+            break;
+        }
+
+        // 同一时刻只有一个写任务使用输出文件
+        if (writeInFlight && !pendingWrite.result()) {
+            writeInFlight = false;
+            succeeded = fail(QString("写入输出文件失败: %1").arg(output.errorString()));
+            break;
+        }
+        const qint64 offset = first * outLayout.sliceBytes();
+        const qint64 bytes = count * outLayout.sliceBytes();
+        pendingWrite = QtConcurrent::run([&output, offset, outputSlab, bytes]() {
+            return writeSlab(&output, offset, outputSlab, bytes);
+        });
+        writeInFlight = true;
+
+        emit slabFinished(first, count);
+        emit progressChanged(static_cast<int>(100LL * (first + count) / depth));
+
+        if (d->cancelled.loadAcquire()) {
+            succeeded = fail("已取消");
+            break;
+        }
+    }
+
+    pendingRead.waitForFinished();
+    if (writeInFlight && !pendingWrite.result() && succeeded) {
+        succeeded = fail(QString("写入输出文件失败: %1").arg(output.errorString()));
+    }
+    output.close();
+    return succeeded;
+}
+
+QString SlabStreamingExecutor::lastError() const {
+    Q_D(const SlabStreamingExecutor);
+    return d->lastError;
+}
+
+void SlabStreamingExecutor::cancel() {
+    Q_D(SlabStreamingExecutor);
+    d->cancelled.storeRelease(1);
+}
+
+#include "SlabStreamingExecutor.moc"
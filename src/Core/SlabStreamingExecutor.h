@@ -0,0 +1,94 @@
+#ifndef SLABSTREAMINGEXECUTOR_H
+#define SLABSTREAMINGEXECUTOR_H
+
+#include <QObject>
+#include <QString>
+#include <memory>
+
+// VTK前向声明
+class vtkImageData;
+
+/**
+ * @brief 可分块流式执行的处理操作
+ *
+ * 操作声明其沿z方向所需的halo层数；执行器为每个分块读入核心层及上下halo层，
+ * 操作只需写出核心层。体数据边界处halo被截断，与整体处理时的边缘复制一致。
+ */
+class SlabOperation {
+public:
+    virtual ~SlabOperation() = default;
+
+    virtual QString name() const = 0;
+    virtual int haloSlices() const = 0;
+    virtual int outputScalarType(int inputScalarType) const { return inputScalarType; }
+    virtual int outputComponents(int inputComponents) const { return inputComponents; }
+    // 除输入输出分块外，每层切片所需的临时内存(字节)，用于确定分块大小
+    virtual qint64 scratchBytesPerSlice(qint64 voxelsPerSlice) const { return 0; }
+
+    /**
+     * @param input 含halo的输入分块(只读)
+     * @param coreOffset 核心层在input中的起始z
+     * @param output 仅含核心层的输出分块，已分配
+     */
+    virtual bool process(vtkImageData* input, int coreOffset, vtkImageData* output) const = 0;
+
+    static std::shared_ptr<SlabOperation> gaussianSmoothing(double sigma);
+    static std::shared_ptr<SlabOperation> threshold(double lowerThreshold, double upperThreshold);
+};
+
+/**
+ * @brief 超出内存的体数据的分块流式执行器
+ *
+ * 输入为无压缩的原始体数据文件(x最快变化，可带文件头)，按z分块内存映射读取，
+ * 处理后写入同样布局的输出文件。下一分块的映射与预取、上一分块的写出
+ * 均在后台线程中与当前分块的计算重叠进行；常驻内存由内存预算约束。
+ */
+class SlabStreamingExecutor : public QObject {
+    Q_OBJECT
+
+public:
+    struct VolumeLayout {
+        int dimensions[3] = {0, 0, 0};
+        double spacing[3] = {1.0, 1.0, 1.0};
+        double origin[3] = {0.0, 0.0, 0.0};
+        int scalarType = 0;      // VTK标量类型，如VTK_SHORT
+        int components = 1;
+        qint64 headerBytes = 0;  // 体素数据之前的文件头字节数
+
+        qint64 voxelsPerSlice() const;
+        qint64 sliceBytes() const;
+        qint64 dataBytes() const;
+        bool isValid() const;
+    };
+
+    explicit SlabStreamingExecutor(QObject *parent = nullptr);
+    ~SlabStreamingExecutor();
+
+    // 执行参数
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
+    void setSlabSlices(int slices); // 0表示按内存预算自动确定
+    int slabSlices() const;
+
+    VolumeLayout outputLayout(const VolumeLayout& input, const SlabOperation& operation) const;
+    int plannedSlabSlices(const VolumeLayout& input, const SlabOperation& operation) const;
+
+    // 阻塞执行，可在工作线程中调用；失败时lastError()给出原因
+    bool execute(const QString& inputPath, const VolumeLayout& layout,
+                 const QString& outputPath, const SlabOperation& operation);
+    QString lastError() const;
+
+public slots:
+    void cancel();
+
+signals:
+    void progressChanged(int percentage);
+    void slabFinished(int firstSlice, int sliceCount);
+
+private:
+    class SlabStreamingExecutorPrivate;
+    std::unique_ptr<SlabStreamingExecutorPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(SlabStreamingExecutor)
+};
+
+#endif // SLABSTREAMINGEXECUTOR_H
@@ -0,0 +1,434 @@
+#ifndef TRANSFORMMODELS_H
+#define TRANSFORMMODELS_H
+
+#include "RegistrationLevel.h"
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ImageKernels {
+
+/**
+ * @brief 配准变换模型的公共约定
+ *
+ * 变换把固定图像的物理点映射到浮动图像的物理点(与Resampler的方向一致)。
+ * 度量以模板方式调用以下接口，sample为样本序号(供按样本缓存基函数的变换使用)：
+ *   int parameterCount() const;
+ *   void map(vtkIdType sample, const double p[3], double q[3]) const;
+ *   // out[k] += gᵀ · ∂T(p)/∂μk，g为浮动图像在T(p)处的物理梯度(已乘样本权重)
+ *   void accumulateGradient(vtkIdType sample, const double p[3], const double g[3], double* out) const;
+ *   // 样本集变化后调用，按样本缓存数据的变换在此预计算
+ *   void setSamples(const SampleSet& samples);
+ */
+
+/**
+ * @brief 绕固定中心的刚体变换：T(p) = R(p − c) + c + t，R = Rz·Ry·Rx
+ *
+ * 参数依次为绕x、y、z轴的旋转角(弧度)与平移(毫米)。
+ */
+class RigidTransform {
+public:
+    static const int kParameters = 6;
+
+    RigidTransform() {
+        update();
+    }
+
+    int parameterCount() const {
+        return kParameters;
+    }
+
+    void setSamples(const SampleSet&) {}
+
+    void setCenter(const double c[3]) {
+        for (int i = 0; i < 3; ++i) {
+            center[i] = c[i];
+        }
+    }
+
+    const double* getCenter() const {
+        return center;
+    }
+
+    void setParameters(const double* p) {
+        for (int i = 0; i < kParameters; ++i) {
+            parameters[i] = p[i];
+        }
+        update();
+    }
+
+    const double* getParameters() const {
+        return parameters;
+    }
+
+    void map(vtkIdType, const double p[3], double q[3]) const {
+        const double d[3] = {p[0] - center[0], p[1] - center[1], p[2] - center[2]};
+        for (int r = 0; r < 3; ++r) {
+            q[r] = R[r][0] * d[0] + R[r][1] * d[1] + R[r][2] * d[2] + center[r] + parameters[3 + r];
+        }
+    }
+
+    void accumulateGradient(vtkIdType, const double p[3], const double g[3], double* out) const {
+        const double d[3] = {p[0] - center[0], p[1] - center[1], p[2] - center[2]};
+        for (int k = 0; k < 3; ++k) {
+            double sum = 0.0;
+            for (int r = 0; r < 3; ++r) {
+                sum += g[r] * (dR[k][r][0] * d[0] + dR[k][r][1] * d[1] + dR[k][r][2] * d[2]);
+            }
+            out[k] += sum;
+        }
+        out[3] += g[0];
+        out[4] += g[1];
+        out[5] += g[2];
+    }
+
+    // 等价的仿射形式 q = A·p + b
+    void affine(double A[3][3], double b[3]) const {
+        for (int r = 0; r < 3; ++r) {
+            b[r] = center[r] + parameters[3 + r];
+            for (int c = 0; c < 3; ++c) {
+                A[r][c] = R[r][c];
+                b[r] -= R[r][c] * center[c];
+            }
+        }
+    }
+
+private:
+    void update() {
+        const double cx = std::cos(parameters[0]), sx = std::sin(parameters[0]);
+        const double cy = std::cos(parameters[1]), sy = std::sin(parameters[1]);
+        const double cz = std::cos(parameters[2]), sz = std::sin(parameters[2]);
+        const double Rx[3][3] = {{1, 0, 0}, {0, cx, -sx}, {0, sx, cx}};
+        const double Ry[3][3] = {{cy, 0, sy}, {0, 1, 0}, {-sy, 0, cy}};
+        const double Rz[3][3] = {{cz, -sz, 0}, {sz, cz, 0}, {0, 0, 1}};
+        const double dRx[3][3] = {{0, 0, 0}, {0, -sx, -cx}, {0, cx, -sx}};
+        const double dRy[3][3] = {{-sy, 0, cy}, {0, 0, 0}, {-cy, 0, -sy}};
+        const double dRz[3][3] = {{-sz, -cz, 0}, {cz, -sz, 0}, {0, 0, 0}};
+        multiply3(Rz, Ry, Rx, R);
+        multiply3(Rz, Ry, dRx, dR[0]);
+        multiply3(Rz, dRy, Rx, dR[1]);
+        multiply3(dRz, Ry, Rx, dR[2]);
+    }
+
+    static void multiply3(const double a[3][3], const double b[3][3], const double c[3][3], double out[3][3]) {
+        double ab[3][3];
+        for (int r = 0; r < 3; ++r) {
+            for (int k = 0; k < 3; ++k) {
+                ab[r][k] = a[r][0] * b[0][k] + a[r][1] * b[1][k] + a[r][2] * b[2][k];
+            }
+        }
+        for (int r = 0; r < 3; ++r) {
+            for (int k = 0; k < 3; ++k) {
+                out[r][k] = ab[r][0] * c[0][k] + ab[r][1] * c[1][k] + ab[r][2] * c[2][k];
+            }
+        }
+    }
+
+    double parameters[kParameters] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    double center[3] = {0.0, 0.0, 0.0};
+    double R[3][3];
+    double dR[3][3][3]; // 对三个旋转角的偏导
+};
+
+/**
+ * @brief 绕固定中心的仿射变换：T(p) = A(p − c) + c + t
+ *
+ * 参数依次为按行存储的矩阵A(9个)与平移t(3个，毫米)，初始为恒等变换。
+ * T对参数是线性的，梯度为 ∂T/∂A(r,k) = (p − c)k·e_r、∂T/∂t(r) = e_r。
+ */
+class AffineTransform {
+public:
+    static const int kParameters = 12;
+
+    int parameterCount() const {
+        return kParameters;
+    }
+
+    void setSamples(const SampleSet&) {}
+
+    void setCenter(const double c[3]) {
+        for (int i = 0; i < 3; ++i) {
+            center[i] = c[i];
+        }
+    }
+
+    const double* getCenter() const {
+        return center;
+    }
+
+    void setParameters(const double* p) {
+        for (int i = 0; i < kParameters; ++i) {
+            parameters[i] = p[i];
+        }
+    }
+
+    const double* getParameters() const {
+        return parameters;
+    }
+
+    void map(vtkIdType, const double p[3], double q[3]) const {
+        const double d[3] = {p[0] - center[0], p[1] - center[1], p[2] - center[2]};
+        for (int r = 0; r < 3; ++r) {
+            const double* row = parameters + 3 * r;
+            q[r] = row[0] * d[0] + row[1] * d[1] + row[2] * d[2] + center[r] + parameters[9 + r];
+        }
+    }
+
+    void accumulateGradient(vtkIdType, const double p[3], const double g[3], double* out) const {
+        const double d[3] = {p[0] - center[0], p[1] - center[1], p[2] - center[2]};
+        for (int r = 0; r < 3; ++r) {
+            out[3 * r] += g[r] * d[0];
+            out[3 * r + 1] += g[r] * d[1];
+            out[3 * r + 2] += g[r] * d[2];
+            out[9 + r] += g[r];
+        }
+    }
+
+    void affine(double A[3][3], double b[3]) const {
+        for (int r = 0; r < 3; ++r) {
+            b[r] = center[r] + parameters[9 + r];
+            for (int c = 0; c < 3; ++c) {
+                A[r][c] = parameters[3 * r + c];
+                b[r] -= A[r][c] * center[c];
+            }
+        }
+    }
+
+private:
+    double parameters[kParameters] = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0};
+    double center[3] = {0.0, 0.0, 0.0};
+};
+
+/**
+ * @brief 三次B样条自由形变(FFD)：T(p) = A·p + b + u(p)
+ *
+ * 仿射部分(A, b)固定不优化；位移u由覆盖固定图像范围的均匀控制网格上的
+ * B样条系数给出，参数依次为全部控制点的x、y、z系数。每个轴的控制点数为
+ * 网格段数 + 3，第j个控制点位于 origin + (j − 1)·spacing。
+ * setSamples为每个样本缓存支撑域起点与三个轴各4个基函数权重，
+ * 迭代中的map/accumulateGradient不再重新求权重；内存只与控制点数和样本数成正比。
+ */
+class BSplineTransform {
+public:
+    BSplineTransform() {
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                bulkMatrix[r][c] = r == c ? 1.0 : 0.0;
+            }
+            bulkOffset[r] = 0.0;
+        }
+    }
+
+    // 在物理范围[origin, origin + extent]上布置spans段网格，系数清零
+    void setGrid(const double origin[3], const double extent[3], const int spans[3]) {
+        for (int i = 0; i < 3; ++i) {
+            gridOrigin[i] = origin[i];
+            gridSpans[i] = std::max(1, spans[i]);
+            gridSpacing[i] = extent[i] > 0.0 ? extent[i] / gridSpans[i] : 1.0;
+            nodes[i] = gridSpans[i] + 3;
+        }
+        nodeCount = static_cast<vtkIdType>(nodes[0]) * nodes[1] * nodes[2];
+        coefficients.assign(static_cast<size_t>(3 * nodeCount), 0.0);
+        sampleBase.clear();
+        sampleWeights.clear();
+    }
+
+    void setBulkTransform(const double A[3][3], const double b[3]) {
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c) {
+                bulkMatrix[r][c] = A[r][c];
+            }
+            bulkOffset[r] = b[r];
+        }
+    }
+
+    const int* getGridSpans() const {
+        return gridSpans;
+    }
+
+    const double* getGridSpacing() const {
+        return gridSpacing;
+    }
+
+    int parameterCount() const {
+        return static_cast<int>(3 * nodeCount);
+    }
+
+    void setParameters(const double* p) {
+        std::copy(p, p + coefficients.size(), coefficients.begin());
+    }
+
+    const std::vector<double>& getParameters() const {
+        return coefficients;
+    }
+
+    void setSamples(const SampleSet& samples) {
+        const vtkIdType count = samples.size();
+        sampleBase.resize(static_cast<size_t>(count));
+        sampleWeights.resize(static_cast<size_t>(count) * 12);
+        vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType i = begin; i < end; ++i) {
+                double p[3];
+                samples.point(i, p);
+                sampleBase[i] = support(p, &sampleWeights[12 * i]);
+            }
+        });
+    }
+
+    void map(vtkIdType sample, const double p[3], double q[3]) const {
+        applyBulk(p, q);
+        const vtkIdType base = sampleBase[sample];
+        if (base >= 0) {
+            addDisplacement(base, &sampleWeights[12 * sample], q);
+        }
+    }
+
+    void accumulateGradient(vtkIdType sample, const double*, const double g[3], double* out) const {
+        const vtkIdType base = sampleBase[sample];
+        if (base < 0) {
+            return;
+        }
+        const float* w = &sampleWeights[12 * sample];
+        const vtkIdType sliceStride = static_cast<vtkIdType>(nodes[0]) * nodes[1];
+        for (int k = 0; k < 4; ++k) {
+            for (int j = 0; j < 4; ++j) {
+                const double wyz = static_cast<double>(w[8 + k]) * w[4 + j];
+                double* node = out + base + k * sliceStride + j * nodes[0];
+                for (int i = 0; i < 4; ++i) {
+                    const double weight = wyz * w[i];
+                    node[i] += g[0] * weight;
+                    node[nodeCount + i] += g[1] * weight;
+                    node[2 * nodeCount + i] += g[2] * weight;
+                }
+            }
+        }
+    }
+
+    // 不经样本缓存映射任意点(用于生成结果位移场)
+    void transformPoint(const double p[3], double q[3]) const {
+        applyBulk(p, q);
+        float w[12];
+        const vtkIdType base = support(p, w);
+        if (base >= 0) {
+            addDisplacement(base, w, q);
+        }
+    }
+
+    /**
+     * @brief 网格加密一倍并精确保持当前形变
+     *
+     * 均匀三次B样条的二分细分：β(t) = Σm s_m·β(2t − m)，s = (1, 4, 6, 4, 1)/8，
+     * 粗网格第j个系数贡献给细网格第 2j − 1 + m 个系数，三个轴依次处理。
+     */
+    void refine() {
+        std::vector<double> current = coefficients;
+        int currentNodes[3] = {nodes[0], nodes[1], nodes[2]};
+        for (int axis = 0; axis < 3; ++axis) {
+            int fineNodes[3] = {currentNodes[0], currentNodes[1], currentNodes[2]};
+            fineNodes[axis] = 2 * (currentNodes[axis] - 3) + 3;
+            const vtkIdType fineCount = static_cast<vtkIdType>(fineNodes[0]) * fineNodes[1] * fineNodes[2];
+            const vtkIdType coarseCount = static_cast<vtkIdType>(currentNodes[0]) * currentNodes[1] * currentNodes[2];
+            std::vector<double> fine(static_cast<size_t>(3 * fineCount), 0.0);
+            for (int component = 0; component < 3; ++component) {
+                const double* src = current.data() + component * coarseCount;
+                double* dst = fine.data() + component * fineCount;
+                for (int z = 0; z < fineNodes[2]; ++z) {
+                    for (int y = 0; y < fineNodes[1]; ++y) {
+                        for (int x = 0; x < fineNodes[0]; ++x) {
+                            const int fineIndex[3] = {x, y, z};
+                            const int k = fineIndex[axis];
+                            int coarseIndex[3] = {x, y, z};
+                            double sum = 0.0;
+                            // |k − 2j + 1| ≤ 2
+                            for (int j = (k - 1) / 2; j <= (k + 3) / 2; ++j) {
+                                const int m = k - 2 * j + 1;
+                                if (j < 0 || j >= currentNodes[axis] || m < -2 || m > 2) {
+                                    continue;
+                                }
+                                coarseIndex[axis] = j;
+                                const vtkIdType offset = coarseIndex[0] + static_cast<vtkIdType>(currentNodes[0]) *
+                                    (coarseIndex[1] + static_cast<vtkIdType>(currentNodes[1]) * coarseIndex[2]);
+                                sum += kSubdivision[m + 2] * src[offset];
+                            }
+                            dst[x + static_cast<vtkIdType>(fineNodes[0]) * (y + static_cast<vtkIdType>(fineNodes[1]) * z)] = sum;
+                        }
+                    }
+                }
+            }
+            current.swap(fine);
+            currentNodes[axis] = fineNodes[axis];
+        }
+        for (int i = 0; i < 3; ++i) {
+            gridSpans[i] *= 2;
+            gridSpacing[i] *= 0.5;
+            nodes[i] = currentNodes[i];
+        }
+        nodeCount = static_cast<vtkIdType>(nodes[0]) * nodes[1] * nodes[2];
+        coefficients.swap(current);
+        sampleBase.clear();
+        sampleWeights.clear();
+    }
+
+private:
+    static constexpr double kSubdivision[5] = {0.125, 0.5, 0.75, 0.5, 0.125};
+
+    void applyBulk(const double p[3], double q[3]) const {
+        for (int r = 0; r < 3; ++r) {
+            q[r] = bulkMatrix[r][0] * p[0] + bulkMatrix[r][1] * p[1] + bulkMatrix[r][2] * p[2] + bulkOffset[r];
+        }
+    }
+
+    // 求p的支撑域起点(控制点线性序号)与各轴权重，网格范围外返回−1
+    vtkIdType support(const double p[3], float w[12]) const {
+        int base[3];
+        for (int i = 0; i < 3; ++i) {
+            const double t = (p[i] - gridOrigin[i]) / gridSpacing[i];
+            if (!(t >= 0.0 && t <= gridSpans[i])) {
+                return -1;
+            }
+            base[i] = std::min(static_cast<int>(t), gridSpans[i] - 1);
+            cubicBSplineWeights(static_cast<float>(t - base[i]), w + 4 * i);
+        }
+        return base[0] + static_cast<vtkIdType>(nodes[0]) * (base[1] + static_cast<vtkIdType>(nodes[1]) * base[2]);
+    }
+
+    void addDisplacement(vtkIdType base, const float* w, double q[3]) const {
+        const vtkIdType sliceStride = static_cast<vtkIdType>(nodes[0]) * nodes[1];
+        const double* cx = coefficients.data() + base;
+        const double* cy = cx + nodeCount;
+        const double* cz = cy + nodeCount;
+        double u[3] = {0.0, 0.0, 0.0};
+        for (int k = 0; k < 4; ++k) {
+            for (int j = 0; j < 4; ++j) {
+                const vtkIdType row = k * sliceStride + j * nodes[0];
+                const double wyz = static_cast<double>(w[8 + k]) * w[4 + j];
+                for (int i = 0; i < 4; ++i) {
+                    const double weight = wyz * w[i];
+                    u[0] += weight * cx[row + i];
+                    u[1] += weight * cy[row + i];
+                    u[2] += weight * cz[row + i];
+                }
+            }
+        }
+        q[0] += u[0];
+        q[1] += u[1];
+        q[2] += u[2];
+    }
+
+    double bulkMatrix[3][3];
+    double bulkOffset[3];
+    double gridOrigin[3] = {0.0, 0.0, 0.0};
+    double gridSpacing[3] = {1.0, 1.0, 1.0};
+    int gridSpans[3] = {1, 1, 1};
+    int nodes[3] = {4, 4, 4};
+    vtkIdType nodeCount = 64;
+    std::vector<double> coefficients = std::vector<double>(192, 0.0);
+    std::vector<vtkIdType> sampleBase;  // 每样本支撑域起点，−1表示在网格外
+    std::vector<float> sampleWeights;   // 每样本12个权重：x、y、z轴各4个
+};
+
+} // namespace ImageKernels
+
+#endif // TRANSFORMMODELS_H
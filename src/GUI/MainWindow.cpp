@@ -6,20 +6,42 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QMenuBar>
+#include <QAction>
 #include <QStatusBar>
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QSplitter>
 #include <QCloseEvent>
 
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+#include "DataModel.h"
+#include "ImageStatistics.h"
+#include "ImageProcessor.h"
+#include "IsosurfaceExtractor.h"
+#include "ParameterPanel.h"
+#include "ReprocessingScheduler.h"
+#include "SeedRegionGrower.h"
+#include "VTKUtils_fixed.h"
+#include "ViewportWidget.h"
+
 class MainWindow::MainWindowPrivate {
 public:
     QWidget* centralWidget = nullptr;
     QSplitter* mainSplitter = nullptr;
-    QLabel* imageDisplayLabel = nullptr;
-    QWidget* parameterPanel = nullptr;
+    MedicalImaging::ViewportWidget* viewport = nullptr;
+    QWidget* controlPanel = nullptr;
+    MedicalImaging::ParameterPanel* parameterPanel = nullptr;
     QPushButton* openButton = nullptr;
     QPushButton* processButton = nullptr;
+
+    DataModel* dataModel = nullptr;
+    ImageProcessor* imageProcessor = nullptr;
+    ReprocessingScheduler* reprocessingScheduler = nullptr;
+    SeedRegionGrower* seedRegionGrower = nullptr;
+    IsosurfaceExtractor* isosurfaceExtractor = nullptr;
+    double surfaceThreshold = 0.0; // 阈值控件的下限，三维视图的等值面阈值
 };
 
 MainWindow::MainWindow(QWidget *parent)
@@ -40,28 +62,27 @@ void MainWindow::setupUI() {
     d->centralWidget = new QWidget(this);
     setCentralWidget(d->centralWidget);
 
+    // 数据与处理服务
+    d->dataModel = new DataModel(this);
+    d->imageProcessor = new ImageProcessor(this);
+    d->reprocessingScheduler = new ReprocessingScheduler(d->imageProcessor, this);
+    d->seedRegionGrower = new SeedRegionGrower(this);
+    d->isosurfaceExtractor = new IsosurfaceExtractor(this);
+    d->isosurfaceExtractor->setDataModel(d->dataModel);
+
     // 主分割器
     d->mainSplitter = new QSplitter(Qt::Horizontal, this);
     
     // 图像显示区域
-    d->imageDisplayLabel = new QLabel("请打开医学影像文件", this);
-    d->imageDisplayLabel->setAlignment(Qt::AlignCenter);
-    d->imageDisplayLabel->setStyleSheet(
-        "QLabel { "
-        "background-color: #f0f0f0; "
-        "border: 2px dashed #cccccc; "
-        "font-size: 16px; "
-        "color: #666666; "
-        "}"
-    );
-    d->imageDisplayLabel->setMinimumSize(400, 300);
+    d->viewport = new MedicalImaging::ViewportWidget(MedicalImaging::ViewportWidget::AXIAL, this);
+    d->viewport->setMinimumSize(400, 300);
     
     // 参数控制面板
-    d->parameterPanel = new QWidget(this);
-    d->parameterPanel->setMaximumWidth(300);
-    d->parameterPanel->setStyleSheet("QWidget { background-color: #fafafa; }");
+    d->controlPanel = new QWidget(this);
+    d->controlPanel->setMaximumWidth(300);
+    d->controlPanel->setStyleSheet("QWidget { background-color: #fafafa; }");
     
-    QVBoxLayout* paramLayout = new QVBoxLayout(d->parameterPanel);
+    QVBoxLayout* paramLayout = new QVBoxLayout(d->controlPanel);
     
     QLabel* titleLabel = new QLabel("控制面板", this);
     titleLabel->setStyleSheet("QLabel { font-size: 14px; font-weight: bold; margin: 10px; }");
@@ -92,15 +113,17 @@ void MainWindow::setupUI() {
         "QPushButton:hover { background-color: #1976D2; }"
     );
     d->processButton->setEnabled(false);
+
+    d->parameterPanel = new MedicalImaging::ParameterPanel(this);
     
     paramLayout->addWidget(titleLabel);
     paramLayout->addWidget(d->openButton);
     paramLayout->addWidget(d->processButton);
-    paramLayout->addStretch();
+    paramLayout->addWidget(d->parameterPanel, 1);
     
     // 添加到分割器
-    d->mainSplitter->addWidget(d->imageDisplayLabel);
-    d->mainSplitter->addWidget(d->parameterPanel);
+    d->mainSplitter->addWidget(d->viewport);
+    d->mainSplitter->addWidget(d->controlPanel);
     d->mainSplitter->setStretchFactor(0, 1);
     d->mainSplitter->setStretchFactor(1, 0);
     
@@ -113,6 +136,7 @@ void MainWindow::setupUI() {
 }
 
 void MainWindow::setupMenuBar() {
+    Q_D(MainWindow);
     // 文件菜单
     QMenu* fileMenu = menuBar()->addMenu(tr("文件(&F)"));
     fileMenu->addAction(tr("打开(&O)"), this, &MainWindow::openFile, 
@@ -131,6 +155,11 @@ void MainWindow::setupMenuBar() {
                        QKeySequence(Qt::CTRL | Qt::Key_R));
     editMenu->addAction(tr("重置参数(&P)"), this, &MainWindow::resetParameters, 
                        QKeySequence(Qt::CTRL | Qt::Key_P));
+    editMenu->addSeparator();
+    // 勾选后在视口中左键点击选择区域生长的种子
+    QAction* seedAction = editMenu->addAction(tr("区域生长(&G)"));
+    seedAction->setCheckable(true);
+    connect(seedAction, &QAction::toggled, d->viewport, &MedicalImaging::ViewportWidget::setSeedSelectionEnabled);
 
     // 帮助菜单
     QMenu* helpMenu = menuBar()->addMenu(tr("帮助(&H)"));
@@ -147,8 +176,77 @@ void MainWindow::setupStatusBar() {
 void MainWindow::setupConnections() {
     Q_D(MainWindow);
     connect(d->openButton, &QPushButton::clicked, this, &MainWindow::openFile);
-    connect(d->processButton, &QPushButton::clicked, [this]() {
-        QMessageBox::information(this, "处理图像", "图像处理功能开发中...");
+    connect(d->dataModel, &DataModel::imageDataChanged, this, &MainWindow::onImageDataChanged);
+    connect(d->dataModel, &DataModel::metaDataChanged, this, &MainWindow::onMetaDataChanged);
+    // 统计在后台完成后：阈值控件取图像的强度范围，窗宽窗位取0.5%~99.5%百分位区间
+    connect(d->dataModel, &DataModel::statisticsChanged, this, [this]() {
+        Q_D(MainWindow);
+        std::shared_ptr<const MedicalImaging::ImageStatistics> statistics = d->dataModel->getStatistics();
+        if (!statistics) {
+            return;
+        }
+        d->parameterPanel->setThresholdRange(*statistics);
+        double window = 0.0;
+        double level = 0.0;
+        statistics->windowLevel(window, level);
+        d->viewport->setWindowLevel(window, level);
+        d->parameterPanel->setWindowLevel(window, level);
+    });
+
+    // 参数面板的连续调整交给重处理调度器：拖动时交付代理体预览，停止后交付全分辨率结果
+    ReprocessingScheduler* scheduler = d->reprocessingScheduler;
+    connect(d->parameterPanel, &MedicalImaging::ParameterPanel::sigmaChanged, scheduler, &ReprocessingScheduler::onSigmaChanged);
+    connect(d->parameterPanel, &MedicalImaging::ParameterPanel::kernelSizeChanged, scheduler, &ReprocessingScheduler::onKernelSizeChanged);
+    connect(d->parameterPanel, &MedicalImaging::ParameterPanel::thresholdChanged, scheduler, &ReprocessingScheduler::onThresholdChanged);
+    connect(d->parameterPanel, &MedicalImaging::ParameterPanel::filterTypeChanged, scheduler, &ReprocessingScheduler::onFilterTypeChanged);
+    connect(d->parameterPanel, &MedicalImaging::ParameterPanel::sharpenFilterRequested, scheduler, &ReprocessingScheduler::onSharpenRequested);
+    connect(d->processButton, &QPushButton::clicked, scheduler, &ReprocessingScheduler::requestReprocess);
+    connect(scheduler, &ReprocessingScheduler::previewReady, d->viewport, &MedicalImaging::ViewportWidget::setImageData);
+    connect(scheduler, &ReprocessingScheduler::resultReady, this, [this](vtkImageData* result) {
+        Q_D(MainWindow);
+        d->viewport->setImageData(result);
+        statusBar()->showMessage(tr("处理完成"));
+    });
+
+    // 视口点击的种子交给区域生长：预览切片与视口方向一致，强度区间跟随阈值控件
+    SeedRegionGrower* grower = d->seedRegionGrower;
+    connect(d->viewport, &MedicalImaging::ViewportWidget::seedPointSelected, grower, &SeedRegionGrower::growFromSeed);
+    connect(d->parameterPanel, &MedicalImaging::ParameterPanel::thresholdChanged, grower, &SeedRegionGrower::setIntensityRange);
+    connect(d->parameterPanel, &MedicalImaging::ParameterPanel::viewTypeChanged, this, [this](int viewType) {
+        Q_D(MainWindow);
+        d->viewport->setViewType(static_cast<MedicalImaging::ViewportWidget::ViewType>(viewType));
+        if (viewType != MedicalImaging::ViewportWidget::VOLUME_3D) {
+            d->seedRegionGrower->setPreviewAxis(viewType == MedicalImaging::ViewportWidget::AXIAL ? 2
+                                                : (viewType == MedicalImaging::ViewportWidget::CORONAL ? 1 : 0));
+        } else {
+            d->isosurfaceExtractor->requestSurface(d->surfaceThreshold);
+        }
+    });
+    connect(grower, &SeedRegionGrower::slicePreviewReady, d->viewport, [this](vtkImageData* sliceMask, int, int) {
+        Q_D(MainWindow);
+        d->viewport->setSegmentationMask(sliceMask);
+    });
+    connect(grower, &SeedRegionGrower::regionReady, this, [this](vtkImageData* mask, qint64 voxelCount) {
+        Q_D(MainWindow);
+        d->viewport->setSegmentationMask(mask);
+        statusBar()->showMessage(tr("区域生长完成：%1 个体素").arg(voxelCount));
+    });
+
+    // 等值面只在三维视图下随阈值提取；提取器自行监听DataModel的图像变化
+    connect(d->parameterPanel, &MedicalImaging::ParameterPanel::thresholdChanged, this, [this](double lower, double) {
+        Q_D(MainWindow);
+        d->surfaceThreshold = lower;
+        if (d->viewport->getViewType() == MedicalImaging::ViewportWidget::VOLUME_3D) {
+            d->isosurfaceExtractor->requestSurface(lower);
+        }
+    });
+    connect(d->isosurfaceExtractor, &IsosurfaceExtractor::surfaceReady, this, [this](vtkPolyData* surface, double threshold) {
+        Q_D(MainWindow);
+        d->viewport->setSurfaceData(surface);
+        statusBar()->showMessage(tr("等值面 %1：体积 %2，表面积 %3")
+                                     .arg(threshold)
+                                     .arg(d->isosurfaceExtractor->getLastVolume())
+                                     .arg(d->isosurfaceExtractor->getLastSurfaceArea()));
     });
 }
 
@@ -182,11 +280,17 @@ void MainWindow::openFile() {
     
     if (!fileName.isEmpty()) {
         lastDir = QFileInfo(fileName).absolutePath(); // 更新上次打开的目录
-        d->imageDisplayLabel->setText(tr("loaded files:\n%1\n\nnow can to config image").arg(fileName));
+        vtkSmartPointer<vtkImageData> image =
+            vtkSmartPointer<vtkImageData>::Take(MedicalImaging::VTKUtils::loadImageData(fileName));
+        if (!image) {
+            QMessageBox::warning(this, tr("打开文件"), tr("无法读取文件：%1").arg(fileName));
+            return;
+        }
         d->processButton->setEnabled(true);
         statusBar()->showMessage(tr("now:%1").arg(fileName));
         
-        emit onImageDataChanged();
+        // DataModel::imageDataChanged触发onImageDataChanged，由其分发给视口和各服务
+        d->dataModel->setImageData(image);
     }
 }
 
@@ -247,6 +351,14 @@ void MainWindow::showHelp() {
 }
 
 void MainWindow::onImageDataChanged() {
+    Q_D(MainWindow);
+    vtkImageData* image = d->dataModel->getImageData();
+    d->viewport->setImageData(image);
+    d->viewport->setSeedReferenceImage(image); // 拖动参数时显示的是代理体，种子仍按原图像换算
+    d->viewport->clearSurfaceData(); // 旧图像的等值面，新图像的网格在三维视图下重新请求
+    d->viewport->clearSegmentationMask();
+    d->reprocessingScheduler->setInputImage(image);
+    d->seedRegionGrower->setInputImage(image);
     statusBar()->showMessage(tr("image data has been updated"));
     updateUI();
 }
@@ -1,4 +1,5 @@
 ﻿#include "ParameterPanel.h"
+#include "ImageStatistics.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGridLayout>
@@ -733,6 +734,10 @@ void ParameterPanel::setThresholdRange(double minVal, double maxVal) {
     if(d->upperThresholdSpinBox) d->upperThresholdSpinBox->setRange(minVal, maxVal);
 }
 
+void ParameterPanel::setThresholdRange(const ImageStatistics& statistics) {
+    setThresholdRange(statistics.global().minimum, statistics.global().maximum);
+}
+
 void ParameterPanel::setOpacity(double opacity) {
     Q_D(ParameterPanel);
     d->currentOpacity = opacity;
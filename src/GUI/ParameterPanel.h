@@ -28,6 +28,7 @@ class QCheckBox;
 namespace MedicalImaging {
 
 class ParameterPanelPrivate;
+class ImageStatistics;
 
 /**
  * @class ParameterPanel
@@ -102,6 +103,13 @@ public:
      * @details 用于图像分割时设置阈值范围
      */
     void setThresholdRange(double minVal, double maxVal);
+
+    /**
+     * @brief 按图像强度统计设置阈值的取值范围
+     * @param statistics 图像强度统计(见DataModel::getStatistics)
+     * @details 取值范围为数据的实际最小/最大值，不再逐次遍历体数据
+     */
+    void setThresholdRange(const ImageStatistics& statistics);
     void setOpacity(double opacity);
     double getOpacity() const;
     void setColormap(const QString& colormapName);
@@ -9,6 +9,8 @@
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QGroupBox>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 // VTK includes (如果找到VTK库，则包含相关头文件)
@@ -23,7 +25,16 @@
 #include <vtkCamera.h>
 #include <vtkProperty.h>
 #include <vtkInteractorStyleImage.h>
+#include <vtkPropPicker.h>
+#include <vtkSmartPointer.h>
+#include <vtkMatrix4x4.h>
+#include <vtkImageProperty.h>
+#include <vtkActor.h>
+#include <vtkLookupTable.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
 #include <QVTKOpenGLNativeWidget.h>
+#include "RegisteredImageView.h"
 #else
 // 如果未找到VTK库，则使用占位符实现
 class vtkRenderWindow {};
@@ -31,6 +42,8 @@ class vtkRenderWindowInteractor {};
 class vtkRenderer {};
 class vtkImageData {};
 class vtkImageViewer2 {};
+class vtkMatrix4x4 {};
+class vtkPolyData {};
 class QVTKOpenGLNativeWidget : public QWidget {
 public:
     QVTKOpenGLNativeWidget(QWidget* parent = nullptr) : QWidget(parent) {}
@@ -63,6 +76,35 @@ struct ViewportWidget::Impl {
     double windowWidth;
     double windowLevel;
     double currentZoom;
+    bool seedSelectionEnabled = false;
+    vtkImageData* seedReferenceImage = nullptr;
+
+    // 配准预览叠加(固定图像即currentImageData)
+    OverlayMode overlayMode = CheckerboardOverlay;
+    int checkerSize = 16;
+    double blendOpacity = 0.5;
+#ifdef VTK_FOUND
+    vtkSmartPointer<vtkImageData> overlayFixed;
+    vtkSmartPointer<vtkImageData> overlayMoving;
+    vtkSmartPointer<vtkImageActor> overlayActor;
+    // 两侧切片都取自带瓦片缓存的惰性视图：翻回已看过的切片、切换叠加方式时不再重采样
+    std::shared_ptr<RegisteredImageView> overlayFixedView;
+    std::shared_ptr<RegisteredImageView> overlayMovedView;
+
+    // 三维视图的等值面
+    vtkSmartPointer<vtkPolyDataMapper> surfaceMapper;
+    vtkSmartPointer<vtkActor> surfaceActor;
+
+    // 分割掩膜叠加：查找表把0映射为全透明、255映射为不透明的标记色
+    vtkSmartPointer<vtkImageData> segmentationMask;
+    vtkSmartPointer<vtkImageActor> maskActor;
+
+    void setOverlayTransform(vtkMatrix4x4* transform, vtkImageData* displacementField) {
+        overlayMovedView = std::make_shared<RegisteredImageView>(
+            overlayMoving, Resampler::Grid::fromImage(overlayFixed), transform, displacementField);
+        overlayMovedView->setFloatOutput(true);
+    }
+#endif
     
     Impl() : viewType(ViewportWidget::AXIAL),
              vtkWidget(nullptr),
@@ -177,10 +219,248 @@ void ViewportWidget::connectSignals() {
             this, &ViewportWidget::onSliceChanged);
     connect(d->sliceSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
             this, &ViewportWidget::onSliceChanged);
+
+    // 拦截渲染窗口的鼠标事件以换算体素坐标
+    d->vtkWidget->setMouseTracking(true);
+    d->vtkWidget->installEventFilter(this);
+}
+
+bool ViewportWidget::eventFilter(QObject* watched, QEvent* event) {
+    if (watched != d->vtkWidget || !d->currentImageData) {
+        return QWidget::eventFilter(watched, event);
+    }
+
+    if (event->type() == QEvent::MouseMove) {
+        auto* mouseEvent = static_cast<QMouseEvent*>(event);
+        int voxel[3];
+        if (pickVoxel(mouseEvent->pos(), d->currentImageData, voxel)) {
+            double value = 0.0;
+#ifdef VTK_FOUND
+            int extent[6];
+            d->currentImageData->GetExtent(extent);
+            value = d->currentImageData->GetScalarComponentAsDouble(
+                extent[0] + voxel[0], extent[2] + voxel[1], extent[4] + voxel[2], 0);
+#endif
+            // 切片平面内的两个轴随视图方向而定，与pickVoxel的切片法向一致
+            const int sliceAxis = d->viewType == AXIAL ? 2 : (d->viewType == CORONAL ? 1 : 0);
+            const int u = sliceAxis == 0 ? 1 : 0;
+            const int v = sliceAxis == 2 ? 1 : 2;
+            d->positionLabel->setText(QString("位置: (%1, %2) 层: %3 值: %4")
+                                          .arg(voxel[u]).arg(voxel[v]).arg(voxel[sliceAxis]).arg(value));
+            emit mousePositionChanged(voxel[u], voxel[v], value);
+        }
+    } else if (event->type() == QEvent::MouseButtonPress && d->seedSelectionEnabled) {
+        auto* mouseEvent = static_cast<QMouseEvent*>(event);
+        int voxel[3];
+        vtkImageData* reference = d->seedReferenceImage ? d->seedReferenceImage : d->currentImageData;
+        if (mouseEvent->button() == Qt::LeftButton && pickVoxel(mouseEvent->pos(), reference, voxel)) {
+            emit seedPointSelected(voxel[0], voxel[1], voxel[2]);
+            return true;
+        }
+    }
+    return QWidget::eventFilter(watched, event);
+}
+
+/**
+ * @brief 把窗口坐标换算为image的体素索引(相对其范围起点)
+ *
+ * 先拾取显示切片上的物理坐标，再按image的原点与间距换算；image可以与显示的图像网格不同(如显示的是降采样代理体)。
+ */
+bool ViewportWidget::pickVoxel(const QPoint& position, vtkImageData* image, int voxel[3]) const {
+#ifdef VTK_FOUND
+    if (!d->renderer || !d->currentImageData || !image || d->viewType == VOLUME_3D) {
+        return false;
+    }
+    // VTK显示坐标以左下角为原点，且以物理像素计
+    const double ratio = d->vtkWidget->devicePixelRatioF();
+    const double displayX = position.x() * ratio;
+    const double displayY = (d->vtkWidget->height() - position.y() - 1) * ratio;
+
+    vtkSmartPointer<vtkPropPicker> picker = vtkSmartPointer<vtkPropPicker>::New();
+    if (!picker->Pick(displayX, displayY, 0.0, d->renderer)) {
+        return false;
+    }
+    double world[3];
+    picker->GetPickPosition(world);
+    // 切片法向上取当前切片平面的位置，避免拾取位置的数值误差
+    const int sliceAxis = d->viewType == AXIAL ? 2 : (d->viewType == CORONAL ? 1 : 0);
+    world[sliceAxis] = currentSlicePosition();
+
+    const double* origin = image->GetOrigin();
+    const double* spacing = image->GetSpacing();
+    int extent[6];
+    image->GetExtent(extent);
+    for (int i = 0; i < 3; ++i) {
+        voxel[i] = static_cast<int>(std::lround((world[i] - origin[i]) / spacing[i])) - extent[2 * i];
+        if (voxel[i] < 0 || voxel[i] > extent[2 * i + 1] - extent[2 * i]) {
+            return false;
+        }
+    }
+    return true;
+#else
+    Q_UNUSED(position);
+    Q_UNUSED(image);
+    Q_UNUSED(voxel);
+    return false;
+#endif
+}
+
+void ViewportWidget::setSeedSelectionEnabled(bool enabled) {
+    d->seedSelectionEnabled = enabled;
+    d->vtkWidget->setCursor(enabled ? Qt::CrossCursor : Qt::ArrowCursor);
+}
+
+bool ViewportWidget::isSeedSelectionEnabled() const {
+    return d->seedSelectionEnabled;
+}
+
+void ViewportWidget::setSeedReferenceImage(vtkImageData* image) {
+    d->seedReferenceImage = image;
+}
+
+double ViewportWidget::currentSlicePosition() const {
+#ifdef VTK_FOUND
+    if (d->currentImageData) {
+        const int sliceAxis = d->viewType == AXIAL ? 2 : (d->viewType == CORONAL ? 1 : 0);
+        int extent[6];
+        d->currentImageData->GetExtent(extent);
+        return d->currentImageData->GetOrigin()[sliceAxis] +
+               (extent[2 * sliceAxis] + d->currentSlice) * d->currentImageData->GetSpacing()[sliceAxis];
+    }
+#endif
+    return 0.0;
+}
+
+void ViewportWidget::setRegistrationPair(vtkImageData* fixedImage, vtkImageData* movingImage) {
+#ifdef VTK_FOUND
+    d->overlayFixed = fixedImage;
+    d->overlayMoving = movingImage;
+    d->overlayFixedView = nullptr;
+    d->overlayMovedView = nullptr;
+    if (fixedImage && movingImage) {
+        d->overlayFixedView = std::make_shared<RegisteredImageView>(
+            fixedImage, Resampler::Grid::fromImage(fixedImage), nullptr);
+        d->overlayFixedView->setFloatOutput(true);
+        d->setOverlayTransform(nullptr, nullptr);
+    }
+    if (!d->overlayActor && d->renderer) {
+        d->overlayActor = vtkSmartPointer<vtkImageActor>::New();
+        d->overlayActor->SetVisibility(false);
+        d->renderer->AddActor(d->overlayActor);
+    }
+#endif
+    setImageData(fixedImage);
+}
+
+void ViewportWidget::clearRegistrationPair() {
+#ifdef VTK_FOUND
+    d->overlayFixed = nullptr;
+    d->overlayMoving = nullptr;
+    d->overlayFixedView = nullptr;
+    d->overlayMovedView = nullptr;
+    updateRegistrationOverlay();
+    updateDisplay();
+#endif
+}
+
+void ViewportWidget::setRegistrationTransform(vtkMatrix4x4* transform, vtkImageData* displacementField) {
+#ifdef VTK_FOUND
+    if (d->overlayFixed && d->overlayMoving) {
+        d->setOverlayTransform(transform, displacementField);
+    }
+    updateRegistrationOverlay();
+    updateDisplay();
+#else
+    Q_UNUSED(transform);
+    Q_UNUSED(displacementField);
+#endif
+}
+
+void ViewportWidget::setOverlayMode(OverlayMode mode) {
+    d->overlayMode = mode;
+    updateRegistrationOverlay();
+    updateDisplay();
+}
+
+ViewportWidget::OverlayMode ViewportWidget::getOverlayMode() const {
+    return d->overlayMode;
+}
+
+void ViewportWidget::setCheckerSize(int voxels) {
+    d->checkerSize = std::max(1, voxels);
+    updateRegistrationOverlay();
+    updateDisplay();
+}
+
+void ViewportWidget::setBlendOpacity(double opacity) {
+    d->blendOpacity = std::max(0.0, std::min(1.0, opacity));
+    updateRegistrationOverlay();
+    updateDisplay();
+}
+
+/**
+ * @brief 在当前切片上合成固定图像与配准后的浮动图像
+ *
+ * 两侧切片都由RegisteredImageView按当前切片的瓦片重采样：位移场先插值到瓦片所在的层，
+ * 预览的开销与切片面积成正比，与体数据大小无关；已算过的瓦片在变换更新前一直复用。合成结果由独立的图像actor显示，
+ * 叠加期间隐藏原切片。
+ */
+void ViewportWidget::updateRegistrationOverlay() {
+#ifdef VTK_FOUND
+    if (!d->overlayActor || !d->imageViewer) {
+        return;
+    }
+    const bool active = d->overlayMode != NoOverlay && d->overlayFixedView && d->overlayMovedView &&
+                        d->overlayFixed == d->currentImageData && d->viewType != VOLUME_3D;
+    d->imageViewer->GetImageActor()->SetVisibility(!active);
+    d->overlayActor->SetVisibility(active);
+    if (!active) {
+        return;
+    }
+
+    const int sliceAxis = d->viewType == AXIAL ? 2 : (d->viewType == CORONAL ? 1 : 0);
+    vtkSmartPointer<vtkImageData> fixedSlice = d->overlayFixedView->slice(sliceAxis, d->currentSlice);
+    vtkSmartPointer<vtkImageData> movedSlice = d->overlayMovedView->slice(sliceAxis, d->currentSlice);
+    if (!fixedSlice || !movedSlice) {
+        d->overlayActor->SetVisibility(false);
+        d->imageViewer->GetImageActor()->SetVisibility(true);
+        return;
+    }
+
+    // 切片法向的索引恒为0，三个索引按格求和的奇偶即为平面内的棋盘格
+    const float* fixedValues = static_cast<const float*>(fixedSlice->GetScalarPointer());
+    const float* movedValues = static_cast<const float*>(movedSlice->GetScalarPointer());
+    float* out = static_cast<float*>(fixedSlice->GetScalarPointer());
+    const float alpha = static_cast<float>(d->blendOpacity);
+    int dims[3];
+    fixedSlice->GetDimensions(dims);
+    vtkIdType i = 0;
+    for (int z = 0; z < dims[2]; ++z) {
+        for (int y = 0; y < dims[1]; ++y) {
+            for (int x = 0; x < dims[0]; ++x, ++i) {
+                if (d->overlayMode == BlendOverlay) {
+                    out[i] = (1.0f - alpha) * fixedValues[i] + alpha * movedValues[i];
+                } else if ((x / d->checkerSize + y / d->checkerSize + z / d->checkerSize) % 2 != 0) {
+                    out[i] = movedValues[i];
+                }
+            }
+        }
+    }
+    fixedSlice->Modified();
+
+    d->overlayActor->SetInputData(fixedSlice);
+    d->overlayActor->GetProperty()->SetColorWindow(d->imageViewer->GetColorWindow());
+    d->overlayActor->GetProperty()->SetColorLevel(d->imageViewer->GetColorLevel());
+#endif
 }
 
 void ViewportWidget::setImageData(vtkImageData* imageData) {
     d->currentImageData = imageData;
+#ifdef VTK_FOUND
+    if (d->overlayFixed && imageData != d->overlayFixed) {
+        clearRegistrationPair();
+    }
+#endif
     
 #ifdef VTK_FOUND
     if (d->imageViewer && imageData) {
@@ -257,11 +537,124 @@ void ViewportWidget::fitToWindow() {
 
 void ViewportWidget::setViewType(ViewType type) {
     d->viewType = type;
+#ifdef VTK_FOUND
+    if (d->surfaceActor) {
+        d->surfaceActor->SetVisibility(type == VOLUME_3D);
+    }
+#endif
+    updateSegmentationOverlay();
     if (d->currentImageData) {
         setImageData(d->currentImageData); // 重新设置当前图像数据
     }
 }
 
+void ViewportWidget::setSurfaceData(vtkPolyData* surface) {
+#ifdef VTK_FOUND
+    if (!surface) {
+        clearSurfaceData();
+        return;
+    }
+    if (!d->surfaceActor && d->renderer) {
+        d->surfaceMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+        d->surfaceMapper->ScalarVisibilityOff();
+        d->surfaceActor = vtkSmartPointer<vtkActor>::New();
+        d->surfaceActor->SetMapper(d->surfaceMapper);
+        d->surfaceActor->GetProperty()->SetColor(0.9, 0.75, 0.6);
+        d->renderer->AddActor(d->surfaceActor);
+    }
+    if (d->surfaceActor) {
+        d->surfaceMapper->SetInputData(surface);
+        d->surfaceActor->SetVisibility(d->viewType == VOLUME_3D);
+        updateDisplay();
+    }
+#else
+    Q_UNUSED(surface);
+#endif
+}
+
+void ViewportWidget::clearSurfaceData() {
+#ifdef VTK_FOUND
+    if (d->surfaceActor && d->renderer) {
+        d->renderer->RemoveActor(d->surfaceActor);
+        d->surfaceActor = nullptr;
+        d->surfaceMapper = nullptr;
+        updateDisplay();
+    }
+#endif
+}
+
+void ViewportWidget::setSegmentationMask(vtkImageData* mask) {
+#ifdef VTK_FOUND
+    if (!mask) {
+        clearSegmentationMask();
+        return;
+    }
+    if (!d->maskActor && d->renderer) {
+        vtkSmartPointer<vtkLookupTable> lookupTable = vtkSmartPointer<vtkLookupTable>::New();
+        lookupTable->SetNumberOfTableValues(256);
+        lookupTable->SetRange(0.0, 255.0);
+        lookupTable->Build();
+        for (int i = 0; i < 256; ++i) {
+            lookupTable->SetTableValue(i, 1.0, 0.2, 0.2, i == 0 ? 0.0 : 1.0);
+        }
+        d->maskActor = vtkSmartPointer<vtkImageActor>::New();
+        d->maskActor->GetProperty()->SetLookupTable(lookupTable);
+        d->maskActor->GetProperty()->SetUseLookupTableScalarRange(true);
+        // 不透明度小于1时在半透明阶段绘制，与共面的图像切片叠加而不被深度测试挡住
+        d->maskActor->GetProperty()->SetOpacity(0.5);
+        d->maskActor->SetVisibility(false);
+        d->renderer->AddActor(d->maskActor);
+    }
+    d->segmentationMask = mask;
+    if (d->maskActor) {
+        d->maskActor->SetInputData(mask);
+        updateSegmentationOverlay();
+        updateDisplay();
+    }
+#else
+    Q_UNUSED(mask);
+#endif
+}
+
+void ViewportWidget::clearSegmentationMask() {
+#ifdef VTK_FOUND
+    d->segmentationMask = nullptr;
+    if (d->maskActor && d->renderer) {
+        d->renderer->RemoveActor(d->maskActor);
+        d->maskActor = nullptr;
+        updateDisplay();
+    }
+#endif
+}
+
+/**
+ * @brief 把掩膜的显示范围限制在当前切片上
+ *
+ * 当前切片按物理位置换算到掩膜的索引(显示的可能是降采样代理体)，落在掩膜范围之外(或处于三维视图)时隐藏叠加。
+ */
+void ViewportWidget::updateSegmentationOverlay() {
+#ifdef VTK_FOUND
+    if (!d->maskActor) {
+        return;
+    }
+    const int sliceAxis = d->viewType == AXIAL ? 2 : (d->viewType == CORONAL ? 1 : 0);
+    int extent[6];
+    bool visible = d->segmentationMask && d->currentImageData && d->viewType != VOLUME_3D;
+    if (visible) {
+        const int slice = static_cast<int>(std::lround(
+            (currentSlicePosition() - d->segmentationMask->GetOrigin()[sliceAxis]) /
+            d->segmentationMask->GetSpacing()[sliceAxis]));
+        d->segmentationMask->GetExtent(extent);
+        visible = slice >= extent[2 * sliceAxis] && slice <= extent[2 * sliceAxis + 1];
+        extent[2 * sliceAxis] = extent[2 * sliceAxis + 1] = slice;
+    }
+    if (visible) {
+        d->maskActor->SetDisplayExtent(extent[0], extent[1], extent[2], extent[3], extent[4], extent[5]);
+    }
+    d->maskActor->SetVisibility(visible);
+#endif
+}
+
 ViewportWidget::ViewType ViewportWidget::getViewType() const {
     return d->viewType;
 }
@@ -274,6 +667,8 @@ void ViewportWidget::setSlicePosition(int slice) {
 #ifdef VTK_FOUND
     if (d->imageViewer) {
         d->imageViewer->SetSlice(slice);
+        updateRegistrationOverlay();
+        updateSegmentationOverlay();
         updateDisplay();
     }
 #endif
@@ -306,6 +701,10 @@ void ViewportWidget::setWindowLevel(double window, double level) {
     if (d->imageViewer) {
         d->imageViewer->SetColorWindow(window);
         d->imageViewer->SetColorLevel(level);
+        if (d->overlayActor) {
+            d->overlayActor->GetProperty()->SetColorWindow(window);
+            d->overlayActor->GetProperty()->SetColorLevel(level);
+        }
         updateDisplay();
     }
 #endif
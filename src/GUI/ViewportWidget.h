@@ -13,6 +13,8 @@ class vtkRenderWindowInteractor;
 class vtkRenderer;
 class vtkImageData;
 class vtkImageViewer2;
+class vtkMatrix4x4;
+class vtkPolyData;
 class QVTKOpenGLNativeWidget;
 
 namespace MedicalImaging {
@@ -33,6 +35,13 @@ public:
         VOLUME_3D   ///< 3D浣撶Н娓叉煋
     };
 
+    // 配准预览叠加方式
+    enum OverlayMode {
+        NoOverlay,            ///< 只显示固定图像
+        CheckerboardOverlay,  ///< 固定图像与配准后浮动图像交替的棋盘格
+        BlendOverlay          ///< 两者按不透明度混合
+    };
+
     explicit ViewportWidget(ViewType viewType = AXIAL, QWidget* parent = nullptr);
     ~ViewportWidget();
 
@@ -62,21 +71,53 @@ public:
     vtkRenderWindow* getRenderWindow() const;
     vtkRenderer* getRenderer() const;
 
+    // 种子选择：启用后左键单击发出seedPointSelected而不交给VTK交互
+    void setSeedSelectionEnabled(bool enabled);
+    bool isSeedSelectionEnabled() const;
+    // 种子索引的参考图像：拾取点按其原点、间距与范围换算，显示的是降采样代理体时种子仍落在原图像上；
+    // 为空时按显示的图像换算
+    void setSeedReferenceImage(vtkImageData* image);
+
+    // 配准预览：显示固定图像，当前切片上叠加按变换重采样的浮动图像(只重采样显示的切片)
+    void setRegistrationPair(vtkImageData* fixedImage, vtkImageData* movingImage);
+    void clearRegistrationPair();
+    void setOverlayMode(OverlayMode mode);
+    OverlayMode getOverlayMode() const;
+    void setCheckerSize(int voxels);          // 棋盘格边长(体素)
+    void setBlendOpacity(double opacity);     // 浮动图像在混合中的权重，0~1
+
+    // 等值面网格(如IsosurfaceExtractor::surfaceReady交付的网格)，只在VOLUME_3D视图中显示
+    void setSurfaceData(vtkPolyData* surface);
+    void clearSurfaceData();
+
+    // 分割掩膜(0/255，如SeedRegionGrower的区域)以半透明颜色叠加在当前切片上；
+    // 掩膜可以只覆盖图像的子范围
+    void setSegmentationMask(vtkImageData* mask);  // 按物理坐标对齐，可叠加在降采样代理体上
+    void clearSegmentationMask();
+
 signals:
     void sliceChanged(int slice);
     void windowLevelChanged(double window, double level);
     void zoomChanged(double zoom);
-    void mousePositionChanged(int x, int y, double value);
+    void mousePositionChanged(int x, int y, double value); // 切片平面内的两个体素索引(轴位x/y、冠状位x/z、矢状位y/z)
+    void seedPointSelected(int x, int y, int z);
 
 public slots:
     void onSliceChanged(int slice);
     void onWindowLevelChanged(double window, double level);
     void onZoomChanged(double zoom);
+    // 固定到浮动物理点的变换；位移场非空时按位移场重采样(可与RegistrationManager::registrationPreview直接连接)
+    void setRegistrationTransform(vtkMatrix4x4* transform, vtkImageData* displacementField = nullptr);
 
 protected:
     void setupUI();
     void setupVTK();
     void connectSignals();
+    bool eventFilter(QObject* watched, QEvent* event) override;
+    bool pickVoxel(const QPoint& position, vtkImageData* image, int voxel[3]) const;
+    void updateRegistrationOverlay();
+    void updateSegmentationOverlay();
+    double currentSlicePosition() const;  // 当前切片平面在法向上的物理坐标
 
 private slots:
     void updateSliceInfo();
@@ -115,6 +115,24 @@ Config::ImageProcessingSettings Config::getImageProcessingSettings() const {
     settings.defaultWindowLevel = getInt("imageProcessing/defaultWindowLevel", settings.defaultWindowLevel);
     settings.defaultColormap = getString("imageProcessing/defaultColormap", settings.defaultColormap);
     settings.enableGPUProcessing = getBool("imageProcessing/enableGPUProcessing", settings.enableGPUProcessing);
+    settings.enableResultCache = getBool("imageProcessing/enableResultCache", settings.enableResultCache);
+    settings.resultCacheSizeMB = getInt("imageProcessing/resultCacheSizeMB", settings.resultCacheSizeMB);
+    settings.enableResultCacheSpill = getBool("imageProcessing/enableResultCacheSpill", settings.enableResultCacheSpill);
+    settings.resultCacheSpillDirectory = getString("imageProcessing/resultCacheSpillDirectory", settings.resultCacheSpillDirectory);
+    settings.intermediatePrecision = getString("imageProcessing/intermediatePrecision", settings.intermediatePrecision);
+    settings.streamingMemoryBudgetMB = getInt("imageProcessing/streamingMemoryBudgetMB", settings.streamingMemoryBudgetMB);
+    settings.enableRegistrationCache = getBool("imageProcessing/enableRegistrationCache", settings.enableRegistrationCache);
+    settings.registrationCacheDirectory = getString("imageProcessing/registrationCacheDirectory", settings.registrationCacheDirectory);
+    settings.registrationCacheSizeMB = getInt("imageProcessing/registrationCacheSizeMB", settings.registrationCacheSizeMB);
+    settings.lazyRegisteredImage = getBool("imageProcessing/lazyRegisteredImage", settings.lazyRegisteredImage);
+    if (settings.resultCacheSpillDirectory.isEmpty()) {
+        settings.resultCacheSpillDirectory =
+            QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/ProcessingCache";
+    }
+    if (settings.registrationCacheDirectory.isEmpty()) {
+        settings.registrationCacheDirectory =
+            QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/RegistrationCache";
+    }
     return settings;
 }
 
@@ -123,6 +141,16 @@ void Config::setImageProcessingSettings(const ImageProcessingSettings& settings)
     setValue("imageProcessing/defaultWindowLevel", settings.defaultWindowLevel);
     setValue("imageProcessing/defaultColormap", settings.defaultColormap);
     setValue("imageProcessing/enableGPUProcessing", settings.enableGPUProcessing);
+    setValue("imageProcessing/enableResultCache", settings.enableResultCache);
+    setValue("imageProcessing/resultCacheSizeMB", settings.resultCacheSizeMB);
+    setValue("imageProcessing/enableResultCacheSpill", settings.enableResultCacheSpill);
+    setValue("imageProcessing/resultCacheSpillDirectory", settings.resultCacheSpillDirectory);
+    setValue("imageProcessing/intermediatePrecision", settings.intermediatePrecision);
+    setValue("imageProcessing/streamingMemoryBudgetMB", settings.streamingMemoryBudgetMB);
+    setValue("imageProcessing/enableRegistrationCache", settings.enableRegistrationCache);
+    setValue("imageProcessing/registrationCacheDirectory", settings.registrationCacheDirectory);
+    setValue("imageProcessing/registrationCacheSizeMB", settings.registrationCacheSizeMB);
+    setValue("imageProcessing/lazyRegisteredImage", settings.lazyRegisteredImage);
 }
 
 bool Config::loadFromFile(const QString& filename) {
@@ -51,6 +51,16 @@ public:
         int defaultWindowLevel = 40;
         QString defaultColormap = "Gray";
         bool enableGPUProcessing = true;
+        bool enableResultCache = true;
+        int resultCacheSizeMB = 512;
+        bool enableResultCacheSpill = false;
+        QString resultCacheSpillDirectory;
+        QString intermediatePrecision = "Full"; // 中间结果精度：Full / Int16 / Float16
+        int streamingMemoryBudgetMB = 2048;      // 分块流式处理的常驻内存预算
+        bool enableRegistrationCache = true;     // 配准结果跨会话持久化缓存
+        QString registrationCacheDirectory;
+        int registrationCacheSizeMB = 1024;      // 配准缓存目录的磁盘预算，超出时按LRU删除
+        bool lazyRegisteredImage = false;        // 配准结果以按需重采样的视图给出，不生成完整结果体
     };
     
     // 配置组管理
@@ -0,0 +1,113 @@
+#ifndef HALFFLOAT_H
+#define HALFFLOAT_H
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace MedicalImaging {
+
+/**
+ * @brief IEEE 754 binary16半精度浮点数，用作降精度中间结果的存储类型
+ *
+ * 仅用于存储，运算时转换为float。float到half按最近偶数舍入，
+ * 超出可表示范围(±65504)的值饱和到最大有限值而不是变为无穷大。
+ */
+struct Half {
+    uint16_t bits = 0;
+
+    Half() = default;
+    explicit Half(float value) : bits(fromFloat(value)) {}
+
+    operator float() const {
+        return toFloat(bits);
+    }
+
+    static constexpr float maxValue() {
+        return 65504.0f;
+    }
+
+    static uint16_t fromFloat(float value) {
+#if defined(__F16C__)
+        if (value > maxValue()) {
+            value = maxValue();
+        } else if (value < -maxValue()) {
+            value = -maxValue();
+        }
+        return static_cast<uint16_t>(_cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT));
+#else
+        uint32_t f;
+        std::memcpy(&f, &value, sizeof(f));
+        const uint32_t sign = (f >> 16) & 0x8000u;
+        const uint32_t magnitude = f & 0x7FFFFFFFu;
+
+        if (magnitude > 0x7F800000u) {
+            return static_cast<uint16_t>(sign | 0x7E00u); // NaN
+        }
+        if (magnitude >= 0x477FE000u) {
+            return static_cast<uint16_t>(sign | 0x7BFFu); // 饱和到65504
+        }
+        if (magnitude < 0x38800000u) {
+            // 半精度非规格化数
+            if (magnitude < 0x33000000u) {
+                return static_cast<uint16_t>(sign);
+            }
+            const uint32_t shift = 126u - (magnitude >> 23);
+            const uint32_t mantissa = (magnitude & 0x7FFFFFu) | 0x800000u;
+            uint32_t half = mantissa >> shift;
+            const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+            const uint32_t halfway = 1u << (shift - 1u);
+            if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+                ++half;
+            }
+            return static_cast<uint16_t>(sign | half);
+        }
+
+        uint32_t half = (((magnitude >> 23) - 112u) << 10) | ((magnitude >> 13) & 0x3FFu);
+        const uint32_t remainder = magnitude & 0x1FFFu;
+        if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+            ++half; // 尾数进位可正确进入指数位
+        }
+        return static_cast<uint16_t>(sign | half);
+#endif
+    }
+
+    static float toFloat(uint16_t h) {
+#if defined(__F16C__)
+        return _cvtsh_ss(h);
+#else
+        const uint32_t sign = (h & 0x8000u) << 16;
+        const uint32_t exponent = (h >> 10) & 0x1Fu;
+        uint32_t mantissa = h & 0x3FFu;
+        uint32_t f;
+        if (exponent == 0) {
+            if (mantissa == 0) {
+                f = sign;
+            } else {
+                // 非规格化数规格化为float
+                uint32_t e = 0;
+                while (!(mantissa & 0x200u)) {
+                    mantissa <<= 1;
+                    ++e;
+                }
+                mantissa = (mantissa << 1) & 0x3FFu;
+                f = sign | ((112u - e) << 23) | (mantissa << 13);
+            }
+        } else if (exponent == 31) {
+            f = sign | 0x7F800000u | (mantissa << 13);
+        } else {
+            f = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+        }
+        float value;
+        std::memcpy(&value, &f, sizeof(value));
+        return value;
+#endif
+    }
+};
+
+} // namespace MedicalImaging
+
+#endif // HALFFLOAT_H
@@ -0,0 +1,292 @@
+#include "ImageStatistics.h"
+#include "VoxelDispatch.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <vtkImageData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <list>
+
+namespace MedicalImaging {
+
+namespace {
+
+const int kCacheEntries = 8;
+
+// 逐切片的矩统计，用于并行合并
+struct SliceMoments {
+    double minimum = std::numeric_limits<double>::max();
+    double maximum = std::numeric_limits<double>::lowest();
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    long long count = 0;
+};
+
+void finalizeMoments(const SliceMoments& moments, IntensityStatistics& statistics) {
+    statistics.voxelCount = moments.count;
+    if (moments.count == 0) {
+        return;
+    }
+    statistics.minimum = moments.minimum;
+    statistics.maximum = moments.maximum;
+    statistics.mean = moments.sum / moments.count;
+    const double m2 = moments.sumSquares - moments.count * statistics.mean * statistics.mean;
+    statistics.standardDeviation = moments.count > 1 ? std::sqrt(std::max(0.0, m2 / (moments.count - 1))) : 0.0;
+}
+
+// 进程内缓存，按最近使用排序
+struct CacheEntry {
+    const vtkImageData* image;
+    std::shared_ptr<const ImageStatistics> statistics;
+};
+
+struct StatisticsCache {
+    QMutex mutex;
+    std::list<CacheEntry> entries;
+};
+
+StatisticsCache& statisticsCache() {
+    static StatisticsCache cache;
+    return cache;
+}
+
+template<typename T>
+inline bool isValidValue(T value) {
+    return value == value; // 只有NaN不等于自身
+}
+
+} // namespace
+
+double IntensityStatistics::binWidth() const {
+    return histogram.empty() ? 0.0 : (histogramMaximum - histogramMinimum) / histogram.size();
+}
+
+double IntensityStatistics::percentile(double percent) const {
+    if (voxelCount <= 0 || histogram.empty()) {
+        return 0.0;
+    }
+    if (percent <= 0.0) {
+        return minimum;
+    }
+    if (percent >= 100.0) {
+        return maximum;
+    }
+    const double target = percent / 100.0 * voxelCount;
+    double cumulative = 0.0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        const double next = cumulative + histogram[i];
+        if (next >= target && histogram[i] > 0) {
+            const double fraction = (target - cumulative) / histogram[i];
+            const double value = histogramMinimum + (i + fraction) * binWidth();
+            return std::min(maximum, std::max(minimum, value));
+        }
+        cumulative = next;
+    }
+    return maximum;
+}
+
+struct ImageStatistics::Impl {
+    vtkMTimeType version = 0;
+    IntensityStatistics global;
+    std::vector<IntensityStatistics> slices;
+
+    template<typename T>
+    void compute(const VoxelView<const T>& in);
+};
+
+template<typename T>
+void ImageStatistics::Impl::compute(const VoxelView<const T>& in) {
+    const int nz = in.dims[2];
+    std::vector<SliceMoments> moments(static_cast<size_t>(nz));
+    slices.assign(static_cast<size_t>(nz), IntensityStatistics());
+
+    // 第一遍：逐切片极值与一、二阶矩，每个切片只由一个任务写入
+    vtkSMPTools::For(0, nz, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType z = begin; z < end; ++z) {
+            SliceMoments& m = moments[z];
+            for (int y = 0; y < in.dims[1]; ++y) {
+                const T* row = in.row(y, static_cast<int>(z));
+                double rowSum = 0.0;
+                double rowSquares = 0.0;
+                for (int x = 0; x < in.dims[0]; ++x) {
+                    const T v = row[x * in.strides[0]];
+                    if (!isValidValue(v)) {
+                        continue;
+                    }
+                    const double value = static_cast<double>(v);
+                    m.minimum = std::min(m.minimum, value);
+                    m.maximum = std::max(m.maximum, value);
+                    rowSum += value;
+                    rowSquares += value * value;
+                    ++m.count;
+                }
+                m.sum += rowSum;
+                m.sumSquares += rowSquares;
+            }
+            finalizeMoments(m, slices[z]);
+        }
+    });
+
+    SliceMoments total;
+    for (const SliceMoments& m : moments) {
+        total.minimum = std::min(total.minimum, m.minimum);
+        total.maximum = std::max(total.maximum, m.maximum);
+        total.sum += m.sum;
+        total.sumSquares += m.sumSquares;
+        total.count += m.count;
+    }
+    finalizeMoments(total, global);
+
+    // 第二遍：全局与逐切片直方图共用[min, max]值域
+    const double low = global.minimum;
+    const double high = global.maximum;
+    const double range = high - low;
+    global.histogramMinimum = low;
+    global.histogramMaximum = high;
+    const double globalScale = range > 0.0 ? kGlobalBins / range : 0.0;
+    const double sliceScale = range > 0.0 ? kSliceBins / range : 0.0;
+    vtkSMPThreadLocal<std::vector<long long>> partials;
+
+    vtkSMPTools::For(0, nz, [&](vtkIdType begin, vtkIdType end) {
+        std::vector<long long>& counts = partials.Local();
+        counts.resize(kGlobalBins, 0);
+        for (vtkIdType z = begin; z < end; ++z) {
+            IntensityStatistics& statistics = slices[z];
+            statistics.histogramMinimum = low;
+            statistics.histogramMaximum = high;
+            statistics.histogram.assign(kSliceBins, 0);
+            for (int y = 0; y < in.dims[1]; ++y) {
+                const T* row = in.row(y, static_cast<int>(z));
+                for (int x = 0; x < in.dims[0]; ++x) {
+                    const T v = row[x * in.strides[0]];
+                    if (!isValidValue(v)) {
+                        continue;
+                    }
+                    const double offset = static_cast<double>(v) - low;
+                    ++counts[std::min(kGlobalBins - 1, static_cast<int>(offset * globalScale))];
+                    ++statistics.histogram[std::min(kSliceBins - 1, static_cast<int>(offset * sliceScale))];
+                }
+            }
+        }
+    });
+
+    global.histogram.assign(kGlobalBins, 0);
+    for (const std::vector<long long>& counts : partials) {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            global.histogram[i] += counts[i];
+        }
+    }
+}
+
+ImageStatistics::ImageStatistics()
+    : d(std::make_unique<Impl>())
+{
+}
+
+ImageStatistics::~ImageStatistics() = default;
+
+std::shared_ptr<const ImageStatistics> ImageStatistics::compute(vtkImageData* image) {
+    std::shared_ptr<ImageStatistics> statistics(new ImageStatistics());
+    statistics->d->version = image->GetMTime();
+    const bool dispatched = dispatchVoxelType(image->GetScalarType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        statistics->d->compute(makeVoxelView<const T>(image).component(0));
+    });
+    return dispatched ? statistics : nullptr;
+}
+
+std::shared_ptr<const ImageStatistics> ImageStatistics::cached(vtkImageData* image) {
+    if (!image) {
+        return nullptr;
+    }
+    StatisticsCache& cache = statisticsCache();
+    const vtkMTimeType version = image->GetMTime();
+    QMutexLocker locker(&cache.mutex);
+    std::list<CacheEntry>& entries = cache.entries;
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->image == image && it->statistics->version() == version) {
+            entries.splice(entries.begin(), entries, it);
+            return entries.front().statistics;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const ImageStatistics> ImageStatistics::get(vtkImageData* image) {
+    if (!image || image->GetNumberOfPoints() == 0) {
+        return nullptr;
+    }
+    if (std::shared_ptr<const ImageStatistics> statistics = cached(image)) {
+        return statistics;
+    }
+
+    // 在锁外遍历体数据，避免阻塞其他图像的查询
+    std::shared_ptr<const ImageStatistics> statistics = compute(image);
+    if (!statistics) {
+        return nullptr;
+    }
+
+    StatisticsCache& cache = statisticsCache();
+    QMutexLocker locker(&cache.mutex);
+    std::list<CacheEntry>& entries = cache.entries;
+    entries.remove_if([image](const CacheEntry& entry) { return entry.image == image; });
+    entries.push_front({image, statistics});
+    while (entries.size() > static_cast<size_t>(kCacheEntries)) {
+        entries.pop_back();
+    }
+    return statistics;
+}
+
+void ImageStatistics::clearCache() {
+    StatisticsCache& cache = statisticsCache();
+    QMutexLocker locker(&cache.mutex);
+    cache.entries.clear();
+}
+
+vtkMTimeType ImageStatistics::version() const {
+    return d->version;
+}
+
+const IntensityStatistics& ImageStatistics::global() const {
+    return d->global;
+}
+
+int ImageStatistics::sliceCount() const {
+    return static_cast<int>(d->slices.size());
+}
+
+const IntensityStatistics& ImageStatistics::slice(int z) const {
+    return d->slices[static_cast<size_t>(std::max(0, std::min(sliceCount() - 1, z)))];
+}
+
+double ImageStatistics::percentile(double percent) const {
+    return d->global.percentile(percent);
+}
+
+std::vector<long long> ImageStatistics::histogram(int bins) const {
+    if (bins <= 0 || kGlobalBins % bins != 0) {
+        return std::vector<long long>();
+    }
+    const int factor = kGlobalBins / bins;
+    std::vector<long long> merged(static_cast<size_t>(bins), 0);
+    for (int i = 0; i < kGlobalBins; ++i) {
+        merged[i / factor] += d->global.histogram[i];
+    }
+    return merged;
+}
+
+void ImageStatistics::windowLevel(double& window, double& level, double lowerPercent, double upperPercent) const {
+    double low = percentile(lowerPercent);
+    double high = percentile(upperPercent);
+    if (!(high > low)) {
+        low = d->global.minimum;
+        high = d->global.maximum;
+    }
+    window = high > low ? high - low : 1.0;
+    level = (low + high) / 2.0;
+}
+
+} // namespace MedicalImaging
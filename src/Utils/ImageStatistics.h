@@ -0,0 +1,83 @@
+#ifndef IMAGESTATISTICS_H
+#define IMAGESTATISTICS_H
+
+#include <memory>
+#include <vector>
+
+#include <vtkType.h>
+
+class vtkImageData;
+
+namespace MedicalImaging {
+
+/**
+ * @brief 一组体素的强度统计：极值、均值、标准差与等宽直方图
+ */
+struct IntensityStatistics {
+    double minimum = 0.0;
+    double maximum = 0.0;
+    double mean = 0.0;
+    double standardDeviation = 0.0;
+    long long voxelCount = 0;
+
+    // 直方图覆盖[histogramMinimum, histogramMaximum]，等宽分箱
+    double histogramMinimum = 0.0;
+    double histogramMaximum = 0.0;
+    std::vector<long long> histogram;
+
+    double binWidth() const;
+    // 百分位数(0~100)，在所在分箱内线性插值
+    double percentile(double percent) const;
+};
+
+/**
+ * @brief 图像强度统计服务
+ *
+ * 一次并行遍历得到全局与逐z切片的极值、均值、标准差和直方图，
+ * 按"图像身份 + 数据版本(MTime)"缓存，数据未修改时重复查询不再遍历体数据。
+ * 只统计第一个分量；浮点数据中的NaN不参与统计。
+ * 逐切片直方图与全局直方图使用相同的值域，便于比较。
+ *
+ * 窗宽窗位、Otsu阈值、颜色映射范围和阈值控件的取值范围都应从这里读取。
+ */
+class ImageStatistics {
+public:
+    static const int kGlobalBins = 4096;
+    static const int kSliceBins = 256;
+
+    // 带缓存的获取；图像为空或体素类型不受支持时返回空指针
+    static std::shared_ptr<const ImageStatistics> get(vtkImageData* image);
+    // 只查缓存，当前数据版本尚未统计时返回空指针
+    static std::shared_ptr<const ImageStatistics> cached(vtkImageData* image);
+    static void clearCache();
+
+    ~ImageStatistics();
+
+    vtkMTimeType version() const;
+    const IntensityStatistics& global() const;
+    int sliceCount() const;
+    const IntensityStatistics& slice(int z) const;
+
+    double percentile(double percent) const;
+
+    // 全局直方图合并到bins个分箱，bins须整除kGlobalBins
+    std::vector<long long> histogram(int bins) const;
+
+    // 以[lowerPercent, upperPercent]百分位区间为显示范围的窗宽窗位
+    void windowLevel(double& window, double& level,
+                     double lowerPercent = 0.5, double upperPercent = 99.5) const;
+
+private:
+    ImageStatistics();
+    ImageStatistics(const ImageStatistics&) = delete;
+    ImageStatistics& operator=(const ImageStatistics&) = delete;
+
+    static std::shared_ptr<const ImageStatistics> compute(vtkImageData* image);
+
+    struct Impl;
+    std::unique_ptr<Impl> d;
+};
+
+} // namespace MedicalImaging
+
+#endif // IMAGESTATISTICS_H
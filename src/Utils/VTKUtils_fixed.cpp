@@ -1,13 +1,33 @@
 #include "VTKUtils_fixed.h"
 #include <QtCore/QDebug>
 
-namespace MedicalImaging {
+#include "ImageStatistics.h"
+#include "VoxelDispatch.h"
+#include "Logger.h"
+#include <vtkDataArray.h>
+#include <vtkCellArray.h>
+#include <vtkDataSet.h>
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkFloatArray.h>
+#include <vtkIdList.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPThreadLocalObject.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
 
 // 条件编译 - 仅在VTK可用时编译
+// 头文件必须在命名空间之外包含
 #ifdef VTK_AVAILABLE
-#include <vtkImageData.h>
 #include <vtkPolyData.h>
-#include <vtkDataSet.h>
 #include <vtkMatrix4x4.h>
 #include <vtkTransform.h>
 #include <vtkLookupTable.h>
@@ -15,8 +35,11 @@ namespace MedicalImaging {
 #include <vtkImageTestSource.h>
 #include <vtkSphereSource.h>
 #include <vtkMath.h>
-#include <vtkPointData.h>
-#include <vtkDataArray.h>
+#endif
+
+namespace MedicalImaging {
+
+#ifdef VTK_AVAILABLE
 
 bool VTKUtils::isVTKAvailable() {
     return true;
@@ -255,24 +278,6 @@ int VTKUtils::stringToVtkDataType(const QString& dataTypeString) {
     return VTK_VOID;
 }
 
-void VTKUtils::getDataRange(vtkDataSet* dataSet, double range[2]) {
-    if (dataSet && dataSet->GetPointData() && dataSet->GetPointData()->GetScalars()) {
-        dataSet->GetPointData()->GetScalars()->GetRange(range);
-    } else {
-        range[0] = 0.0;
-        range[1] = 1.0;
-    }
-}
-
-void VTKUtils::getScalarRange(vtkDataSet* dataSet, double range[2]) {
-    getDataRange(dataSet, range);
-}
-
-void VTKUtils::normalizeData(vtkDataSet* dataSet) {
-    Q_UNUSED(dataSet)
-    // 实现数据标准化逻辑
-}
-
 QString VTKUtils::getVTKFileExtension(const QString& filename) {
     int lastDot = filename.lastIndexOf('.');
     if (lastDot >= 0) {
@@ -334,19 +339,6 @@ void VTKUtils::printMatrixInfo(vtkMatrix4x4* matrix) {
     }
 }
 
-void VTKUtils::calculateOptimalWindowLevel(vtkImageData* imageData, double& window, double& level) {
-    if (!imageData) {
-        window = 1.0;
-        level = 0.5;
-        return;
-    }
-    
-    double range[2];
-    getDataRange(imageData, range);
-    window = range[1] - range[0];
-    level = (range[1] + range[0]) / 2.0;
-}
-
 void VTKUtils::applyWindowLevel(vtkImageData* imageData, double window, double level) {
     Q_UNUSED(imageData)
     Q_UNUSED(window)
@@ -371,18 +363,6 @@ void VTKUtils::calculateCenter(vtkDataSet* dataSet, double center[3]) {
     center[2] = (bounds[4] + bounds[5]) / 2.0;
 }
 
-double VTKUtils::calculateVolume(vtkPolyData* polyData) {
-    Q_UNUSED(polyData)
-    // 实现体积计算逻辑
-    return 0.0;
-}
-
-double VTKUtils::calculateSurfaceArea(vtkPolyData* polyData) {
-    Q_UNUSED(polyData)
-    // 实现表面积计算逻辑
-    return 0.0;
-}
-
 #else // VTK_AVAILABLE not defined
 
 // VTK不可用时的替代实现
@@ -530,22 +510,6 @@ int VTKUtils::stringToVtkDataType(const QString& dataTypeString) {
     return 0;
 }
 
-void VTKUtils::getDataRange(vtkDataSet* dataSet, double range[2]) {
-    Q_UNUSED(dataSet)
-    range[0] = 0.0;
-    range[1] = 1.0;
-}
-
-void VTKUtils::getScalarRange(vtkDataSet* dataSet, double range[2]) {
-    Q_UNUSED(dataSet)
-    range[0] = 0.0;
-    range[1] = 1.0;
-}
-
-void VTKUtils::normalizeData(vtkDataSet* dataSet) {
-    Q_UNUSED(dataSet)
-}
-
 QString VTKUtils::getVTKFileExtension(const QString& filename) {
     int lastDot = filename.lastIndexOf('.');
     if (lastDot >= 0) {
@@ -579,12 +543,6 @@ void VTKUtils::printMatrixInfo(vtkMatrix4x4* matrix) {
     qDebug() << "VTK not available";
 }
 
-void VTKUtils::calculateOptimalWindowLevel(vtkImageData* imageData, double& window, double& level) {
-    Q_UNUSED(imageData)
-    window = 1.0;
-    level = 0.5;
-}
-
 void VTKUtils::applyWindowLevel(vtkImageData* imageData, double window, double level) {
     Q_UNUSED(imageData)
     Q_UNUSED(window)
@@ -602,16 +560,352 @@ void VTKUtils::calculateCenter(vtkDataSet* dataSet, double center[3]) {
     center[0] = center[1] = center[2] = 0.0;
 }
 
+#endif // VTK_AVAILABLE
+
+// ========== 基于缓存统计的数据范围与窗宽窗位(与VTK_AVAILABLE无关) ==========
+
+void VTKUtils::getDataRange(vtkDataSet* dataSet, double range[2]) {
+    // 图像数据走统计缓存，数据未修改时不再遍历
+    if (auto statistics = ImageStatistics::get(vtkImageData::SafeDownCast(dataSet))) {
+        range[0] = statistics->global().minimum;
+        range[1] = statistics->global().maximum;
+        return;
+    }
+    if (dataSet && dataSet->GetPointData() && dataSet->GetPointData()->GetScalars()) {
+        dataSet->GetPointData()->GetScalars()->GetRange(range);
+    } else {
+        range[0] = 0.0;
+        range[1] = 1.0;
+    }
+}
+
+void VTKUtils::getScalarRange(vtkDataSet* dataSet, double range[2]) {
+    getDataRange(dataSet, range);
+}
+
+void VTKUtils::calculateOptimalWindowLevel(vtkImageData* imageData, double& window, double& level) {
+    // 取0.5%~99.5%百分位区间，避免少量极值(金属伪影、填充值)压缩显示对比度
+    if (auto statistics = ImageStatistics::get(imageData)) {
+        statistics->windowLevel(window, level);
+        return;
+    }
+    window = 1.0;
+    level = 0.5;
+}
+
+// ========== 强度归一化 ==========
+
+namespace {
+
+// 每个任务至少处理的元素数，避免小数组的调度开销超过计算本身
+const vtkIdType kNormalizeGrain = 1 << 16;
+
+// 一次并行归约得到的极值与一、二阶矩
+struct ValueMoments {
+    double minimum = std::numeric_limits<double>::max();
+    double maximum = std::numeric_limits<double>::lowest();
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    long long count = 0;
+};
+
+template<typename T>
+ValueMoments reduceMoments(const T* data, vtkIdType count) {
+    vtkSMPThreadLocal<ValueMoments> partials;
+    vtkSMPTools::For(0, count, kNormalizeGrain, [&](vtkIdType begin, vtkIdType end) {
+        ValueMoments& moments = partials.Local();
+        double minimum = moments.minimum;
+        double maximum = moments.maximum;
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        long long valid = 0;
+        for (vtkIdType i = begin; i < end; ++i) {
+            const T v = data[i];
+            if (!(v == v)) { // NaN不参与统计，整数类型下编译器会消去此判断
+                continue;
+            }
+            const double value = static_cast<double>(v);
+            minimum = std::min(minimum, value);
+            maximum = std::max(maximum, value);
+            sum += value;
+            sumSquares += value * value;
+            ++valid;
+        }
+        moments.minimum = minimum;
+        moments.maximum = maximum;
+        moments.sum += sum;
+        moments.sumSquares += sumSquares;
+        moments.count += valid;
+    });
+
+    ValueMoments total;
+    for (const ValueMoments& moments : partials) {
+        total.minimum = std::min(total.minimum, moments.minimum);
+        total.maximum = std::max(total.maximum, moments.maximum);
+        total.sum += moments.sum;
+        total.sumSquares += moments.sumSquares;
+        total.count += moments.count;
+    }
+    return total;
+}
+
+/**
+ * @brief out = clamp(in·scale + shift, lower, upper)，逐元素无分支，便于编译器向量化
+ *
+ * 计算类型TCompute：16位及以下整数与float用float，int与double用double。
+ * 整数输出在截断前加0.5(值域已截到非负区间，等价于四舍五入)。
+ * in与out可以是同一数组。
+ */
+template<typename TIn, typename TOut, typename TCompute>
+void applyLinearMap(const TIn* in, TOut* out, vtkIdType count,
+                    TCompute scale, TCompute shift, TCompute lower, TCompute upper) {
+    const TCompute rounding = std::is_integral<TOut>::value ? TCompute(0.5) : TCompute(0);
+    vtkSMPTools::For(0, count, kNormalizeGrain, [=](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i) {
+            TCompute value = static_cast<TCompute>(in[i]) * scale + shift;
+            value = value < lower ? lower : value;
+            value = value > upper ? upper : value;
+            out[i] = static_cast<TOut>(value + rounding);
+        }
+    });
+}
+
+template<typename T>
+using ComputeTypeOf = typename std::conditional<(sizeof(T) <= 2 || std::is_same<T, float>::value),
+                                                float, double>::type;
+
+// 最小-最大映射的目标区间：整数类型用满[0, 类型最大值]，浮点类型为[0, 1]
+template<typename T>
+double normalizedUpperBound() {
+    return std::is_integral<T>::value ? static_cast<double>(std::numeric_limits<T>::max()) : 1.0;
+}
+
+} // namespace
+
+bool VTKUtils::normalizeData(vtkDataSet* dataSet, NormalizationMethod method,
+                             double lowerPercent, double upperPercent) {
+    vtkDataArray* scalars = dataSet && dataSet->GetPointData() ? dataSet->GetPointData()->GetScalars() : nullptr;
+    if (!scalars || scalars->GetNumberOfTuples() == 0) {
+        return false;
+    }
+    const vtkIdType count = scalars->GetNumberOfTuples() * scalars->GetNumberOfComponents();
+    vtkImageData* image = vtkImageData::SafeDownCast(dataSet);
+    const bool singleComponent = scalars->GetNumberOfComponents() == 1;
+
+    // 百分位来自统计服务的直方图，只对单分量图像可用
+    std::shared_ptr<const ImageStatistics> statistics;
+    if (method == PercentileClipNormalization) {
+        if (!image || !singleComponent || !(upperPercent > lowerPercent)) {
+            LOG_WARNING("normalizeData: 百分位截断归一化需要单分量图像且上百分位大于下百分位");
+            return false;
+        }
+        statistics = ImageStatistics::get(image);
+    } else if (image && singleComponent) {
+        // 已有缓存统计时直接复用，否则在下面的单次归约中求得
+        statistics = ImageStatistics::cached(image);
+    }
+
+    bool converted = false;
+    const bool dispatched = dispatchVoxelType(scalars->GetDataType(), [&](auto tag) {
+        using T = typename decltype(tag)::type;
+        using TCompute = ComputeTypeOf<T>;
+        T* data = static_cast<T*>(scalars->GetVoidPointer(0));
+
+        double minimum;
+        double maximum;
+        double mean;
+        double standardDeviation;
+        if (statistics) {
+            const IntensityStatistics& global = statistics->global();
+            minimum = global.minimum;
+            maximum = global.maximum;
+            mean = global.mean;
+            standardDeviation = global.standardDeviation;
+        } else {
+            const ValueMoments moments = reduceMoments(data, count);
+            if (moments.count == 0) {
+                minimum = maximum = mean = standardDeviation = 0.0;
+            } else {
+                minimum = moments.minimum;
+                maximum = moments.maximum;
+                mean = moments.sum / moments.count;
+                const double m2 = moments.sumSquares - moments.count * mean * mean;
+                standardDeviation = moments.count > 1 ? std::sqrt(std::max(0.0, m2 / (moments.count - 1))) : 0.0;
+            }
+        }
+
+        if (method == ZScoreNormalization) {
+            const double scale = standardDeviation > 0.0 ? 1.0 / standardDeviation : 0.0;
+            const double shift = -mean * scale;
+            if (std::is_floating_point<T>::value) {
+                applyLinearMap<T, T, TCompute>(data, data, count, scale, shift,
+                                               std::numeric_limits<TCompute>::lowest(),
+                                               std::numeric_limits<TCompute>::max());
+                return;
+            }
+            // 整数类型无法表示z分数，换成同名float数组
+            auto result = vtkSmartPointer<vtkFloatArray>::New();
+            result->SetName(scalars->GetName());
+            result->SetNumberOfComponents(scalars->GetNumberOfComponents());
+            result->SetNumberOfTuples(scalars->GetNumberOfTuples());
+            applyLinearMap<T, float, double>(data, static_cast<float*>(result->GetVoidPointer(0)), count,
+                                             scale, shift, std::numeric_limits<float>::lowest(),
+                                             std::numeric_limits<float>::max());
+            dataSet->GetPointData()->SetScalars(result);
+            converted = true;
+            return;
+        }
+
+        double low = minimum;
+        double high = maximum;
+        if (method == PercentileClipNormalization) {
+            low = statistics->percentile(lowerPercent);
+            high = statistics->percentile(upperPercent);
+        }
+        const double upper = normalizedUpperBound<T>();
+        const double scale = high > low ? upper / (high - low) : 0.0;
+        const double shift = high > low ? -low * scale : 0.0;
+        applyLinearMap<T, T, TCompute>(data, data, count, scale, shift, 0, upper);
+    });
+
+    if (!dispatched) {
+        LOG_WARNING(QString("normalizeData: 不支持的标量类型 %1").arg(scalars->GetDataType()));
+        return false;
+    }
+    // 数据版本变化使统计缓存与范围缓存失效
+    if (!converted) {
+        scalars->Modified();
+    }
+    dataSet->Modified();
+    return true;
+}
+
+// ========== 网格体积与表面积 ==========
+
+namespace {
+
+const char* const kVolumeFieldName = "Volume";
+const char* const kSurfaceAreaFieldName = "SurfaceArea";
+const char* const kMeasuresTimeFieldName = "MeasuresMTime";
+
+struct MeshMeasures {
+    double signedVolume = 0.0;
+    double surfaceArea = 0.0;
+};
+
+// 网格几何(点坐标与多边形)的修改时间，附加的度量只对附加时的几何有效
+double geometryTime(vtkPolyData* polyData) {
+    vtkMTimeType time = 0;
+    if (vtkPoints* points = polyData->GetPoints()) {
+        time = std::max(time, points->GetMTime());
+    }
+    if (vtkCellArray* polys = polyData->GetPolys()) {
+        time = std::max(time, polys->GetMTime());
+    }
+    return static_cast<double>(time);
+}
+
+// 读取网格上附加的单值字段；不存在或几何在附加后被修改时返回false
+bool readMeshMeasure(vtkPolyData* polyData, const char* name, double& value) {
+    vtkFieldData* fieldData = polyData ? polyData->GetFieldData() : nullptr;
+    vtkDataArray* array = fieldData ? fieldData->GetArray(name) : nullptr;
+    vtkDataArray* time = fieldData ? fieldData->GetArray(kMeasuresTimeFieldName) : nullptr;
+    if (!array || array->GetNumberOfTuples() < 1 || !time || time->GetNumberOfTuples() < 1 ||
+        time->GetTuple1(0) != geometryTime(polyData)) {
+        return false;
+    }
+    value = array->GetTuple1(0);
+    return true;
+}
+
+} // namespace
+
+void VTKUtils::calculateMeshMeasures(vtkPolyData* polyData, double& volume, double& surfaceArea) {
+    volume = 0.0;
+    surfaceArea = 0.0;
+    vtkPoints* points = polyData ? polyData->GetPoints() : nullptr;
+    vtkCellArray* polys = polyData ? polyData->GetPolys() : nullptr;
+    if (!points || !polys) {
+        return;
+    }
+
+    // 体积按散度定理累加各三角形与原点构成的有向四面体体积，只对闭合网格有意义
+    vtkSMPThreadLocalObject<vtkIdList> cellPoints;
+    vtkSMPThreadLocal<MeshMeasures> partials;
+    vtkSMPTools::For(0, polys->GetNumberOfCells(), [&](vtkIdType begin, vtkIdType end) {
+        vtkIdList* ids = cellPoints.Local();
+        MeshMeasures& measures = partials.Local();
+        for (vtkIdType cell = begin; cell < end; ++cell) {
+            polys->GetCellAtId(cell, ids);
+            const vtkIdType count = ids->GetNumberOfIds();
+            if (count < 3) {
+                continue;
+            }
+            double p0[3];
+            double p1[3];
+            double p2[3];
+            points->GetPoint(ids->GetId(0), p0);
+            points->GetPoint(ids->GetId(1), p1);
+            for (vtkIdType i = 2; i < count; ++i) {
+                points->GetPoint(ids->GetId(i), p2);
+                const double u[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+                const double v[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+                const double normal[3] = {u[1] * v[2] - u[2] * v[1],
+                                          u[2] * v[0] - u[0] * v[2],
+                                          u[0] * v[1] - u[1] * v[0]};
+                measures.surfaceArea += 0.5 * std::sqrt(normal[0] * normal[0] + normal[1] * normal[1]
+                                                        + normal[2] * normal[2]);
+                measures.signedVolume += (p0[0] * normal[0] + p0[1] * normal[1] + p0[2] * normal[2]) / 6.0;
+                std::copy(p2, p2 + 3, p1);
+            }
+        }
+    });
+
+    double signedVolume = 0.0;
+    for (const MeshMeasures& measures : partials) {
+        signedVolume += measures.signedVolume;
+        surfaceArea += measures.surfaceArea;
+    }
+    volume = std::fabs(signedVolume);
+}
+
+void VTKUtils::attachMeshMeasures(vtkPolyData* polyData) {
+    if (!polyData || !polyData->GetFieldData()) {
+        return;
+    }
+    double volume = 0.0;
+    double surfaceArea = 0.0;
+    calculateMeshMeasures(polyData, volume, surfaceArea);
+
+    const char* const names[3] = {kVolumeFieldName, kSurfaceAreaFieldName, kMeasuresTimeFieldName};
+    const double values[3] = {volume, surfaceArea, geometryTime(polyData)};
+    for (int i = 0; i < 3; ++i) {
+        auto array = vtkSmartPointer<vtkDoubleArray>::New();
+        array->SetName(names[i]);
+        array->SetNumberOfTuples(1);
+        array->SetTuple1(0, values[i]);
+        polyData->GetFieldData()->AddArray(array);
+    }
+}
+
 double VTKUtils::calculateVolume(vtkPolyData* polyData) {
-    Q_UNUSED(polyData)
-    return 0.0;
+    double volume = 0.0;
+    if (readMeshMeasure(polyData, kVolumeFieldName, volume)) {
+        return volume;
+    }
+    double surfaceArea = 0.0;
+    calculateMeshMeasures(polyData, volume, surfaceArea);
+    return volume;
 }
 
 double VTKUtils::calculateSurfaceArea(vtkPolyData* polyData) {
-    Q_UNUSED(polyData)
-    return 0.0;
+    double surfaceArea = 0.0;
+    if (readMeshMeasure(polyData, kSurfaceAreaFieldName, surfaceArea)) {
+        return surfaceArea;
+    }
+    double volume = 0.0;
+    calculateMeshMeasures(polyData, volume, surfaceArea);
+    return surfaceArea;
 }
 
-#endif // VTK_AVAILABLE
-
 } // namespace MedicalImaging
@@ -70,7 +70,18 @@ public:
     // 数据范围工具
     static void getDataRange(vtkDataSet* dataSet, double range[2]);
     static void getScalarRange(vtkDataSet* dataSet, double range[2]);
-    static void normalizeData(vtkDataSet* dataSet);
+
+    // 强度归一化方式
+    enum NormalizationMethod {
+        MinMaxNormalization,        // 线性映射到[0, 1](整数类型映射到[0, 类型最大值])
+        ZScoreNormalization,        // (v − 均值) / 标准差
+        PercentileClipNormalization // 截断到[lowerPercent, upperPercent]百分位区间后按最小-最大映射
+    };
+
+    // 原地归一化点数据标量；z-score作用于整数类型时标量数组替换为float，其余情况保持类型
+    static bool normalizeData(vtkDataSet* dataSet,
+                              NormalizationMethod method = MinMaxNormalization,
+                              double lowerPercent = 1.0, double upperPercent = 99.0);
     
     // 文件I/O辅助
     static QString getVTKFileExtension(const QString& filename);
@@ -98,8 +109,13 @@ public:
     // 几何计算
     static double calculateDistance(const double point1[3], const double point2[3]);
     static void calculateCenter(vtkDataSet* dataSet, double center[3]);
+    // 闭合三角网格的体积与表面积；带有提取时度量(见attachMeshMeasures)且几何未再修改的网格直接读取
     static double calculateVolume(vtkPolyData* polyData);
     static double calculateSurfaceArea(vtkPolyData* polyData);
+    // 一次并行遍历多边形同时求体积与表面积(多边形按扇形三角化)
+    static void calculateMeshMeasures(vtkPolyData* polyData, double& volume, double& surfaceArea);
+    // 计算度量并以字段数据("Volume"、"SurfaceArea")附加到网格上，同时记录几何的修改时间("MeasuresMTime")
+    static void attachMeshMeasures(vtkPolyData* polyData);
 
 private:
     VTKUtils() = delete;  // 静态工具类，不允许实例化
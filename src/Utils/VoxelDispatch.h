@@ -0,0 +1,158 @@
+#ifndef VOXELDISPATCH_H
+#define VOXELDISPATCH_H
+
+#include "HalfFloat.h"
+#include <vtkImageData.h>
+#include <vtkType.h>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+namespace MedicalImaging {
+
+/**
+ * @brief vtkImageData标量内存的类型化跨步视图
+ *
+ * 步长以元素为单位，已包含分量数，因此component(c)只需偏移数据指针。
+ * 内核以模板形式针对具体体素类型编写，避免逐体素的类型转换和虚函数调用。
+ */
+template<typename T>
+struct VoxelView {
+    T* data = nullptr;
+    int dims[3] = {0, 0, 0};
+    vtkIdType strides[3] = {0, 0, 0};
+    int components = 1;
+
+    T& at(int x, int y, int z) const {
+        return data[x * strides[0] + y * strides[1] + z * strides[2]];
+    }
+
+    T* row(int y, int z) const {
+        return data + y * strides[1] + z * strides[2];
+    }
+
+    vtkIdType voxelCount() const {
+        return static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+    }
+
+    // 连续单分量存储时x方向可直接按指针步进，便于编译器向量化
+    bool isContiguous() const {
+        return components == 1 && strides[0] == 1;
+    }
+
+    VoxelView<T> component(int c) const {
+        VoxelView<T> view = *this;
+        view.data = data + c;
+        return view;
+    }
+
+    VoxelView<const T> asConst() const {
+        VoxelView<const T> view;
+        view.data = data;
+        for (int i = 0; i < 3; ++i) {
+            view.dims[i] = dims[i];
+            view.strides[i] = strides[i];
+        }
+        view.components = components;
+        return view;
+    }
+};
+
+template<typename T>
+VoxelView<T> makeVoxelView(vtkImageData* image) {
+    VoxelView<T> view;
+    if (!image) {
+        return view;
+    }
+    typedef typename std::remove_const<T>::type ValueType;
+    view.data = static_cast<ValueType*>(image->GetScalarPointer());
+    image->GetDimensions(view.dims);
+    view.components = image->GetNumberOfScalarComponents();
+    view.strides[0] = view.components;
+    view.strides[1] = view.strides[0] * view.dims[0];
+    view.strides[2] = view.strides[1] * view.dims[1];
+    return view;
+}
+
+// 连续存储的单分量缓冲区视图(中间结果)
+template<typename T>
+VoxelView<T> makeVoxelView(T* data, const int dims[3]) {
+    VoxelView<T> view;
+    view.data = data;
+    for (int i = 0; i < 3; ++i) {
+        view.dims[i] = dims[i];
+    }
+    view.strides[0] = 1;
+    view.strides[1] = dims[0];
+    view.strides[2] = static_cast<vtkIdType>(dims[0]) * dims[1];
+    return view;
+}
+
+template<typename T>
+struct VoxelTypeTag {
+    typedef T type;
+};
+
+/**
+ * @brief 按VTK标量类型在编译期实例化内核
+ *
+ * 支持uint8、int16、uint16、int32、float以及double；其他类型返回false，
+ * 由调用方决定回退方式。用法：
+ *   dispatchVoxelType(image->GetScalarType(), [&](auto tag) {
+ *       using T = typename decltype(tag)::type;
+ *       ...
+ *   });
+ */
+template<typename Functor>
+bool dispatchVoxelType(int vtkScalarType, Functor&& functor) {
+    switch (vtkScalarType) {
+        case VTK_UNSIGNED_CHAR:  functor(VoxelTypeTag<unsigned char>());  return true;
+        case VTK_SHORT:          functor(VoxelTypeTag<short>());          return true;
+        case VTK_UNSIGNED_SHORT: functor(VoxelTypeTag<unsigned short>()); return true;
+        case VTK_INT:            functor(VoxelTypeTag<int>());            return true;
+        case VTK_FLOAT:          functor(VoxelTypeTag<float>());          return true;
+        case VTK_DOUBLE:         functor(VoxelTypeTag<double>());         return true;
+        default:                 return false;
+    }
+}
+
+inline bool isDispatchableVoxelType(int vtkScalarType) {
+    return dispatchVoxelType(vtkScalarType, [](auto) {});
+}
+
+// 类型到VTK标量类型常量的映射
+template<typename T> struct VtkScalarTypeOf;
+template<> struct VtkScalarTypeOf<unsigned char>  { static const int value = VTK_UNSIGNED_CHAR; };
+template<> struct VtkScalarTypeOf<short>          { static const int value = VTK_SHORT; };
+template<> struct VtkScalarTypeOf<unsigned short> { static const int value = VTK_UNSIGNED_SHORT; };
+template<> struct VtkScalarTypeOf<int>            { static const int value = VTK_INT; };
+template<> struct VtkScalarTypeOf<float>          { static const int value = VTK_FLOAT; };
+template<> struct VtkScalarTypeOf<double>         { static const int value = VTK_DOUBLE; };
+
+/**
+ * @brief 浮点值写回体素类型：整数类型四舍五入并饱和截断
+ *
+ * Half按最近偶数舍入并饱和到±65504。
+ */
+template<typename T, typename S>
+inline T saturateCast(S value) {
+    if constexpr (std::is_same<T, Half>::value) {
+        return Half(static_cast<float>(value));
+    } else if constexpr (std::is_floating_point<T>::value) {
+        return static_cast<T>(value);
+    } else {
+        const S lowest = static_cast<S>(std::numeric_limits<T>::lowest());
+        const S highest = static_cast<S>(std::numeric_limits<T>::max());
+        if (!(value > lowest)) {
+            return std::numeric_limits<T>::lowest();
+        }
+        if (!(value < highest)) {
+            return std::numeric_limits<T>::max();
+        }
+        return static_cast<T>(std::lround(value));
+    }
+}
+
+} // namespace MedicalImaging
+
+#endif // VOXELDISPATCH_H